@@ -46,6 +46,11 @@ namespace CodeExpander
 		}
 	}
 
+	String getDirective(String line)
+	{
+		return line.substr(1).trimmed().split(U' ')[0];
+	}
+
 	void AnalyzeCode(String fileName, Code& res)
 	{
 		fileName = FileSystem::FullPath(fileName);
@@ -58,6 +63,7 @@ namespace CodeExpander
 		const String baseName = FileSystem::BaseName(fileName);
 		Array<String> bufferedSourceFiles;
 		bool siv3dIgnore = false;
+		int32 conditionDepth = 0; // 今いる #if の入れ子の深さ
 
 		while (reader.readLine(line))
 		{
@@ -81,7 +87,9 @@ namespace CodeExpander
 				
 				if (line.includes('<'))
 				{
-					res.libraries << includedFile;
+					// #if の中の標準ヘッダは環境によって無いことがある (<intrin.h> など) ので、先頭にまとめずその場に残す
+					if (conditionDepth > 0) res.codes << line;
+					else res.libraries << includedFile;
 				}
 				else if (baseName != FileSystem::BaseName(includedFile))
 				{
@@ -103,7 +111,18 @@ namespace CodeExpander
 				continue;
 			}
 
-			res.controllers << line;
+			// #pragma などはファイル全体に効くので先頭にまとめ、#if などの条件分岐はその場に残す
+			const String directive = getDirective(line);
+			if (directive == U"if" or directive == U"ifdef" or directive == U"ifndef") ++conditionDepth;
+			else if (directive == U"endif") --conditionDepth;
+			if (directive == U"pragma" or directive == U"undef")
+			{
+				res.controllers << line;
+			}
+			else
+			{
+				res.codes << line;
+			}
 		}
 
 		for (auto sourceFile : bufferedSourceFiles)
@@ -0,0 +1,399 @@
+﻿# include "EndgameSolver.hpp"
+# include <algorithm>
+# include <array>
+# include <bit>
+
+namespace Reversi
+{
+	namespace
+	{
+		constexpr uint64_t Corners = 0x8100000000000081;
+
+		/// @brief 盤面を 4 つに分けた区画 (左上, 右上, 左下, 右下)
+		constexpr uint64_t Quadrants[4] = {
+			0xF0F0F0F000000000, 0x0F0F0F0F00000000, 0x00000000F0F0F0F0, 0x000000000F0F0F0F,
+		};
+
+		/// @brief 空きマスが奇数個ある区画のマスク
+		inline uint64_t oddQuadrants(uint64_t empties)
+		{
+			uint64_t res = 0;
+			for (const uint64_t quadrant : Quadrants)
+			{
+				if (std::popcount(empties & quadrant) & 1) res |= quadrant;
+			}
+			return res;
+		}
+
+		/// @brief 終局の石差。空きマスは勝った側に数える
+		inline int32_t finalScore(uint64_t player, uint64_t opp)
+		{
+			const int32_t p = std::popcount(player), o = std::popcount(opp);
+			const int32_t diff = p - o;
+			if (diff > 0) return diff + (64 - p - o);
+			if (diff < 0) return diff - (64 - p - o);
+			return 0;
+		}
+
+		/// @brief 置換表のキー。解く局面は手番側から見た盤面なので手番は含めない
+		inline uint64_t hashBoard(uint64_t player, uint64_t opp)
+		{
+			uint64_t z = player * 0x9e3779b97f4a7c15 ^ std::rotl(opp, 29) * 0xc2b2ae3d27d4eb4f;
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+			return z ^ (z >> 31);
+		}
+	}
+
+	EndgameSolver::EndgameSolver(size_t hashSizeMB) :
+		m_table(hashSizeMB)
+	{
+	}
+
+	void EndgameSolver::clearHash()
+	{
+		m_table.clear();
+	}
+
+	void EndgameSolver::setStopCallback(std::function<bool()> shouldStop)
+	{
+		m_shouldStop = std::move(shouldStop);
+	}
+
+	EndgameSolver::Result EndgameSolver::solveWLD(const ReversiEngine& engine)
+	{
+		m_nodes = 0;
+		m_stopped = false;
+		m_table.newSearch();
+
+		Result res = searchRoot(engine, -1, 1);
+		if (not res.completed) return {};
+		res.score = (res.score > 0) - (res.score < 0);
+		return res;
+	}
+
+	EndgameSolver::Result EndgameSolver::solve(const ReversiEngine& engine)
+	{
+		// 勝敗で窓を半分に絞ってから石差を求める (子は PVS の null window で調べる)。引き分けならそれで終わり
+		const Result wld = solveWLD(engine);
+		if (not wld.completed or wld.score == 0) return wld;
+
+		Result res = wld.score > 0 ? searchRoot(engine, 0, ScoreInf) : searchRoot(engine, -ScoreInf, 0);
+		if (not res.completed)
+		{
+			// 勝敗の結果は確かなので、そちらの手を返す
+			res = wld;
+			res.completed = false;
+		}
+		return res;
+	}
+
+	bool EndgameSolver::countNode()
+	{
+		if ((++m_nodes & (StopCheckInterval - 1)) == 0 and m_shouldStop and m_shouldStop()) m_stopped = true;
+		return m_stopped;
+	}
+
+	EndgameSolver::Result EndgameSolver::searchRoot(const ReversiEngine& engine, int32_t alpha, int32_t beta)
+	{
+		const uint64_t player = engine.isBlackTurn() ? engine.getBlacks() : engine.getWhites();
+		const uint64_t opp = engine.isBlackTurn() ? engine.getWhites() : engine.getBlacks();
+		const uint64_t legals = calcLegals(player, opp);
+		Result res;
+
+		if (legals == 0)
+		{
+			res.score = -search(opp, player, -beta, -alpha, true);
+		}
+		else
+		{
+			TTEntry entry;
+			uint64_t ttMove = 0;
+			if (m_table.probe(hashBoard(player, opp), entry) and entry.bestMove != TTEntry::NoMove) ttMove = 1ull << entry.bestMove;
+
+			res.score = searchMoves(player, opp, legals, alpha, beta, ttMove, res.bestMove);
+			if (not m_stopped) m_table.store(hashBoard(player, opp), res.score, std::popcount(~(player | opp)), Bound::Exact, res.bestMove);
+		}
+
+		res.completed = not m_stopped;
+		return res;
+	}
+
+	int32_t EndgameSolver::search(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, bool passed)
+	{
+		const int32_t nEmpties = std::popcount(~(player | opp));
+		if (nEmpties < FastestFirstMinEmpties) return searchParity(player, opp, alpha, beta, passed);
+		if (countNode()) return 0;
+
+		const uint64_t legals = calcLegals(player, opp);
+		if (legals == 0)
+		{
+			if (passed) return finalScore(player, opp);
+			return -search(opp, player, -beta, -alpha, true);
+		}
+
+		// 空きマスが同じなら深さも同じなので、深さは比べずに値の種類だけ見る
+		const bool useHash = nEmpties >= HashMinEmpties;
+		const uint64_t key = useHash ? hashBoard(player, opp) : 0;
+		uint64_t ttMove = 0;
+		if (useHash)
+		{
+			TTEntry entry;
+			if (m_table.probe(key, entry))
+			{
+				if (entry.bestMove != TTEntry::NoMove) ttMove = 1ull << entry.bestMove;
+				if (entry.bound == Bound::Exact) return entry.score;
+				if (entry.bound == Bound::Lower and entry.score >= beta) return entry.score;
+				if (entry.bound == Bound::Upper and entry.score <= alpha) return entry.score;
+			}
+		}
+
+		uint64_t best = 0;
+		const int32_t score = searchMoves(player, opp, legals, alpha, beta, ttMove, best);
+		if (m_stopped) return 0;
+
+		if (useHash)
+		{
+			const Bound bound = score >= beta ? Bound::Lower : score > alpha ? Bound::Exact : Bound::Upper;
+			m_table.store(key, score, nEmpties, bound, best);
+		}
+		return score;
+	}
+
+	int32_t EndgameSolver::searchMoves(uint64_t player, uint64_t opp, uint64_t legals, int32_t alpha, int32_t beta, uint64_t ttMove, uint64_t& best)
+	{
+		struct Candidate
+		{
+			int32_t key;
+			uint64_t bit, flips;
+		};
+		std::array<Candidate, 64> moves;
+		int32_t nMoves = 0, i, j;
+
+		// 置換表の手を先に、残りは相手の着手可能数が少ない順。同数なら隅と奇数区画を先にする
+		const uint64_t odd = oddQuadrants(~(player | opp));
+		while (legals)
+		{
+			const uint64_t bit = legals & (0 - legals);
+			legals ^= bit;
+			const uint64_t flips = calcFlips(player, opp, std::countr_zero(bit));
+
+			int32_t key;
+			if (bit == ttMove)
+			{
+				key = 1 << 20;
+			}
+			else
+			{
+				key = -16 * std::popcount(calcLegals(opp ^ flips, player ^ flips ^ bit));
+				if (bit & Corners) key += 8;
+				if (bit & odd) key += 4;
+			}
+
+			// 挿入ソート (合法手は多くても 30 程度)
+			for (j = nMoves++; j > 0 and moves[j - 1].key < key; j--) moves[j] = moves[j - 1];
+			moves[j] = { key, bit, flips };
+		}
+
+		int32_t maxScore = -ScoreInf, g;
+		for (i = 0; i < nMoves; i++)
+		{
+			const uint64_t nextPlayer = opp ^ moves[i].flips;
+			const uint64_t nextOpp = player ^ moves[i].flips ^ moves[i].bit;
+
+			// 最初の手だけ全幅で読み、残りは alpha を超えるかだけ null window で確かめる
+			if (i == 0)
+			{
+				g = -search(nextPlayer, nextOpp, -beta, -alpha, false);
+			}
+			else
+			{
+				g = -search(nextPlayer, nextOpp, -alpha - 1, -alpha, false);
+				if (alpha < g and g < beta) g = -search(nextPlayer, nextOpp, -beta, -g, false);
+			}
+			if (m_stopped) return 0;
+
+			if (g > maxScore)
+			{
+				maxScore = g;
+				best = moves[i].bit;
+			}
+			if (g >= beta) break;
+			alpha = std::max(alpha, g);
+		}
+		return maxScore;
+	}
+
+	int32_t EndgameSolver::searchParity(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, bool passed)
+	{
+		const uint64_t empties = ~(player | opp);
+		if (std::popcount(empties) <= 4) return searchLast(player, opp, alpha, beta);
+		if (countNode()) return 0;
+
+		const uint64_t legals = calcLegals(player, opp);
+		if (legals == 0)
+		{
+			if (passed) return finalScore(player, opp);
+			return -searchParity(opp, player, -beta, -alpha, true);
+		}
+
+		// 奇数個の空きがある区画に打てば、その区画の最後の 1 マスを自分が取りやすい
+		const uint64_t odd = oddQuadrants(empties);
+		int32_t maxScore = -ScoreInf, g;
+		for (uint64_t moves : { legals & odd, legals & ~odd })
+		{
+			while (moves)
+			{
+				const int32_t sq = std::countr_zero(moves);
+				const uint64_t bit = 1ull << sq;
+				moves ^= bit;
+
+				const uint64_t flips = calcFlips(player, opp, sq);
+				g = -searchParity(opp ^ flips, player ^ flips ^ bit, -beta, -alpha, false);
+				if (m_stopped) return 0;
+
+				if (g > maxScore) maxScore = g;
+				if (g >= beta) return g;
+				alpha = std::max(alpha, g);
+			}
+		}
+		return maxScore;
+	}
+
+	int32_t EndgameSolver::searchLast(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta)
+	{
+		// 空きマスを奇数区画のものから並べる
+		const uint64_t empties = ~(player | opp);
+		const uint64_t odd = oddQuadrants(empties);
+		int32_t sq[4], n = 0;
+		for (uint64_t part : { empties & odd, empties & ~odd })
+		{
+			for (; part; part &= part - 1) sq[n++] = std::countr_zero(part);
+		}
+
+		switch (n)
+		{
+		case 4: return solve4(player, opp, alpha, beta, sq[0], sq[1], sq[2], sq[3], false);
+		case 3: return solve3(player, opp, alpha, beta, sq[0], sq[1], sq[2], false);
+		case 2: return solve2(player, opp, alpha, beta, sq[0], sq[1], false);
+		case 1: return solve1(player, opp, sq[0]);
+		default: return finalScore(player, opp);
+		}
+	}
+
+	int32_t EndgameSolver::solve4(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, int32_t sq1, int32_t sq2, int32_t sq3, int32_t sq4, bool passed)
+	{
+		m_nodes++;
+		int32_t maxScore = -ScoreInf, g;
+		uint64_t flips;
+
+		if ((flips = calcFlips(player, opp, sq1)))
+		{
+			g = -solve3(opp ^ flips, player ^ flips ^ (1ull << sq1), -beta, -alpha, sq2, sq3, sq4, false);
+			if (g >= beta) return g;
+			maxScore = g;
+			alpha = std::max(alpha, g);
+		}
+		if ((flips = calcFlips(player, opp, sq2)))
+		{
+			g = -solve3(opp ^ flips, player ^ flips ^ (1ull << sq2), -beta, -alpha, sq1, sq3, sq4, false);
+			if (g >= beta) return g;
+			maxScore = std::max(maxScore, g);
+			alpha = std::max(alpha, g);
+		}
+		if ((flips = calcFlips(player, opp, sq3)))
+		{
+			g = -solve3(opp ^ flips, player ^ flips ^ (1ull << sq3), -beta, -alpha, sq1, sq2, sq4, false);
+			if (g >= beta) return g;
+			maxScore = std::max(maxScore, g);
+			alpha = std::max(alpha, g);
+		}
+		if ((flips = calcFlips(player, opp, sq4)))
+		{
+			g = -solve3(opp ^ flips, player ^ flips ^ (1ull << sq4), -beta, -alpha, sq1, sq2, sq3, false);
+			return std::max(maxScore, g);
+		}
+
+		if (maxScore == -ScoreInf)
+		{
+			if (passed) return finalScore(player, opp);
+			return -solve4(opp, player, -beta, -alpha, sq1, sq2, sq3, sq4, true);
+		}
+		return maxScore;
+	}
+
+	int32_t EndgameSolver::solve3(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, int32_t sq1, int32_t sq2, int32_t sq3, bool passed)
+	{
+		m_nodes++;
+		int32_t maxScore = -ScoreInf, g;
+		uint64_t flips;
+
+		if ((flips = calcFlips(player, opp, sq1)))
+		{
+			g = -solve2(opp ^ flips, player ^ flips ^ (1ull << sq1), -beta, -alpha, sq2, sq3, false);
+			if (g >= beta) return g;
+			maxScore = g;
+			alpha = std::max(alpha, g);
+		}
+		if ((flips = calcFlips(player, opp, sq2)))
+		{
+			g = -solve2(opp ^ flips, player ^ flips ^ (1ull << sq2), -beta, -alpha, sq1, sq3, false);
+			if (g >= beta) return g;
+			maxScore = std::max(maxScore, g);
+			alpha = std::max(alpha, g);
+		}
+		if ((flips = calcFlips(player, opp, sq3)))
+		{
+			g = -solve2(opp ^ flips, player ^ flips ^ (1ull << sq3), -beta, -alpha, sq1, sq2, false);
+			return std::max(maxScore, g);
+		}
+
+		if (maxScore == -ScoreInf)
+		{
+			if (passed) return finalScore(player, opp);
+			return -solve3(opp, player, -beta, -alpha, sq1, sq2, sq3, true);
+		}
+		return maxScore;
+	}
+
+	int32_t EndgameSolver::solve2(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, int32_t sq1, int32_t sq2, bool passed)
+	{
+		m_nodes++;
+		int32_t maxScore = -ScoreInf, g;
+		uint64_t flips;
+
+		if ((flips = calcFlips(player, opp, sq1)))
+		{
+			g = -solve1(opp ^ flips, player ^ flips ^ (1ull << sq1), sq2);
+			if (g >= beta) return g;
+			maxScore = g;
+		}
+		if ((flips = calcFlips(player, opp, sq2)))
+		{
+			g = -solve1(opp ^ flips, player ^ flips ^ (1ull << sq2), sq1);
+			return std::max(maxScore, g);
+		}
+
+		if (maxScore == -ScoreInf)
+		{
+			if (passed) return finalScore(player, opp);
+			return -solve2(opp, player, -beta, -alpha, sq1, sq2, true);
+		}
+		return maxScore;
+	}
+
+	int32_t EndgameSolver::solve1(uint64_t player, uint64_t opp, int32_t sq)
+	{
+		// 残り 1 マスなので石の数は 63。石差は手番側の石の数と裏返る石の数だけで決まる
+		m_nodes++;
+		const int32_t p = std::popcount(player);
+		uint64_t flips = calcFlips(player, opp, sq);
+		if (flips) return 2 * (p + std::popcount(flips)) - 62;
+
+		flips = calcFlips(opp, player, sq);
+		if (flips) return 2 * (p - std::popcount(flips)) - 64;
+
+		// どちらも打てない
+		return p > 31 ? 2 * p - 62 : 2 * p - 64;
+	}
+}
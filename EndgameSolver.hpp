@@ -0,0 +1,85 @@
+﻿#pragma once
+# include "ReversiEngine.hpp"
+# include "TranspositionTable.hpp"
+# include <cstdint>
+# include <functional>
+
+namespace Reversi
+{
+	/// @brief 終盤の完全読み
+	/// 評価値は手番側から見た最終石差 (空きマスは勝った側に数える) です。
+	/// 勝敗 (WLD) は窓 (-1, 1) の、石差は勝敗で絞った窓の null window 探索 (PVS) で求めます。
+	/// 手は残り空きマスが多い所では相手の着手可能数の少ない順 (fastest-first)、少ない所では偶数理論 (奇数個の空きがある区画を先) で並べ、
+	/// 最後の 4 マスは合法手生成を使わない専用の関数で読みます。
+	class EndgameSolver
+	{
+	public:
+		struct Result
+		{
+			int32_t score = 0; // 最終石差。solveWLD では -1 / 0 / 1
+			uint64_t bestMove = 0; // 最善手のビット。パスか、勝敗も求まらずに打ち切られたら 0
+			bool completed = false; // 打ち切られずに読み終えたら true
+		};
+
+		/// @param hashSizeMB 置換表の大きさ (MB)
+		explicit EndgameSolver(size_t hashSizeMB = 16);
+
+		/// @brief 置換表の中身を消します
+		void clearHash();
+
+		/// @brief 探索を打ち切るかを返す関数を設定します。数千ノードごとに呼びます
+		void setStopCallback(std::function<bool()> shouldStop);
+
+		/// @brief 勝敗だけを求めます
+		Result solveWLD(const ReversiEngine& engine);
+
+		/// @brief 最終石差を求めます
+		/// 勝敗を求めた後で打ち切られたときは、completed を false にして勝敗の結果を返します
+		Result solve(const ReversiEngine& engine);
+
+		/// @brief 直前の solve / solveWLD で探索したノード数
+		int64_t getNodeCount() const { return m_nodes; }
+
+	private:
+		static constexpr int32_t ScoreInf = 65;
+
+		/// @brief 置換表を使う空きマス数の下限
+		static constexpr int32_t HashMinEmpties = 10;
+
+		/// @brief fastest-first で並べる空きマス数の下限。これ未満は偶数理論だけで並べる
+		static constexpr int32_t FastestFirstMinEmpties = 7;
+
+		/// @brief 停止を確かめる間隔 (ノード数、2 の冪)
+		static constexpr int64_t StopCheckInterval = 4096;
+
+		TranspositionTable m_table;
+		std::function<bool()> m_shouldStop;
+		int64_t m_nodes = 0;
+		bool m_stopped = false;
+
+		/// @brief ノード数を数え、一定間隔で停止を確かめます
+		/// @return 打ち切るなら true
+		bool countNode();
+
+		/// @brief ルートの全ての手を窓 (alpha, beta) で読みます
+		Result searchRoot(const ReversiEngine& engine, int32_t alpha, int32_t beta);
+
+		/// @brief 空きマス 5 以上の局面の探索
+		int32_t search(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, bool passed);
+
+		/// @brief 空きマス 5 から 6 程度の、置換表も fastest-first も使わない探索
+		int32_t searchParity(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, bool passed);
+
+		/// @brief 残り 4 マス以下の局面を専用の関数に振り分けます
+		int32_t searchLast(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta);
+
+		int32_t solve4(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, int32_t sq1, int32_t sq2, int32_t sq3, int32_t sq4, bool passed);
+		int32_t solve3(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, int32_t sq1, int32_t sq2, int32_t sq3, bool passed);
+		int32_t solve2(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, int32_t sq1, int32_t sq2, bool passed);
+		int32_t solve1(uint64_t player, uint64_t opp, int32_t sq);
+
+		/// @brief 子の局面を並べ替えた順に読み、PVS で値を求めます (search と searchRoot の共通部分)
+		/// @param best 最善手のビット
+		int32_t searchMoves(uint64_t player, uint64_t opp, uint64_t legals, int32_t alpha, int32_t beta, uint64_t ttMove, uint64_t& best);
+	};
+}
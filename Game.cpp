@@ -5,6 +5,8 @@
 # include "ReversiAgents/GreedyAgent.hpp"
 # include "ReversiAgents/MinMaxAgent.hpp"
 # include "ReversiAgents/AlphaBetaAgent.hpp"
+# include "ReversiAgents/YBWCAgent.hpp"
+# include <thread>
 
 void genAgents(Array<std::shared_ptr<ReversiAgent>>& agents)
 {
@@ -12,7 +14,17 @@ void genAgents(Array<std::shared_ptr<ReversiAgent>>& agents)
 	agents << std::make_shared<RandomAgent>();
 	agents << std::make_shared<GreedyAgent>();
 	agents << std::make_shared<MinMaxAgent>();
-	agents << std::make_shared<AlphaBetaAgent>();
+
+	// 対局中は 1 度に 1 人しか考えないので、全てのコアを使ってよい
+	const int32_t threads = static_cast<int32_t>(std::max(std::thread::hardware_concurrency(), 1u));
+
+	auto alphaBeta = std::make_shared<AlphaBetaAgent>();
+	alphaBeta->setThreadCount(threads);
+	agents << alphaBeta;
+
+	auto ybwc = std::make_shared<YBWCAgent>();
+	ybwc->setThreadCount(threads);
+	agents << ybwc;
 }
 
 
@@ -81,6 +93,19 @@ void Game::draw() const
 		FontAsset(U"bold")(U"分: {}"_fmt(gameStats.draws)).drawAt(width / 2, 100, ColorF{ 0.1 });
 		FontAsset(U"bold")(U"白: {}"_fmt(gameStats.p2Wins)).drawAt(width * 3 / 4, 100, ColorF{ 0.1 });
 	}
+
+	drawSearchStats(p1Search, AppData::Width / 2 + 10);
+	drawSearchStats(p2Search, AppData::Width * 3 / 4 + 5);
+}
+
+void Game::drawSearchStats(const SearchStats& stats, double x) const
+{
+	const double y = AppData::Height - 140;
+	const ColorF color{ 0.1 };
+	FontAsset(U"font")(U"深さ {}  {} nodes  {} ms"_fmt(stats.depth, stats.nodes, stats.timeUs / 1000)).draw(16, Vec2{ x, y }, color);
+	FontAsset(U"font")(U"{:.0f} nodes/s  分岐数 {:.2f}"_fmt(stats.nps(), stats.branchingFactor())).draw(16, Vec2{ x, y + 20 }, color);
+	FontAsset(U"font")(U"置換表 ヒット {:.1f}%  衝突 {:.1f}%"_fmt(stats.ttHitRate() * 100, stats.ttCollisionRate() * 100)).draw(16, Vec2{ x, y + 40 }, color);
+	FontAsset(U"font")(U"初手でカット {:.1f}%"_fmt(stats.firstMoveCutRate() * 100)).draw(16, Vec2{ x, y + 60 }, color);
 }
 
 void Game::reset()
@@ -93,6 +118,8 @@ void Game::reset()
 	legals = arr;
 	subjectiveState = boardState;
 	isFirstFrame = true;
+	p1Search = SearchStats();
+	p2Search = SearchStats();
 }
 
 void Game::updatePlayers()
@@ -127,6 +154,10 @@ void Game::updatePlayers()
 
 	Point pos = playTask.get();
 
+	// play は終わっているので統計を読んでよい
+	const auto& agents = engine.isBlackTurn() ? p1agents : p2agents;
+	(engine.isBlackTurn() ? p1Search : p2Search) = agents[*player.type.selectedItemIndex]->getSearchStats();
+
 	bool executed = engine.place(pos.x, pos.y);
 	if (not executed) return;
 
@@ -152,7 +183,7 @@ void Game::updatePlayers()
 void Game::updateUIs()
 {
 
-	if (SimpleGUI::ListBox(p1Info.type, { AppData::Width / 2 + 10, AppData::Height / 2 + 10 }, UIW, AppData::Height / 2 - 70))
+	if (SimpleGUI::ListBox(p1Info.type, { AppData::Width / 2 + 10, AppData::Height / 2 + 10 }, UIW, AppData::Height / 2 - 160))
 	{
 		p1Info.active = p1Info.type.selectedItemIndex == 0;
 		if (engine.isBlackTurn() and playTask.isValid())
@@ -163,7 +194,7 @@ void Game::updateUIs()
 		}
 		isFirstFrame = true;
 	}
-	if (SimpleGUI::ListBox(p2Info.type, { AppData::Width * 3 / 4 + 5, AppData::Height / 2 + 10 }, UIW, AppData::Height / 2 - 70))
+	if (SimpleGUI::ListBox(p2Info.type, { AppData::Width * 3 / 4 + 5, AppData::Height / 2 + 10 }, UIW, AppData::Height / 2 - 160))
 	{
 		p2Info.active = p2Info.type.selectedItemIndex == 0;
 		if (not engine.isBlackTurn() and playTask.isValid())
@@ -27,6 +27,7 @@ private:
 		U"Greedy",
 		U"MinMax",
 		U"AlphaBeta",
+		U"YBWC",
 	};
 
 	const int32 boardW = AppData::Width / 2 - 20;
@@ -47,6 +48,9 @@ private:
 	Statistics gameStats;
 	bool runningStats;
 
+	/// @brief それぞれの最後の手の探索の統計
+	SearchStats p1Search, p2Search;
+
 public:
 	Game(const InitData& init);
 	~Game();
@@ -56,4 +60,5 @@ public:
 	void updatePlayers();
 	void updateUIs();
 	void updateStats();
+	void drawSearchStats(const SearchStats& stats, double x) const;
 };
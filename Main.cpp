@@ -1,6 +1,7 @@
 ﻿# include "Main.hpp"
 # include "Game.hpp"
 # include "CodeExpander.hpp"
+# include "ReversiEval/WeightFile.hpp"
 # include "lib/CMat/CMat.hpp"
 
 
@@ -22,6 +23,12 @@ void Main()
 	y = { {9,8,7},{6,5,4},{3,2,1} };
 	Console << CMat::matmul(x, y);
 
+	// Tools/Tuner で学習した重みがあれば、全てのエージェントで使う
+	if (Reversi::Eval::loadWeightFile("eval.bin", Reversi::Eval::defaultPatternEvaluator()))
+	{
+		Console << U"eval.bin loaded";
+	}
+
 	MyApp app;
 
 	app.add<Game>(U"Game");
@@ -1,10 +1,32 @@
 ﻿# pragma once
 # include "../ReversiEngine.hpp"
+# include "SearchStats.hpp"
+# include <atomic>
+# include <algorithm>
+# include <utility>
 
 class ReversiAgent
 {
+public:
+	/// @brief 持ち時間の設定。0 の項目は指定なしとして扱います
+	struct TimeControl
+	{
+		int32_t moveTimeMs = 0; // 1 手に使える時間
+		int32_t remainingMs = 0; // 持ち時間の残り
+		int32_t incrementMs = 0; // 1 手ごとに加算される時間
+	};
+
+	/// @brief 1 手に使う時間の目安
+	struct TimeBudget
+	{
+		int32_t softMs; // これを過ぎたら次の反復を始めない
+		int32_t hardMs; // これを過ぎたら探索を打ち切る
+	};
+
 private:
-	bool m_abort;
+	std::atomic<bool> m_abort;
+	TimeControl m_timeControl;
+
 public:
 	using Pos = std::pair<int32_t, int32_t>;
 
@@ -23,7 +45,59 @@ public:
 	{
 		m_abort = true;
 	}
+
+	void setTimeControl(const TimeControl& timeControl)
+	{
+		m_timeControl = timeControl;
+	}
+
+	const TimeControl& getTimeControl() const
+	{
+		return m_timeControl;
+	}
+
+	/// @brief 直前の play の探索の統計 (play の最中に読んではいけません)
+	const SearchStats& getSearchStats() const
+	{
+		return m_searchStats;
+	}
 protected:
 	const int32_t inf = 1000000;
-	bool isAborted() { return m_abort; }
+
+	/// @brief play の中で書き込む探索の統計
+	SearchStats m_searchStats;
+	bool isAborted() const { return m_abort.load(std::memory_order_relaxed); }
+
+	/// @brief 持ち時間の設定からこの手に使う時間を決めます
+	/// @param empties 空きマスの数 (残りの手数の見積もりに使う)
+	/// @return 時間の指定が無ければ両方とも負の値
+	TimeBudget getTimeBudget(int32_t empties) const
+	{
+		const TimeControl& tc = m_timeControl;
+		int32_t hard = -1;
+
+		if (tc.remainingMs > 0)
+		{
+			// 自分の残り手数で均等に割り、加算分はほぼ使い切る
+			const int32_t movesLeft = std::max((empties + 1) / 2, 4);
+			const int32_t share = tc.remainingMs / movesLeft + tc.incrementMs * 3 / 4;
+			hard = std::min(share * 2, tc.remainingMs / 3);
+		}
+		if (tc.moveTimeMs > 0)
+		{
+			hard = hard < 0 ? tc.moveTimeMs : std::min(hard, tc.moveTimeMs);
+		}
+
+		if (hard < 0) return { -1, -1 };
+		hard = std::max(hard, 1);
+		// 次の反復は今までの合計より長くかかるので、半分を過ぎたら始めない
+		return { hard / 2, hard };
+	}
+
+	/// @brief マスのビットを座標に変換します
+	static Pos bit2pos(uint64_t bit)
+	{
+		const int32_t idx = 63 - std::countr_zero(bit);
+		return { idx & 7, idx >> 3 };
+	}
 };
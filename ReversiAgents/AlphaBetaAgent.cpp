@@ -1,116 +1,330 @@
 ﻿#include "AlphaBetaAgent.hpp"
+# include <thread>
+# include <vector>
 
-AlphaBetaAgent::AlphaBetaAgent()
+AlphaBetaAgent::AlphaBetaAgent(size_t hashSizeMB) :
+	transTable(hashSizeMB), endgameSolver(hashSizeMB)
 {
+	endgameSolver.setStopCallback([this]
+	{
+		checkStop();
+		return stopped.load();
+	});
+}
+
+void AlphaBetaAgent::setHashSize(size_t hashSizeMB)
+{
+	transTable.resize(hashSizeMB);
+}
+
+void AlphaBetaAgent::clearHash()
+{
+	transTable.clear();
+	endgameSolver.clearHash();
+}
+
+void AlphaBetaAgent::setSearchDepth(int32_t depth)
+{
+	searchDepth = std::max(depth, 1);
+}
+
+void AlphaBetaAgent::setEndgameEmpties(int32_t empties)
+{
+	endgameEmpties = std::max(empties, 0);
+}
+
+void AlphaBetaAgent::setEvaluator(const Reversi::Eval::PatternEvaluator& evaluator_)
+{
+	evaluator = &evaluator_;
+}
+
+void AlphaBetaAgent::setNetwork(const Reversi::Eval::NNEvaluator* network_)
+{
+	network = network_;
+}
+
+void AlphaBetaAgent::setThreadCount(int32_t threads)
+{
+	threadCount = std::max(threads, 1);
+}
 
+void AlphaBetaAgent::setAspiration(int32_t window, int32_t growth)
+{
+	aspirationWindow = std::max(window, 0);
+	aspirationGrowth = std::clamp(growth, 2, 16);
 }
 
 AlphaBetaAgent::Pos AlphaBetaAgent::play(const Reversi::ReversiEngine& engine)
 {
+	searchStart = std::chrono::steady_clock::now();
 	callCnt = 0;
-	Reversi::ReversiEngine env = engine;
-	if (not env.isBlackTurn()) env.swapBW(); // 黒を扱いたい
-	const uint64_t prevBlacks = env.getBlacks(), prevWhites = env.getWhites();
-	const int32_t SEARCH_DEPTH = 6;
+	lastDepth = 0;
+	stopped = false;
+	m_searchStats = SearchStats();
 
-	int32_t best = -1, score, alpha = -inf, beta = inf, depth;
-	std::vector<LegalState> legals;
+	Worker main;
+	main.engine = engine;
+	if (not main.engine.isBlackTurn()) main.engine.swapBW(); // 黒を扱いたい
+	main.network = network;
+	if (network) network->reset(main.nn, main.engine);
+	else main.patterns.reset(main.engine);
 
-	for (depth = 0; depth < SEARCH_DEPTH; depth++)
+	// 打てる手が無ければ読むものが無い。ルートの値が -inf のままになり、窓を広げる繰り返しが終わらなくなる
+	if (main.engine.getLegals() == 0)
 	{
-		if (isAborted()) break;
-		alpha = -inf, beta = inf;
+		m_searchStats.timeUs = elapsedUs();
+		return bit2pos(0);
+	}
+
+	const int32_t empties = 64 - std::popcount(main.engine.getBlacks() | main.engine.getWhites());
+	budget = getTimeBudget(empties);
+
+	if (empties <= endgameEmpties)
+	{
+		// 勝敗までは求まれば、その手は評価関数で読んだ手より確か
+		const auto res = endgameSolver.solve(main.engine);
+		callCnt = endgameSolver.getNodeCount();
+		if (res.bestMove != 0)
+		{
+			lastDepth = res.completed ? empties : 0;
+			m_searchStats.nodes = callCnt;
+			m_searchStats.depth = lastDepth;
+			m_searchStats.timeUs = elapsedUs();
+			return bit2pos(res.bestMove);
+		}
+		stopped = false;
+	}
+
+	// 置換表は反復の間も手の間も持ち越す。世代だけ進めて古いエントリを置き換えやすくする
+	transTable.newSearch();
+
+	// 補助スレッドの結果は置換表を通してだけ主スレッドに伝わる
+	std::vector<Worker> helpers(threadCount - 1);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < helpers.size(); i++)
+	{
+		helpers[i].engine = main.engine;
+		helpers[i].patterns = main.patterns;
+		helpers[i].nn = main.nn;
+		helpers[i].network = main.network;
+		helpers[i].id = static_cast<int32_t>(i + 1);
+		threads.emplace_back(&AlphaBetaAgent::helperSearch, this, std::ref(helpers[i]));
+	}
 
-		getSortedLegals(env, legals);
+	uint64_t best = 0, iterBest;
+	int32_t depth, score, alpha, beta, delta;
+	int32_t prevScore[2] = {};
 
-		for (auto [v, idx] : legals)
+	for (depth = 1; depth <= searchDepth; depth++)
+	{
+		if (isAborted()) break;
+		// 次の反復は終わりそうにないので始めない。深さ 1 だけは必ず読む
+		if (depth > 1 and budget.softMs >= 0 and elapsedMs() >= budget.softMs) break;
+
+		// 偶奇の同じ前の反復の値の近くに窓を絞り、外れたら外れた側だけ広げて読み直す
+		delta = aspirationWindow;
+		alpha = depth > 2 and delta > 0 ? std::max(prevScore[depth & 1] - delta, -inf) : -inf;
+		beta = depth > 2 and delta > 0 ? std::min(prevScore[depth & 1] + delta, inf) : inf;
+		while (true)
 		{
-			env.place(idx & 7, idx >> 3);
-			score = -negaAlpha(env, depth + 1, false, -beta, -alpha);
+			iterBest = best;
+			score = searchRoot(main, depth, alpha, beta, iterBest);
+			if (stopped) break;
+
+			if (score <= alpha) alpha = std::max(score - (delta = std::min(delta * aspirationGrowth, inf)), -inf);
+			else if (score >= beta) beta = std::min(score + (delta = std::min(delta * aspirationGrowth, inf)), inf);
+			else break;
+		}
+
+		// 途中で打ち切った反復の結果は使わない
+		if (stopped) break;
+
+		best = iterBest;
+		prevScore[depth & 1] = score;
+		lastDepth = depth;
+		// 補助スレッドのノードは読み終えるまで数えられないので、反復ごとの数は主スレッドの分だけ
+		m_searchStats.iterations.push_back({ depth, score, main.stats.nodes, elapsedUs() });
+	}
+
+	stopped = true;
+	for (auto& thread : threads) thread.join();
+
+	m_searchStats += main.stats;
+	for (const auto& helper : helpers) m_searchStats += helper.stats;
+	callCnt += m_searchStats.nodes;
+	m_searchStats.nodes = callCnt;
+	m_searchStats.depth = lastDepth;
+	m_searchStats.timeUs = elapsedUs();
+
+	// 1 回目の反復も終わらなかったときは、並べ替えで先頭に来た手を指す
+	if (best == 0)
+	{
+		LegalList legals;
+		if (getSortedLegals(main, legals, 0) > 0) best = legals[0].move.bit;
+	}
+	return bit2pos(best);
+}
+
+int32_t AlphaBetaAgent::searchRoot(Worker& worker, int32_t depth, int32_t alpha, int32_t beta, uint64_t& bestMove)
+{
+	LegalList legals;
+	const int32_t nLegals = getSortedLegals(worker, legals, bestMove);
+	const int32_t alphaOrig = alpha;
+	int32_t maxScore = -inf, score, i;
+	uint64_t best = 0;
+
+	// 補助スレッドは置換表の手の後ろをずらし、主スレッドと別の部分木から読み始める
+	if (worker.id > 0 and nLegals > 2)
+	{
+		std::rotate(legals.begin() + 1, legals.begin() + 1 + worker.id % (nLegals - 1), legals.begin() + nLegals);
+	}
 
-			if (alpha < score)
-			{
-				alpha = score;
-				best = idx;
-			}
+	for (i = 0; i < nLegals; i++)
+	{
+		const auto& move = legals[i].move;
+		doMove(worker, move);
+		// 最初の手だけ窓全体で読み、残りは alpha を超えるかだけ null window で確かめる
+		if (i == 0)
+		{
+			score = -negaAlpha(worker, depth - 1, false, -beta, -alpha);
+		}
+		else
+		{
+			score = -negaAlpha(worker, depth - 1, false, -alpha - 1, -alpha);
+			if (alpha < score and score < beta) score = -negaAlpha(worker, depth - 1, false, -beta, -score);
+		}
+		undoMove(worker, move);
+		if (stopped) return maxScore;
 
-			env.setState(prevBlacks, prevWhites, true);
+		if (score > maxScore)
+		{
+			maxScore = score;
+			best = move.bit;
 		}
-		transTable.swap(transTablePrev);
-		transTable.clear();
+		if (score >= beta) break;
+		alpha = std::max(alpha, score);
+	}
+
+	// 窓より下に外れたら、どの手も上限しか分からないので最善手は前のままにする
+	if (maxScore > alphaOrig) bestMove = best;
+	const Reversi::Bound bound = maxScore >= beta ? Reversi::Bound::Lower
+		: maxScore > alphaOrig ? Reversi::Bound::Exact : Reversi::Bound::Upper;
+	storeEntry(worker, maxScore, depth, bound, bestMove);
+	return maxScore;
+}
+
+void AlphaBetaAgent::helperSearch(Worker& worker)
+{
+	uint64_t best = 0;
+	// 奇数番は 1 つ深い所から読み、主スレッドより先の深さの置換表を埋める
+	for (int32_t depth = 1 + (worker.id & 1); depth <= searchDepth; depth++)
+	{
+		searchRoot(worker, depth, -inf, inf, best);
+		if (stopped) return;
 	}
-	return { best & 7, best >> 3 };
+}
+
+int64_t AlphaBetaAgent::elapsedMs() const
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - searchStart).count();
+}
+
+int64_t AlphaBetaAgent::elapsedUs() const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - searchStart).count();
+}
+
+void AlphaBetaAgent::checkStop()
+{
+	if (isAborted() or (budget.hardMs >= 0 and elapsedMs() >= budget.hardMs)) stopped = true;
 }
 
 void AlphaBetaAgent::reset_child()
 {
 }
 
-int32_t AlphaBetaAgent::negaAlpha(Reversi::ReversiEngine& engine, int32_t depth, bool passed, int32_t alpha, int32_t beta)
+int32_t AlphaBetaAgent::negaAlpha(Worker& worker, int32_t depth, bool passed, int32_t alpha, int32_t beta)
 {
-	callCnt++;
-	if (depth == 0) return eval(engine);
-	if (transTable.contains(engine.getTupleState())) return transTable[engine.getTupleState()];
+	REVERSI_TRACE_ZONE("negaAlpha");
+	Reversi::ReversiEngine& engine = worker.engine;
+
+	// 打ち切ったら値は使われないので、置換表に書かずにすぐ戻る
+	if ((++worker.stats.nodes & (TimeCheckInterval - 1)) == 0) checkStop();
+	if (stopped) return 0;
+	if (depth == 0) return eval(worker);
+
+	// 十分な深さで探索済みなら、値の種類に応じて使い回す。足りなくても最善手は並べ替えに使う
+	Reversi::TTEntry entry;
+	uint64_t ttMove = 0;
+	worker.stats.ttProbes++;
+	if (transTable.probe(engine.getHash(), entry))
+	{
+		worker.stats.ttHits++;
+		if (entry.bestMove != Reversi::TTEntry::NoMove) ttMove = 1ull << entry.bestMove;
+		if (entry.depth >= depth)
+		{
+			if (entry.bound == Reversi::Bound::Exact) return entry.score;
+			if (entry.bound == Reversi::Bound::Lower and entry.score >= beta) return entry.score;
+			if (entry.bound == Reversi::Bound::Upper and entry.score <= alpha) return entry.score;
+		}
+	}
 
-	const uint64_t prevBlacks = engine.getBlacks(), prevWhites = engine.getWhites();
-	const bool prevBlackTurn = engine.isBlackTurn();
-	int32_t maxScore = -inf, g = 0;
+	const int32_t alphaOrig = alpha;
+	int32_t maxScore = -inf, g = 0, nLegals, i;
+	uint64_t best = 0;
 
-	std::vector<LegalState> legals;
-	getSortedLegals(engine, legals);
+	LegalList legals;
+	nLegals = getSortedLegals(worker, legals, ttMove);
 
-	for (auto [v, idx] : legals)
+	// fail-soft: 窓の外に出た値もそのまま返し、境界値として保存する
+	for (i = 0; i < nLegals; i++)
 	{
-		engine.place(idx & 7, idx >> 3);
-		g = -negaAlpha(engine, depth - 1, false, -beta, -alpha);
-		if (g >= beta) return g;
+		const auto& move = legals[i].move;
+		doMove(worker, move);
+		// ルートと同じ PVS。null window で alpha を超えた手だけ窓全体で読み直す
+		if (i == 0)
+		{
+			g = -negaAlpha(worker, depth - 1, false, -beta, -alpha);
+		}
+		else
+		{
+			g = -negaAlpha(worker, depth - 1, false, -alpha - 1, -alpha);
+			if (alpha < g and g < beta) g = -negaAlpha(worker, depth - 1, false, -beta, -g);
+		}
+		undoMove(worker, move);
+		if (stopped) return 0;
+		if (g > maxScore)
+		{
+			maxScore = g;
+			best = move.bit;
+		}
+		if (g >= beta)
+		{
+			worker.stats.cutNodes++;
+			if (i == 0) worker.stats.firstMoveCuts++;
+			break;
+		}
 		alpha = std::max(alpha, g);
-		maxScore = std::max(maxScore, g);
-		engine.setState(prevBlacks, prevWhites, prevBlackTurn);
 	}
 
-	if (maxScore != -inf) return transTable[engine.getTupleState()] = maxScore; // 操作をした
-
-	if (passed) return transTable[engine.getTupleState()] = eval(engine); // パスの連続
-
-	// 初回のパス
-	engine.pass();
-	maxScore = -negaAlpha(engine, depth - 1, true, -beta, -alpha);
-	engine.pass();
-	return transTable[engine.getTupleState()] = maxScore;
-}
-
-inline int32_t AlphaBetaAgent::eval(const Reversi::ReversiEngine& engine) const
-{
-	uint64_t black = engine.getBlacks(), white = engine.getWhites();
-	int32_t score = 0;
-	score += rowValues[(0 << 8) + ((black & 0xFF00000000000000) >> 56)];
-	score += rowValues[(1 << 8) + ((black & 0x00FF000000000000) >> 48)];
-	score += rowValues[(2 << 8) + ((black & 0x0000FF0000000000) >> 40)];
-	score += rowValues[(3 << 8) + ((black & 0x000000FF00000000) >> 32)];
-	score += rowValues[(4 << 8) + ((black & 0x00000000FF000000) >> 24)];
-	score += rowValues[(5 << 8) + ((black & 0x0000000000FF0000) >> 16)];
-	score += rowValues[(6 << 8) + ((black & 0x000000000000FF00) >> 8)];
-	score += rowValues[(7 << 8) + ((black & 0x00000000000000FF))];
-	score -= rowValues[(0 << 8) + ((white & 0xFF00000000000000) >> 56)];
-	score -= rowValues[(1 << 8) + ((white & 0x00FF000000000000) >> 48)];
-	score -= rowValues[(2 << 8) + ((white & 0x0000FF0000000000) >> 40)];
-	score -= rowValues[(3 << 8) + ((white & 0x000000FF00000000) >> 32)];
-	score -= rowValues[(4 << 8) + ((white & 0x00000000FF000000) >> 24)];
-	score -= rowValues[(5 << 8) + ((white & 0x0000000000FF0000) >> 16)];
-	score -= rowValues[(6 << 8) + ((white & 0x000000000000FF00) >> 8)];
-	score -= rowValues[(7 << 8) + ((white & 0x00000000000000FF))];
-
-	if (not engine.isBlackTurn()) score = -score;
-	if (score > 0) // 四捨五入のため
-		score += 128;
-	else
-		score -= 128;
-	score /= 256; // 生の評価値は最終石差の256倍なので、256で割る
-	if (score > 64) score = 64; // 評価値を[-64, 64] に収める
-	else if (score < -64) score = -64;
-
-	score += std::popcount(engine.getLegals());
-
-	return score;
+	if (maxScore == -inf)
+	{
+		if (passed) // パスの連続
+		{
+			maxScore = eval(worker);
+			storeEntry(worker, maxScore, depth, Reversi::Bound::Exact, 0);
+			return maxScore;
+		}
+
+		// 初回のパス
+		engine.pass();
+		maxScore = -negaAlpha(worker, depth - 1, true, -beta, -alpha);
+		engine.pass();
+		if (stopped) return 0;
+	}
+
+	const Reversi::Bound bound = maxScore >= beta ? Reversi::Bound::Lower
+		: maxScore > alphaOrig ? Reversi::Bound::Exact : Reversi::Bound::Upper;
+	storeEntry(worker, maxScore, depth, bound, best);
+	return maxScore;
 }
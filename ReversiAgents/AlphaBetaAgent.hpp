@@ -1,111 +1,212 @@
 ﻿# pragma once
 
 # include "Agent.hpp"
-# include <unordered_map>
+# include "../TranspositionTable.hpp"
+# include "../Trace.hpp"
+# include "../EndgameSolver.hpp"
+# include "../ReversiEval/PatternEval.hpp"
+# include "../ReversiEval/NNEval.hpp"
+# include <array>
+# include <algorithm>
+# include <functional>
+# include <chrono>
+# include <atomic>
 
 class AlphaBetaAgent : public ReversiAgent
 {
 public:
-	AlphaBetaAgent();
+	/// @param hashSizeMB 置換表の大きさ (MB)
+	explicit AlphaBetaAgent(size_t hashSizeMB = 16);
 	Pos play(const Reversi::ReversiEngine& engine) override;
 	void reset_child() override;
+
+	/// @brief 置換表の大きさを変えます (中身は消えます)
+	void setHashSize(size_t hashSizeMB);
+
+	/// @brief 置換表の中身を消します (新しい対局の前など)
+	void clearHash();
+
+	/// @brief 反復深化で読む最大の深さ (ルートの手を含む) を設定します
+	/// 持ち時間 (setTimeControl) を設定したときは、時間内で読める所までの上限になります
+	void setSearchDepth(int32_t depth);
+
+	/// @brief 空きマスがこの数以下なら、評価関数で読む代わりに終局まで完全に読みます (0 なら使わない)
+	/// 持ち時間の内に勝敗も求まらなければ、いつもの探索に戻ります
+	void setEndgameEmpties(int32_t empties);
+
+	/// @brief 評価関数を設定します (既定は Reversi::Eval::defaultPatternEvaluator)
+	void setEvaluator(const Reversi::Eval::PatternEvaluator& evaluator);
+
+	/// @brief ニューラルネットの評価関数を設定します。設定している間はパターンの評価関数の代わりに使います
+	/// @param network 使う評価関数 (探索中は生きていること)。nullptr ならパターンの評価関数に戻します
+	void setNetwork(const Reversi::Eval::NNEvaluator* network);
+
+	/// @brief 探索に使うスレッド数を設定します (Lazy SMP)
+	/// 2 以上なら補助スレッドが同じルートを少しずらした深さと手順で探索し、置換表だけを共有します
+	void setThreadCount(int32_t threads);
+
+	/// @brief 反復深化の窓 (aspiration window) を設定します
+	/// 深さ 3 からは偶奇の同じ 1 つ前の反復 (深さ - 2) の値 ± window の窓で読み、外れたら外れた側の幅を growth 倍に広げて読み直します
+	/// (評価値は読む深さの偶奇で大きく振れるので、直前の反復の値を中心にすると外れてばかりになる)
+	/// @param window 最初の窓の片側の幅 (石差)。0 なら毎回全幅で読みます
+	/// @param growth 外れるたびに幅を何倍にするか (2 から 16)
+	void setAspiration(int32_t window, int32_t growth = 2);
+
+	/// @brief 直前の play で探索したノード数 (全スレッドの合計)
+	int64_t getNodeCount() const { return callCnt; }
+
+	/// @brief 直前の play で最後まで読み終えた深さ (完全読みなら空きマス数)
+	int32_t getLastDepth() const { return lastDepth; }
 private:
+	/// @brief Tools/MicroBench.cpp が非公開の getSortedLegals を測るため
+	friend struct MicroBenchAccess;
+
 	struct LegalState
 	{
-		int32_t score, idx;
-		inline bool operator<(const LegalState& a)
+		int32_t score;
+		Reversi::ReversiEngine::Move move;
+
+		// 同点なら盤面の右下側 (下位ビット) を大きいとみなす
+		inline bool operator<(const LegalState& a) const
 		{
 			if (score != a.score) return score < a.score;
-			return idx < a.idx;
+			return move.bit > a.move.bit;
 		}
 
-		inline bool operator>(const LegalState& a)
+		inline bool operator>(const LegalState& a) const
 		{
 			if (score != a.score) return score > a.score;
-			return idx > a.idx;
+			return move.bit < a.move.bit;
 		}
 	};
 
-	const std::vector<int32_t>valPerCell = {
-		2714, 147, 69, -18, -18, 69, 147, 2714,
-		147, -577, -186, -153, -153, -186, -577, 147,
-		69, -186, -379, -122, -122, -379, -186, 69,
-		-18, -153, -122, -169, -169, -122, -153, -18,
-		-18, -153, -122, -169, -169, -122, -153, -18,
-		69, -186, -379, -122, -122, -379, -186, 69,
-		147, -577, -186, -153, -153, -186, -577, 147,
-		2714, 147, 69, -18, -18, 69, 147, 2714,
+	/// @brief 1 局面の合法手を置いておく領域 (合法手は高々 64 個)
+	using LegalList = std::array<LegalState, 64>;
+
+	/// @brief スレッドごとの探索状態
+	struct Worker
+	{
+		Reversi::ReversiEngine engine;
+		Reversi::Eval::PatternState patterns; // engine と同じ局面のパターン番号 (network が無いとき)
+		Reversi::Eval::NNState nn; // engine と同じ局面のアキュムレータ (network があるとき)
+		const Reversi::Eval::NNEvaluator* network = nullptr;
+		SearchCounters stats;
+		int32_t id = 0; // 0 が主スレッド
 	};
 
-	const std::vector<int32_t>rowValues = _initRowValues();
-	const int32_t MAX_CALL_CNT = 100000;
+	/// @brief 着手を盤面と評価関数の差分の状態 (パターン番号かアキュムレータ) の両方に適用します
+	static inline void doMove(Worker& worker, const Reversi::ReversiEngine::Move& move)
+	{
+		REVERSI_TRACE_ZONE("doMove");
+		const bool blackMoved = worker.engine.isBlackTurn();
+		worker.engine.doMove(move);
+		if (worker.network) worker.network->update(worker.nn, move, blackMoved);
+		else worker.patterns.update(move, blackMoved);
+	}
 
-	std::vector<int32_t> _initRowValues()
+	/// @brief doMove で適用した着手を取り消します
+	static inline void undoMove(Worker& worker, const Reversi::ReversiEngine::Move& move)
 	{
-		//Grid<int32_t>res{ 8, (1 << 8) };
-		std::vector<int32_t> res(1 << 11);
-		int32_t i, bit, j;
-		for (i = 0; i < 8; i++)
-		{
-			for (bit = 0; bit < (1 << 8); bit++)
-			{
-				for (j = 0; j < 8; j++)
-				{
-					if (bit & (1 << (7 - j)))
-					{
-						res[(i << 8) + bit] += valPerCell[(i << 3) + j];
-					}
-				}
-			}
-		}
-		return res;
+		worker.engine.undoMove(move);
+		if (worker.network) worker.network->restore(worker.nn, move, worker.engine.isBlackTurn());
+		else worker.patterns.restore(move, worker.engine.isBlackTurn());
 	}
 
-	int32_t negaAlpha(Reversi::ReversiEngine& engine, int32_t depth, bool passed, int32_t alpha, int32_t beta);
+	/// @brief 時間と中断要求を確かめる間隔 (ノード数、2 の冪)
+	static constexpr int64_t TimeCheckInterval = 1024;
 
-	inline int32_t eval(const Reversi::ReversiEngine& engine) const;
+	/// @brief ルートの全ての手を窓 (alpha, beta) で読みます
+	/// @param bestMove 最善手のビット (並べ替えの先頭にも使います)。打ち切ったときと窓より下に外れたときは書き換えません
+	/// @return 最善手の評価値 (fail-soft なので窓の外なら境界値)。打ち切ったときの値は使えません
+	int32_t searchRoot(Worker& worker, int32_t depth, int32_t alpha, int32_t beta, uint64_t& bestMove);
 
+	/// @brief 補助スレッドの反復深化。stopped が立つか最大の深さまで読むと戻ります
+	void helperSearch(Worker& worker);
 
-	/// @brief 合法手をざっとした評価の高い順に並べて返します
-	/// @param engine リバーシエンジン
-	/// @param legalList 適当なリスト (スコア, 手)
-	inline void getSortedLegals(Reversi::ReversiEngine& engine, std::vector<LegalState>& legalList)
+	/// @brief PVS (NegaScout) で読みます。最初の手だけ窓全体で読み、残りは null window で確かめます
+	int32_t negaAlpha(Worker& worker, int32_t depth, bool passed, int32_t alpha, int32_t beta);
+
+	/// @brief 探索開始からの経過時間 (ms)
+	int64_t elapsedMs() const;
+
+	/// @brief 探索開始からの経過時間 (µs)
+	int64_t elapsedUs() const;
+
+	/// @brief 時間切れか中断要求があれば stopped を立てます
+	void checkStop();
+
+	/// @brief 今の局面を置換表に書き、書いた回数と追い出した回数を数えます
+	inline void storeEntry(Worker& worker, int32_t score, int32_t depth, Reversi::Bound bound, uint64_t bestMove)
 	{
-		const uint64_t legals = engine.getLegals();
-		const uint64_t prevBlacks = engine.getBlacks(), prevWhites = engine.getWhites();
-		const bool prevTurn = engine.isBlackTurn();
+		worker.stats.ttStores++;
+		if (transTable.store(worker.engine.getHash(), score, depth, bound, bestMove)) worker.stats.ttCollisions++;
+	}
+
+	inline int32_t eval(const Worker& worker) const
+	{
+		REVERSI_TRACE_ZONE("eval");
+		if (worker.network) return worker.network->evaluate(worker.nn, worker.engine);
+		return evaluator->evaluate(worker.patterns, worker.engine);
+	}
 
-		legalList.assign(std::popcount(legals), { 0,0 });
 
-		uint64_t mask = 0x8000000000000000;
-		int32_t idx = 0, i;
-		for (i = 0; i < 64; i++)
+	/// @brief 合法手をざっとした評価の高い順に並べて返します
+	/// 置換表の最善手を先頭にし、残りは置換表にある子の値か静的評価で並べます
+	/// @param worker 探索状態
+	/// @param legalList 結果を書き込む領域 (スコア, 手)
+	/// @param ttMove 置換表の最善手のビット。0 なら無し
+	/// @return 合法手の数
+	inline int32_t getSortedLegals(Worker& worker, LegalList& legalList, uint64_t ttMove)
+	{
+		REVERSI_TRACE_ZONE("getSortedLegals");
+		Reversi::ReversiEngine& engine = worker.engine;
+		uint64_t legals = engine.getLegals();
+		int32_t idx = 0;
+
+		while (legals)
 		{
-			if (not (legals & mask))
+			const uint64_t bit = legals & (0 - legals);
+			legals ^= bit;
+
+			const auto move = engine.makeMove(bit);
+			if (bit == ttMove)
 			{
-				mask >>= 1;
+				legalList[idx++] = { inf, move };
 				continue;
 			}
 
-			engine.place(i & 7, i >> 3);
+			doMove(worker, move);
 
-			if (transTablePrev.contains(engine.getTupleState()))
+			Reversi::TTEntry entry;
+			if (transTable.probe(engine.getHash(), entry))
 			{
-				legalList[idx++] = { 1000 - transTablePrev[engine.getTupleState()], i };
+				legalList[idx++] = { 1000 - entry.score, move };
 			}
 			else
 			{
-				legalList[idx++] = { -eval(engine), i };
+				legalList[idx++] = { -eval(worker), move };
 			}
 
-			engine.setState(prevBlacks, prevWhites, prevTurn);
-			mask >>= 1;
+			undoMove(worker, move);
 		}
 
-		std::sort(legalList.rbegin(), legalList.rend());
+		std::sort(legalList.begin(), legalList.begin() + idx, std::greater<>{});
+		return idx;
 	}
 
-	int32_t callCnt;
-	std::unordered_map<std::tuple<uint64_t, uint64_t, bool>, int32_t, Reversi::TupleHash> transTable, transTablePrev;
-	//HashTable<std::tuple<uint64_t, uint64_t, bool>, int32_t> transTable, transTablePrev;
+	int64_t callCnt = 0;
+	int32_t searchDepth = 7;
+	int32_t lastDepth = 0;
+	int32_t threadCount = 1;
+	int32_t endgameEmpties = 16;
+	int32_t aspirationWindow = 2;
+	int32_t aspirationGrowth = 2;
+
+	std::chrono::steady_clock::time_point searchStart;
+	TimeBudget budget = { -1, -1 };
+	std::atomic<bool> stopped = false; // 全スレッドの探索を打ち切る
+	Reversi::TranspositionTable transTable;
+	Reversi::EndgameSolver endgameSolver;
+	const Reversi::Eval::PatternEvaluator* evaluator = &Reversi::Eval::defaultPatternEvaluator();
+	const Reversi::Eval::NNEvaluator* network = nullptr;
 };
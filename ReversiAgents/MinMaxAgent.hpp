@@ -1,6 +1,7 @@
 ﻿# pragma once
 
 # include "Agent.hpp"
+# include "../ReversiEval/SquareEval.hpp"
 
 class MinMaxAgent : public ReversiAgent
 {
@@ -9,41 +10,14 @@ public:
 	Pos play(const Reversi::ReversiEngine& engine) override;
 	void reset_child() override;
 private:
-	const Grid<int32>valPerCell = {
-		{ 2714, 147, 69, -18, -18, 69, 147, 2714 },
-		{ 147, -577, -186, -153, -153, -186, -577, 147 },
-		{ 69, -186, -379, -122, -122, -379, -186, 69 },
-		{ -18, -153, -122, -169, -169, -122, -153, -18 },
-		{ -18, -153, -122, -169, -169, -122, -153, -18 },
-		{ 69, -186, -379, -122, -122, -379, -186, 69 },
-		{ 147, -577, -186, -153, -153, -186, -577, 147 },
-		{ 2714, 147, 69, -18, -18, 69, 147, 2714 },
-	};
+	/// @brief 評価関数。マスごとの価値を別の Policy にすれば差し替えられる
+	using Evaluator = Reversi::Eval::SquareEvaluator<>;
 
-	const Grid<int32>rowValues = _initRowValues();
+	/// @brief ルートの手の後に読む深さ
+	static constexpr int32_t SearchDepth = 3;
 
-	constexpr Grid<int32> _initRowValues()
-	{
-		Grid<int32>res{ 8, (1 << 8) };
-		for (int32 i : step(8))
-		{
-			for (int32 bit : step(1 << 8))
-			{
-				for (int32 j : step(8))
-				{
-					if (bit & (1 << (7 - j)))
-					{
-						res[i][bit] += valPerCell[i][j];
-					}
-				}
-			}
-		}
-		return res;
-	}
+	int32_t negaMax(Reversi::ReversiEngine& engine, int32_t depth, bool passed);
 
-	int32 negaMax(Reversi::ReversiEngine& engine, int32 depth, bool passed);
 
-	inline int32 eval(const Reversi::ReversiEngine& engine) const;
-
-	int32 callCnt;
+	int64_t callCnt = 0;
 };
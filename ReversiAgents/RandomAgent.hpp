@@ -1,26 +1,26 @@
 ﻿#pragma once
 # include "Agent.hpp"
+# include <bit>
+# include <random>
 
 class RandomAgent : public ReversiAgent
 {
 public:
-	RandomAgent() {}
+	RandomAgent() : m_rng(std::random_device{}()) {}
+
+	/// @param seed 乱数の種 (同じ種なら同じ手を選びます)
+	explicit RandomAgent(uint64_t seed) : m_rng(seed) {}
+
 	Pos play(const Reversi::ReversiEngine& engine) override
 	{
-		uint64 uintlegals = engine.getLegals();
-		Array<int32> legals;
-		uint64 mask = 0x8000000000000000;
-		for (int32 i : step(64))
-		{
-			if (uintlegals & mask)
-			{
-				legals << i;
-			}
-			mask >>= 1;
-		}
+		uint64_t legals = engine.getLegals();
+		if (legals == 0) return bit2pos(0); // 打てる手が無い (パス)
 
-		int32 p = Sample(legals);
-		return { p % 8, p / 8 };
+		// n 番目に立っているビットを選ぶ
+		for (uint64_t n = m_rng() % std::popcount(legals); n > 0; --n) legals &= legals - 1;
+		return bit2pos(legals & (0 - legals));
 	}
 	void reset_child() override {}
+private:
+	std::mt19937_64 m_rng;
 };
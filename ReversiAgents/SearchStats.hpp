@@ -0,0 +1,70 @@
+﻿# pragma once
+# include <cstdint>
+# include <vector>
+
+/// @brief 探索しながら数える値
+/// スレッドや作業ごとに持って数え、最後に足し合わせます。
+struct SearchCounters
+{
+	int64_t nodes = 0; // 探索したノード数
+	int64_t ttProbes = 0; // 置換表を引いた回数 (手の並べ替えのためのものは除く)
+	int64_t ttHits = 0; // そのうち見つかった回数
+	int64_t ttStores = 0; // 置換表に書いた回数
+	int64_t ttCollisions = 0; // そのうち別の局面のエントリを追い出した回数
+	int64_t cutNodes = 0; // beta カットしたノード数
+	int64_t firstMoveCuts = 0; // そのうち最初に読んだ手でカットしたもの
+
+	SearchCounters& operator+=(const SearchCounters& other)
+	{
+		nodes += other.nodes;
+		ttProbes += other.ttProbes;
+		ttHits += other.ttHits;
+		ttStores += other.ttStores;
+		ttCollisions += other.ttCollisions;
+		cutNodes += other.cutNodes;
+		firstMoveCuts += other.firstMoveCuts;
+		return *this;
+	}
+};
+
+/// @brief 反復深化の 1 回の反復の結果
+struct IterationStats
+{
+	int32_t depth;
+	int32_t score; // ルートの評価値
+	int64_t nodes; // この反復の終わりまでのノード数の合計
+	int64_t timeUs; // 探索開始からこの反復の終わりまでの時間 (µs)
+};
+
+/// @brief 1 回の play の探索の統計
+struct SearchStats : SearchCounters
+{
+	int32_t depth = 0; // 最後まで読み終えた深さ (完全読みなら空きマス数)
+	int64_t timeUs = 0; // play にかかった時間 (µs)
+	std::vector<IterationStats> iterations; // 読み終えた反復 (反復深化しないエージェントでは 1 つか空)
+
+	/// @brief 1 秒あたりのノード数
+	double nps() const { return timeUs > 0 ? nodes * 1e6 / timeUs : 0.0; }
+
+	/// @brief 置換表を引いて見つかった割合
+	double ttHitRate() const { return ratio(ttHits, ttProbes); }
+
+	/// @brief 置換表に書いたときに別の局面を追い出した割合
+	double ttCollisionRate() const { return ratio(ttCollisions, ttStores); }
+
+	/// @brief beta カットのうち最初に読んだ手でカットした割合 (手の並べ替えの良さ)
+	double firstMoveCutRate() const { return ratio(firstMoveCuts, cutNodes); }
+
+	/// @brief 実効分岐数 (最後の反復のノード数 / その前の反復のノード数)。反復が 2 つ無ければ 0
+	double branchingFactor() const
+	{
+		const size_t n = iterations.size();
+		if (n < 2) return 0.0;
+		const int64_t last = iterations[n - 1].nodes - iterations[n - 2].nodes;
+		const int64_t prev = iterations[n - 2].nodes - (n >= 3 ? iterations[n - 3].nodes : 0);
+		return ratio(last, prev);
+	}
+
+private:
+	static double ratio(int64_t a, int64_t b) { return b > 0 ? static_cast<double>(a) / b : 0.0; }
+};
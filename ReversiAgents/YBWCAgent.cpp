@@ -0,0 +1,343 @@
+﻿#include "YBWCAgent.hpp"
+
+namespace
+{
+	/// @brief 時間を確かめるためのスレッドごとのノード数
+	/// 弟の作業は小さいことが多いので、作業ごとの Worker::stats では数えない
+	thread_local int64_t t_checkCounter = 0;
+}
+
+YBWCAgent::YBWCAgent(size_t hashSizeMB) :
+	transTable(hashSizeMB)
+{
+
+}
+
+void YBWCAgent::setHashSize(size_t hashSizeMB)
+{
+	transTable.resize(hashSizeMB);
+}
+
+void YBWCAgent::clearHash()
+{
+	transTable.clear();
+}
+
+void YBWCAgent::setSearchDepth(int32_t depth)
+{
+	searchDepth = std::max(depth, 1);
+}
+
+void YBWCAgent::setEvaluator(const Reversi::Eval::PatternEvaluator& evaluator_)
+{
+	evaluator = &evaluator_;
+}
+
+void YBWCAgent::setThreadCount(int32_t threads)
+{
+	threadCount = std::max(threads, 1);
+}
+
+void YBWCAgent::setAspiration(int32_t window, int32_t growth)
+{
+	aspirationWindow = std::max(window, 0);
+	aspirationGrowth = std::clamp(growth, 2, 16);
+}
+
+YBWCAgent::Pos YBWCAgent::play(const Reversi::ReversiEngine& engine)
+{
+	searchStart = std::chrono::steady_clock::now();
+	callCnt = 0;
+	lastDepth = 0;
+	stopped = false;
+	siblingStats = SearchCounters();
+	splitCnt = 0;
+	m_searchStats = SearchStats();
+
+	Worker main;
+	main.engine = engine;
+	if (not main.engine.isBlackTurn()) main.engine.swapBW(); // 黒を扱いたい
+	main.patterns.reset(main.engine);
+
+	// 打てる手が無ければ読むものが無い。ルートの値が -inf のままになり、窓を広げる繰り返しが終わらなくなる
+	if (main.engine.getLegals() == 0)
+	{
+		m_searchStats.timeUs = elapsedUs();
+		return bit2pos(0);
+	}
+
+	budget = getTimeBudget(64 - std::popcount(main.engine.getBlacks() | main.engine.getWhites()));
+	transTable.newSearch();
+
+	// 1 スレッドなら作業を積まずに AlphaBetaAgent と同じ順に読む
+	Reversi::WorkStealingPool workers(threadCount);
+	pool = threadCount > 1 ? &workers : nullptr;
+
+	uint64_t best = 0, iterBest;
+	int32_t depth, score, alpha, beta, delta;
+	int32_t prevScore[2] = {};
+
+	for (depth = 1; depth <= searchDepth; depth++)
+	{
+		if (isAborted()) break;
+		// 次の反復は終わりそうにないので始めない。深さ 1 だけは必ず読む
+		if (depth > 1 and budget.softMs >= 0 and elapsedMs() >= budget.softMs) break;
+
+		// 偶奇の同じ前の反復の値の近くに窓を絞り、外れたら外れた側だけ広げて読み直す (AlphaBetaAgent と同じ)
+		delta = aspirationWindow;
+		alpha = depth > 2 and delta > 0 ? std::max(prevScore[depth & 1] - delta, -inf) : -inf;
+		beta = depth > 2 and delta > 0 ? std::min(prevScore[depth & 1] + delta, inf) : inf;
+		while (true)
+		{
+			iterBest = best;
+			score = searchRoot(main, depth, alpha, beta, iterBest);
+			if (stopped) break;
+
+			if (score <= alpha) alpha = std::max(score - (delta = std::min(delta * aspirationGrowth, inf)), -inf);
+			else if (score >= beta) beta = std::min(score + (delta = std::min(delta * aspirationGrowth, inf)), inf);
+			else break;
+		}
+
+		// 途中で打ち切った反復の結果は使わない
+		if (stopped) break;
+
+		best = iterBest;
+		prevScore[depth & 1] = score;
+		lastDepth = depth;
+
+		// 反復を終えたときには弟の作業も全て終わっている
+		std::lock_guard lock{ statsMutex };
+		m_searchStats.iterations.push_back({ depth, score, main.stats.nodes + siblingStats.nodes, elapsedUs() });
+	}
+
+	pool = nullptr;
+	m_searchStats += main.stats;
+	m_searchStats += siblingStats;
+	m_searchStats.depth = lastDepth;
+	m_searchStats.timeUs = elapsedUs();
+	callCnt = m_searchStats.nodes;
+
+	// 1 回目の反復も終わらなかったときは、並べ替えで先頭に来た手を指す
+	if (best == 0)
+	{
+		LegalList legals;
+		if (getSortedLegals(main, legals, 0) > 0) best = legals[0].move.bit;
+	}
+	return bit2pos(best);
+}
+
+int32_t YBWCAgent::searchRoot(Worker& worker, int32_t depth, int32_t alpha, int32_t beta, uint64_t& bestMove)
+{
+	LegalList legals;
+	const int32_t nLegals = getSortedLegals(worker, legals, bestMove);
+	int32_t maxScore = -inf;
+	uint64_t best = 0;
+
+	searchMoves(worker, nullptr, legals, nLegals, depth, alpha, beta, maxScore, best);
+	if (stopped) return maxScore;
+
+	// 窓より下に外れたら、どの手も上限しか分からないので最善手は前のままにする
+	if (maxScore > alpha) bestMove = best;
+	const Reversi::Bound bound = maxScore >= beta ? Reversi::Bound::Lower
+		: maxScore > alpha ? Reversi::Bound::Exact : Reversi::Bound::Upper;
+	storeEntry(worker, maxScore, depth, bound, bestMove);
+	return maxScore;
+}
+
+void YBWCAgent::reset_child()
+{
+}
+
+void YBWCAgent::searchMoves(Worker& worker, const SplitPoint* split, const LegalList& legals, int32_t nLegals,
+	int32_t depth, int32_t alpha, int32_t beta, int32_t& maxScore, uint64_t& best)
+{
+	int32_t g, i;
+
+	for (i = 0; i < nLegals; i++)
+	{
+		// 長男を読み終えても beta カットしなかったら、残りの弟はまとめて作業にする
+		if (i == 1 and pool != nullptr and depth >= MinSplitDepth)
+		{
+			SplitPoint sp;
+			sp.parent = split;
+			sp.alpha = alpha;
+			sp.beta = beta;
+			sp.bestScore = maxScore;
+			sp.bestMove = best;
+			sp.depth = depth;
+			sp.pending = nLegals - 1;
+			splitCnt++;
+
+			// 自分は末尾から、盗む側は先頭から取るので、先に読みたい弟が末尾に来るよう逆順に積む
+			for (int32_t k = nLegals - 1; k >= 1; k--)
+			{
+				pool->push([this, &sp, parent = worker, move = legals[k].move] { searchSibling(sp, parent, move); });
+			}
+			pool->wait(sp.pending);
+
+			maxScore = sp.bestScore;
+			best = sp.bestMove;
+			return;
+		}
+
+		const auto& move = legals[i].move;
+		doMove(worker, move);
+		// 最初の手だけ窓全体で読み、残りは alpha を超えるかだけ null window で確かめる
+		if (i == 0)
+		{
+			g = -negaAlpha(worker, split, depth - 1, false, -beta, -alpha);
+		}
+		else
+		{
+			g = -negaAlpha(worker, split, depth - 1, false, -alpha - 1, -alpha);
+			if (alpha < g and g < beta) g = -negaAlpha(worker, split, depth - 1, false, -beta, -g);
+		}
+		undoMove(worker, move);
+		if (isCancelled(split)) return;
+
+		if (g > maxScore)
+		{
+			maxScore = g;
+			best = move.bit;
+		}
+		if (g >= beta)
+		{
+			worker.stats.cutNodes++;
+			if (i == 0) worker.stats.firstMoveCuts++;
+			return;
+		}
+		alpha = std::max(alpha, g);
+	}
+}
+
+void YBWCAgent::searchSibling(SplitPoint& sp, const Worker& parent, Reversi::ReversiEngine::Move move)
+{
+	if (not isCancelled(&sp))
+	{
+		Worker worker;
+		worker.engine = parent.engine;
+		worker.patterns = parent.patterns;
+		doMove(worker, move);
+
+		int32_t alpha;
+		{
+			std::lock_guard lock{ sp.mutex };
+			alpha = sp.alpha;
+		}
+
+		// 積んだ後に兄弟が窓を狭めていれば、その alpha を超えるかを null window で確かめる
+		int32_t g = -negaAlpha(worker, &sp, sp.depth - 1, false, -alpha - 1, -alpha);
+		if (alpha < g and g < sp.beta and not isCancelled(&sp))
+		{
+			// 読み直す前に兄弟がさらに alpha を上げていれば、この手は最善ではないので読み直さない
+			{
+				std::lock_guard lock{ sp.mutex };
+				alpha = sp.alpha;
+			}
+			if (alpha < g) g = -negaAlpha(worker, &sp, sp.depth - 1, false, -sp.beta, -g);
+		}
+
+		if (not isCancelled(&sp))
+		{
+			std::lock_guard lock{ sp.mutex };
+			if (g > sp.bestScore)
+			{
+				sp.bestScore = g;
+				sp.bestMove = move.bit;
+			}
+			if (g >= sp.beta)
+			{
+				if (not sp.cutoff) worker.stats.cutNodes++; // 分割点のカットは 1 回と数える
+				sp.cutoff = true;
+			}
+			else sp.alpha = std::max(sp.alpha, g);
+		}
+		std::lock_guard lock{ statsMutex };
+		siblingStats += worker.stats;
+	}
+
+	// これ以降 sp は積んだ側が片付けるかもしれないので触らない
+	sp.pending.fetch_sub(1, std::memory_order_release);
+}
+
+bool YBWCAgent::isCancelled(const SplitPoint* split) const
+{
+	if (stopped.load(std::memory_order_relaxed)) return true;
+	for (; split != nullptr; split = split->parent)
+	{
+		if (split->cutoff.load(std::memory_order_relaxed)) return true;
+	}
+	return false;
+}
+
+int64_t YBWCAgent::elapsedMs() const
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - searchStart).count();
+}
+
+int64_t YBWCAgent::elapsedUs() const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - searchStart).count();
+}
+
+void YBWCAgent::checkStop()
+{
+	if (isAborted() or (budget.hardMs >= 0 and elapsedMs() >= budget.hardMs)) stopped = true;
+}
+
+int32_t YBWCAgent::negaAlpha(Worker& worker, const SplitPoint* split, int32_t depth, bool passed, int32_t alpha, int32_t beta)
+{
+	REVERSI_TRACE_ZONE("negaAlpha");
+	Reversi::ReversiEngine& engine = worker.engine;
+
+	// 打ち切ったか兄弟が beta カットしたら値は使われないので、置換表に書かずにすぐ戻る
+	worker.stats.nodes++;
+	if ((++t_checkCounter & (TimeCheckInterval - 1)) == 0) checkStop();
+	if (isCancelled(split)) return 0;
+	if (depth == 0) return eval(worker);
+
+	// 十分な深さで探索済みなら、値の種類に応じて使い回す。足りなくても最善手は並べ替えに使う
+	Reversi::TTEntry entry;
+	uint64_t ttMove = 0;
+	worker.stats.ttProbes++;
+	if (transTable.probe(engine.getHash(), entry))
+	{
+		worker.stats.ttHits++;
+		if (entry.bestMove != Reversi::TTEntry::NoMove) ttMove = 1ull << entry.bestMove;
+		if (entry.depth >= depth)
+		{
+			if (entry.bound == Reversi::Bound::Exact) return entry.score;
+			if (entry.bound == Reversi::Bound::Lower and entry.score >= beta) return entry.score;
+			if (entry.bound == Reversi::Bound::Upper and entry.score <= alpha) return entry.score;
+		}
+	}
+
+	int32_t maxScore = -inf;
+	uint64_t best = 0;
+
+	LegalList legals;
+	const int32_t nLegals = getSortedLegals(worker, legals, ttMove);
+	searchMoves(worker, split, legals, nLegals, depth, alpha, beta, maxScore, best);
+	if (isCancelled(split)) return 0;
+
+	if (maxScore == -inf)
+	{
+		if (passed) // パスの連続
+		{
+			maxScore = eval(worker);
+			storeEntry(worker, maxScore, depth, Reversi::Bound::Exact, 0);
+			return maxScore;
+		}
+
+		// 初回のパス
+		engine.pass();
+		maxScore = -negaAlpha(worker, split, depth - 1, true, -beta, -alpha);
+		engine.pass();
+		if (isCancelled(split)) return 0;
+	}
+
+	const Reversi::Bound bound = maxScore >= beta ? Reversi::Bound::Lower
+		: maxScore > alpha ? Reversi::Bound::Exact : Reversi::Bound::Upper;
+	storeEntry(worker, maxScore, depth, bound, best);
+	return maxScore;
+}
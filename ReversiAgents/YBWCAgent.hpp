@@ -0,0 +1,222 @@
+﻿# pragma once
+
+# include "Agent.hpp"
+# include "../TranspositionTable.hpp"
+# include "../Trace.hpp"
+# include "../WorkStealingPool.hpp"
+# include "../ReversiEval/PatternEval.hpp"
+# include <array>
+# include <algorithm>
+# include <functional>
+# include <chrono>
+# include <atomic>
+# include <mutex>
+
+/// @brief Young Brothers Wait による並列 alpha-beta 探索
+/// 各局面で最初の手 (長男) を読み終えてから、残りの手 (弟) を作業としてプールに積み、空いたスレッドに盗ませます。
+/// 探索の中身 (評価関数、置換表、手の並べ替え、PVS と aspiration window) は AlphaBetaAgent と同じなので、
+/// 1 スレッドなら同じノード数になります (AlphaBetaAgent の完全読みを使わないとき)。
+class YBWCAgent : public ReversiAgent
+{
+public:
+	/// @param hashSizeMB 置換表の大きさ (MB)
+	explicit YBWCAgent(size_t hashSizeMB = 16);
+	Pos play(const Reversi::ReversiEngine& engine) override;
+	void reset_child() override;
+
+	/// @brief 置換表の大きさを変えます (中身は消えます)
+	void setHashSize(size_t hashSizeMB);
+
+	/// @brief 置換表の中身を消します (新しい対局の前など)
+	void clearHash();
+
+	/// @brief 反復深化で読む最大の深さ (ルートの手を含む) を設定します
+	void setSearchDepth(int32_t depth);
+
+	/// @brief 評価関数を設定します (既定は Reversi::Eval::defaultPatternEvaluator)
+	void setEvaluator(const Reversi::Eval::PatternEvaluator& evaluator);
+
+	/// @brief 探索に使うスレッド数を設定します
+	void setThreadCount(int32_t threads);
+
+	/// @brief 反復深化の窓 (aspiration window) を設定します。意味は AlphaBetaAgent::setAspiration と同じです
+	/// @param window 最初の窓の片側の幅 (石差)。0 なら毎回全幅で読みます
+	/// @param growth 外れるたびに幅を何倍にするか (2 から 16)
+	void setAspiration(int32_t window, int32_t growth = 2);
+
+	/// @brief 直前の play で探索したノード数 (全スレッドの合計)
+	int64_t getNodeCount() const { return callCnt; }
+
+	/// @brief 直前の play で最後まで読み終えた深さ
+	int32_t getLastDepth() const { return lastDepth; }
+
+	/// @brief 直前の play で弟を作業として積んだ回数
+	int64_t getSplitCount() const { return splitCnt; }
+private:
+	/// @brief Tools/MicroBench.cpp が非公開の getSortedLegals を測るため
+	friend struct MicroBenchAccess;
+
+	struct LegalState
+	{
+		int32_t score;
+		Reversi::ReversiEngine::Move move;
+
+		// 同点なら盤面の右下側 (下位ビット) を大きいとみなす
+		inline bool operator>(const LegalState& a) const
+		{
+			if (score != a.score) return score > a.score;
+			return move.bit < a.move.bit;
+		}
+	};
+
+	/// @brief 1 局面の合法手を置いておく領域 (合法手は高々 64 個)
+	using LegalList = std::array<LegalState, 64>;
+
+	/// @brief 弟を並列に読んでいる局面
+	/// 窓と最善の値は mutex で守り、beta カットが起きたら cutoff を立てて子孫の探索を止めさせます
+	struct SplitPoint
+	{
+		const SplitPoint* parent;
+		std::mutex mutex;
+		int32_t alpha, beta, bestScore;
+		uint64_t bestMove;
+		int32_t depth;
+		std::atomic<int32_t> pending; // 終わっていない弟の数
+		std::atomic<bool> cutoff = false;
+	};
+
+	/// @brief 作業ごとの探索状態
+	struct Worker
+	{
+		Reversi::ReversiEngine engine;
+		Reversi::Eval::PatternState patterns; // engine と同じ局面のパターン番号
+		SearchCounters stats;
+	};
+
+	/// @brief 着手を盤面とパターン番号の両方に適用します
+	static inline void doMove(Worker& worker, const Reversi::ReversiEngine::Move& move)
+	{
+		REVERSI_TRACE_ZONE("doMove");
+		const bool blackMoved = worker.engine.isBlackTurn();
+		worker.engine.doMove(move);
+		worker.patterns.update(move, blackMoved);
+	}
+
+	/// @brief doMove で適用した着手を取り消します
+	static inline void undoMove(Worker& worker, const Reversi::ReversiEngine::Move& move)
+	{
+		worker.engine.undoMove(move);
+		worker.patterns.restore(move, worker.engine.isBlackTurn());
+	}
+
+	/// @brief 時間と中断要求を確かめる間隔 (ノード数、2 の冪)
+	static constexpr int64_t TimeCheckInterval = 1024;
+
+	/// @brief 弟を作業に分ける残り深さの下限。浅い所で分けると作業を積む手間の方が大きい
+	static constexpr int32_t MinSplitDepth = 4;
+
+	/// @brief ルートの全ての手を窓 (alpha, beta) で読みます
+	/// @param bestMove 最善手のビット (並べ替えの先頭にも使います)。打ち切ったときと窓より下に外れたときは書き換えません
+	/// @return 最善手の評価値 (fail-soft なので窓の外なら境界値)。打ち切ったときの値は使えません
+	int32_t searchRoot(Worker& worker, int32_t depth, int32_t alpha, int32_t beta, uint64_t& bestMove);
+
+	int32_t negaAlpha(Worker& worker, const SplitPoint* split, int32_t depth, bool passed, int32_t alpha, int32_t beta);
+
+	/// @brief 並べ替えた合法手を、長男は自分で読み、弟は深さが足りればプールに積んで読みます
+	/// 弟はまず null window で alpha を超えるかだけ確かめ、超えたら窓全体で読み直します (PVS)
+	/// @param maxScore 最善の値 (呼び出し側で -inf に初期化)
+	/// @param best 最善手のビット
+	void searchMoves(Worker& worker, const SplitPoint* split, const LegalList& legals, int32_t nLegals,
+		int32_t depth, int32_t alpha, int32_t beta, int32_t& maxScore, uint64_t& best);
+
+	/// @brief 弟を 1 手読む作業
+	/// @param parent 分割点の局面 (コピーして使う)
+	void searchSibling(SplitPoint& sp, const Worker& parent, Reversi::ReversiEngine::Move move);
+
+	/// @brief 自分か祖先の分割点で beta カットが起きたか、探索の打ち切りが決まっていれば true
+	bool isCancelled(const SplitPoint* split) const;
+
+	/// @brief 探索開始からの経過時間 (ms)
+	int64_t elapsedMs() const;
+
+	/// @brief 探索開始からの経過時間 (µs)
+	int64_t elapsedUs() const;
+
+	/// @brief 時間切れか中断要求があれば stopped を立てます
+	void checkStop();
+
+	/// @brief 今の局面を置換表に書き、書いた回数と追い出した回数を数えます
+	inline void storeEntry(Worker& worker, int32_t score, int32_t depth, Reversi::Bound bound, uint64_t bestMove)
+	{
+		worker.stats.ttStores++;
+		if (transTable.store(worker.engine.getHash(), score, depth, bound, bestMove)) worker.stats.ttCollisions++;
+	}
+
+	inline int32_t eval(const Worker& worker) const
+	{
+		REVERSI_TRACE_ZONE("eval");
+		return evaluator->evaluate(worker.patterns, worker.engine);
+	}
+
+	/// @brief 合法手をざっとした評価の高い順に並べて返します
+	/// 置換表の最善手を先頭にし、残りは置換表にある子の値か静的評価で並べます
+	/// @param worker 探索状態
+	/// @param legalList 結果を書き込む領域 (スコア, 手)
+	/// @param ttMove 置換表の最善手のビット。0 なら無し
+	/// @return 合法手の数
+	inline int32_t getSortedLegals(Worker& worker, LegalList& legalList, uint64_t ttMove) const
+	{
+		REVERSI_TRACE_ZONE("getSortedLegals");
+		Reversi::ReversiEngine& engine = worker.engine;
+		uint64_t legals = engine.getLegals();
+		int32_t idx = 0;
+
+		while (legals)
+		{
+			const uint64_t bit = legals & (0 - legals);
+			legals ^= bit;
+
+			const auto move = engine.makeMove(bit);
+			if (bit == ttMove)
+			{
+				legalList[idx++] = { inf, move };
+				continue;
+			}
+
+			doMove(worker, move);
+
+			Reversi::TTEntry entry;
+			if (transTable.probe(engine.getHash(), entry))
+			{
+				legalList[idx++] = { 1000 - entry.score, move };
+			}
+			else
+			{
+				legalList[idx++] = { -eval(worker), move };
+			}
+
+			undoMove(worker, move);
+		}
+
+		std::sort(legalList.begin(), legalList.begin() + idx, std::greater<>{});
+		return idx;
+	}
+
+	int64_t callCnt = 0;
+	int32_t searchDepth = 7;
+	int32_t lastDepth = 0;
+	int32_t threadCount = 1;
+	int32_t aspirationWindow = 2;
+	int32_t aspirationGrowth = 2;
+
+	std::chrono::steady_clock::time_point searchStart;
+	TimeBudget budget = { -1, -1 };
+	std::atomic<bool> stopped = false; // 全スレッドの探索を打ち切る
+	std::mutex statsMutex;
+	SearchCounters siblingStats; // 弟の作業を終えたときに足し込む (statsMutex で守る)
+	std::atomic<int64_t> splitCnt = 0;
+
+	Reversi::TranspositionTable transTable;
+	const Reversi::Eval::PatternEvaluator* evaluator = &Reversi::Eval::defaultPatternEvaluator();
+	Reversi::WorkStealingPool* pool = nullptr; // play の間だけ有効
+};
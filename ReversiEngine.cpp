@@ -1,8 +1,40 @@
 ﻿# include "ReversiEngine.hpp"
-# include <bitset>
+# include "Trace.hpp"
+# include <array>
+#ifdef REVERSI_SIMD_AVX2
+# include <immintrin.h>
+#endif
 
 namespace Reversi
 {
+	namespace
+	{
+		/// @brief 各マスから 8 方向へ伸びる直線 (自マスを含まない) のマスクを作ります
+		/// @return [ビット番号][方向] のマスク。方向 0-3 は上位ビット向き、4-7 は下位ビット向き
+		constexpr std::array<std::array<uint64_t, 8>, 64> makeLineMasks()
+		{
+			constexpr int32_t dx[8] = { -1, 0, 1, -1, 1, 0, -1, 1 };
+			constexpr int32_t dy[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+			std::array<std::array<uint64_t, 8>, 64> res{};
+			for (int32_t bit = 0; bit < 64; ++bit)
+			{
+				const int32_t x = (63 - bit) & 7, y = (63 - bit) >> 3;
+				for (int32_t dir = 0; dir < 8; ++dir)
+				{
+					int32_t cx = x + dx[dir], cy = y + dy[dir];
+					while (0 <= cx and cx < 8 and 0 <= cy and cy < 8)
+					{
+						res[bit][dir] |= 0x8000000000000000ull >> (cx + (cy << 3));
+						cx += dx[dir];
+						cy += dy[dir];
+					}
+				}
+			}
+			return res;
+		}
+
+		constexpr auto LineMasks = makeLineMasks();
+	}
 
 	uint64_t ReversiEngine::pos2bit(uint32_t x, uint32_t y) const
 	{
@@ -13,8 +45,15 @@ namespace Reversi
 	}
 
 	ReversiEngine::ReversiEngine() :
-		m_blacks(0), m_whites(0), m_blackTurn(true)
+		m_blacks(0), m_whites(0), m_blackTurn(true), m_hash(0)
+	{
+	}
+
+	void ReversiEngine::recomputeHash()
 	{
+		m_hash = m_blackTurn ? 0 : Zobrist::WhiteTurn;
+		for (uint64_t b = m_blacks; b; b &= b - 1) m_hash ^= Zobrist::black(std::countr_zero(b));
+		for (uint64_t w = m_whites; w; w &= w - 1) m_hash ^= Zobrist::white(std::countr_zero(w));
 	}
 
 	void ReversiEngine::reset()
@@ -22,16 +61,15 @@ namespace Reversi
 		m_blacks = pos2bit(4, 3) | pos2bit(3, 4);
 		m_whites = pos2bit(3, 3) | pos2bit(4, 4);
 		m_blackTurn = true;
+		recomputeHash();
 	}
 
-	uint64_t ReversiEngine::getLegals(bool inverseTurn) const
+	uint64_t calcLegalsScalar(uint64_t playerBoard, uint64_t oppBoard)
 	{
-		const uint64_t& playerBoard = (m_blackTurn ^ inverseTurn) ? m_blacks : m_whites;
-		const uint64_t& oppBoard = (m_blackTurn ^ inverseTurn) ? m_whites : m_blacks;
 		const uint64_t hMask = 0x7e7e7e7e7e7e7e7e & oppBoard;
 		const uint64_t vMask = 0x00FFFFFFFFFFFF00 & oppBoard;
 		const uint64_t edgeMask = 0x007e7e7e7e7e7e00 & oppBoard;
-		const uint64_t blank = ~(m_blacks | m_whites);
+		const uint64_t blank = ~(playerBoard | oppBoard);
 
 		uint64_t tmp = 0, legals = 0;
 
@@ -102,57 +140,122 @@ namespace Reversi
 		return legals;
 	}
 
-	bool ReversiEngine::place(uint32_t x, uint32_t y)
+#ifdef REVERSI_SIMD_AVX2
+	uint64_t calcLegalsAVX2(uint64_t playerBoard, uint64_t oppBoard)
+	{
+		// レーンごとに 横 / 縦 / 斜め / 斜め の方向を担当する
+		const __m256i shift = _mm256_set_epi64x(9, 7, 8, 1);
+		const __m256i player = _mm256_set1_epi64x(static_cast<int64_t>(playerBoard));
+		const __m256i mask = _mm256_and_si256(_mm256_set1_epi64x(static_cast<int64_t>(oppBoard)),
+			_mm256_set_epi64x(0x007e7e7e7e7e7e00, 0x007e7e7e7e7e7e00, 0x00FFFFFFFFFFFF00, 0x7e7e7e7e7e7e7e7e));
+
+		__m256i l, r;
+
+		l = _mm256_and_si256(mask, _mm256_sllv_epi64(player, shift));
+		r = _mm256_and_si256(mask, _mm256_srlv_epi64(player, shift));
+		for (int32_t i = 0; i < 5; ++i)
+		{
+			l = _mm256_or_si256(l, _mm256_and_si256(mask, _mm256_sllv_epi64(l, shift)));
+			r = _mm256_or_si256(r, _mm256_and_si256(mask, _mm256_srlv_epi64(r, shift)));
+		}
+		const __m256i legals = _mm256_or_si256(_mm256_sllv_epi64(l, shift), _mm256_srlv_epi64(r, shift));
+
+		__m128i res = _mm_or_si128(_mm256_castsi256_si128(legals), _mm256_extracti128_si256(legals, 1));
+		res = _mm_or_si128(res, _mm_unpackhi_epi64(res, res));
+		return static_cast<uint64_t>(_mm_cvtsi128_si64(res)) & ~(playerBoard | oppBoard);
+	}
+#endif
+
+#ifdef REVERSI_SIMD_AVX512
+	uint64_t calcLegalsAVX512(uint64_t playerBoard, uint64_t oppBoard)
+	{
+		// 右シフトは 64 - n の左ローテートで表す。
+		// 回り込んだビットは各方向のマスクで盤端として落ちるので、ローテートのままでよい
+		const __m512i rotate = _mm512_set_epi64(55, 57, 56, 63, 9, 7, 8, 1);
+		const __m512i player = _mm512_set1_epi64(static_cast<int64_t>(playerBoard));
+		const __m512i mask = _mm512_and_si512(_mm512_set1_epi64(static_cast<int64_t>(oppBoard)),
+			_mm512_set_epi64(0x007e7e7e7e7e7e00, 0x007e7e7e7e7e7e00, 0x00FFFFFFFFFFFF00, 0x7e7e7e7e7e7e7e7e,
+				0x007e7e7e7e7e7e00, 0x007e7e7e7e7e7e00, 0x00FFFFFFFFFFFF00, 0x7e7e7e7e7e7e7e7e));
+
+		__m512i tmp = _mm512_and_si512(mask, _mm512_rolv_epi64(player, rotate));
+		for (int32_t i = 0; i < 5; ++i)
+		{
+			tmp = _mm512_or_si512(tmp, _mm512_and_si512(mask, _mm512_rolv_epi64(tmp, rotate)));
+		}
+		const uint64_t legals = static_cast<uint64_t>(_mm512_reduce_or_epi64(_mm512_rolv_epi64(tmp, rotate)));
+		return legals & ~(playerBoard | oppBoard);
+	}
+#endif
+
+	uint64_t calcFlips(uint64_t playerBoard, uint64_t oppBoard, int32_t sq)
 	{
-		uint64_t& playerBoard = m_blackTurn ? m_blacks : m_whites;
-		uint64_t& oppBoard = m_blackTurn ? m_whites : m_blacks;
-		uint64_t b = pos2bit(x, y);
-		if ((getLegals() & b) == 0) return false;
+		const auto& lines = LineMasks[sq];
 		uint64_t rev = 0;
-		for (int dir = 0; dir < 8; ++dir)
+
+		// 上位ビット方向: 打ったマスに最も近いのは最下位ビット
+		for (uint32_t dir = 0; dir < 4; ++dir)
 		{
-			uint64_t rev_ = 0;
-			uint64_t mask = transfer(b, dir);
-			while (mask != 0 && ((mask & oppBoard) != 0))
-			{
-				rev_ |= mask;
-				mask = transfer(mask, dir);
-			}
-			if ((mask & playerBoard) != 0)
-			{
-				rev |= rev_;
-			}
+			const uint64_t outflank = lines[dir] & ~oppBoard;
+			const uint64_t first = outflank & (0 - outflank);
+			const uint64_t valid = 0 - static_cast<uint64_t>((first & playerBoard) != 0);
+			rev |= lines[dir] & (first - 1) & valid;
 		}
 
-		playerBoard ^= b | rev;
-		oppBoard ^= rev;
-		m_blackTurn = !m_blackTurn;
+		// 下位ビット方向: 打ったマスに最も近いのは最上位ビット
+		for (uint32_t dir = 4; dir < 8; ++dir)
+		{
+			const uint64_t outflank = lines[dir] & ~oppBoard;
+			const uint64_t first = std::bit_floor(outflank);
+			const uint64_t valid = 0 - static_cast<uint64_t>((first & playerBoard) != 0);
+			rev |= lines[dir] & ~((first << 1) - 1) & valid;
+		}
+
+		return rev;
+	}
 
+	uint64_t calcLegals(uint64_t playerBoard, uint64_t oppBoard)
+	{
+#if defined(REVERSI_SIMD_AVX512)
+		return calcLegalsAVX512(playerBoard, oppBoard);
+#elif defined(REVERSI_SIMD_AVX2)
+		return calcLegalsAVX2(playerBoard, oppBoard);
+#else
+		return calcLegalsScalar(playerBoard, oppBoard);
+#endif
+	}
+
+	uint64_t ReversiEngine::getLegals(bool inverseTurn) const
+	{
+		REVERSI_TRACE_ZONE("getLegals");
+		const uint64_t& playerBoard = (m_blackTurn ^ inverseTurn) ? m_blacks : m_whites;
+		const uint64_t& oppBoard = (m_blackTurn ^ inverseTurn) ? m_whites : m_blacks;
+		return calcLegals(playerBoard, oppBoard);
+	}
+
+	bool ReversiEngine::place(uint32_t x, uint32_t y)
+	{
+		REVERSI_TRACE_ZONE("place");
+		const uint64_t b = pos2bit(x, y);
+		if ((m_blacks | m_whites) & b) return false;
+
+		const uint64_t rev = getFlips(b);
+		if (rev == 0) return false;
+
+		doMove({ b, rev });
 		return true;
 	}
 
-	uint64_t ReversiEngine::transfer(uint64_t put, uint32_t dir) const
-	{
-		switch (dir) {
-		case 0: //上
-			return (put << 8) & 0xffffffffffffff00;
-		case 1: //右上
-			return (put << 7) & 0x7f7f7f7f7f7f7f00;
-		case 2: //右
-			return (put >> 1) & 0x7f7f7f7f7f7f7f7f;
-		case 3: //右下
-			return (put >> 9) & 0x007f7f7f7f7f7f7f;
-		case 4: //下
-			return (put >> 8) & 0x00ffffffffffffff;
-		case 5: //左下
-			return (put >> 7) & 0x00fefefefefefefe;
-		case 6: //左
-			return (put << 1) & 0xfefefefefefefefe;
-		case 7: //左上
-			return (put << 9) & 0xfefefefefefefe00;
-		default:
-			return 0;
-		}
+	void ReversiEngine::placeUnchecked(uint64_t bit)
+	{
+		REVERSI_TRACE_ZONE("place");
+		doMove(makeMove(bit));
+	}
+
+	uint64_t ReversiEngine::getFlips(uint64_t bit) const
+	{
+		REVERSI_TRACE_ZONE("getFlips");
+		return m_blackTurn ? calcFlips(m_blacks, m_whites, std::countr_zero(bit))
+			: calcFlips(m_whites, m_blacks, std::countr_zero(bit));
 	}
 
 	void ReversiEngine::getBoard(std::vector<int32_t>& board) const
@@ -171,6 +274,7 @@ namespace Reversi
 	void ReversiEngine::pass()
 	{
 		m_blackTurn = !m_blackTurn;
+		m_hash ^= Zobrist::WhiteTurn;
 	}
 
 	void ReversiEngine::setState(uint64_t blacks, uint64_t whites, bool blackTurn)
@@ -178,12 +282,14 @@ namespace Reversi
 		m_blacks = blacks;
 		m_whites = whites;
 		m_blackTurn = blackTurn;
+		recomputeHash();
 	}
 
 	void ReversiEngine::swapBW()
 	{
 		std::swap(m_blacks, m_whites);
 		m_blackTurn = !m_blackTurn;
+		recomputeHash();
 	}
 
 	bool ReversiEngine::isBlackTurn() const
@@ -229,4 +335,46 @@ namespace Reversi
 			mask >>= 1;
 		}
 	}
+
+	bool parseBoard(std::string_view str, ReversiEngine& engine)
+	{
+		uint64_t blacks = 0, whites = 0, mask = 0x8000000000000000;
+		size_t i = 0;
+		for (; i < str.size() and mask; ++i)
+		{
+			switch (str[i])
+			{
+			case 'X': case 'x': case '*': blacks |= mask; break;
+			case 'O': case 'o': whites |= mask; break;
+			case '-': case '.': break;
+			default: return false;
+			}
+			mask >>= 1;
+		}
+		if (mask) return false;
+
+		while (i < str.size() and str[i] == ' ') ++i;
+		if (i == str.size()) return false;
+
+		const char turn = str[i];
+		if (turn != 'X' and turn != 'x' and turn != '*' and turn != 'O' and turn != 'o') return false;
+
+		engine.setState(blacks, whites, turn == 'X' or turn == 'x' or turn == '*');
+		return true;
+	}
+
+	std::string toBoardString(const ReversiEngine& engine)
+	{
+		std::string res(66, ' ');
+		uint64_t mask = 0x8000000000000000;
+		for (uint32_t i = 0; i < 64; ++i)
+		{
+			if (engine.getBlacks() & mask) res[i] = 'X';
+			else if (engine.getWhites() & mask) res[i] = 'O';
+			else res[i] = '-';
+			mask >>= 1;
+		}
+		res[65] = engine.isBlackTurn() ? 'X' : 'O';
+		return res;
+	}
 }
@@ -1,48 +1,94 @@
 ﻿#pragma once
+# include <cstdint>
+# include <array>
+# include <vector>
+# include <tuple>
+# include <bit>
+# include <string>
+# include <string_view>
+
+// getLegals の SIMD 実装の選択
+// コンパイラが AVX2 / AVX-512 を有効にしていれば自動で使います。
+// #pragma GCC target で有効にした場合は __AVX2__ が定義されないので REVERSI_SIMD_AVX2 を定義してください。
+// REVERSI_NO_SIMD を定義するとスカラー実装に固定します。
+#if !defined(REVERSI_NO_SIMD)
+#if defined(__AVX512F__) && !defined(REVERSI_SIMD_AVX512)
+#define REVERSI_SIMD_AVX512
+#endif
+#if (defined(__AVX2__) || defined(REVERSI_SIMD_AVX512)) && !defined(REVERSI_SIMD_AVX2)
+#define REVERSI_SIMD_AVX2
+#endif
+#endif
 
 namespace Reversi
 {
-	struct TupleHash {
-		std::size_t operator()(const std::tuple<uint64_t, uint64_t, bool>& t) const noexcept {
-			uint64_t a, b;
-			bool c;
-			std::tie(a, b, c) = t;
-
-			// 高速で分布の良いハッシュ関数（SplitMix64ベース）
-			auto hash64 = [](uint64_t x) {
+	namespace Zobrist
+	{
+		/// @brief SplitMix64 で乱数表を作ります
+		constexpr std::array<uint64_t, 129> makeTable()
+		{
+			std::array<uint64_t, 129> res{};
+			uint64_t x = 0x2545F4914F6CDD1D;
+			for (auto& v : res)
+			{
 				x += 0x9e3779b97f4a7c15;
-				x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
-				x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
-				return x ^ (x >> 31);
-				};
+				uint64_t z = x;
+				z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+				z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+				v = z ^ (z >> 31);
+			}
+			return res;
+		}
 
-			uint64_t h1 = hash64(a);
-			uint64_t h2 = hash64(b);
-			uint64_t h3 = hash64(static_cast<uint64_t>(c));
+		inline constexpr std::array<uint64_t, 129> Table = makeTable();
 
-			// ハッシュ値を混合する（rotate xor加算など）
-			uint64_t combined = h1;
-			combined ^= (h2 << 1) | (h2 >> 63);
-			combined ^= (h3 << 2) | (h3 >> 62);
+		/// @brief ビット番号 sq に黒石があるときのキー
+		constexpr uint64_t black(int32_t sq) { return Table[sq]; }
 
-			return static_cast<std::size_t>(combined);
-		}
-	};
+		/// @brief ビット番号 sq に白石があるときのキー
+		constexpr uint64_t white(int32_t sq) { return Table[64 + sq]; }
+
+		/// @brief 白番のときのキー
+		constexpr uint64_t WhiteTurn = Table[128];
+	}
 
 	class ReversiEngine
 	{
+	public:
+		/// @brief 着手の記録。bit が 0 の手はパスを表します
+		struct Move
+		{
+			uint64_t bit;
+			uint64_t flips;
+		};
+
 	private:
 		uint64_t m_blacks, m_whites;
 		bool m_blackTurn;
 
+		/// @brief 局面の Zobrist ハッシュ (着手ごとに差分更新する)
+		uint64_t m_hash;
+
+		/// @brief 裏返った石のキーを m_hash に反映します
+		inline void hashFlips(uint64_t flips)
+		{
+			while (flips)
+			{
+				const int32_t sq = std::countr_zero(flips);
+				m_hash ^= Zobrist::black(sq) ^ Zobrist::white(sq);
+				flips &= flips - 1;
+			}
+		}
+
+		/// @brief 盤面から m_hash を計算し直します
+		void recomputeHash();
+
 		/// @brief 二次元座標をビットに変換します
 		/// @param x 左から何番目か
 		/// @param y 上から何番目か
 		/// @return ビッドボードでのマスク
 		uint64_t pos2bit(uint32_t x, uint32_t y) const;
 
-		uint64_t transfer(uint64_t put, uint32_t dir) const;
-
 	public:
 		ReversiEngine();
 
@@ -52,6 +98,56 @@ namespace Reversi
 
 		bool place(uint32_t x, uint32_t y);
 
+		/// @brief 合法であることが分かっている手を検査なしで打ちます
+		/// @param bit 打つマスのビット
+		void placeUnchecked(uint64_t bit);
+
+		/// @brief 手番側がマスに打ったときに裏返る石を求めます
+		/// @param bit 打つマスのビット (空きマスであること)
+		/// @return 裏返る石のマスク。0 なら非合法手
+		uint64_t getFlips(uint64_t bit) const;
+
+		/// @brief 手番側がマスに打つ着手を作ります
+		/// @param bit 打つマスのビット (合法手であること)
+		inline Move makeMove(uint64_t bit) const
+		{
+			return { bit, getFlips(bit) };
+		}
+
+		/// @brief 着手を適用して手番を交代します
+		inline void doMove(const Move& move)
+		{
+			uint64_t& playerBoard = m_blackTurn ? m_blacks : m_whites;
+			uint64_t& oppBoard = m_blackTurn ? m_whites : m_blacks;
+			playerBoard ^= move.bit | move.flips;
+			oppBoard ^= move.flips;
+			if (move.bit)
+			{
+				const int32_t sq = std::countr_zero(move.bit);
+				m_hash ^= m_blackTurn ? Zobrist::black(sq) : Zobrist::white(sq);
+			}
+			hashFlips(move.flips);
+			m_hash ^= Zobrist::WhiteTurn;
+			m_blackTurn = !m_blackTurn;
+		}
+
+		/// @brief doMove で適用した着手を取り消します
+		inline void undoMove(const Move& move)
+		{
+			m_blackTurn = !m_blackTurn;
+			uint64_t& playerBoard = m_blackTurn ? m_blacks : m_whites;
+			uint64_t& oppBoard = m_blackTurn ? m_whites : m_blacks;
+			playerBoard ^= move.bit | move.flips;
+			oppBoard ^= move.flips;
+			if (move.bit)
+			{
+				const int32_t sq = std::countr_zero(move.bit);
+				m_hash ^= m_blackTurn ? Zobrist::black(sq) : Zobrist::white(sq);
+			}
+			hashFlips(move.flips);
+			m_hash ^= Zobrist::WhiteTurn;
+		}
+
 		void getBoard(std::vector<int32_t>& board) const;
 
 		void pass();
@@ -76,8 +172,49 @@ namespace Reversi
 		{
 			return { m_blacks, m_whites, m_blackTurn };
 		}
+
+		/// @brief 局面の Zobrist ハッシュ (手番を含む)
+		inline uint64_t getHash() const
+		{
+			return m_hash;
+		}
 	};
 
 	void bit2boad(const uint64_t& bit, std::vector<int32_t>& board);
 
+	/// @brief 盤面文字列を読み込みます
+	/// @param str 左上から 1 行ずつ 64 文字 (黒 X, 白 O, 空き -) と、空白を挟んで手番 (X / O)
+	/// @param engine 読み込んだ局面を設定するエンジン
+	/// @return 書式が正しければ true
+	bool parseBoard(std::string_view str, ReversiEngine& engine);
+
+	/// @brief 局面を parseBoard で読める盤面文字列にします
+	std::string toBoardString(const ReversiEngine& engine);
+
+	/// @brief 手番側がマスに打ったときに裏返る石を求めます
+	/// @param playerBoard 手番側の石
+	/// @param oppBoard 相手の石
+	/// @param sq 打つマスのビット番号 (空きマスであること)
+	/// @return 裏返る石のマスク。0 なら非合法手
+	uint64_t calcFlips(uint64_t playerBoard, uint64_t oppBoard, int32_t sq);
+
+	/// @brief 合法手を求めます (ビルドで有効な最速の実装)
+	/// @param playerBoard 手番側の石
+	/// @param oppBoard 相手の石
+	/// @return 合法手のマスク
+	uint64_t calcLegals(uint64_t playerBoard, uint64_t oppBoard);
+
+	/// @brief 8 方向を 1 方向ずつ調べる合法手生成
+	uint64_t calcLegalsScalar(uint64_t playerBoard, uint64_t oppBoard);
+
+#ifdef REVERSI_SIMD_AVX2
+	/// @brief 4 方向を 1 本の __m256i にまとめ、左右 2 回のシフトで調べる合法手生成
+	uint64_t calcLegalsAVX2(uint64_t playerBoard, uint64_t oppBoard);
+#endif
+
+#ifdef REVERSI_SIMD_AVX512
+	/// @brief 8 方向を 1 本の __m512i にまとめ、ローテートで一度に調べる合法手生成
+	uint64_t calcLegalsAVX512(uint64_t playerBoard, uint64_t oppBoard);
+#endif
+
 };
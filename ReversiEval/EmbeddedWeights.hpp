@@ -0,0 +1,10 @@
+﻿#pragma once
+
+// CodinGame 版に埋め込む重み。Tools/Tuner embed で学習した重みファイルから作り直します
+// 空のままなら既定の重みを使います。
+namespace Reversi::Eval
+{
+	inline constexpr const char* EmbeddedWeights[] = {
+		"",
+	};
+}
@@ -0,0 +1,94 @@
+﻿# include "NNBatch.hpp"
+# include <algorithm>
+# include <bit>
+
+namespace Reversi::Eval
+{
+	namespace
+	{
+		constexpr uint32_t InputSize = NNParameters::InputSize;
+		constexpr uint32_t Hidden1 = NNParameters::Hidden1;
+		constexpr uint32_t Hidden2 = NNParameters::Hidden2;
+
+		void copyTo(const std::vector<float>& values, CMat::CMat<float>& m)
+		{
+			std::copy(values.begin(), values.end(), m.data());
+		}
+
+		/// @brief 先頭 rows 行の各行にバイアスを足して [0, 1] に切り詰めます
+		void addBiasClamp(CMat::CMat<float>& m, uint32_t rows, const CMat::CMat<float>& bias)
+		{
+			const uint32_t cols = m.shape.cols;
+			for (uint32_t r = 0; r < rows; ++r)
+			{
+				float* row = m.data() + static_cast<size_t>(r) * cols;
+				for (uint32_t c = 0; c < cols; ++c) row[c] = std::clamp(row[c] + bias.data()[c], 0.0f, 1.0f);
+			}
+		}
+	}
+
+	NNBatchEvaluator::NNBatchEvaluator(uint32_t capacity) :
+		m_capacity(std::max(capacity, 1u)),
+		m_w1(CMat::MatShape{ InputSize, Hidden1 }), m_b1(CMat::MatShape{ 1, Hidden1 }),
+		m_w2(CMat::MatShape{ Hidden1, Hidden2 }), m_b2(CMat::MatShape{ 1, Hidden2 }),
+		m_w3(CMat::MatShape{ Hidden2, 1 }),
+		m_input(CMat::MatShape{ m_capacity, InputSize }),
+		m_hidden1(CMat::MatShape{ m_capacity, Hidden1 }),
+		m_hidden2(CMat::MatShape{ m_capacity, Hidden2 }),
+		m_output(CMat::MatShape{ m_capacity, 1 }),
+		m_scores(m_capacity),
+		m_blackTurn(m_capacity)
+	{
+	}
+
+	NNBatchEvaluator::NNBatchEvaluator(const NNParameters& params, uint32_t capacity) :
+		NNBatchEvaluator(capacity)
+	{
+		setParameters(params);
+	}
+
+	bool NNBatchEvaluator::setParameters(const NNParameters& params)
+	{
+		if (not params.isValid()) return false;
+
+		copyTo(params.w1, m_w1);
+		copyTo(params.b1, m_b1);
+		copyTo(params.w2, m_w2);
+		copyTo(params.b2, m_b2);
+		copyTo(params.w3, m_w3);
+		m_b3 = params.b3;
+		return true;
+	}
+
+	int32_t NNBatchEvaluator::add(const ReversiEngine& engine)
+	{
+		if (m_size == m_capacity) return -1;
+
+		float* row = m_input.data() + static_cast<size_t>(m_size) * InputSize;
+		std::fill_n(row, InputSize, 0.0f);
+		for (uint64_t b = engine.getBlacks(); b; b &= b - 1) row[std::countr_zero(b)] = 1;
+		for (uint64_t w = engine.getWhites(); w; w &= w - 1) row[64 + std::countr_zero(w)] = 1;
+		m_blackTurn[m_size] = engine.isBlackTurn();
+		return static_cast<int32_t>(m_size++);
+	}
+
+	std::span<const float> NNBatchEvaluator::evaluate()
+	{
+		const uint32_t n = m_size;
+		if (n == 0) return {};
+
+		// 積んだ行だけのビューに書くので、中間の行列は確保しない
+		CMat::matmulInto(m_hidden1.block(0, 0, n, Hidden1), m_input.block(0, 0, n, InputSize), m_w1);
+		addBiasClamp(m_hidden1, n, m_b1);
+		CMat::matmulInto(m_hidden2.block(0, 0, n, Hidden2), m_hidden1.block(0, 0, n, Hidden1), m_w2);
+		addBiasClamp(m_hidden2, n, m_b2);
+		CMat::matmulInto(m_output.block(0, 0, n, 1), m_hidden2.block(0, 0, n, Hidden2), m_w3);
+
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			const float score = m_output.data()[i] + m_b3;
+			m_scores[i] = m_blackTurn[i] ? score : -score;
+		}
+		return { m_scores.data(), n };
+	}
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+# include "NNEval.hpp"
+# include "../lib/CMat/CMat.hpp"
+# include <cstdint>
+# include <span>
+# include <vector>
+
+namespace Reversi::Eval
+{
+	/// @brief 複数の局面をまとめて評価するニューラルネットの評価関数
+	/// 局面を add で積み、evaluate で全層を CMat の行列積 (バッチ x 入力) * (入力 x 出力) で一度に計算します。
+	/// MCTS の葉の展開やルートの手の並べ替えのように、評価する局面が先にまとめて分かっている所で使います。
+	/// 重みは量子化しない NNParameters そのままで、NNEvaluator とは丸めの分だけ値が違います。
+	/// 入力と中間層と出力の行列は作るときに capacity 行分確保し、評価のたびに確保し直しません。
+	class NNBatchEvaluator
+	{
+	public:
+		static constexpr uint32_t DefaultCapacity = 256;
+
+		/// @brief 全ての重みが 0 の (常に 0 を返す) 評価関数を作ります
+		explicit NNBatchEvaluator(uint32_t capacity = DefaultCapacity);
+
+		explicit NNBatchEvaluator(const NNParameters& params, uint32_t capacity = DefaultCapacity);
+
+		/// @brief 重みを設定します
+		/// @return params の大きさが合わなければ何もせず false
+		bool setParameters(const NNParameters& params);
+
+		/// @brief 一度に評価できる局面の数
+		uint32_t capacity() const { return m_capacity; }
+
+		/// @brief 積んである局面の数
+		uint32_t size() const { return m_size; }
+
+		/// @brief 積んだ局面を捨てて、新しいバッチを始めます
+		void clear() { m_size = 0; }
+
+		/// @brief 局面を積みます
+		/// @return 積んだ位置 (evaluate の結果の添字)。満杯なら積まずに -1
+		int32_t add(const ReversiEngine& engine);
+
+		/// @brief 積んである全ての局面を評価します
+		/// @return 積んだ順の、手番側から見た評価値 (石差)。次に add か clear を呼ぶまで有効
+		std::span<const float> evaluate();
+
+	private:
+		uint32_t m_capacity;
+		uint32_t m_size = 0;
+
+		CMat::CMat<float> m_w1, m_b1, m_w2, m_b2, m_w3;
+		float m_b3 = 0;
+
+		CMat::CMat<float> m_input; // [capacity][InputSize] 石のある所が 1
+		CMat::CMat<float> m_hidden1; // [capacity][Hidden1]
+		CMat::CMat<float> m_hidden2; // [capacity][Hidden2]
+		CMat::CMat<float> m_output; // [capacity][1]
+		std::vector<float> m_scores;
+		std::vector<bool> m_blackTurn;
+	};
+}
@@ -0,0 +1,225 @@
+﻿# include "NNEval.hpp"
+# include "WeightFormat.hpp"
+# include <algorithm>
+# include <bit>
+# include <cmath>
+# include <cstring>
+# include <fstream>
+# include <random>
+
+namespace Reversi::Eval
+{
+	namespace
+	{
+		struct NetworkFileHeader
+		{
+			char magic[4];
+			uint32_t version;
+			uint32_t inputSize;
+			uint32_t hidden1;
+			uint32_t hidden2;
+			uint32_t checksum; // 重みの CRC-32
+		};
+
+		constexpr char NetworkFileMagic[4] = { 'R', 'V', 'N', 'N' };
+		constexpr uint32_t NetworkFileVersion = 1;
+
+		/// @brief 1 層目の量子化した重みの上限。64 マス全てに石があっても 16 ビットで溢れないようにする
+		constexpr int32_t MaxWeight1 = 480;
+		constexpr int32_t MaxBias1 = 1000;
+
+		int32_t quantize(float value, float scale, int32_t limit)
+		{
+			return std::clamp(static_cast<int32_t>(std::lround(value * scale)), -limit, limit);
+		}
+
+		/// @brief 全ての重みを決まった順に 1 本に並べます (ファイルの中身とチェックサムの対象)
+		std::vector<float> flatten(const NNParameters& params)
+		{
+			std::vector<float> res;
+			for (const auto* v : { &params.w1, &params.b1, &params.w2, &params.b2, &params.w3 }) res.insert(res.end(), v->begin(), v->end());
+			res.push_back(params.b3);
+			return res;
+		}
+	}
+
+	NNParameters NNParameters::initial(uint64_t seed)
+	{
+		std::mt19937_64 rng(seed);
+		auto fill = [&](std::vector<float>& v, size_t size, float range)
+		{
+			std::uniform_real_distribution<float> dist(-range, range);
+			v.resize(size);
+			for (auto& x : v) x = dist(rng);
+		};
+
+		// 入力は 1 局面に高々 64 個しか立たないので小さめに、隠れ層は活性が [0, 1] の中に来るように
+		NNParameters res;
+		fill(res.w1, static_cast<size_t>(InputSize) * Hidden1, 0.1f);
+		res.b1.assign(Hidden1, 0.5f);
+		fill(res.w2, static_cast<size_t>(Hidden1) * Hidden2, std::sqrt(3.0f / Hidden1));
+		res.b2.assign(Hidden2, 0.5f);
+		fill(res.w3, Hidden2, std::sqrt(3.0f / Hidden2));
+		res.b3 = 0;
+		return res;
+	}
+
+	bool NNParameters::isValid() const
+	{
+		return w1.size() == static_cast<size_t>(InputSize) * Hidden1
+			and b1.size() == Hidden1
+			and w2.size() == static_cast<size_t>(Hidden1) * Hidden2
+			and b2.size() == Hidden2
+			and w3.size() == Hidden2;
+	}
+
+	bool saveNetworkFile(const std::string& path, const NNParameters& params)
+	{
+		if (not params.isValid()) return false;
+		std::ofstream ofs(path, std::ios::binary);
+		if (not ofs) return false;
+
+		const std::vector<float> data = flatten(params);
+		NetworkFileHeader header{ {}, NetworkFileVersion, NNParameters::InputSize, NNParameters::Hidden1, NNParameters::Hidden2,
+			crc32(data.data(), data.size() * sizeof(float)) };
+		std::memcpy(header.magic, NetworkFileMagic, sizeof(header.magic));
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		ofs.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size() * sizeof(float)));
+		return static_cast<bool>(ofs);
+	}
+
+	bool loadNetworkFile(const std::string& path, NNParameters& params)
+	{
+		std::ifstream ifs(path, std::ios::binary);
+		if (not ifs) return false;
+
+		NetworkFileHeader header{};
+		if (not ifs.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+		if (std::memcmp(header.magic, NetworkFileMagic, sizeof(header.magic)) != 0
+			or header.version != NetworkFileVersion
+			or header.inputSize != NNParameters::InputSize
+			or header.hidden1 != NNParameters::Hidden1
+			or header.hidden2 != NNParameters::Hidden2)
+		{
+			return false;
+		}
+
+		NNParameters res = NNParameters::initial(0);
+		std::vector<float> data = flatten(res);
+		if (not ifs.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size() * sizeof(float)))) return false;
+		if (crc32(data.data(), data.size() * sizeof(float)) != header.checksum) return false;
+
+		const float* p = data.data();
+		for (auto* v : { &res.w1, &res.b1, &res.w2, &res.b2, &res.w3 })
+		{
+			std::copy(p, p + v->size(), v->begin());
+			p += v->size();
+		}
+		res.b3 = *p;
+		params = std::move(res);
+		return true;
+	}
+
+	NNEvaluator::NNEvaluator() = default;
+
+	NNEvaluator::NNEvaluator(const NNParameters& params)
+	{
+		setParameters(params);
+	}
+
+	bool NNEvaluator::setParameters(const NNParameters& params)
+	{
+		if (not params.isValid()) return false;
+
+		for (int32_t sq = 0; sq < 64; ++sq)
+		{
+			for (int32_t h = 0; h < Hidden1; ++h)
+			{
+				m_black[sq][h] = static_cast<int16_t>(quantize(params.w1[static_cast<size_t>(sq) * Hidden1 + h], ActivationOne, MaxWeight1));
+				m_white[sq][h] = static_cast<int16_t>(quantize(params.w1[static_cast<size_t>(64 + sq) * Hidden1 + h], ActivationOne, MaxWeight1));
+				m_flip[sq][h] = static_cast<int16_t>(m_black[sq][h] - m_white[sq][h]);
+			}
+		}
+		for (int32_t h = 0; h < Hidden1; ++h) m_bias1[h] = static_cast<int16_t>(quantize(params.b1[h], ActivationOne, MaxBias1));
+
+		for (int32_t o = 0; o < Hidden2; ++o)
+		{
+			for (int32_t h = 0; h < Hidden1; ++h)
+			{
+				m_w2[o][h] = static_cast<int16_t>(quantize(params.w2[static_cast<size_t>(h) * Hidden2 + o], Weight2One, 32767));
+			}
+			m_b2[o] = quantize(params.b2[o], static_cast<float>(ActivationOne * Weight2One), 1 << 30);
+			m_w3[o] = quantize(params.w3[o], DiscScale, 1 << 24);
+		}
+		m_b3 = quantize(params.b3, DiscScale, 1 << 24);
+		return true;
+	}
+
+	void NNEvaluator::reset(NNState& state, const ReversiEngine& engine) const
+	{
+		state.acc = m_bias1;
+		for (uint64_t b = engine.getBlacks(); b; b &= b - 1) add(state, m_black[std::countr_zero(b)]);
+		for (uint64_t w = engine.getWhites(); w; w &= w - 1) add(state, m_white[std::countr_zero(w)]);
+	}
+
+	int32_t NNEvaluator::evaluateRaw(const NNState& state) const
+	{
+		std::array<int32_t, Hidden2> a2;
+
+#ifdef REVERSI_SIMD_AVX2
+		// 1 層目の活性 [0, 127]
+		__m256i a1[Hidden1 / 16];
+		for (int32_t i = 0; i < Hidden1 / 16; ++i)
+		{
+			const __m256i acc = _mm256_load_si256(reinterpret_cast<const __m256i*>(state.acc.data() + 16 * i));
+			a1[i] = _mm256_min_epi16(_mm256_max_epi16(acc, _mm256_setzero_si256()), _mm256_set1_epi16(ActivationOne));
+		}
+
+		// 2 層目: 出力 8 個ずつ、積和 (madd) の 8 レーンを水平に足し合わせる
+		for (int32_t o = 0; o < Hidden2; o += 8)
+		{
+			__m256i sums[8];
+			for (int32_t k = 0; k < 8; ++k)
+			{
+				const __m256i* w = reinterpret_cast<const __m256i*>(m_w2[o + k].data());
+				__m256i s = _mm256_madd_epi16(a1[0], _mm256_load_si256(w));
+				for (int32_t i = 1; i < Hidden1 / 16; ++i) s = _mm256_add_epi32(s, _mm256_madd_epi16(a1[i], _mm256_load_si256(w + i)));
+				sums[k] = s;
+			}
+			const __m256i s01 = _mm256_hadd_epi32(sums[0], sums[1]);
+			const __m256i s23 = _mm256_hadd_epi32(sums[2], sums[3]);
+			const __m256i s45 = _mm256_hadd_epi32(sums[4], sums[5]);
+			const __m256i s67 = _mm256_hadd_epi32(sums[6], sums[7]);
+			const __m256i s0123 = _mm256_hadd_epi32(s01, s23);
+			const __m256i s4567 = _mm256_hadd_epi32(s45, s67);
+			// 下位 128 ビットと上位 128 ビットを足すと、出力 o..o+7 が順に並ぶ
+			const __m256i lo = _mm256_permute2x128_si256(s0123, s4567, 0x20);
+			const __m256i hi = _mm256_permute2x128_si256(s0123, s4567, 0x31);
+			__m256i z = _mm256_add_epi32(_mm256_add_epi32(lo, hi), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m_b2.data() + o)));
+			z = _mm256_srai_epi32(z, std::countr_zero(static_cast<uint32_t>(Weight2One)));
+			z = _mm256_min_epi32(_mm256_max_epi32(z, _mm256_setzero_si256()), _mm256_set1_epi32(ActivationOne));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(a2.data() + o), z);
+		}
+#else
+		std::array<int32_t, Hidden1> a1;
+		for (int32_t h = 0; h < Hidden1; ++h) a1[h] = std::clamp<int32_t>(state.acc[h], 0, ActivationOne);
+
+		for (int32_t o = 0; o < Hidden2; ++o)
+		{
+			int32_t z = m_b2[o];
+			for (int32_t h = 0; h < Hidden1; ++h) z += a1[h] * m_w2[o][h];
+			a2[o] = std::clamp(z >> std::countr_zero(static_cast<uint32_t>(Weight2One)), 0, ActivationOne);
+		}
+#endif
+
+		int32_t out = 0;
+		for (int32_t o = 0; o < Hidden2; ++o) out += a2[o] * m_w3[o];
+		return out / ActivationOne + m_b3;
+	}
+
+	int32_t NNEvaluator::evaluate(const NNState& state, const ReversiEngine& engine) const
+	{
+		const int32_t score = evaluateRaw(state);
+		return toDiscDiff(engine.isBlackTurn() ? score : -score);
+	}
+}
@@ -0,0 +1,159 @@
+﻿#pragma once
+# include "../ReversiEngine.hpp"
+# include "SquareEval.hpp"
+# include <array>
+# include <cstdint>
+# include <string>
+# include <vector>
+
+#ifdef REVERSI_SIMD_AVX2
+# include <immintrin.h>
+#endif
+
+namespace Reversi::Eval
+{
+	/// @brief ニューラルネットの評価関数の学習用の (量子化前の) 重み
+	/// 入力は 128 個 ([ビット番号] 黒の石、[64 + ビット番号] 白の石) で、
+	/// 隠れ層 2 つは [0, 1] に切り詰める ReLU、出力は黒から見た石差です。
+	/// 行列は全て [入力][出力] の順に行優先で並べます。
+	struct NNParameters
+	{
+		static constexpr int32_t InputSize = 128;
+		static constexpr int32_t Hidden1 = 64;
+		static constexpr int32_t Hidden2 = 32;
+
+		std::vector<float> w1; // [InputSize][Hidden1]
+		std::vector<float> b1; // [Hidden1]
+		std::vector<float> w2; // [Hidden1][Hidden2]
+		std::vector<float> b2; // [Hidden2]
+		std::vector<float> w3; // [Hidden2]
+		float b3 = 0;
+
+		/// @brief 乱数で初期化した重みを作ります (学習の開始点や速度の計測用)
+		static NNParameters initial(uint64_t seed);
+
+		/// @brief 全ての配列が正しい大きさか
+		bool isValid() const;
+	};
+
+	/// @brief NNParameters をファイルに書き出します
+	/// 先頭に識別子 "RVNN"、版、層の大きさ 3 つ、重みの CRC-32 (各 uint32_t) を置き、続けて重みを float で並べます。
+	bool saveNetworkFile(const std::string& path, const NNParameters& params);
+
+	/// @brief saveNetworkFile で書いたファイルを読みます
+	/// @return 読み込めれば true。形式やチェックサムが合わなければ params は変えずに false
+	bool loadNetworkFile(const std::string& path, NNParameters& params);
+
+	/// @brief 1 層目の出力 (アキュムレータ)。局面の石から差分で更新します
+	struct NNState
+	{
+		alignas(32) std::array<int16_t, NNParameters::Hidden1> acc{};
+	};
+
+	/// @brief 量子化したニューラルネットによる評価関数
+	/// 1 層目は入力が石の有無だけなので、着手ごとに打ったマスと裏返った石のマスの列を
+	/// アキュムレータ (NNState) に足し引きするだけで済みます (石 1 つにつき 16 ビット整数 64 個の加算)。
+	/// 2 層目以降だけを局面ごとに計算します。
+	/// 値の単位: 1 層目の出力と活性は 127 が 1.0、2 層目の重みは 64 が 1.0、出力は DiscScale が 1 石。
+	class NNEvaluator
+	{
+	public:
+		static constexpr int32_t Hidden1 = NNParameters::Hidden1;
+		static constexpr int32_t Hidden2 = NNParameters::Hidden2;
+
+		/// @brief 活性の 1.0
+		static constexpr int32_t ActivationOne = 127;
+
+		/// @brief 2 層目の重みの 1.0
+		static constexpr int32_t Weight2One = 64;
+
+		/// @brief 全ての重みが 0 の (常に 0 を返す) 評価関数を作ります
+		NNEvaluator();
+
+		explicit NNEvaluator(const NNParameters& params);
+
+		/// @brief 重みを量子化して設定します
+		/// @return params の大きさが合わなければ何もせず false
+		bool setParameters(const NNParameters& params);
+
+		/// @brief 盤面からアキュムレータを計算し直します
+		void reset(NNState& state, const ReversiEngine& engine) const;
+
+		/// @brief ReversiEngine::doMove の後に呼びます
+		/// @param blackMoved 黒の着手なら true
+		inline void update(NNState& state, const ReversiEngine::Move& move, bool blackMoved) const
+		{
+			if (move.bit)
+			{
+				const int32_t sq = std::countr_zero(move.bit);
+				add(state, blackMoved ? m_black[sq] : m_white[sq]);
+			}
+			// 裏返った石は白と黒の列が入れ替わる
+			for (uint64_t flips = move.flips; flips; flips &= flips - 1)
+			{
+				const auto& column = m_flip[std::countr_zero(flips)];
+				blackMoved ? add(state, column) : sub(state, column);
+			}
+		}
+
+		/// @brief ReversiEngine::undoMove の後に呼びます
+		/// @param blackMoved 取り消した着手が黒のものなら true
+		inline void restore(NNState& state, const ReversiEngine::Move& move, bool blackMoved) const
+		{
+			if (move.bit)
+			{
+				const int32_t sq = std::countr_zero(move.bit);
+				sub(state, blackMoved ? m_black[sq] : m_white[sq]);
+			}
+			for (uint64_t flips = move.flips; flips; flips &= flips - 1)
+			{
+				const auto& column = m_flip[std::countr_zero(flips)];
+				blackMoved ? sub(state, column) : add(state, column);
+			}
+		}
+
+		/// @brief 手番側から見た評価値 (石差、[-64, 64])
+		int32_t evaluate(const NNState& state, const ReversiEngine& engine) const;
+
+		/// @brief 黒から見た評価値 (石差の DiscScale 倍)
+		int32_t evaluateRaw(const NNState& state) const;
+
+	private:
+		using Column = std::array<int16_t, Hidden1>;
+
+		alignas(32) std::array<Column, 64> m_black{}; // [ビット番号] 黒の石の列
+		alignas(32) std::array<Column, 64> m_white{}; // [ビット番号] 白の石の列
+		alignas(32) std::array<Column, 64> m_flip{}; // [ビット番号] m_black - m_white
+		alignas(32) Column m_bias1{};
+		alignas(32) std::array<Column, Hidden2> m_w2{}; // [出力][入力]
+		std::array<int32_t, Hidden2> m_b2{};
+		std::array<int32_t, Hidden2> m_w3{};
+		int32_t m_b3 = 0;
+
+		static inline void add(NNState& state, const Column& column)
+		{
+#ifdef REVERSI_SIMD_AVX2
+			for (int32_t i = 0; i < Hidden1; i += 16)
+			{
+				__m256i* p = reinterpret_cast<__m256i*>(state.acc.data() + i);
+				*p = _mm256_add_epi16(*p, _mm256_load_si256(reinterpret_cast<const __m256i*>(column.data() + i)));
+			}
+#else
+			for (int32_t i = 0; i < Hidden1; ++i) state.acc[i] += column[i];
+#endif
+		}
+
+		static inline void sub(NNState& state, const Column& column)
+		{
+#ifdef REVERSI_SIMD_AVX2
+			for (int32_t i = 0; i < Hidden1; i += 16)
+			{
+				__m256i* p = reinterpret_cast<__m256i*>(state.acc.data() + i);
+				*p = _mm256_sub_epi16(*p, _mm256_load_si256(reinterpret_cast<const __m256i*>(column.data() + i)));
+			}
+#else
+			for (int32_t i = 0; i < Hidden1; ++i) state.acc[i] -= column[i];
+#endif
+		}
+	};
+}
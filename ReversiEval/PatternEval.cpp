@@ -0,0 +1,113 @@
+﻿# include "PatternEval.hpp"
+# include <algorithm>
+# include <bit>
+# include <cmath>
+
+namespace Reversi::Eval
+{
+	namespace
+	{
+		constexpr int32_t maxSquareFeatures()
+		{
+			int32_t res = 0;
+			for (const auto& sq : SquareToFeatures) res = std::max(res, sq.count);
+			return res;
+		}
+		static_assert(maxSquareFeatures() <= 8, "SquareFeatures::entries is too small");
+	}
+
+	void PatternState::reset(const ReversiEngine& engine)
+	{
+		const uint64_t blacks = engine.getBlacks(), whites = engine.getWhites();
+		for (int32_t f = 0; f < NumFeatures; ++f)
+		{
+			const int32_t size = ShapeSize[static_cast<int32_t>(Features[f].shape)];
+			int32_t index = 0;
+			for (int32_t i = 0; i < size; ++i)
+			{
+				const uint64_t bit = 1ull << Features[f].squares[i];
+				index = index * 3 + ((blacks & bit) ? 1 : (whites & bit) ? 2 : 0);
+			}
+			indices[f] = static_cast<uint16_t>(index);
+		}
+	}
+
+	PatternEvaluator::PatternEvaluator()
+	{
+		// 各マスの価値を、そのマスを含むパターンの数で割って配る。
+		// 全てのパターンを足すと、マスごとの価値の合計 (以前の静的評価) になる
+		int32_t coverage[64] = {};
+		for (const auto& f : Features)
+		{
+			for (int32_t i = 0; i < ShapeSize[static_cast<int32_t>(f.shape)]; ++i) coverage[f.squares[i]]++;
+		}
+
+		std::vector<int16_t> phase(PhaseSize);
+		for (int32_t s = 0; s < NumShapes; ++s)
+		{
+			// 同じ形のパターンは回転・反転しただけなので、先頭のものの配置で計算すればよい
+			const Feature* base = std::find_if(Features.begin(), Features.end(), [&](const Feature& f) { return static_cast<int32_t>(f.shape) == s; });
+			const int32_t size = ShapeSize[s];
+
+			for (int32_t index = 0; index < Pow3[size]; ++index)
+			{
+				double value = 0;
+				for (int32_t i = 0, rest = index; i < size; ++i, rest /= 3)
+				{
+					const int32_t sq = base->squares[size - 1 - i];
+					const int32_t digit = rest % 3;
+					if (digit == 0) continue;
+					value += (digit == 1 ? 1.0 : -1.0) * DefaultSquareValues::Values[63 - sq] / coverage[sq];
+				}
+				phase[ShapeOffset[s] + index] = static_cast<int16_t>(std::lround(value));
+			}
+		}
+
+		// 着手可能数 1 つにつき 1 石
+		for (int32_t n = 0; n < MobilitySize; ++n) phase[MobilityOffset + n] = static_cast<int16_t>(n * Scale);
+
+		std::vector<int16_t> weights(WeightCount);
+		for (int32_t p = 0; p < NumPhases; ++p)
+		{
+			std::copy(phase.begin(), phase.end(), weights.begin() + static_cast<size_t>(p) * PhaseSize);
+		}
+		setWeights(std::move(weights));
+	}
+
+	int32_t PatternEvaluator::evaluate(const PatternState& state, const ReversiEngine& engine) const
+	{
+		const int32_t discs = std::popcount(engine.getBlacks() | engine.getWhites());
+		const int16_t* w = m_weights + static_cast<size_t>(phaseOf(discs)) * PhaseSize;
+
+		int32_t score = 0;
+		for (int32_t f = 0; f < NumFeatures; ++f)
+		{
+			score += w[FeatureOffset[f] + state.indices[f]];
+		}
+		if (not engine.isBlackTurn()) score = -score;
+
+		score += w[MobilityOffset + std::popcount(engine.getLegals())];
+
+		return toDiscDiff(score);
+	}
+
+	bool PatternEvaluator::setWeights(std::vector<int16_t> weights)
+	{
+		if (weights.size() != WeightCount) return false;
+		auto owner = std::make_shared<const std::vector<int16_t>>(std::move(weights));
+		shareWeights(owner, owner->data());
+		return true;
+	}
+
+	void PatternEvaluator::shareWeights(std::shared_ptr<const void> owner, const int16_t* weights)
+	{
+		m_owner = std::move(owner);
+		m_weights = weights;
+	}
+
+	PatternEvaluator& defaultPatternEvaluator()
+	{
+		static PatternEvaluator evaluator;
+		return evaluator;
+	}
+}
@@ -0,0 +1,264 @@
+﻿#pragma once
+# include "../ReversiEngine.hpp"
+# include "SquareEval.hpp"
+# include <array>
+# include <cstdint>
+# include <memory>
+# include <span>
+# include <vector>
+
+namespace Reversi::Eval
+{
+	/// @brief パターンの形。同じ形のパターン (回転・反転したもの) は同じ重みの表を使います
+	enum class Shape : uint8_t
+	{
+		Edge2X, // 辺 8 マスと 2 つの X 打ち
+		Corner3x3, // 隅の 3x3
+		Corner2x5, // 隅の 2x5 (縦横 2 種類)
+		Diag8, // 長さ 8 の斜め
+		Diag7,
+		Diag6,
+		Diag5,
+		Diag4,
+	};
+
+	inline constexpr int32_t NumShapes = 8;
+
+	/// @brief 形ごとのマス数
+	inline constexpr int32_t ShapeSize[NumShapes] = { 10, 9, 10, 8, 7, 6, 5, 4 };
+
+	/// @brief 3 の冪
+	inline constexpr int32_t Pow3[11] = { 1, 3, 9, 27, 81, 243, 729, 2187, 6561, 19683, 59049 };
+
+	/// @brief 1 つの局面で見るパターン (特徴) の数
+	inline constexpr int32_t NumFeatures = 34;
+
+	/// @brief 盤面上に置いた 1 つのパターン
+	struct Feature
+	{
+		Shape shape;
+		int8_t squares[10]; // ビット番号。先頭のマスが 3 進数の最上位の桁
+	};
+
+	namespace detail
+	{
+		struct Point
+		{
+			int8_t x, y;
+		};
+
+		/// @brief 90 度回転
+		constexpr Point rotate(Point p) { return { static_cast<int8_t>(7 - p.y), p.x }; }
+
+		/// @brief 左上と右下を結ぶ対角線での反転
+		constexpr Point transpose(Point p) { return { p.y, p.x }; }
+
+		constexpr int8_t toBit(Point p) { return static_cast<int8_t>(63 - (p.x + 8 * p.y)); }
+
+		/// @brief 基準の配置を回転 (と反転) して全てのパターンを作ります
+		constexpr std::array<Feature, NumFeatures> makeFeatures()
+		{
+			constexpr Point edge2X[10] = { { 1, 1 }, { 0, 0 }, { 1, 0 }, { 2, 0 }, { 3, 0 }, { 4, 0 }, { 5, 0 }, { 6, 0 }, { 7, 0 }, { 6, 1 } };
+			constexpr Point corner3x3[9] = { { 0, 0 }, { 1, 0 }, { 2, 0 }, { 0, 1 }, { 1, 1 }, { 2, 1 }, { 0, 2 }, { 1, 2 }, { 2, 2 } };
+			constexpr Point corner2x5[10] = { { 0, 0 }, { 1, 0 }, { 2, 0 }, { 3, 0 }, { 4, 0 }, { 0, 1 }, { 1, 1 }, { 2, 1 }, { 3, 1 }, { 4, 1 } };
+			constexpr Point diag8[8] = { { 0, 0 }, { 1, 1 }, { 2, 2 }, { 3, 3 }, { 4, 4 }, { 5, 5 }, { 6, 6 }, { 7, 7 } };
+			constexpr Point diag7[7] = { { 1, 0 }, { 2, 1 }, { 3, 2 }, { 4, 3 }, { 5, 4 }, { 6, 5 }, { 7, 6 } };
+			constexpr Point diag6[6] = { { 2, 0 }, { 3, 1 }, { 4, 2 }, { 5, 3 }, { 6, 4 }, { 7, 5 } };
+			constexpr Point diag5[5] = { { 3, 0 }, { 4, 1 }, { 5, 2 }, { 6, 3 }, { 7, 4 } };
+			constexpr Point diag4[4] = { { 4, 0 }, { 5, 1 }, { 6, 2 }, { 7, 3 } };
+
+			std::array<Feature, NumFeatures> res{};
+			int32_t n = 0;
+
+			auto add = [&](Shape shape, const Point* base, int32_t size, int32_t rotations, bool flip)
+			{
+				for (int32_t r = 0; r < rotations; ++r)
+				{
+					Feature f{ shape, {} };
+					for (int32_t i = 0; i < size; ++i)
+					{
+						Point p = flip ? transpose(base[i]) : base[i];
+						for (int32_t k = 0; k < r; ++k) p = rotate(p);
+						f.squares[i] = toBit(p);
+					}
+					res[n++] = f;
+				}
+			};
+
+			add(Shape::Edge2X, edge2X, 10, 4, false);
+			add(Shape::Corner3x3, corner3x3, 9, 4, false);
+			add(Shape::Corner2x5, corner2x5, 10, 4, false);
+			add(Shape::Corner2x5, corner2x5, 10, 4, true);
+			add(Shape::Diag8, diag8, 8, 2, false);
+			add(Shape::Diag7, diag7, 7, 4, false);
+			add(Shape::Diag6, diag6, 6, 4, false);
+			add(Shape::Diag5, diag5, 5, 4, false);
+			add(Shape::Diag4, diag4, 4, 4, false);
+			return res;
+		}
+	}
+
+	inline constexpr std::array<Feature, NumFeatures> Features = detail::makeFeatures();
+
+	/// @brief あるマスを含むパターンと、そのマスの桁の重み (3 の冪)
+	struct SquareFeatures
+	{
+		struct Entry
+		{
+			uint8_t feature;
+			uint16_t pow3;
+		};
+
+		int32_t count;
+		Entry entries[8];
+	};
+
+	namespace detail
+	{
+		constexpr std::array<SquareFeatures, 64> makeSquareFeatures()
+		{
+			std::array<SquareFeatures, 64> res{};
+			for (int32_t f = 0; f < NumFeatures; ++f)
+			{
+				const int32_t size = ShapeSize[static_cast<int32_t>(Features[f].shape)];
+				for (int32_t i = 0; i < size; ++i)
+				{
+					auto& sq = res[Features[f].squares[i]];
+					sq.entries[sq.count++] = { static_cast<uint8_t>(f), static_cast<uint16_t>(Pow3[size - 1 - i]) };
+				}
+			}
+			return res;
+		}
+	}
+
+	/// @brief [ビット番号] そのマスを含むパターンの一覧
+	inline constexpr std::array<SquareFeatures, 64> SquareToFeatures = detail::makeSquareFeatures();
+
+	/// @brief 局面の全てのパターンの 3 進数の番号 (空き 0, 黒 1, 白 2)
+	/// 着手ごとに、打ったマスと裏返った石のマスを含むパターンの番号だけを差分で更新します
+	struct PatternState
+	{
+		std::array<uint16_t, NumFeatures> indices{};
+
+		/// @brief 盤面から番号を計算し直します
+		void reset(const ReversiEngine& engine);
+
+		/// @brief ReversiEngine::doMove の後に呼びます
+		/// @param blackMoved 黒の着手なら true
+		inline void update(const ReversiEngine::Move& move, bool blackMoved)
+		{
+			if (move.bit)
+			{
+				for (const auto& e : entriesOf(move.bit)) indices[e.feature] += e.pow3 * (blackMoved ? 1 : 2);
+			}
+			// 裏返った石は黒 (1) と白 (2) が入れ替わる
+			applyFlips(move.flips, blackMoved ? -1 : 1);
+		}
+
+		/// @brief ReversiEngine::undoMove の後に呼びます
+		/// @param blackMoved 取り消した着手が黒のものなら true
+		inline void restore(const ReversiEngine::Move& move, bool blackMoved)
+		{
+			if (move.bit)
+			{
+				for (const auto& e : entriesOf(move.bit)) indices[e.feature] -= e.pow3 * (blackMoved ? 1 : 2);
+			}
+			applyFlips(move.flips, blackMoved ? 1 : -1);
+		}
+
+	private:
+		struct EntryRange
+		{
+			const SquareFeatures::Entry* first;
+			const SquareFeatures::Entry* last;
+			const SquareFeatures::Entry* begin() const { return first; }
+			const SquareFeatures::Entry* end() const { return last; }
+		};
+
+		static EntryRange entriesOf(uint64_t bit)
+		{
+			const auto& sq = SquareToFeatures[std::countr_zero(bit)];
+			return { sq.entries, sq.entries + sq.count };
+		}
+
+		inline void applyFlips(uint64_t flips, int32_t sign)
+		{
+			for (; flips; flips &= flips - 1)
+			{
+				for (const auto& e : entriesOf(flips)) indices[e.feature] += sign * e.pow3;
+			}
+		}
+	};
+
+	/// @brief パターンの重みによる評価関数
+	/// 重みは [段階][形ごとの表 + 着手可能数の表] の順に 1 本の int16_t 配列に詰めてあります。
+	/// 段階は石の数で分け、番号は黒から見たものなので、白番では符号を反転します。
+	/// 重みの配列は読み取り専用で、コピーした評価関数どうしや読み込んだファイル (WeightFile.hpp) と共有します。
+	class PatternEvaluator
+	{
+	public:
+		/// @brief 段階の数
+		static constexpr int32_t NumPhases = 6;
+
+		/// @brief 重みの単位 (1 石 = Scale)
+		static constexpr int32_t Scale = DiscScale;
+
+		/// @brief 形ごとの表の先頭位置 (1 段階の中での位置)
+		static constexpr std::array<int32_t, NumShapes + 1> ShapeOffset = []
+		{
+			std::array<int32_t, NumShapes + 1> res{};
+			for (int32_t s = 0; s < NumShapes; ++s) res[s + 1] = res[s] + Pow3[ShapeSize[s]];
+			return res;
+		}();
+
+		/// @brief パターンごとの表の先頭位置 (1 段階の中での位置)
+		static constexpr std::array<int32_t, NumFeatures> FeatureOffset = []
+		{
+			std::array<int32_t, NumFeatures> res{};
+			for (int32_t f = 0; f < NumFeatures; ++f) res[f] = ShapeOffset[static_cast<int32_t>(Features[f].shape)];
+			return res;
+		}();
+
+		/// @brief 着手可能数の表の先頭位置と大きさ
+		static constexpr int32_t MobilityOffset = ShapeOffset[NumShapes];
+		static constexpr int32_t MobilitySize = 64;
+
+		/// @brief 1 段階の重みの数
+		static constexpr int32_t PhaseSize = MobilityOffset + MobilitySize;
+
+		/// @brief 重み全体の数
+		static constexpr size_t WeightCount = static_cast<size_t>(PhaseSize) * NumPhases;
+
+		/// @brief 石の数から段階を求めます
+		static constexpr int32_t phaseOf(int32_t discs)
+		{
+			const int32_t phase = (discs - 4) * NumPhases / 61;
+			return phase < 0 ? 0 : phase >= NumPhases ? NumPhases - 1 : phase;
+		}
+
+		/// @brief マスごとの静的な価値から作った初期の重みで作ります
+		PatternEvaluator();
+
+		/// @brief 手番側から見た評価値 (石差、[-64, 64])
+		int32_t evaluate(const PatternState& state, const ReversiEngine& engine) const;
+
+		/// @brief 重み全体
+		std::span<const int16_t> weights() const { return { m_weights, WeightCount }; }
+
+		/// @brief 重みを差し替えます (学習の結果など)
+		/// @return 数が WeightCount でなければ何もせず false
+		bool setWeights(std::vector<int16_t> weights);
+
+		/// @brief 外部のメモリにある重みを、コピーせずに使います
+		/// @param owner weights の寿命を持つもの (メモリに割り当てたファイルなど)
+		/// @param weights WeightCount 個の重み
+		void shareWeights(std::shared_ptr<const void> owner, const int16_t* weights);
+
+	private:
+		std::shared_ptr<const void> m_owner; // m_weights の寿命を持つ
+		const int16_t* m_weights = nullptr;
+	};
+
+	/// @brief 既定の評価関数 (全てのエージェントで共有する)
+	PatternEvaluator& defaultPatternEvaluator();
+}
@@ -0,0 +1,82 @@
+﻿#pragma once
+# include "../ReversiEngine.hpp"
+# include <array>
+# include <cstdint>
+
+namespace Reversi::Eval
+{
+	/// @brief 評価関数の内部の単位 (1 石 = DiscScale)
+	inline constexpr int32_t DiscScale = 256;
+
+	/// @brief DiscScale 倍の評価値を四捨五入して石差にし、[-64, 64] に収めます
+	constexpr int32_t toDiscDiff(int32_t raw)
+	{
+		const int32_t score = raw > 0 ? (raw + DiscScale / 2) / DiscScale : -((-raw + DiscScale / 2) / DiscScale);
+		return score < -64 ? -64 : score > 64 ? 64 : score;
+	}
+
+	/// @brief マスごとの価値の既定値 (石差の DiscScale 倍)
+	struct DefaultSquareValues
+	{
+		/// @brief [x + 8 * y]
+		static constexpr std::array<int32_t, 64> Values = {
+			2714, 147, 69, -18, -18, 69, 147, 2714,
+			147, -577, -186, -153, -153, -186, -577, 147,
+			69, -186, -379, -122, -122, -379, -186, 69,
+			-18, -153, -122, -169, -169, -122, -153, -18,
+			-18, -153, -122, -169, -169, -122, -153, -18,
+			69, -186, -379, -122, -122, -379, -186, 69,
+			147, -577, -186, -153, -153, -186, -577, 147,
+			2714, 147, 69, -18, -18, 69, 147, 2714,
+		};
+	};
+
+	/// @brief マスごとの価値の合計による評価関数
+	/// 価値は Policy::Values ([x + 8 * y]、石差の DiscScale 倍) で与えます。
+	/// 行ごとに石の並び 256 通りの価値の合計をコンパイル時に表にしておき、1 行 1 回の表引きで合計します。
+	/// 表は Policy ごとに 1 つだけの静的な配列 (8 KB) で、エージェントごとには持ちません。
+	template <class Policy = DefaultSquareValues>
+	class SquareEvaluator
+	{
+	public:
+		/// @brief [行][その行の石の並び (左端が最上位ビット)] 価値の合計
+		static constexpr std::array<std::array<int32_t, 256>, 8> RowValues = []
+		{
+			std::array<std::array<int32_t, 256>, 8> res{};
+			for (int32_t y = 0; y < 8; ++y)
+			{
+				for (int32_t bits = 0; bits < 256; ++bits)
+				{
+					for (int32_t x = 0; x < 8; ++x)
+					{
+						if (bits & (1 << (7 - x))) res[y][bits] += Policy::Values[x + 8 * y];
+					}
+				}
+			}
+			return res;
+		}();
+
+		/// @brief 黒から見た価値の合計 (石差の DiscScale 倍)
+		static constexpr int32_t evaluateRaw(uint64_t blacks, uint64_t whites)
+		{
+			int32_t score = 0;
+			for (int32_t y = 0; y < 8; ++y)
+			{
+				const int32_t shift = 56 - 8 * y;
+				score += RowValues[y][(blacks >> shift) & 0xFF];
+				score -= RowValues[y][(whites >> shift) & 0xFF];
+			}
+			return score;
+		}
+
+		/// @brief 手番側から見た評価値 (石差、[-64, 64])
+		static int32_t evaluate(const ReversiEngine& engine)
+		{
+			const int32_t score = evaluateRaw(engine.getBlacks(), engine.getWhites());
+			return toDiscDiff(engine.isBlackTurn() ? score : -score);
+		}
+	};
+
+	static_assert(SquareEvaluator<>::evaluateRaw(0x0000000810000000, 0x0000001008000000) == 0, "initial position must be even");
+	static_assert(SquareEvaluator<>::evaluateRaw(0x8000000000000001, 0) == 2 * 2714, "corners");
+}
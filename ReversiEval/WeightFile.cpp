@@ -0,0 +1,122 @@
+﻿# include "WeightFile.hpp"
+# include "WeightFormat.hpp"
+# include <cstring>
+# include <filesystem>
+# include <fstream>
+# include <memory>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+# include <Windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+namespace Reversi::Eval
+{
+	namespace
+	{
+		/// @brief 読み取り専用でメモリに割り当てたファイル。破棄すると割り当てを解除します
+		class MappedFile
+		{
+		public:
+			/// @return 開けなければ nullptr
+			static std::shared_ptr<const MappedFile> open(const std::string& path)
+			{
+#if defined(_WIN32)
+				const HANDLE file = CreateFileW(std::filesystem::path(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+					OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+				LARGE_INTEGER size;
+				void* data = nullptr;
+				if (GetFileSizeEx(file, &size) and size.QuadPart > 0)
+				{
+					const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+					if (mapping)
+					{
+						data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+						// ビューが残っている間は、ハンドルを閉じても割り当ては続く
+						CloseHandle(mapping);
+					}
+				}
+				CloseHandle(file);
+				if (not data) return nullptr;
+				return std::shared_ptr<const MappedFile>(new MappedFile(data, static_cast<size_t>(size.QuadPart)));
+#else
+				const int fd = ::open(path.c_str(), O_RDONLY);
+				if (fd < 0) return nullptr;
+
+				struct stat st;
+				void* data = MAP_FAILED;
+				if (fstat(fd, &st) == 0 and st.st_size > 0)
+				{
+					data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+				}
+				::close(fd);
+				if (data == MAP_FAILED) return nullptr;
+				return std::shared_ptr<const MappedFile>(new MappedFile(data, static_cast<size_t>(st.st_size)));
+#endif
+			}
+
+			~MappedFile()
+			{
+#if defined(_WIN32)
+				UnmapViewOfFile(m_data);
+#else
+				munmap(m_data, m_size);
+#endif
+			}
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			const uint8_t* data() const { return static_cast<const uint8_t*>(m_data); }
+			size_t size() const { return m_size; }
+
+		private:
+			void* m_data;
+			size_t m_size;
+
+			MappedFile(void* data, size_t size) : m_data(data), m_size(size) {}
+		};
+	}
+
+	bool saveWeightFile(const std::string& path, std::span<const int16_t> weights)
+	{
+		std::ofstream ofs(path, std::ios::binary);
+		if (not ofs) return false;
+
+		const WeightFileHeader header = makeWeightFileHeader(weights, false);
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		ofs.write(reinterpret_cast<const char*>(weights.data()), static_cast<std::streamsize>(weights.size_bytes()));
+		return static_cast<bool>(ofs);
+	}
+
+	bool loadWeightFile(const std::string& path, PatternEvaluator& evaluator)
+	{
+		const auto file = MappedFile::open(path);
+		if (not file or file->size() < sizeof(WeightFileHeader)) return false;
+
+		WeightFileHeader header;
+		std::memcpy(&header, file->data(), sizeof(header));
+		if (not isValidHeader(header, false)) return false;
+
+		const size_t bytes = header.count * sizeof(int16_t);
+		if (file->size() != sizeof(header) + bytes) return false;
+
+		const uint8_t* weights = file->data() + sizeof(header);
+		if (crc32(weights, bytes) != header.checksum) return false;
+
+		evaluator.shareWeights(file, reinterpret_cast<const int16_t*>(weights));
+		return true;
+	}
+}
@@ -0,0 +1,17 @@
+﻿#pragma once
+# include "PatternEval.hpp"
+# include <span>
+# include <string>
+
+namespace Reversi::Eval
+{
+	/// @brief 重みをファイルに書き出します (形式は WeightFormat.hpp の WeightFileHeader を参照)
+	/// @return 書き込めれば true
+	bool saveWeightFile(const std::string& path, std::span<const int16_t> weights);
+
+	/// @brief 重みファイルを読み取り専用でメモリに割り当て、評価関数にコピーせずに使わせます
+	/// 評価関数を共有する全てのエージェントとスレッドが 1 つの割り当てを使い、読み込みでの変換もありません。
+	/// 同じファイルを開いた別のプロセスとも、OS のページキャッシュで物理メモリを共有します。
+	/// @return 読み込めれば true。ファイルが無いか、版や大きさやチェックサムが合わなければ評価関数は変えずに false
+	bool loadWeightFile(const std::string& path, PatternEvaluator& evaluator);
+}
@@ -0,0 +1,182 @@
+﻿# include "WeightFormat.hpp"
+# include <array>
+# include <cstring>
+# include <vector>
+
+namespace Reversi::Eval
+{
+	namespace
+	{
+		constexpr char RawMagic[4] = { 'R', 'V', 'P', 'W' };
+		constexpr char CompressedMagic[4] = { 'R', 'V', 'P', 'Z' };
+
+		constexpr std::array<uint32_t, 256> Crc32Table = []
+		{
+			std::array<uint32_t, 256> res{};
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t c = i;
+				for (int32_t k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+				res[i] = c;
+			}
+			return res;
+		}();
+
+		constexpr char Base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+		constexpr std::array<int8_t, 256> Base64Values = []
+		{
+			std::array<int8_t, 256> res{};
+			res.fill(-1);
+			for (int32_t i = 0; i < 64; ++i) res[static_cast<uint8_t>(Base64Chars[i])] = static_cast<int8_t>(i);
+			return res;
+		}();
+
+		void putVarint(std::string& out, uint32_t value)
+		{
+			for (; value >= 0x80; value >>= 7) out += static_cast<char>((value & 0x7F) | 0x80);
+			out += static_cast<char>(value);
+		}
+
+		bool getVarint(const std::string& in, size_t& pos, uint32_t& value)
+		{
+			value = 0;
+			for (int32_t shift = 0; shift < 35; shift += 7)
+			{
+				if (pos >= in.size()) return false;
+				const uint8_t byte = static_cast<uint8_t>(in[pos++]);
+				value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+				if (not (byte & 0x80)) return true;
+			}
+			return false;
+		}
+
+		std::string toBase64(const std::string& bytes)
+		{
+			std::string res;
+			res.reserve((bytes.size() + 2) / 3 * 4);
+			uint32_t buffer = 0;
+			int32_t bits = 0;
+			for (const char c : bytes)
+			{
+				buffer = (buffer << 8) | static_cast<uint8_t>(c);
+				for (bits += 8; bits >= 6; bits -= 6) res += Base64Chars[(buffer >> (bits - 6)) & 63];
+			}
+			if (bits > 0) res += Base64Chars[(buffer << (6 - bits)) & 63];
+			return res;
+		}
+
+		/// @brief base64 を読みます。改行などの base64 でない文字は読み飛ばします
+		std::string fromBase64(std::span<const char* const> pieces)
+		{
+			std::string res;
+			uint32_t buffer = 0;
+			int32_t bits = 0;
+			for (const char* piece : pieces)
+			{
+				for (; *piece; ++piece)
+				{
+					const int32_t value = Base64Values[static_cast<uint8_t>(*piece)];
+					if (value < 0) continue;
+					buffer = (buffer << 6) | static_cast<uint32_t>(value);
+					bits += 6;
+					if (bits >= 8)
+					{
+						bits -= 8;
+						res += static_cast<char>((buffer >> bits) & 0xFF);
+					}
+				}
+			}
+			return res;
+		}
+	}
+
+	uint32_t crc32(const void* data, size_t size)
+	{
+		const uint8_t* p = static_cast<const uint8_t*>(data);
+		uint32_t c = 0xFFFFFFFF;
+		for (size_t i = 0; i < size; ++i) c = Crc32Table[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+		return c ^ 0xFFFFFFFF;
+	}
+
+	WeightFileHeader makeWeightFileHeader(std::span<const int16_t> weights, bool compressed)
+	{
+		WeightFileHeader header{ {}, WeightFileVersion, PatternEvaluator::NumPhases, PatternEvaluator::PhaseSize,
+			weights.size(), crc32(weights.data(), weights.size_bytes()), 0 };
+		std::memcpy(header.magic, compressed ? CompressedMagic : RawMagic, sizeof(header.magic));
+		return header;
+	}
+
+	bool isValidHeader(const WeightFileHeader& header, bool compressed)
+	{
+		return std::memcmp(header.magic, compressed ? CompressedMagic : RawMagic, sizeof(header.magic)) == 0
+			and header.version == WeightFileVersion
+			and header.numPhases == PatternEvaluator::NumPhases
+			and header.phaseSize == PatternEvaluator::PhaseSize
+			and header.count == PatternEvaluator::WeightCount;
+	}
+
+	std::string encodeEmbeddedWeights(std::span<const int16_t> weights)
+	{
+		const WeightFileHeader header = makeWeightFileHeader(weights, true);
+		const PatternEvaluator defaults;
+		const auto base = defaults.weights();
+
+		std::string bytes(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (size_t i = 0; i < weights.size(); )
+		{
+			// 0 の連続は (長さ << 1) | 1、それ以外は差をジグザグ符号化して << 1
+			const int32_t diff = weights[i] - base[i];
+			if (diff == 0)
+			{
+				size_t j = i;
+				while (j < weights.size() and weights[j] == base[j]) ++j;
+				putVarint(bytes, static_cast<uint32_t>(j - i) << 1 | 1);
+				i = j;
+			}
+			else
+			{
+				const uint32_t zigzag = static_cast<uint32_t>(diff << 1) ^ static_cast<uint32_t>(diff >> 31);
+				putVarint(bytes, zigzag << 1);
+				++i;
+			}
+		}
+		return toBase64(bytes);
+	}
+
+	bool loadEmbeddedWeights(std::span<const char* const> pieces, PatternEvaluator& evaluator)
+	{
+		const std::string bytes = fromBase64(pieces);
+		if (bytes.size() < sizeof(WeightFileHeader)) return false;
+
+		WeightFileHeader header;
+		std::memcpy(&header, bytes.data(), sizeof(header));
+		if (not isValidHeader(header, true)) return false;
+
+		const PatternEvaluator defaults;
+		const auto base = defaults.weights();
+		std::vector<int16_t> weights(base.begin(), base.end());
+		size_t pos = sizeof(header), i = 0;
+		uint32_t token;
+
+		while (pos < bytes.size())
+		{
+			if (not getVarint(bytes, pos, token)) return false;
+			if (token & 1)
+			{
+				i += token >> 1;
+			}
+			else
+			{
+				if (i >= weights.size()) return false;
+				const uint32_t zigzag = token >> 1;
+				const int32_t diff = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+				weights[i] = static_cast<int16_t>(base[i] + diff);
+				++i;
+			}
+		}
+
+		if (i != weights.size() or crc32(weights.data(), weights.size() * sizeof(int16_t)) != header.checksum) return false;
+		return evaluator.setWeights(std::move(weights));
+	}
+}
@@ -0,0 +1,47 @@
+﻿#pragma once
+# include "PatternEval.hpp"
+# include <cstdint>
+# include <cstddef>
+# include <span>
+# include <string>
+
+namespace Reversi::Eval
+{
+	/// @brief 重みファイルの先頭 (32 バイト)
+	/// ファイルではこの直後に int16_t の重みが count 個続きます。リトルエンディアンの環境で書いたものをそのまま読みます。
+	/// 先頭が 32 バイトなので、メモリに割り当てたファイルの重みも 32 バイト境界に揃います。
+	struct WeightFileHeader
+	{
+		char magic[4]; // "RVPW"。埋め込み用に圧縮したものは "RVPZ"
+		uint32_t version;
+		uint32_t numPhases;
+		uint32_t phaseSize;
+		uint64_t count; // 重みの数
+		uint32_t checksum; // 圧縮前の重みの CRC-32
+		uint32_t reserved;
+	};
+	static_assert(sizeof(WeightFileHeader) == 32, "WeightFileHeader must be 32 bytes");
+
+	/// @brief 重みファイルの版。形式を変えたら上げる
+	inline constexpr uint32_t WeightFileVersion = 2;
+
+	/// @brief CRC-32 (IEEE 802.3)
+	uint32_t crc32(const void* data, size_t size);
+
+	/// @brief PatternEvaluator の重みのヘッダを作ります
+	/// @param compressed 埋め込み用に圧縮したものなら true
+	WeightFileHeader makeWeightFileHeader(std::span<const int16_t> weights, bool compressed);
+
+	/// @brief ヘッダの識別子、版、大きさが今の PatternEvaluator と合うか確かめます (チェックサムは見ません)
+	bool isValidHeader(const WeightFileHeader& header, bool compressed);
+
+	/// @brief 重みを圧縮し、ソースコードに埋め込める base64 の文字列にします
+	/// 既定の重み (PatternEvaluator のコンストラクタのもの) との差を、0 の連続をまとめた可変長整数で並べます。
+	/// 局面集に現れず学習で変わらなかった重みは 0 の連続になります。
+	std::string encodeEmbeddedWeights(std::span<const int16_t> weights);
+
+	/// @brief encodeEmbeddedWeights の文字列を読んで評価関数に設定します
+	/// @param pieces 文字列を分けたもの (コンパイラの文字列リテラルの長さの制限のため)。つないで 1 つとして読みます
+	/// @return 読み込めれば true。空か壊れていれば評価関数は変えずに false
+	bool loadEmbeddedWeights(std::span<const char* const> pieces, PatternEvaluator& evaluator);
+}
@@ -0,0 +1,37 @@
+﻿#pragma once
+// ベンチマーク用の局面集 (ランダムな対局の途中局面)
+// 盤面文字列は Reversi::parseBoard の書式
+
+namespace BenchPositions
+{
+	/// @brief 中盤 (空きマス 52 から 24 まで)
+	inline constexpr const char* Midgame[] = {
+		"---O------XOX------OX------OX------OX-----O--X------------------ X",
+		"--------------X----O--X---XOXOX---XOOX----XOOO------------------ X",
+		"---------X----X---X--XX---OXXX----OOOX----OOXXX---O---X--------- X",
+		"----------OX--O----XXXOO--OXOOO---XXOO-X---OOX----O-O----O------ X",
+		"-OOOO-----OO-----XOOO---XXXOOO----OOO-O---O-XO------XX------XXX- X",
+		"-OOOO------XO------XOX---OOXOX---XXXXXXO--OXO-O----XOO-X--X-O-O- X",
+		"OOOOO----OXX-O---OXXX-O--XXXXXXX-XXXOX---X-OXXX--XOOOO---------- X",
+		"-OO-----XOO---OOXOO--OOOXOXOOOXO-XXOXXXXXXOXXXXX-O-X-----O--X--- X",
+	};
+
+	/// @brief 手番の側に打てる手が無い (パスする) 局面
+	inline constexpr const char* Pass[] = {
+		"-------------------X-------XX------XXX-------X-O-----OO------O-X X",
+	};
+
+	/// @brief 終盤 (空きマス 14 から 18 まで)。空きマス数の深さで読めば終局まで届きます
+	inline constexpr const char* Endgame[] = {
+		"XX-O--O-XXO--O--XXXOOOOOXXOXOOO-XXXOXOO-XXOXXXO-XOOOOOO-O-OOOOO- X",
+		"-XO---O--XXXXOOX--XXXXXX-XOXOXXOXOXOXXOOXOOXXXOOXOO-XOOO--O--OOO X",
+		"OOO-XXO-OXXXXXX-OOOXOXX-OOOXXX-XOX-XOXO-XXXXXOOO--XXXXO--OX--X-- O",
+		"-----OXXO--X-OXXOOXXXXOXOXOXOOOOOOXOOOOOOOOXOX--OXXXXXX--XX-OX-- O",
+		"--XXX-OX-OXX-OO--XXXOOXXXXXOOXXXO-OOXXXX-OOOOO-X--OOOOO---X-OOOO X",
+		"XO-XO--O-X-OOOO-OOOOOOOO-OOOOXXOXXXXOXX--OOOOXXX--O-OXXX--O--XXX X",
+		"OOOX----OOOOO---OXXX-O--XXXXXXXXXXXOOXXXXXXXOXXX--O-X-XX-OX-OX-X O",
+		"-OOOOOOOXX-X-OO--XXOOOOO-OXOOX-XO-OXXXX-XOOOXX--XXOX--X-XXXO---X O",
+		"-O-OX----OOO-XX--OOOOOXXXOOXOOX--OOOOX-OXOOOXXXX--XXXXX--OXX-X-O X",
+		"--O-X-O-X-OOXOXXOXO-OO-X-OXOOOXX--OOXOXX-OO-XXX--OOOOXXO--OOO-XX X",
+	};
+}
@@ -0,0 +1,98 @@
+﻿// 終盤の完全読み (Reversi::EndgameSolver) の正しさと速さを確かめます
+// FFO の終盤問題 (#40, #41) と BenchPositions::Endgame を解き、勝敗と石差を読む時間とノード数を表示します。
+// 石差の基準値は FFO の公表値と、枝刈りだけの単純な alpha-beta で求めた値です。
+//
+// g++ -std=c++20 -O2 -march=native Tools/EndgameBench.cpp ReversiEngine.cpp Trace.cpp TranspositionTable.cpp EndgameSolver.cpp -o EndgameBench
+// ./EndgameBench [maxEmpties]    空きマスが maxEmpties 以下の問題だけ解く (既定は全て)
+
+# include <iostream>
+# include <chrono>
+# include <string>
+# include "../EndgameSolver.hpp"
+# include "BenchPositions.hpp"
+
+namespace
+{
+	struct EndgameCase
+	{
+		const char* name;
+		const char* board;
+		int32_t score; // 手番側から見た最終石差
+		const char* bestMove; // 最善手 (一意なものだけ確かめる)。nullptr なら確かめない
+	};
+
+	const EndgameCase FFOSuite[] = {
+		{ "FFO #40", "O--OOOOX-OOOOOOXOOXXOOOXOOXOOOXXOOOOOOXX---OOOOX----O--X-------- X", 38, "a2" },
+		{ "FFO #41", "-OOOOO----OOOOX--OOOOOO-XXXXXOO--XXOOX--OOXOXX----OXXO---OOO--O- X", 0, "h4" },
+	};
+
+	/// @brief BenchPositions::Endgame の石差 (同じ順)
+	constexpr int32_t BenchEndgameScores[] = { 58, -12, 22, 18, 2, 44, 22, 6, -2, 16 };
+
+	std::string moveName(uint64_t bit)
+	{
+		if (bit == 0) return "pass";
+		const int32_t idx = 63 - std::countr_zero(bit);
+		return { char('a' + (idx & 7)), char('1' + (idx >> 3)) };
+	}
+
+	int64_t totalNodes = 0;
+	double totalSec = 0;
+
+	/// @brief 1 問解いて結果を表示します
+	/// @return 正しければ true
+	bool run(Reversi::EndgameSolver& solver, const EndgameCase& c)
+	{
+		Reversi::ReversiEngine engine;
+		Reversi::parseBoard(c.board, engine);
+		const int32_t empties = 64 - std::popcount(engine.getBlacks() | engine.getWhites());
+
+		solver.clearHash();
+		auto start = std::chrono::steady_clock::now();
+		const auto wld = solver.solveWLD(engine);
+		const double wldSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		solver.clearHash();
+		start = std::chrono::steady_clock::now();
+		const auto res = solver.solve(engine);
+		const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		totalNodes += solver.getNodeCount();
+		totalSec += sec;
+
+		const bool ok = res.completed and res.score == c.score and wld.score == (c.score > 0) - (c.score < 0)
+			and (c.bestMove == nullptr or moveName(res.bestMove) == c.bestMove);
+
+		std::cout << c.name << " (" << empties << " empties): " << moveName(res.bestMove) << " " << res.score
+			<< ", WLD " << wldSec * 1000 << " ms, exact " << sec * 1000 << " ms, " << solver.getNodeCount() << " nodes, "
+			<< static_cast<int64_t>(solver.getNodeCount() / std::max(sec, 1e-9)) << " nodes/s";
+		if (ok) std::cout << "  OK\n";
+		else std::cout << "  NG (expected " << c.score << (c.bestMove ? std::string(" ") + c.bestMove : "") << ")\n";
+		return ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const int32_t maxEmpties = argc > 1 ? std::stoi(argv[1]) : 64;
+	Reversi::EndgameSolver solver(64);
+	int32_t failures = 0;
+
+	auto solveIfSmall = [&](const EndgameCase& c)
+	{
+		Reversi::ReversiEngine engine;
+		Reversi::parseBoard(c.board, engine);
+		if (64 - std::popcount(engine.getBlacks() | engine.getWhites()) > maxEmpties) return;
+		if (not run(solver, c)) failures++;
+	};
+
+	for (size_t i = 0; i < std::size(BenchPositions::Endgame); i++)
+	{
+		const std::string name = "bench #" + std::to_string(i);
+		solveIfSmall({ name.c_str(), BenchPositions::Endgame[i], BenchEndgameScores[i], nullptr });
+	}
+	for (const auto& c : FFOSuite) solveIfSmall(c);
+
+	std::cout << "total: " << totalNodes << " nodes, " << totalSec * 1000 << " ms, "
+		<< static_cast<int64_t>(totalNodes / std::max(totalSec, 1e-9)) << " nodes/s, " << failures << " failures\n";
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+﻿// CMat::matmul (詰め直し + ブロック化した GEMM) の速さを、以前の転置してから内積を取る実装と比べます
+// 正方行列と端の出る大きさで、結果の最大誤差と GFLOPS を表示します。
+// 要素ごとの式 a * b + c も、以前の演算子 (左辺をコピーしてスカラーのループで計算) と比べます。
+// 初めに ThreadExecutor で分けた結果が 1 スレッドの結果と一致するかを確かめ、違えば 1 を返して終わります
+// (コアが 1 つでもスレッドは作るので確かめられます)。
+//
+// g++ -std=c++20 -O2 -march=native -pthread Tools/GemmBench.cpp -o GemmBench
+// ./GemmBench [threads]    既定はハードウェアのスレッド数
+
+# include <iostream>
+# include <chrono>
+# include <random>
+# include <string>
+# include <cmath>
+# include <tuple>
+# include "../lib/CMat/CMat.hpp"
+
+namespace
+{
+	/// @brief 以前の CMat::matmul (b を転置して、出力の要素ごとに 1 本の __m256 で内積を取る)
+	CMat::CMat<float> transposedDotMatmul(const CMat::CMat<float>& a, const CMat::CMat<float>& b)
+	{
+		const CMat::CMat<float> bt = b.transposed();
+		CMat::CMat<float> c(CMat::MatShape{ a.shape.rows, b.shape.cols });
+
+		const float* a_ptr = a.data();
+		float* c_ptr = c.data();
+
+		for (uint32_t i = 0; i < c.shape.rows; ++i)
+		{
+			const float* bt_ptr = bt.data();
+			for (uint32_t j = 0; j < c.shape.cols; ++j)
+			{
+				float sum = 0;
+				uint32_t k = 0;
+				__m256 acc = _mm256_setzero_ps();
+				for (; k + 8 <= a.shape.cols; k += 8)
+				{
+					acc = _mm256_fmadd_ps(_mm256_loadu_ps(a_ptr + k), _mm256_loadu_ps(bt_ptr + k), acc);
+				}
+				alignas(32) float temp[8];
+				_mm256_store_ps(temp, acc);
+				for (int l = 0; l < 8; ++l) sum += temp[l];
+				for (; k < a.shape.cols; ++k) sum += a_ptr[k] * bt_ptr[k];
+
+				*c_ptr++ = sum;
+				bt_ptr += a.shape.cols;
+			}
+			a_ptr += a.shape.cols;
+		}
+		return c;
+	}
+
+	template<class _Dty>
+	CMat::CMat<_Dty> randomMat(uint32_t rows, uint32_t cols, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<_Dty> dist(-1, 1);
+		CMat::CMat<_Dty> res(CMat::MatShape{ rows, cols });
+		for (size_t i = 0; i < res.size(); ++i) res.data()[i] = dist(rng);
+		return res;
+	}
+
+	/// @brief f を 0.5 秒以上になるまで繰り返し、1 回あたりの秒数を返します
+	template<class _Fn>
+	double measure(_Fn&& f)
+	{
+		f();
+		int32_t reps = 0;
+		const auto start = std::chrono::steady_clock::now();
+		double sec = 0;
+		do
+		{
+			f();
+			reps++;
+			sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		} while (sec < 0.5);
+		return sec / reps;
+	}
+
+	template<class _Dty>
+	double maxError(CMat::CMat<_Dty>& x, CMat::CMat<_Dty>& y)
+	{
+		double res = 0;
+		for (size_t i = 0; i < x.size(); ++i) res = std::max(res, std::abs(static_cast<double>(x.data()[i]) - y.data()[i]));
+		return res;
+	}
+
+	/// @brief 誤差の基準にする倍精度の素朴な行列積
+	template<class _Dty>
+	CMat::CMat<_Dty> referenceMatmul(const CMat::CMat<_Dty>& a, const CMat::CMat<_Dty>& b)
+	{
+		CMat::CMat<_Dty> c(CMat::MatShape{ a.shape.rows, b.shape.cols });
+		for (uint32_t i = 0; i < a.shape.rows; ++i)
+		{
+			for (uint32_t j = 0; j < b.shape.cols; ++j)
+			{
+				double sum = 0;
+				for (uint32_t p = 0; p < a.shape.cols; ++p)
+				{
+					sum += static_cast<double>(a.data()[i * a.shape.cols + p]) * b.data()[p * b.shape.cols + j];
+				}
+				c.data()[i * c.shape.cols + j] = static_cast<_Dty>(sum);
+			}
+		}
+		return c;
+	}
+
+	/// @brief 以前の operator* と operator+ (左辺をコピーしてから 1 要素ずつ計算)
+	CMat::CMat<float> copyingMulAdd(const CMat::CMat<float>& a, const CMat::CMat<float>& b, const CMat::CMat<float>& c)
+	{
+		CMat::CMat<float> t = a;
+		for (size_t i = 0; i < t.size(); ++i) t.data()[i] *= b.data()[i];
+		CMat::CMat<float> res = t;
+		for (size_t i = 0; i < res.size(); ++i) res.data()[i] += c.data()[i];
+		return res;
+	}
+
+	void runElementwise(uint32_t rows, uint32_t cols, std::mt19937& rng)
+	{
+		const auto a = randomMat<float>(rows, cols, rng), b = randomMat<float>(rows, cols, rng), c = randomMat<float>(rows, cols, rng);
+		const double bytes = 4.0 * 4 * rows * cols;
+
+		CMat::CMat<float> r0, r1(CMat::MatShape{ rows, cols });
+		const double t0 = measure([&] { r0 = copyingMulAdd(a, b, c); });
+		const double t1 = measure([&] { r1 = a * b + c; });
+		std::cout << rows << "x" << cols << " a * b + c\n"
+			<< "  copying operators    " << t0 * 1e6 << " us, " << bytes / t0 * 1e-9 << " GB/s\n"
+			<< "  expression           " << t1 * 1e6 << " us, " << bytes / t1 * 1e-9 << " GB/s (max error " << maxError(r0, r1) << "), x" << t0 / t1 << "\n";
+	}
+
+	/// @brief ThreadExecutor{ threads } の結果が SerialExecutor の結果とビット単位で一致するか
+	/// タイルごとの計算は同じなので、スレッドの分け方によらず同じ値になるはずです
+	template<class _Dty>
+	bool checkThreaded(uint32_t m, uint32_t k, uint32_t n, uint32_t threads, std::mt19937& rng)
+	{
+		const auto a = randomMat<_Dty>(m, k, rng), b = randomMat<_Dty>(k, n, rng);
+		auto serial = CMat::matmul(a, b);
+		auto threaded = CMat::matmul(a, b, CMat::ThreadExecutor{ threads });
+		if (maxError(serial, threaded) == 0) return true;
+		std::cout << "threaded mismatch: " << m << "x" << k << " * " << k << "x" << n << ", " << threads << " threads\n";
+		return false;
+	}
+
+	void run(uint32_t m, uint32_t k, uint32_t n, uint32_t threads, std::mt19937& rng)
+	{
+		const auto a = randomMat<float>(m, k, rng), b = randomMat<float>(k, n, rng);
+		const auto ad = randomMat<double>(m, k, rng), bd = randomMat<double>(k, n, rng);
+		const double flop = 2.0 * m * n * k;
+
+		CMat::CMat<float> c0, c1, c2;
+		CMat::CMat<double> d1;
+		const double t0 = measure([&] { c0 = transposedDotMatmul(a, b); });
+		const double t1 = measure([&] { c1 = CMat::matmul(a, b); });
+		const double t2 = measure([&] { c2 = CMat::matmul(a, b, CMat::ThreadExecutor{ threads }); });
+		const double t3 = measure([&] { d1 = CMat::matmul(ad, bd); });
+
+		auto ref = referenceMatmul(a, b);
+		auto refd = referenceMatmul(ad, bd);
+		std::cout << m << "x" << k << " * " << k << "x" << n << "\n"
+			<< "  transpose + dot      " << flop / t0 * 1e-9 << " GFLOPS (max error " << maxError(c0, ref) << ")\n"
+			<< "  blocked              " << flop / t1 * 1e-9 << " GFLOPS (max error " << maxError(c1, ref) << "), x" << t0 / t1 << "\n"
+			<< "  blocked " << threads << " threads    " << flop / t2 * 1e-9 << " GFLOPS (max error " << maxError(c2, ref) << "), x" << t0 / t2 << "\n"
+			<< "  blocked double       " << flop / t3 * 1e-9 << " GFLOPS (max error " << maxError(d1, refd) << ")\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const uint32_t threads = argc > 1 ? static_cast<uint32_t>(std::stoi(argv[1])) : std::max(std::thread::hardware_concurrency(), 1u);
+
+	std::mt19937 rng(1);
+
+	// B を詰めた領域は呼び出したスレッドのものなので、他のスレッドが読めているかを確かめる
+	// (行のタイルが複数になり、B が幾つかのパネルに分かれる大きさを含める)
+	int32_t failures = 0;
+	for (uint32_t t : { 2u, 3u, 8u, threads })
+	{
+		for (const auto& [m, k, n] : { std::tuple{ 300u, 600u, 1100u }, { 1000u, 777u, 515u }, { 73u, 5u, 9u } })
+		{
+			failures += not checkThreaded<float>(m, k, n, t, rng);
+			failures += not checkThreaded<double>(m, k, n, t, rng);
+		}
+	}
+	if (failures)
+	{
+		std::cout << failures << " failures\n";
+		return 1;
+	}
+	std::cout << "threaded matmul matches serial\n";
+
+	for (uint32_t size : { 64u, 256u, 512u, 1024u })
+	{
+		run(size, size, size, threads, rng);
+	}
+	// 端が出る大きさと、学習で使う細長い形
+	run(1000, 777, 515, threads, rng);
+	run(256, 128, 64, threads, rng);
+
+	runElementwise(256, 64, rng);
+	runElementwise(1024, 1024, rng);
+	return 0;
+}
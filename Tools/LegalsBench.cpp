@@ -0,0 +1,116 @@
+﻿// 合法手生成 (calcLegals*) の一致確認と速度比較
+// ランダムな対局の途中局面とランダムな石配置を大量に作り、
+// ビルドで有効な SIMD 実装がスカラー実装とビット単位で一致するかを確かめてから時間を測ります。
+//
+// g++ -std=c++20 -O2 -march=native Tools/LegalsBench.cpp ReversiEngine.cpp Trace.cpp -o LegalsBench
+// ./LegalsBench [positions]
+
+# include <iostream>
+# include <chrono>
+# include <random>
+# include <string>
+# include "../ReversiEngine.hpp"
+
+namespace
+{
+	struct Position
+	{
+		uint64_t player, opp;
+	};
+
+	/// @brief ランダムな対局の途中局面とランダムな石配置を半分ずつ作ります
+	std::vector<Position> makePositions(size_t n, uint64_t seed)
+	{
+		std::mt19937_64 rng{ seed };
+		std::vector<Position> res;
+		res.reserve(n);
+
+		Reversi::ReversiEngine engine;
+		engine.reset();
+		while (res.size() < n / 2)
+		{
+			const uint64_t player = engine.isBlackTurn() ? engine.getBlacks() : engine.getWhites();
+			const uint64_t opp = engine.isBlackTurn() ? engine.getWhites() : engine.getBlacks();
+			res.push_back({ player, opp });
+
+			uint64_t legals = engine.getLegals();
+			if (legals == 0)
+			{
+				if (engine.getLegals(true) == 0) engine.reset();
+				else engine.pass();
+				continue;
+			}
+			for (uint64_t k = rng() % std::popcount(legals); k > 0; --k) legals &= legals - 1;
+			engine.placeUnchecked(legals & (0 - legals));
+		}
+
+		while (res.size() < n)
+		{
+			const uint64_t occupied = rng() | rng();
+			const uint64_t player = occupied & rng();
+			res.push_back({ player, occupied & ~player });
+		}
+		return res;
+	}
+
+	template<class F>
+	bool verify(const char* name, const std::vector<Position>& positions, F f)
+	{
+		size_t mismatches = 0;
+		for (const auto& p : positions)
+		{
+			if (f(p.player, p.opp) != Reversi::calcLegalsScalar(p.player, p.opp))
+			{
+				if (mismatches++ < 5)
+				{
+					std::cout << name << " mismatch: player=0x" << std::hex << p.player << " opp=0x" << p.opp << std::dec << "\n";
+				}
+			}
+		}
+		std::cout << name << ": " << positions.size() << " positions, " << mismatches << " mismatches\n";
+		return mismatches == 0;
+	}
+
+	template<class F>
+	double bench(const char* name, const std::vector<Position>& positions, F f)
+	{
+		uint64_t sink = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (const auto& p : positions)
+		{
+			sink ^= f(p.player, p.opp);
+		}
+		const auto end = std::chrono::steady_clock::now();
+		const double sec = std::chrono::duration<double>(end - start).count();
+
+		std::cout << name << ": " << sec * 1e9 / positions.size() << " ns/call, "
+			<< positions.size() / sec / 1e6 << " Mcalls/s (sink " << (sink & 1) << ")\n";
+		return sec;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const size_t n = argc > 1 ? std::stoull(argv[1]) : 4000000;
+	const auto positions = makePositions(n, 20240601);
+
+	bool ok = true;
+#ifdef REVERSI_SIMD_AVX2
+	ok &= verify("AVX2  ", positions, Reversi::calcLegalsAVX2);
+#endif
+#ifdef REVERSI_SIMD_AVX512
+	ok &= verify("AVX512", positions, Reversi::calcLegalsAVX512);
+#endif
+	if (not ok) return 1;
+
+	const double scalar = bench("scalar", positions, Reversi::calcLegalsScalar);
+#ifdef REVERSI_SIMD_AVX2
+	const double avx2 = bench("AVX2  ", positions, Reversi::calcLegalsAVX2);
+	std::cout << "  speedup x" << scalar / avx2 << "\n";
+#endif
+#ifdef REVERSI_SIMD_AVX512
+	const double avx512 = bench("AVX512", positions, Reversi::calcLegalsAVX512);
+	std::cout << "  speedup x" << scalar / avx512 << "\n";
+#endif
+	return 0;
+}
@@ -0,0 +1,464 @@
+﻿// エンジン、評価関数、手の並べ替え、置換表、CMat の小さな処理を 1 回ずつ測り、基準の結果と比べます
+// 局面は BenchPositions と、seed を固定したランダムな対局の途中局面で、毎回同じものを使います。
+// 各項目は 0.05 秒以上かかる回数を 1 組として 9 組測り、1 回あたりの時間の最小値を取ります
+// (他の処理に割り込まれた組を除くため。中央値より実行ごとのぶれが小さい)。
+// 結果は Google Benchmark に似た JSON に書けます (--out)。--baseline で基準の JSON と比べ、
+// threshold % (既定 5) より遅くなった項目が一つでもあれば 1 を返します (遅かった項目は 2 回まで測り直します)。
+// 基準はマシンごとに違うので、計測するマシンで --out した結果を Tools/MicroBench.baseline.json に置いてください。
+//
+// cmake --build build --target MicroBench
+// ./MicroBench [--out result.json] [--baseline Tools/MicroBench.baseline.json] [--threshold 5] [--filter name]
+
+# include <iostream>
+# include <algorithm>
+# include <chrono>
+# include <fstream>
+# include <functional>
+# include <map>
+# include <random>
+# include <sstream>
+# include <string>
+# include <thread>
+# include <vector>
+# include "BenchPositions.hpp"
+# include "../ReversiAgents/AlphaBetaAgent.hpp"
+# include "../ReversiAgents/YBWCAgent.hpp"
+# include "../ReversiEval/NNBatch.hpp"
+# include "../ReversiEval/SquareEval.hpp"
+# include "../lib/CMat/CMat.hpp"
+
+/// @brief エージェントの非公開の getSortedLegals を呼びます
+struct MicroBenchAccess
+{
+	template<class Agent>
+	static uint64_t sortLegals(Agent& agent, const std::vector<Reversi::ReversiEngine>& positions, const std::vector<Reversi::Eval::PatternState>& patterns)
+	{
+		typename Agent::Worker worker;
+		typename Agent::LegalList list;
+		uint64_t sink = 0;
+		for (size_t i = 0; i < positions.size(); ++i)
+		{
+			worker.engine = positions[i];
+			worker.patterns = patterns[i];
+			const int32_t n = agent.getSortedLegals(worker, list, 0);
+			sink += n + list[0].move.bit;
+		}
+		return sink;
+	}
+};
+
+namespace
+{
+	using Reversi::ReversiEngine;
+
+	volatile uint64_t Sink = 0;
+
+	/// @brief 1 組ぶん実行して実行した回数を返す関数 (sink は結果を最適化で消させないためのもの)
+	using BenchFunction = std::function<int64_t(uint64_t& sink)>;
+
+	struct Benchmark
+	{
+		std::string name;
+		BenchFunction run;
+	};
+
+	struct Result
+	{
+		std::string name;
+		int64_t iterations;
+		double nsPerOp;
+	};
+
+	/// @brief 測る局面と、局面ごとの前計算
+	struct Corpus
+	{
+		std::vector<ReversiEngine> positions;
+		std::vector<uint64_t> firstMove; // 最初の合法手
+		std::vector<Reversi::Eval::PatternState> patterns;
+		std::vector<Reversi::Eval::NNState> nnStates;
+		std::vector<uint64_t> missKeys; // 置換表に無いキー
+	};
+
+	/// @brief BenchPositions と、seed を固定したランダムな対局の途中局面 (合法手のある局面だけ)
+	std::vector<ReversiEngine> makePositions(size_t count)
+	{
+		std::vector<ReversiEngine> res;
+		ReversiEngine engine;
+		for (const char* board : BenchPositions::Midgame)
+		{
+			if (Reversi::parseBoard(board, engine)) res.push_back(engine);
+		}
+		for (const char* board : BenchPositions::Endgame)
+		{
+			if (Reversi::parseBoard(board, engine)) res.push_back(engine);
+		}
+
+		std::mt19937_64 rng(20240601);
+		engine.reset();
+		while (res.size() < count)
+		{
+			uint64_t legals = engine.getLegals();
+			if (legals == 0)
+			{
+				if (engine.getLegals(true) == 0) engine.reset();
+				else engine.pass();
+				continue;
+			}
+			res.push_back(engine);
+			for (uint64_t n = rng() % std::popcount(legals); n > 0; --n) legals &= legals - 1;
+			engine.placeUnchecked(legals & (0 - legals));
+		}
+		return res;
+	}
+
+	Corpus makeCorpus(size_t count, const Reversi::Eval::NNEvaluator& network)
+	{
+		Corpus res;
+		res.positions = makePositions(count);
+		std::mt19937_64 rng(1);
+		for (const auto& engine : res.positions)
+		{
+			const uint64_t legals = engine.getLegals();
+			res.firstMove.push_back(legals & (0 - legals));
+			res.patterns.emplace_back().reset(engine);
+			network.reset(res.nnStates.emplace_back(), engine);
+			res.missKeys.push_back(rng());
+		}
+		return res;
+	}
+
+	Result measure(const Benchmark& bench)
+	{
+		using Clock = std::chrono::steady_clock;
+		constexpr double MinSeconds = 0.05;
+		constexpr int32_t Repetitions = 9;
+		uint64_t sink = 0;
+
+		// 1 組が MinSeconds 以上になるように通す回数を決める
+		auto start = Clock::now();
+		int64_t ops = bench.run(sink);
+		const double once = std::chrono::duration<double>(Clock::now() - start).count();
+		const int64_t passes = std::max<int64_t>(1, static_cast<int64_t>(MinSeconds / std::max(once, 1e-9)) + 1);
+
+		std::vector<double> samples;
+		for (int32_t rep = 0; rep < Repetitions; ++rep)
+		{
+			ops = 0;
+			start = Clock::now();
+			for (int64_t p = 0; p < passes; ++p) ops += bench.run(sink);
+			samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops);
+		}
+		Sink = Sink + sink;
+		return { bench.name, ops, *std::min_element(samples.begin(), samples.end()) };
+	}
+
+	std::string toJson(const std::vector<Result>& results)
+	{
+		std::ostringstream os;
+		os << "{\n  \"context\": {\n"
+			<< "    \"num_cpus\": " << std::thread::hardware_concurrency() << "\n  },\n"
+			<< "  \"benchmarks\": [\n";
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			os << "    { \"name\": \"" << results[i].name << "\", \"iterations\": " << results[i].iterations
+				<< ", \"real_time\": " << results[i].nsPerOp << ", \"time_unit\": \"ns\" }"
+				<< (i + 1 < results.size() ? ",\n" : "\n");
+		}
+		os << "  ]\n}\n";
+		return os.str();
+	}
+
+	/// @brief toJson で書いた JSON から 項目名 → 1 回あたりの時間 (ns) を読みます
+	bool readBaseline(const std::string& path, std::map<std::string, double>& baseline)
+	{
+		std::ifstream ifs(path);
+		if (not ifs) return false;
+		std::stringstream ss;
+		ss << ifs.rdbuf();
+		const std::string text = ss.str();
+
+		const std::string nameKey = "\"name\": \"", timeKey = "\"real_time\":";
+		for (size_t pos = text.find(nameKey); pos != std::string::npos; pos = text.find(nameKey, pos))
+		{
+			pos += nameKey.size();
+			const size_t nameEnd = text.find('"', pos);
+			const size_t timePos = text.find(timeKey, nameEnd);
+			if (nameEnd == std::string::npos or timePos == std::string::npos) return false;
+			baseline[text.substr(pos, nameEnd - pos)] = std::strtod(text.c_str() + timePos + timeKey.size(), nullptr);
+		}
+		return not baseline.empty();
+	}
+
+	std::vector<Benchmark> makeBenchmarks(const Corpus& corpus, std::shared_ptr<const Reversi::Eval::NNEvaluator> network)
+	{
+		namespace Eval = Reversi::Eval;
+
+		const auto& pos = corpus.positions;
+		const int64_t n = static_cast<int64_t>(pos.size());
+
+		auto alphaBeta = std::make_shared<AlphaBetaAgent>();
+		auto ybwc = std::make_shared<YBWCAgent>();
+		auto tt = std::make_shared<Reversi::TranspositionTable>(16);
+		for (const auto& engine : pos) tt->store(engine.getHash(), 0, 1, Reversi::Bound::Exact, 0);
+		auto batch = std::make_shared<Eval::NNBatchEvaluator>(Eval::NNParameters::initial(1), 64);
+
+		const auto matrix = [](uint32_t rows, uint32_t cols)
+		{
+			CMat::CMat<float> m(CMat::MatShape{ rows, cols });
+			for (size_t i = 0; i < m.size(); ++i) m.data()[i] = static_cast<float>(i % 17) * 0.25f - 2.0f;
+			return m;
+		};
+		auto mats = std::make_shared<std::vector<CMat::CMat<float>>>();
+		for (const auto& [r, c] : { std::pair{ 64u, 64u }, { 256u, 256u }, { 1u, 128u }, { 128u, 64u }, { 1024u, 768u } }) mats->push_back(matrix(r, c));
+		auto out = std::make_shared<CMat::CMat<float>>(CMat::MatShape{ 1, 64 });
+
+		std::vector<Benchmark> res;
+		const auto add = [&res](std::string name, BenchFunction f) { res.push_back({ std::move(name), std::move(f) }); };
+
+		add("engine/getLegals", [&pos, n](uint64_t& sink)
+		{
+			for (const auto& engine : pos) sink += engine.getLegals();
+			return n;
+		});
+		add("engine/place", [&pos, &corpus, n](uint64_t& sink)
+		{
+			for (int64_t i = 0; i < n; ++i)
+			{
+				ReversiEngine engine = pos[i];
+				const int32_t idx = 63 - std::countr_zero(corpus.firstMove[i]);
+				sink += engine.place(idx & 7, idx >> 3) + engine.getBlacks();
+			}
+			return n;
+		});
+		add("engine/placeUnchecked", [&pos, &corpus, n](uint64_t& sink)
+		{
+			for (int64_t i = 0; i < n; ++i)
+			{
+				ReversiEngine engine = pos[i];
+				engine.placeUnchecked(corpus.firstMove[i]);
+				sink += engine.getBlacks();
+			}
+			return n;
+		});
+		add("engine/doMove+undoMove", [&pos, &corpus, n](uint64_t& sink)
+		{
+			for (int64_t i = 0; i < n; ++i)
+			{
+				ReversiEngine engine = pos[i];
+				const auto move = engine.makeMove(corpus.firstMove[i]);
+				engine.doMove(move);
+				sink += engine.getHash();
+				engine.undoMove(move);
+			}
+			return n;
+		});
+		add("engine/getBoard", [&pos, n, board = std::vector<int32_t>(64)](uint64_t& sink) mutable
+		{
+			for (const auto& engine : pos)
+			{
+				engine.getBoard(board);
+				sink += board[19];
+			}
+			return n;
+		});
+
+		add("eval/square", [&pos, n](uint64_t& sink)
+		{
+			for (const auto& engine : pos) sink += Eval::SquareEvaluator<>::evaluate(engine);
+			return n;
+		});
+		add("eval/pattern", [&pos, &corpus, n](uint64_t& sink)
+		{
+			const auto& evaluator = Eval::defaultPatternEvaluator();
+			for (int64_t i = 0; i < n; ++i) sink += evaluator.evaluate(corpus.patterns[i], pos[i]);
+			return n;
+		});
+		add("eval/pattern/reset", [&pos, n, state = Eval::PatternState()](uint64_t& sink) mutable
+		{
+			for (const auto& engine : pos)
+			{
+				state.reset(engine);
+				sink += state.indices[0];
+			}
+			return n;
+		});
+		add("eval/pattern/update+restore", [&pos, &corpus, n](uint64_t& sink)
+		{
+			for (int64_t i = 0; i < n; ++i)
+			{
+				Eval::PatternState state = corpus.patterns[i];
+				const auto move = pos[i].makeMove(corpus.firstMove[i]);
+				state.update(move, pos[i].isBlackTurn());
+				sink += state.indices[0];
+				state.restore(move, pos[i].isBlackTurn());
+			}
+			return n;
+		});
+		add("eval/nn", [&pos, &corpus, network, n](uint64_t& sink)
+		{
+			for (int64_t i = 0; i < n; ++i) sink += network->evaluate(corpus.nnStates[i], pos[i]);
+			return n;
+		});
+		add("eval/nn/update+restore", [&pos, &corpus, network, n](uint64_t& sink)
+		{
+			for (int64_t i = 0; i < n; ++i)
+			{
+				Eval::NNState state = corpus.nnStates[i];
+				const auto move = pos[i].makeMove(corpus.firstMove[i]);
+				network->update(state, move, pos[i].isBlackTurn());
+				sink += state.acc[0];
+				network->restore(state, move, pos[i].isBlackTurn());
+			}
+			return n;
+		});
+		add("eval/nnBatch/64", [&pos, batch, n](uint64_t& sink)
+		{
+			for (int64_t i = 0; i < n; i += 64)
+			{
+				batch->clear();
+				for (int64_t j = i; j < std::min(i + 64, n); ++j) batch->add(pos[j]);
+				sink += static_cast<uint64_t>(batch->evaluate()[0]);
+			}
+			return n;
+		});
+
+		add("agent/alphabeta/getSortedLegals", [&pos, &corpus, alphaBeta, n](uint64_t& sink)
+		{
+			sink += MicroBenchAccess::sortLegals(*alphaBeta, pos, corpus.patterns);
+			return n;
+		});
+		add("agent/ybwc/getSortedLegals", [&pos, &corpus, ybwc, n](uint64_t& sink)
+		{
+			sink += MicroBenchAccess::sortLegals(*ybwc, pos, corpus.patterns);
+			return n;
+		});
+
+		add("tt/store", [&pos, tt, n](uint64_t&)
+		{
+			for (const auto& engine : pos) tt->store(engine.getHash(), 1, 2, Reversi::Bound::Lower, 0);
+			return n;
+		});
+		add("tt/probe/hit", [&pos, tt, n](uint64_t& sink)
+		{
+			Reversi::TTEntry entry;
+			for (const auto& engine : pos) sink += tt->probe(engine.getHash(), entry) + entry.depth;
+			return n;
+		});
+		add("tt/probe/miss", [&corpus, tt, n](uint64_t& sink)
+		{
+			Reversi::TTEntry entry;
+			for (const uint64_t key : corpus.missKeys) sink += tt->probe(key, entry);
+			return n;
+		});
+
+		add("cmat/matmul/64x64x64", [mats](uint64_t& sink)
+		{
+			sink += static_cast<uint64_t>(CMat::matmul((*mats)[0], (*mats)[0]).data()[0]);
+			return 1;
+		});
+		add("cmat/matmul/256x256x256", [mats](uint64_t& sink)
+		{
+			sink += static_cast<uint64_t>(CMat::matmul((*mats)[1], (*mats)[1]).data()[0]);
+			return 1;
+		});
+		add("cmat/matmulInto/1x128x64", [mats, out](uint64_t& sink)
+		{
+			CMat::matmulInto(*out, (*mats)[2], (*mats)[3]);
+			sink += static_cast<uint64_t>(out->data()[0]);
+			return 1;
+		});
+		add("cmat/transposed/256x256", [mats](uint64_t& sink)
+		{
+			sink += static_cast<uint64_t>((*mats)[1].transposed().data()[1]);
+			return 1;
+		});
+		add("cmat/transpose/256x256", [mats](uint64_t& sink)
+		{
+			(*mats)[1].transpose();
+			sink += static_cast<uint64_t>((*mats)[1].data()[1]);
+			return 1;
+		});
+		add("cmat/transposed/1024x768", [mats](uint64_t& sink)
+		{
+			sink += static_cast<uint64_t>((*mats)[4].transposed().data()[1]);
+			return 1;
+		});
+		return res;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string outPath, baselinePath, filter;
+	double threshold = 5.0;
+	for (int32_t i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (i + 1 < argc and arg == "--out") outPath = argv[++i];
+		else if (i + 1 < argc and arg == "--baseline") baselinePath = argv[++i];
+		else if (i + 1 < argc and arg == "--threshold") threshold = std::stod(argv[++i]);
+		else if (i + 1 < argc and arg == "--filter") filter = argv[++i];
+		else
+		{
+			std::cout << "usage: MicroBench [--out result.json] [--baseline baseline.json] [--threshold percent] [--filter name]\n";
+			return 1;
+		}
+	}
+
+	std::map<std::string, double> baseline;
+	if (not baselinePath.empty() and not readBaseline(baselinePath, baseline))
+	{
+		std::cout << "cannot read baseline " << baselinePath << "\n";
+		return 1;
+	}
+
+	const auto network = std::make_shared<const Reversi::Eval::NNEvaluator>(Reversi::Eval::NNParameters::initial(1));
+	const Corpus corpus = makeCorpus(4096, *network);
+	const std::vector<Benchmark> benchmarks = makeBenchmarks(corpus, network);
+	std::cout << corpus.positions.size() << " positions\n\n";
+
+	std::vector<Result> results;
+	int32_t regressions = 0;
+	for (const auto& bench : benchmarks)
+	{
+		if (not filter.empty() and bench.name.find(filter) == std::string::npos) continue;
+		Result r = measure(bench);
+		const auto it = baseline.find(r.name);
+		// 基準より遅ければ、たまたま遅い時に当たっただけでないか 2 回まで測り直す
+		for (int32_t retry = 0; retry < 2 and it != baseline.end() and r.nsPerOp > it->second * (1 + threshold / 100); ++retry)
+		{
+			const Result again = measure(bench);
+			if (again.nsPerOp < r.nsPerOp) r = again;
+		}
+		results.push_back(r);
+
+		std::cout << r.name << std::string(std::max<size_t>(36 - r.name.size(), 1), ' ') << r.nsPerOp << " ns";
+		if (it != baseline.end())
+		{
+			const double change = (r.nsPerOp / it->second - 1) * 100;
+			std::cout << "  (baseline " << it->second << " ns, " << (change >= 0 ? "+" : "") << change << "%)";
+			if (change > threshold)
+			{
+				std::cout << "  REGRESSION";
+				regressions++;
+			}
+		}
+		else if (not baseline.empty())
+		{
+			std::cout << "  (not in baseline)";
+		}
+		std::cout << "\n";
+	}
+
+	if (not outPath.empty())
+	{
+		std::ofstream(outPath) << toJson(results);
+		std::cout << "\nwrote " << outPath << "\n";
+	}
+	if (regressions)
+	{
+		std::cout << "\n" << regressions << " benchmarks are more than " << threshold << "% slower than the baseline\n";
+		return 1;
+	}
+	return 0;
+}
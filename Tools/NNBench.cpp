@@ -0,0 +1,197 @@
+﻿// ニューラルネットの評価関数 (Reversi::Eval::NNEvaluator) の速さをパターンの評価関数と比べます
+// 1. 差分更新: 乱択の対局の各局面で全ての合法手を 打つ→評価→戻す (探索の葉と手の並べ替えと同じ使い方)
+// 2. 一から計算: 局面ごとに状態を作り直して評価
+// 3. NNBatchEvaluator でバッチの大きさ 1〜256 ごとにまとめて評価したときの毎秒局面数と、NNEvaluator との差
+// 4. AlphaBetaAgent の固定深さ探索 (BenchPositions::Midgame) のノード数と毎秒ノード数
+// ネットの重みは速さに関係しないので、ファイルを指定しなければ乱数の重みを使います。
+//
+// g++ -std=c++20 -O2 -march=native Tools/NNBench.cpp ReversiEngine.cpp Trace.cpp TranspositionTable.cpp EndgameSolver.cpp ReversiEval/PatternEval.cpp ReversiEval/NNEval.cpp ReversiEval/NNBatch.cpp ReversiEval/WeightFormat.cpp ReversiAgents/AlphaBetaAgent.cpp -o NNBench
+// ./NNBench [network.bin] [depth]    既定は乱数の重み、深さ 8
+
+# include <iostream>
+# include <chrono>
+# include <random>
+# include <string>
+# include <vector>
+# include "../ReversiAgents/AlphaBetaAgent.hpp"
+# include "../ReversiEval/NNBatch.hpp"
+# include "../ReversiEval/NNEval.hpp"
+# include "../ReversiEval/PatternEval.hpp"
+# include "BenchPositions.hpp"
+
+namespace
+{
+	using Reversi::ReversiEngine;
+
+	/// @brief 乱択の対局の途中局面を集めます
+	std::vector<ReversiEngine> randomPositions(int32_t games, uint64_t seed)
+	{
+		std::mt19937_64 rng(seed);
+		std::vector<ReversiEngine> res;
+		for (int32_t g = 0; g < games; ++g)
+		{
+			ReversiEngine engine;
+			engine.reset();
+			while (true)
+			{
+				uint64_t legals = engine.getLegals();
+				if (legals == 0)
+				{
+					if (engine.getLegals(true) == 0) break;
+					engine.pass();
+					continue;
+				}
+				res.push_back(engine);
+				for (int32_t n = static_cast<int32_t>(rng() % std::popcount(legals)); n > 0; --n) legals &= legals - 1;
+				engine.placeUnchecked(legals & (0 - legals));
+			}
+		}
+		return res;
+	}
+
+	template <class Evaluator, class State>
+	void benchEval(const char* name, const Evaluator& evaluator, const std::vector<ReversiEngine>& positions,
+		void (*reset)(const Evaluator&, State&, const ReversiEngine&),
+		void (*update)(const Evaluator&, State&, const ReversiEngine::Move&, bool),
+		void (*restore)(const Evaluator&, State&, const ReversiEngine::Move&, bool))
+	{
+		// 差分更新
+		int64_t evals = 0, checksum = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int32_t rep = 0; rep < 10; ++rep)
+		{
+			for (ReversiEngine engine : positions)
+			{
+				State state;
+				reset(evaluator, state, engine);
+				const bool black = engine.isBlackTurn();
+				for (uint64_t legals = engine.getLegals(); legals; legals &= legals - 1)
+				{
+					const auto move = engine.makeMove(legals & (0 - legals));
+					engine.doMove(move);
+					update(evaluator, state, move, black);
+					checksum += evaluator.evaluate(state, engine);
+					engine.undoMove(move);
+					restore(evaluator, state, move, black);
+					evals++;
+				}
+			}
+		}
+		double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << name << " incremental: " << evals << " evals, " << sec * 1000 << " ms, "
+			<< static_cast<int64_t>(evals / std::max(sec, 1e-9)) << " evals/s (checksum " << checksum << ")\n";
+
+		// 一から計算
+		evals = 0;
+		checksum = 0;
+		start = std::chrono::steady_clock::now();
+		for (int32_t rep = 0; rep < 10; ++rep)
+		{
+			for (const ReversiEngine& engine : positions)
+			{
+				State state;
+				reset(evaluator, state, engine);
+				checksum += evaluator.evaluate(state, engine);
+				evals++;
+			}
+		}
+		sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << name << " from scratch: " << evals << " evals, " << sec * 1000 << " ms, "
+			<< static_cast<int64_t>(evals / std::max(sec, 1e-9)) << " evals/s (checksum " << checksum << ")\n";
+	}
+
+	void benchBatch(const Reversi::Eval::NNParameters& params, const std::vector<ReversiEngine>& positions)
+	{
+		const Reversi::Eval::NNEvaluator network(params);
+		Reversi::Eval::NNBatchEvaluator batch(params);
+
+		for (uint32_t size = 1; size <= batch.capacity(); size *= 2)
+		{
+			int64_t evals = 0;
+			double checksum = 0, diff = 0;
+			const auto start = std::chrono::steady_clock::now();
+			for (size_t first = 0; first + size <= positions.size(); first += size)
+			{
+				batch.clear();
+				for (uint32_t i = 0; i < size; ++i) batch.add(positions[first + i]);
+				for (const float score : batch.evaluate()) checksum += score;
+				evals += size;
+			}
+			const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			// 量子化した評価関数との差 (最後のバッチだけ)
+			const auto scores = batch.evaluate();
+			for (uint32_t i = 0; i < size; ++i)
+			{
+				const ReversiEngine& engine = positions[positions.size() / size * size - size + i];
+				Reversi::Eval::NNState state;
+				network.reset(state, engine);
+				const double raw = network.evaluateRaw(state) / static_cast<double>(Reversi::Eval::DiscScale);
+				diff += std::abs((engine.isBlackTurn() ? raw : -raw) - scores[i]);
+			}
+
+			std::cout << "batch " << size << ": " << evals << " evals, " << sec * 1000 << " ms, "
+				<< static_cast<int64_t>(evals / std::max(sec, 1e-9)) << " evals/s, mean |float - quantized| "
+				<< diff / size << " discs (checksum " << static_cast<int64_t>(checksum) << ")\n";
+		}
+	}
+
+	void benchSearch(const char* name, AlphaBetaAgent& agent)
+	{
+		int64_t totalNodes = 0;
+		double totalSec = 0;
+		for (const char* board : BenchPositions::Midgame)
+		{
+			ReversiEngine engine;
+			Reversi::parseBoard(board, engine);
+			agent.clearHash();
+			agent.reset();
+
+			const auto start = std::chrono::steady_clock::now();
+			agent.play(engine);
+			totalSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			totalNodes += agent.getNodeCount();
+		}
+		std::cout << name << " search: " << totalNodes << " nodes, " << totalSec * 1000 << " ms, "
+			<< static_cast<int64_t>(totalNodes / std::max(totalSec, 1e-9)) << " nodes/s\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Reversi::Eval::NNParameters params = Reversi::Eval::NNParameters::initial(1);
+	if (argc > 1 and not Reversi::Eval::loadNetworkFile(argv[1], params))
+	{
+		std::cout << "cannot load " << argv[1] << "\n";
+		return 1;
+	}
+	const int32_t depth = argc > 2 ? std::stoi(argv[2]) : 8;
+
+	const auto positions = randomPositions(2000, 1);
+	std::cout << positions.size() << " positions\n";
+
+	using Reversi::Eval::PatternEvaluator;
+	using Reversi::Eval::PatternState;
+	benchEval<PatternEvaluator, PatternState>("pattern", Reversi::Eval::defaultPatternEvaluator(), positions,
+		[](const PatternEvaluator&, PatternState& s, const ReversiEngine& e) { s.reset(e); },
+		[](const PatternEvaluator&, PatternState& s, const ReversiEngine::Move& m, bool b) { s.update(m, b); },
+		[](const PatternEvaluator&, PatternState& s, const ReversiEngine::Move& m, bool b) { s.restore(m, b); });
+
+	using Reversi::Eval::NNEvaluator;
+	using Reversi::Eval::NNState;
+	const NNEvaluator network(params);
+	benchEval<NNEvaluator, NNState>("network", network, positions,
+		[](const NNEvaluator& n, NNState& s, const ReversiEngine& e) { n.reset(s, e); },
+		[](const NNEvaluator& n, NNState& s, const ReversiEngine::Move& m, bool b) { n.update(s, m, b); },
+		[](const NNEvaluator& n, NNState& s, const ReversiEngine::Move& m, bool b) { n.restore(s, m, b); });
+
+	benchBatch(params, positions);
+
+	AlphaBetaAgent agent;
+	agent.setSearchDepth(depth);
+	agent.setEndgameEmpties(0);
+	benchSearch("pattern", agent);
+	agent.setNetwork(&network);
+	benchSearch("network", agent);
+	return 0;
+}
@@ -0,0 +1,136 @@
+﻿// perft: 指定した深さまでの葉の数を数えて、合法手生成と着手処理の正しさと速さを確かめます
+// パスは 1 手として数え、途中で終局した局面はその時点で葉として数えます。
+//
+// g++ -std=c++20 -O2 -march=native Tools/Perft.cpp ReversiEngine.cpp Trace.cpp -o Perft
+// ./Perft                      基準値つきの局面集を実行 (既定で深さ 11 まで)
+// ./Perft <maxDepth>           局面集を深さ maxDepth までに制限して実行
+// ./Perft <depth> "<board>"    任意の局面を 1 つ数える (盤面文字列は Reversi::parseBoard の書式)
+
+# include <iostream>
+# include <chrono>
+# include <string>
+# include "../ReversiEngine.hpp"
+
+namespace
+{
+	using Reversi::ReversiEngine;
+
+	struct PerftCase
+	{
+		const char* name;
+		const char* board;
+		int32_t depth;
+		uint64_t nodes;
+	};
+
+	const PerftCase PerftSuite[] = {
+		{ "start", "---------------------------OX------XO--------------------------- X", 1, 4 },
+		{ "start", "---------------------------OX------XO--------------------------- X", 2, 12 },
+		{ "start", "---------------------------OX------XO--------------------------- X", 3, 56 },
+		{ "start", "---------------------------OX------XO--------------------------- X", 4, 244 },
+		{ "start", "---------------------------OX------XO--------------------------- X", 5, 1396 },
+		{ "start", "---------------------------OX------XO--------------------------- X", 6, 8200 },
+		{ "start", "---------------------------OX------XO--------------------------- X", 7, 55092 },
+		{ "start", "---------------------------OX------XO--------------------------- X", 8, 390216 },
+		{ "start", "---------------------------OX------XO--------------------------- X", 9, 3005288 },
+		{ "start", "---------------------------OX------XO--------------------------- X", 10, 24571284 },
+		{ "start", "---------------------------OX------XO--------------------------- X", 11, 212258800 },
+		{ "start", "---------------------------OX------XO--------------------------- X", 12, 1939886636 },
+		{ "opening", "----O-----OOO-X--XOXXX----OXOX----XOXXX--XXXX-----X------------- X", 6, 2394736 },
+		{ "root pass", "-------------------X-------XX------XXX-------X-O-----OO------O-X X", 6, 1384 },
+		{ "root pass", "-XXX------X-------OOO-----OOO---OOOOO--------------------------- O", 6, 5178 },
+		{ "midgame", "O-O-XO-X-OOXOOOXO-XOXOOOOXOOXX--OOOXOOX-OOXXXOXXO-OX--OX-XXXX--O X", 8, 6236517 },
+		{ "midgame passes", "OOOOOO--XOXX-OO--XOOOO--XOOOXO--XOOOOOO-OOXOOOO-OOOOXOO-XXXXXO-- X", 8, 2227387 },
+		{ "endgame", "OO-OOO-XOOOOOOOXOOOOXXXXOOXOOXXXOXOOXOX---XOXXOO-OXOOOOOO--OX--X X", 12, 184754 },
+		{ "endgame", "XXXXXOOXXXXXOOOXXXXOOXOXOXOXXOOX-OXXOOOO--XOOOOO-X-OOOOX--O---OX X", 12, 137085 },
+		{ "game over", "OOOOOOOOXOOXOXOOXOXOOOXOXXXOOXOXXXXXOXOOOOXOXXOOOOOXXXOOXXXXXXXO X", 3, 1 },
+	};
+
+	uint64_t perft(const ReversiEngine& engine, int32_t depth, bool passed)
+	{
+		uint64_t legals = engine.getLegals();
+
+		if (legals == 0)
+		{
+			if (passed) return 1; // 終局
+			ReversiEngine child = engine;
+			child.pass();
+			return depth == 1 ? 1 : perft(child, depth - 1, true);
+		}
+
+		if (depth == 1) return std::popcount(legals);
+
+		uint64_t nodes = 0;
+		while (legals)
+		{
+			const uint64_t bit = legals & (0 - legals);
+			legals ^= bit;
+			ReversiEngine child = engine;
+			child.placeUnchecked(bit);
+			nodes += perft(child, depth - 1, false);
+		}
+		return nodes;
+	}
+
+	/// @brief 1 局面を数えて結果を表示します
+	/// @return 数えた葉の数
+	uint64_t run(const char* name, const ReversiEngine& engine, int32_t depth, double& sec)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const uint64_t nodes = depth == 0 ? 1 : perft(engine, depth, false);
+		const auto end = std::chrono::steady_clock::now();
+		sec = std::chrono::duration<double>(end - start).count();
+
+		std::cout << name << " depth " << depth << ": " << nodes << " nodes, " << sec * 1000 << " ms, "
+			<< static_cast<uint64_t>(nodes / std::max(sec, 1e-9)) << " nodes/s";
+		return nodes;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	ReversiEngine engine;
+	double sec;
+
+	if (argc > 2)
+	{
+		if (not Reversi::parseBoard(argv[2], engine))
+		{
+			std::cout << "invalid board: " << argv[2] << "\n";
+			return 1;
+		}
+		run("position", engine, std::stoi(argv[1]), sec);
+		std::cout << "\n";
+		return 0;
+	}
+
+	const int32_t maxDepth = argc > 1 ? std::stoi(argv[1]) : 11;
+	uint64_t totalNodes = 0;
+	double totalSec = 0;
+	int32_t failures = 0;
+
+	for (const auto& c : PerftSuite)
+	{
+		if (c.depth > maxDepth) continue;
+		Reversi::parseBoard(c.board, engine);
+
+		const uint64_t nodes = run(c.name, engine, c.depth, sec);
+		totalNodes += nodes;
+		totalSec += sec;
+
+		if (nodes == c.nodes)
+		{
+			std::cout << "  OK\n";
+		}
+		else
+		{
+			std::cout << "  NG (expected " << c.nodes << ")\n";
+			failures++;
+		}
+	}
+
+	std::cout << "total: " << totalNodes << " nodes, " << totalSec * 1000 << " ms, "
+		<< static_cast<uint64_t>(totalNodes / std::max(totalSec, 1e-9)) << " nodes/s, "
+		<< failures << " failures\n";
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+﻿// ReversiEngine::place の速度比較
+// 旧実装 (getLegals による検査 + 方向ごとの transfer ループ) と
+// 新実装 (place / placeUnchecked) で同じ perft 探索を行い、葉の数と時間を比べます。
+//
+// g++ -std=c++20 -O2 -march=native Tools/PlaceBench.cpp ReversiEngine.cpp Trace.cpp -o PlaceBench
+// ./PlaceBench [depth]
+
+# include <iostream>
+# include <chrono>
+# include <string>
+# include "../ReversiEngine.hpp"
+
+namespace
+{
+	using Reversi::ReversiEngine;
+
+	uint64_t legacyTransfer(uint64_t put, uint32_t dir)
+	{
+		switch (dir) {
+		case 0: return (put << 8) & 0xffffffffffffff00;
+		case 1: return (put << 7) & 0x7f7f7f7f7f7f7f00;
+		case 2: return (put >> 1) & 0x7f7f7f7f7f7f7f7f;
+		case 3: return (put >> 9) & 0x007f7f7f7f7f7f7f;
+		case 4: return (put >> 8) & 0x00ffffffffffffff;
+		case 5: return (put >> 7) & 0x00fefefefefefefe;
+		case 6: return (put << 1) & 0xfefefefefefefefe;
+		case 7: return (put << 9) & 0xfefefefefefefe00;
+		default: return 0;
+		}
+	}
+
+	/// @brief 変更前の ReversiEngine::place と同じ処理
+	bool legacyPlace(ReversiEngine& engine, uint64_t b)
+	{
+		uint64_t blacks = engine.getBlacks(), whites = engine.getWhites();
+		uint64_t& playerBoard = engine.isBlackTurn() ? blacks : whites;
+		uint64_t& oppBoard = engine.isBlackTurn() ? whites : blacks;
+		if ((engine.getLegals() & b) == 0) return false;
+		uint64_t rev = 0;
+		for (uint32_t dir = 0; dir < 8; ++dir)
+		{
+			uint64_t rev_ = 0;
+			uint64_t mask = legacyTransfer(b, dir);
+			while (mask != 0 && ((mask & oppBoard) != 0))
+			{
+				rev_ |= mask;
+				mask = legacyTransfer(mask, dir);
+			}
+			if ((mask & playerBoard) != 0)
+			{
+				rev |= rev_;
+			}
+		}
+		playerBoard ^= b | rev;
+		oppBoard ^= rev;
+		engine.setState(blacks, whites, not engine.isBlackTurn());
+		return true;
+	}
+
+	struct LegacyPlacer
+	{
+		void operator()(ReversiEngine& engine, uint64_t bit) const { legacyPlace(engine, bit); }
+	};
+
+	struct CheckedPlacer
+	{
+		void operator()(ReversiEngine& engine, uint64_t bit) const
+		{
+			const uint32_t idx = 63 - std::countr_zero(bit);
+			engine.place(idx & 7, idx >> 3);
+		}
+	};
+
+	struct UncheckedPlacer
+	{
+		void operator()(ReversiEngine& engine, uint64_t bit) const { engine.placeUnchecked(bit); }
+	};
+
+	/// @brief 葉の局面から作るチェックサム (裏返し結果の一致確認用)
+	uint64_t leafChecksum = 0;
+
+	template<class Placer>
+	uint64_t perft(const ReversiEngine& engine, int32_t depth, bool passed)
+	{
+		if (depth == 0)
+		{
+			leafChecksum += engine.getBlacks() * 0x9e3779b97f4a7c15 ^ engine.getWhites();
+			return 1;
+		}
+
+		uint64_t legals = engine.getLegals();
+		if (legals == 0)
+		{
+			if (passed) // 終局
+			{
+				leafChecksum += engine.getBlacks() * 0x9e3779b97f4a7c15 ^ engine.getWhites();
+				return 1;
+			}
+			ReversiEngine child = engine;
+			child.pass();
+			return perft<Placer>(child, depth - 1, true);
+		}
+
+		uint64_t nodes = 0;
+		while (legals)
+		{
+			const uint64_t bit = legals & (0 - legals);
+			legals ^= bit;
+			ReversiEngine child = engine;
+			Placer{}(child, bit);
+			nodes += perft<Placer>(child, depth - 1, false);
+		}
+		return nodes;
+	}
+
+	template<class Placer>
+	double run(const char* name, int32_t depth, uint64_t& nodes, uint64_t& checksum)
+	{
+		leafChecksum = 0;
+		ReversiEngine engine;
+		engine.reset();
+
+		const auto start = std::chrono::steady_clock::now();
+		nodes = perft<Placer>(engine, depth, false);
+		const auto end = std::chrono::steady_clock::now();
+		const double sec = std::chrono::duration<double>(end - start).count();
+		checksum = leafChecksum;
+
+		std::cout << name << ": " << nodes << " nodes, " << sec * 1000 << " ms, "
+			<< static_cast<uint64_t>(nodes / sec) << " nodes/s\n";
+		return sec;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const int32_t depth = argc > 1 ? std::stoi(argv[1]) : 9;
+
+	uint64_t legacyNodes, checkedNodes, uncheckedNodes;
+	uint64_t legacySum, checkedSum, uncheckedSum;
+	const double legacy = run<LegacyPlacer>("legacy place   ", depth, legacyNodes, legacySum);
+	const double checked = run<CheckedPlacer>("place          ", depth, checkedNodes, checkedSum);
+	const double unchecked = run<UncheckedPlacer>("placeUnchecked ", depth, uncheckedNodes, uncheckedSum);
+
+	if (legacyNodes != checkedNodes or legacyNodes != uncheckedNodes
+		or legacySum != checkedSum or legacySum != uncheckedSum)
+	{
+		std::cout << "result mismatch\n";
+		return 1;
+	}
+
+	std::cout << "speedup: place x" << legacy / checked << ", placeUnchecked x" << legacy / unchecked << "\n";
+	return 0;
+}
@@ -0,0 +1,75 @@
+﻿// AlphaBetaAgent の固定深さ探索のノード数と時間を測ります
+// 局面ごとに置換表を消してから探索するので、ノード数は実行ごとに変わりません。
+// 最後にパスの局面 (BenchPositions::Pass) で、探索せずに着手無しを返すことを確かめます。
+// REVERSI_TRACE を定義してビルドし trace.json を指定すると、探索の区間を Chrome trace に書き出します
+// (スレッドごとに新しい方から Trace::ThreadBuffer::Capacity 個の区間)。
+//
+// g++ -std=c++20 -O2 -march=native Tools/SearchBench.cpp ReversiEngine.cpp Trace.cpp TranspositionTable.cpp EndgameSolver.cpp ReversiEval/PatternEval.cpp ReversiEval/NNEval.cpp ReversiEval/WeightFormat.cpp ReversiAgents/AlphaBetaAgent.cpp -o SearchBench
+// ./SearchBench [depth] [trace.json]
+
+# include <iostream>
+# include <chrono>
+# include <string>
+# include "../ReversiAgents/AlphaBetaAgent.hpp"
+# include "../Trace.hpp"
+# include "BenchPositions.hpp"
+
+int main(int argc, char* argv[])
+{
+	const int32_t depth = argc > 1 ? std::stoi(argv[1]) : 8;
+
+	AlphaBetaAgent agent;
+	agent.setSearchDepth(depth);
+
+	int64_t totalNodes = 0;
+	double totalSec = 0;
+
+	for (const char* board : BenchPositions::Midgame)
+	{
+		Reversi::ReversiEngine engine;
+		Reversi::parseBoard(board, engine);
+		agent.clearHash();
+		agent.reset();
+
+		const auto start = std::chrono::steady_clock::now();
+		const auto [x, y] = agent.play(engine);
+		const auto end = std::chrono::steady_clock::now();
+		const double sec = std::chrono::duration<double>(end - start).count();
+
+		totalNodes += agent.getNodeCount();
+		totalSec += sec;
+		std::cout << board << "  move " << char('a' + x) << y + 1 << ", " << agent.getNodeCount() << " nodes, "
+			<< sec * 1000 << " ms\n";
+	}
+
+	std::cout << "depth " << depth << " total: " << totalNodes << " nodes, " << totalSec * 1000 << " ms, "
+		<< static_cast<int64_t>(totalNodes / std::max(totalSec, 1e-9)) << " nodes/s\n";
+
+	// 打てる手の無い局面では探索せずに着手無しを返すこと (合計には含めない)
+	for (const char* board : BenchPositions::Pass)
+	{
+		Reversi::ReversiEngine engine;
+		Reversi::parseBoard(board, engine);
+		agent.clearHash();
+		agent.reset();
+
+		const auto [x, y] = agent.play(engine);
+		if (y >= 0)
+		{
+			std::cout << board << "  returned a move on a pass position\n";
+			return 1;
+		}
+		std::cout << board << "  pass\n";
+	}
+
+	if (argc > 2)
+	{
+		if (not Reversi::Trace::Enabled) std::cout << "built without REVERSI_TRACE; the trace will be empty\n";
+		if (not Reversi::Trace::dumpChromeTrace(argv[2]))
+		{
+			std::cout << "cannot write " << argv[2] << "\n";
+			return 1;
+		}
+	}
+	return 0;
+}
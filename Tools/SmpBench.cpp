@@ -0,0 +1,56 @@
+﻿// AlphaBetaAgent の Lazy SMP のスレッド数ごとの伸びを測ります
+// スレッド数ごとに、局面集を固定の深さまで読み終える時間 (time-to-depth) と毎秒ノード数を表示します。
+// 局面ごとに置換表を消すので、1 スレッドのノード数は実行ごとに変わりません。
+//
+// g++ -std=c++20 -O2 -march=native -pthread Tools/SmpBench.cpp ReversiEngine.cpp Trace.cpp TranspositionTable.cpp EndgameSolver.cpp ReversiEval/PatternEval.cpp ReversiEval/NNEval.cpp ReversiEval/WeightFormat.cpp ReversiAgents/AlphaBetaAgent.cpp -o SmpBench
+// ./SmpBench [depth] [maxThreads]    既定は深さ 10、スレッド数は 1, 2, 4, 8, 16 (maxThreads まで)
+
+# include <iostream>
+# include <chrono>
+# include <string>
+# include <thread>
+# include "../ReversiAgents/AlphaBetaAgent.hpp"
+# include "BenchPositions.hpp"
+
+int main(int argc, char* argv[])
+{
+	const int32_t depth = argc > 1 ? std::stoi(argv[1]) : 10;
+	const int32_t maxThreads = argc > 2 ? std::stoi(argv[2]) : 16;
+
+	std::cout << "depth " << depth << ", hardware threads " << std::thread::hardware_concurrency() << "\n";
+
+	AlphaBetaAgent agent(64);
+	agent.setSearchDepth(depth);
+
+	double baseSec = 0;
+	for (int32_t threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		agent.setThreadCount(threads);
+
+		int64_t totalNodes = 0;
+		double totalSec = 0;
+		std::string moves;
+
+		for (const char* board : BenchPositions::Midgame)
+		{
+			Reversi::ReversiEngine engine;
+			Reversi::parseBoard(board, engine);
+			agent.clearHash();
+			agent.reset();
+
+			const auto start = std::chrono::steady_clock::now();
+			const auto [x, y] = agent.play(engine);
+			const auto end = std::chrono::steady_clock::now();
+
+			totalSec += std::chrono::duration<double>(end - start).count();
+			totalNodes += agent.getNodeCount();
+			moves += { char('a' + x), char('1' + y), ' ' };
+		}
+
+		if (threads == 1) baseSec = totalSec;
+		std::cout << threads << " threads: " << totalSec * 1000 << " ms, " << totalNodes << " nodes, "
+			<< static_cast<int64_t>(totalNodes / std::max(totalSec, 1e-9)) << " nodes/s, speedup x"
+			<< baseSec / std::max(totalSec, 1e-9) << ", moves " << moves << "\n";
+	}
+	return 0;
+}
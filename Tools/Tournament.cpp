@@ -0,0 +1,375 @@
+﻿// 2 つのエージェントを画面なしで対局させ、強さの差を測ります
+// 開始局面は初期局面からランダムに plies 手進めたもので、同じ開始局面を先後を入れ替えて 2 局ずつ打ちます。
+// 対局は全てのスレッドに分けて並列に打ち、A から見た勝ち/分け/負け、Elo の差と 95% の誤差、毎秒の対局数を表示します。
+// 開始局面は対局の番号と seed だけで決まるので、スレッド数を変えても同じ組の対局になります
+// (持ち時間 ms を指定したときは探索の深さが実行ごとに変わるので、結果は変わります)。
+//
+// g++ -std=c++20 -O2 -march=native -pthread Tools/Tournament.cpp ReversiEngine.cpp Trace.cpp TranspositionTable.cpp WorkStealingPool.cpp EndgameSolver.cpp ReversiEval/PatternEval.cpp ReversiEval/NNEval.cpp ReversiEval/WeightFormat.cpp ReversiEval/WeightFile.cpp ReversiAgents/AlphaBetaAgent.cpp ReversiAgents/YBWCAgent.cpp ReversiAgents/GreedyAgent.cpp ReversiAgents/MinMaxAgent.cpp -o Tournament
+// ./Tournament <agentA> <agentB> [games] [threads] [seed] [plies] [stats.jsonl]    既定は 100 局、全てのスレッド、seed 1、8 手
+// stats.jsonl を指定すると、エージェントが打った手ごとに探索の統計 (SearchStats) を 1 行の JSON で書きます。
+//
+// エージェントは "名前[:キー=値,...]" で指定します。
+//   random, greedy, minmax
+//   alphabeta, ybwc
+//     depth=<n>     最大の深さ (既定 7)
+//     ms=<n>        1 手の持ち時間 (ms)
+//     hash=<n>      置換表の大きさ (MB、既定 16)
+//     threads=<n>   1 局の探索に使うスレッド数 (既定 1)
+//     eval=<file>   Tuner で学習したパターンの重みファイル
+//     endgame=<n>   完全読みを始める空きマス数 (alphabeta のみ、既定 16)
+//     nn=<file>     Tuner trainnn で学習したネットワークで評価する (alphabeta のみ)
+//     aspiration=<n> 反復深化の窓の片側の幅 (石差、0 なら全幅、既定 2)
+// 例: ./Tournament alphabeta:depth=6 alphabeta:depth=6,nn=network.bin 1000
+
+# include <iostream>
+# include <atomic>
+# include <chrono>
+# include <cmath>
+# include <fstream>
+# include <functional>
+# include <map>
+# include <memory>
+# include <mutex>
+# include <random>
+# include <sstream>
+# include <string>
+# include <thread>
+# include <vector>
+# include "../ReversiAgents/AlphaBetaAgent.hpp"
+# include "../ReversiAgents/GreedyAgent.hpp"
+# include "../ReversiAgents/MinMaxAgent.hpp"
+# include "../ReversiAgents/RandomAgent.hpp"
+# include "../ReversiAgents/YBWCAgent.hpp"
+# include "../ReversiEval/WeightFile.hpp"
+
+namespace
+{
+	using Reversi::ReversiEngine;
+
+	/// @brief コマンドラインで指定したエージェントの作り方
+	/// 重みファイルは一度だけ読み、全てのスレッドのエージェントで共有します。
+	struct AgentSpec
+	{
+		std::string text;
+		std::string name;
+		std::map<std::string, std::string> options;
+		std::shared_ptr<Reversi::Eval::PatternEvaluator> evaluator;
+		std::shared_ptr<Reversi::Eval::NNEvaluator> network;
+
+		int32_t intOption(const std::string& key, int32_t defaultValue) const
+		{
+			const auto it = options.find(key);
+			return it == options.end() ? defaultValue : std::stoi(it->second);
+		}
+	};
+
+	/// @brief スレッドごとに作る対局者
+	struct Player
+	{
+		std::unique_ptr<ReversiAgent> agent;
+		std::function<void()> newGame; // 対局の前に置換表などを消す
+	};
+
+	bool parseSpec(const std::string& text, AgentSpec& spec)
+	{
+		spec.text = text;
+		const size_t colon = text.find(':');
+		spec.name = text.substr(0, colon);
+
+		std::map<std::string, std::vector<std::string>> allowed = {
+			{ "random", {} }, { "greedy", {} }, { "minmax", {} },
+			{ "alphabeta", { "depth", "ms", "hash", "threads", "eval", "endgame", "nn", "aspiration" } },
+			{ "ybwc", { "depth", "ms", "hash", "threads", "eval", "aspiration" } },
+		};
+		if (not allowed.contains(spec.name))
+		{
+			std::cout << "unknown agent: " << spec.name << "\n";
+			return false;
+		}
+
+		for (size_t pos = colon; pos != std::string::npos and pos + 1 < text.size();)
+		{
+			const size_t next = text.find(',', pos + 1);
+			const std::string option = text.substr(pos + 1, next == std::string::npos ? std::string::npos : next - pos - 1);
+			const size_t eq = option.find('=');
+			const std::string key = option.substr(0, eq);
+			const auto& keys = allowed[spec.name];
+			if (eq == std::string::npos or std::find(keys.begin(), keys.end(), key) == keys.end())
+			{
+				std::cout << "unknown option for " << spec.name << ": " << option << "\n";
+				return false;
+			}
+			spec.options[key] = option.substr(eq + 1);
+			pos = next;
+		}
+
+		try
+		{
+			for (const char* key : { "depth", "ms", "hash", "threads", "endgame", "aspiration" }) spec.intOption(key, 0);
+		}
+		catch (const std::exception&)
+		{
+			std::cout << "invalid number in " << text << "\n";
+			return false;
+		}
+
+		if (spec.options.contains("eval"))
+		{
+			spec.evaluator = std::make_shared<Reversi::Eval::PatternEvaluator>();
+			if (not Reversi::Eval::loadWeightFile(spec.options["eval"], *spec.evaluator))
+			{
+				std::cout << "cannot load " << spec.options["eval"] << "\n";
+				return false;
+			}
+		}
+		if (spec.options.contains("nn"))
+		{
+			Reversi::Eval::NNParameters params;
+			if (not Reversi::Eval::loadNetworkFile(spec.options["nn"], params))
+			{
+				std::cout << "cannot load " << spec.options["nn"] << "\n";
+				return false;
+			}
+			spec.network = std::make_shared<Reversi::Eval::NNEvaluator>(params);
+		}
+		return true;
+	}
+
+	template <class Agent>
+	void configureSearch(Agent& agent, const AgentSpec& spec)
+	{
+		agent.setSearchDepth(spec.intOption("depth", 7));
+		agent.setThreadCount(spec.intOption("threads", 1));
+		agent.setAspiration(spec.intOption("aspiration", 2));
+		if (spec.evaluator) agent.setEvaluator(*spec.evaluator);
+		if (const int32_t ms = spec.intOption("ms", 0); ms > 0)
+		{
+			ReversiAgent::TimeControl tc;
+			tc.moveTimeMs = ms;
+			agent.setTimeControl(tc);
+		}
+	}
+
+	Player makePlayer(const AgentSpec& spec, uint64_t seed)
+	{
+		if (spec.name == "random") return { std::make_unique<RandomAgent>(seed), [] {} };
+		if (spec.name == "greedy") return { std::make_unique<GreedyAgent>(), [] {} };
+		if (spec.name == "minmax") return { std::make_unique<MinMaxAgent>(), [] {} };
+
+		const size_t hash = static_cast<size_t>(spec.intOption("hash", 16));
+		if (spec.name == "alphabeta")
+		{
+			auto agent = std::make_unique<AlphaBetaAgent>(hash);
+			configureSearch(*agent, spec);
+			agent->setEndgameEmpties(spec.intOption("endgame", 16));
+			if (spec.network) agent->setNetwork(spec.network.get());
+			AlphaBetaAgent* p = agent.get();
+			return { std::move(agent), [p] { p->clearHash(); } };
+		}
+
+		auto agent = std::make_unique<YBWCAgent>(hash);
+		configureSearch(*agent, spec);
+		YBWCAgent* p = agent.get();
+		return { std::move(agent), [p] { p->clearHash(); } };
+	}
+
+	/// @brief 初期局面からランダムに plies 手進めた局面 (途中で終局しそうなら打てる所まで)
+	ReversiEngine randomOpening(int32_t plies, uint64_t seed)
+	{
+		std::mt19937_64 rng(seed);
+		ReversiEngine engine;
+		engine.reset();
+		for (int32_t i = 0; i < plies; ++i)
+		{
+			uint64_t legals = engine.getLegals();
+			if (legals == 0) break;
+			for (uint64_t n = rng() % std::popcount(legals); n > 0; --n) legals &= legals - 1;
+			engine.placeUnchecked(legals & (0 - legals));
+		}
+		return engine;
+	}
+
+	/// @brief 1 手ぶんの探索の統計を 1 行の JSON にします
+	std::string statsJson(const SearchStats& stats)
+	{
+		std::ostringstream os;
+		os << "\"nodes\":" << stats.nodes << ",\"time_us\":" << stats.timeUs << ",\"nps\":" << static_cast<int64_t>(stats.nps())
+			<< ",\"depth\":" << stats.depth
+			<< ",\"tt_probes\":" << stats.ttProbes << ",\"tt_hit_rate\":" << stats.ttHitRate()
+			<< ",\"tt_stores\":" << stats.ttStores << ",\"tt_collision_rate\":" << stats.ttCollisionRate()
+			<< ",\"cut_nodes\":" << stats.cutNodes << ",\"first_move_cut_rate\":" << stats.firstMoveCutRate()
+			<< ",\"ebf\":" << stats.branchingFactor() << ",\"iterations\":[";
+		for (size_t i = 0; i < stats.iterations.size(); ++i)
+		{
+			const auto& it = stats.iterations[i];
+			os << (i ? "," : "") << "{\"depth\":" << it.depth << ",\"score\":" << it.score
+				<< ",\"nodes\":" << it.nodes << ",\"time_us\":" << it.timeUs << "}";
+		}
+		os << "]";
+		return os.str();
+	}
+
+	/// @brief エージェントごとの統計の合計
+	struct AgentTotals
+	{
+		int64_t moves = 0, nodes = 0, timeUs = 0, depth = 0;
+
+		void add(const SearchStats& stats)
+		{
+			moves++;
+			nodes += stats.nodes;
+			timeUs += stats.timeUs;
+			depth += stats.depth;
+		}
+	};
+
+	/// @brief 1 局打ちます
+	/// @param onMove 手を打つごとに (打った側が黒か, 手数, 打った側) で呼びます
+	/// @return 黒から見た最終石差。非合法手を返したエージェントはその時点で 64 石差の負け
+	int32_t playGame(ReversiEngine engine, ReversiAgent& black, ReversiAgent& white, bool& illegal,
+		const std::function<void(bool, int32_t, const ReversiAgent&)>& onMove)
+	{
+		black.reset();
+		white.reset();
+		for (int32_t ply = 0; not engine.isFinished();)
+		{
+			if (engine.getLegals() == 0)
+			{
+				engine.pass();
+				continue;
+			}
+
+			const bool blackTurn = engine.isBlackTurn();
+			ReversiAgent& agent = blackTurn ? black : white;
+			const auto [x, y] = agent.play(engine);
+			onMove(blackTurn, ply++, agent);
+			const uint64_t bit = (0 <= x and x < 8 and 0 <= y and y < 8) ? 1ULL << (63 - (x + 8 * y)) : 0;
+			if ((engine.getLegals() & bit) == 0)
+			{
+				illegal = true;
+				return blackTurn ? -64 : 64;
+			}
+			engine.placeUnchecked(bit);
+		}
+		return engine.getNBlacks() - engine.getNWhites();
+	}
+
+	double eloFromScore(double score)
+	{
+		score = std::clamp(score, 1e-6, 1 - 1e-6);
+		return -400.0 * std::log10(1.0 / score - 1.0);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::cout << "usage: Tournament <agentA> <agentB> [games] [threads] [seed] [plies] [stats.jsonl]\n"
+			<< "  agents: random | greedy | minmax | alphabeta[:depth=n,ms=n,hash=n,threads=n,eval=file,endgame=n,nn=file,aspiration=n]\n"
+			<< "          | ybwc[:depth=n,ms=n,hash=n,threads=n,eval=file,aspiration=n]\n";
+		return 1;
+	}
+
+	AgentSpec specs[2];
+	if (not parseSpec(argv[1], specs[0]) or not parseSpec(argv[2], specs[1])) return 1;
+
+	const int32_t pairs = std::max((argc > 3 ? std::stoi(argv[3]) : 100) + 1, 2) / 2;
+	const int32_t threads = std::clamp(argc > 4 ? std::stoi(argv[4]) : static_cast<int32_t>(std::thread::hardware_concurrency()), 1, pairs);
+	const uint64_t seed = argc > 5 ? std::stoull(argv[5]) : 1;
+	const int32_t plies = argc > 6 ? std::stoi(argv[6]) : 8;
+
+	std::ofstream statsLog;
+	if (argc > 7)
+	{
+		statsLog.open(argv[7]);
+		if (not statsLog)
+		{
+			std::cout << "cannot open " << argv[7] << "\n";
+			return 1;
+		}
+	}
+
+	std::cout << specs[0].text << " vs " << specs[1].text << ": " << pairs * 2 << " games, " << threads << " threads, "
+		<< plies << " random plies (seed " << seed << ")\n";
+
+	// [0] A の勝ち [1] 分け [2] A の負け
+	std::atomic<int64_t> results[3] = {};
+	std::atomic<int64_t> discSum = 0;
+	std::atomic<int32_t> nextPair = 0, illegalGames = 0;
+	std::mutex printMutex; // 表示、statsLog、totals を守る
+	AgentTotals totals[2];
+
+	auto work = [&](int32_t id)
+	{
+		Player a = makePlayer(specs[0], seed * 1000 + id * 2);
+		Player b = makePlayer(specs[1], seed * 1000 + id * 2 + 1);
+
+		for (int32_t pair; (pair = nextPair.fetch_add(1)) < pairs;)
+		{
+			const ReversiEngine opening = randomOpening(plies, seed * 1000003 + pair);
+			for (int32_t game = 0; game < 2; ++game)
+			{
+				a.newGame();
+				b.newGame();
+				bool illegal = false;
+				const bool aBlack = game == 0;
+				const auto onMove = [&](bool blackMoved, int32_t ply, const ReversiAgent& agent)
+				{
+					const int32_t side = blackMoved == aBlack ? 0 : 1;
+					const SearchStats& stats = agent.getSearchStats();
+					std::lock_guard lock(printMutex);
+					totals[side].add(stats);
+					if (statsLog.is_open())
+					{
+						statsLog << "{\"pair\":" << pair << ",\"game\":" << game << ",\"ply\":" << ply
+							<< ",\"agent\":\"" << (side == 0 ? "A" : "B") << "\",\"spec\":\"" << specs[side].text << "\","
+							<< statsJson(stats) << "}\n";
+					}
+				};
+				const int32_t diff = playGame(opening, aBlack ? *a.agent : *b.agent, aBlack ? *b.agent : *a.agent, illegal, onMove);
+				const int32_t aDiff = aBlack ? diff : -diff;
+
+				results[aDiff > 0 ? 0 : aDiff == 0 ? 1 : 2]++;
+				discSum += aDiff;
+				if (illegal)
+				{
+					illegalGames++;
+					std::lock_guard lock(printMutex);
+					std::cout << "illegal move in pair " << pair << " game " << game << "\n";
+				}
+			}
+		}
+	};
+
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (int32_t t = 1; t < threads; ++t) workers.emplace_back(work, t);
+	work(0);
+	for (auto& th : workers) th.join();
+	const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const int64_t wins = results[0], draws = results[1], losses = results[2];
+	const int64_t games = wins + draws + losses;
+	const double score = (wins + 0.5 * draws) / games;
+	// 1 局の得点 (1, 0.5, 0) の分散から、平均の得点の 95% 区間を Elo に直す
+	const double variance = (wins * (1 - score) * (1 - score) + draws * (0.5 - score) * (0.5 - score) + losses * score * score) / games;
+	const double margin = 1.96 * std::sqrt(variance / games);
+	const double elo = eloFromScore(score);
+	const double eloError = (eloFromScore(score + margin) - eloFromScore(score - margin)) / 2;
+
+	std::cout << "A wins " << wins << ", draws " << draws << ", B wins " << losses
+		<< " (score " << score * 100 << "%, mean disc diff " << static_cast<double>(discSum) / games << ")\n"
+		<< "Elo difference (A - B): " << elo << " +/- " << eloError << " (95%)\n"
+		<< games << " games in " << sec << " s, " << games / sec << " games/s\n";
+	for (int32_t side = 0; side < 2; ++side)
+	{
+		const AgentTotals& t = totals[side];
+		const double moves = static_cast<double>(std::max<int64_t>(t.moves, 1));
+		std::cout << (side == 0 ? "A" : "B") << ": " << t.moves << " moves, mean depth " << t.depth / moves
+			<< ", " << t.nodes / moves << " nodes/move, " << t.timeUs / moves / 1000 << " ms/move, "
+			<< (t.timeUs > 0 ? t.nodes * 1e6 / t.timeUs : 0.0) << " nodes/s\n";
+	}
+	if (illegalGames) std::cout << illegalGames << " games ended by an illegal move\n";
+	return 0;
+}
@@ -0,0 +1,148 @@
+﻿// CMat の転置 (タイルごとにレジスタの中で転置する再帰の実装) を確かめ、速さを測ります
+// 1. 1x1 から 41x41 までの全ての形と端の出る大きい形で、float / double / int の transposed() と
+//    transpose() (正方行列はその場で転置) を素朴な転置と比べます。一つでも違えば 1 を返して終わります。
+// 2. 以前の実装 (8 要素読んで 1 要素ずつ書き散らす) と比べた帯域 (読みと書きの合計バイト/秒)
+//    transposed() は結果の確保も含むので、確保済みの行列に書く場合も測ります。
+//
+// g++ -std=c++20 -O2 -march=native Tools/TransposeBench.cpp -o TransposeBench
+// ./TransposeBench
+
+# include <iostream>
+# include <chrono>
+# include <random>
+# include "../lib/CMat/CMat.hpp"
+
+namespace
+{
+	/// @brief 以前の CMat::transpose の float の部分
+	CMat::CMat<float> scatterTransposed(const CMat::CMat<float>& m)
+	{
+		CMat::CMat<float> res(CMat::MatShape{ m.shape.cols, m.shape.rows });
+		const float* src = m.data();
+		float* dst = res.data();
+		uint32_t i, j, k;
+
+		for (i = 0; i < m.shape.rows; ++i)
+		{
+			j = 0;
+			for (; j + 8 <= m.shape.cols; j += 8)
+			{
+				__m256 vec = _mm256_loadu_ps(&src[i * m.shape.cols + j]);
+				for (k = 0; k < 8; ++k)
+				{
+					dst[(j + k) * m.shape.rows + i] = ((float*)&vec)[k];
+				}
+			}
+			for (; j < m.shape.cols; ++j)
+			{
+				dst[j * m.shape.rows + i] = src[i * m.shape.cols + j];
+			}
+		}
+		return res;
+	}
+
+	template<class _Dty>
+	CMat::CMat<_Dty> sequence(uint32_t rows, uint32_t cols)
+	{
+		CMat::CMat<_Dty> res(CMat::MatShape{ rows, cols });
+		for (size_t i = 0; i < res.size(); ++i) res.data()[i] = static_cast<_Dty>(i);
+		return res;
+	}
+
+	template<class _Dty>
+	bool isTransposeOf(const CMat::CMat<_Dty>& t, const CMat::CMat<_Dty>& m)
+	{
+		if (t.shape.rows != m.shape.cols or t.shape.cols != m.shape.rows) return false;
+		for (uint32_t i = 0; i < m.shape.rows; ++i)
+		{
+			for (uint32_t j = 0; j < m.shape.cols; ++j)
+			{
+				if (t.data()[j * t.shape.cols + i] != m.data()[i * m.shape.cols + j]) return false;
+			}
+		}
+		return true;
+	}
+
+	template<class _Dty>
+	bool check(uint32_t rows, uint32_t cols, const char* type)
+	{
+		const auto m = sequence<_Dty>(rows, cols);
+		auto inPlace = m;
+		inPlace.transpose();
+		auto twice = inPlace;
+		twice.transpose();
+
+		if (isTransposeOf(m.transposed(), m) and isTransposeOf(inPlace, m) and isTransposeOf(twice, inPlace)) return true;
+		std::cout << "mismatch: " << type << " " << rows << "x" << cols << "\n";
+		return false;
+	}
+
+	template<class _Fn>
+	double measure(_Fn&& f)
+	{
+		f();
+		int32_t reps = 0;
+		const auto start = std::chrono::steady_clock::now();
+		double sec = 0;
+		do
+		{
+			f();
+			reps++;
+			sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		} while (sec < 0.5);
+		return sec / reps;
+	}
+
+	void bench(uint32_t rows, uint32_t cols)
+	{
+		auto m = sequence<float>(rows, cols);
+		auto md = sequence<double>(rows, cols);
+		CMat::CMat<float> r0, r1, r3(CMat::MatShape{ cols, rows });
+		CMat::CMat<double> r2;
+		const double bytes = 2.0 * sizeof(float) * rows * cols;
+
+		const double t0 = measure([&] { r0 = scatterTransposed(m); });
+		const double t1 = measure([&] { r1 = m.transposed(); });
+		const double t2 = measure([&] { m.transpose(); });
+		const double t3 = measure([&] { r2 = md.transposed(); });
+		const double t4 = measure([&] { CMat::detail::transposeBlock(m.data(), cols, r3.data(), rows, rows, cols); });
+
+		std::cout << rows << "x" << cols << "\n"
+			<< "  scatter (previous)   " << bytes / t0 * 1e-9 << " GB/s\n"
+			<< "  tiled transposed()   " << bytes / t1 * 1e-9 << " GB/s, x" << t0 / t1 << "\n"
+			<< "  tiled transpose()    " << bytes / t2 * 1e-9 << " GB/s, x" << t0 / t2 << (rows == cols ? " (in place)" : "") << "\n"
+			<< "  tiled into existing  " << bytes / t4 * 1e-9 << " GB/s (no allocation)\n"
+			<< "  tiled double         " << 2 * bytes / t3 * 1e-9 << " GB/s\n";
+	}
+}
+
+int main()
+{
+	int32_t failures = 0;
+	for (uint32_t rows = 1; rows <= 41; ++rows)
+	{
+		for (uint32_t cols = 1; cols <= 41; ++cols)
+		{
+			failures += not check<float>(rows, cols, "float");
+			failures += not check<double>(rows, cols, "double");
+			failures += not check<int32_t>(rows, cols, "int32_t");
+		}
+	}
+	for (const auto& [rows, cols] : { std::pair{ 0u, 0u }, { 0u, 5u }, { 100u, 100u }, { 257u, 257u }, { 1000u, 777u }, { 3u, 1025u }, { 1025u, 3u } })
+	{
+		failures += not check<float>(rows, cols, "float");
+		failures += not check<double>(rows, cols, "double");
+	}
+	if (failures)
+	{
+		std::cout << failures << " failures\n";
+		return 1;
+	}
+	std::cout << "all transposes match\n";
+
+	for (const auto& [rows, cols] : { std::pair{ 64u, 64u }, { 256u, 256u }, { 1024u, 1024u }, { 4096u, 4096u }, { 1000u, 777u }, { 4096u, 1024u } })
+	{
+		bench(rows, cols);
+	}
+	return 0;
+}
@@ -0,0 +1,809 @@
+﻿// パターン評価関数 (Reversi::Eval::PatternEvaluator) の重みを、石差つきの局面集から学習します
+// ニューラルネットの評価関数 (Reversi::Eval::NNEvaluator) の重みも同じ局面集から学習できます (trainnn)。
+// 局面ごとに 34 個のパターンの番号と着手可能数を疎な特徴として並べ、予測した石差と正解の二乗誤差を
+// 全件の勾配降下 (Adam) で小さくします。勾配は局面をスレッドに分けて集め、CMat の行列で足し合わせます。
+// 白黒を入れ替えたパターンの重みは符号を反転したものになるように、2 つを組にして更新します。
+// 正則化は既定の重みからのずれに掛けるので、局面集に現れないパターンの重みは既定のまま残ります。
+//
+// 局面集はテキストで、1 行に 1 局面を "<盤面 64 文字> <手番 X|O> <手番側から見た最終石差>" の形で書きます
+// (盤面と手番は Reversi::parseBoard の書式)。gen で自己対局から作れます。
+//
+// g++ -std=c++20 -O2 -march=native -pthread Tools/Tuner.cpp ReversiEngine.cpp Trace.cpp TranspositionTable.cpp EndgameSolver.cpp ReversiEval/PatternEval.cpp ReversiEval/WeightFormat.cpp ReversiEval/WeightFile.cpp ReversiEval/NNEval.cpp ReversiAgents/AlphaBetaAgent.cpp -o Tuner
+// ./Tuner gen <games> <corpus.txt> [threads] [seed]          自己対局で局面集を作って追記する
+// ./Tuner train <corpus.txt> <eval.bin> [epochs] [threads]   学習して重みファイルを書き出す
+// ./Tuner trainnn <corpus.txt> <network.bin> [epochs] [threads]   ニューラルネットを学習する
+// ./Tuner embed <eval.bin> <EmbeddedWeights.hpp>             重みファイルを CodinGame 版に埋め込むヘッダにする
+//
+// 書き出した eval.bin を実行ファイルと同じフォルダに置くと、起動時に読み込んで全てのエージェントで使います。
+// embed の出力で ReversiEval/EmbeddedWeights.hpp を置き換えると、CodinGame 版もその重みを使います。
+
+# include <iostream>
+# include <fstream>
+# include <chrono>
+# include <string>
+# include <vector>
+# include <thread>
+# include <mutex>
+# include <random>
+# include <atomic>
+# include <algorithm>
+# include <cmath>
+# include "../lib/CMat/CMat.hpp"
+# include "../EndgameSolver.hpp"
+# include "../ReversiAgents/AlphaBetaAgent.hpp"
+# include "../ReversiEval/PatternEval.hpp"
+# include "../ReversiEval/NNEval.hpp"
+# include "../ReversiEval/WeightFile.hpp"
+# include "../ReversiEval/WeightFormat.hpp"
+
+namespace
+{
+	using Reversi::ReversiEngine;
+	using Reversi::Eval::PatternEvaluator;
+	using Reversi::Eval::PatternState;
+	using Reversi::Eval::NumFeatures;
+
+	/// @brief 学習に使う重みの総数
+	constexpr int32_t NumWeights = PatternEvaluator::PhaseSize * PatternEvaluator::NumPhases;
+
+	/// @brief 疎な特徴行列の 1 行 (1 局面)
+	/// 値が ±1 の列が NumFeatures 個 (パターン) と、値が 1 の列が 1 個 (着手可能数) あります。
+	struct Sample
+	{
+		int32_t offset; // 段階の先頭位置
+		std::array<uint16_t, NumFeatures> indices;
+		uint8_t mobility;
+		int8_t sign; // 黒番なら 1、白番なら -1
+		float target; // 手番側から見た石差
+	};
+
+	/// @brief 全ての列の番号 (段階の中での位置) を、白黒を入れ替えたパターンの番号へ写す表
+	/// 着手可能数の列は自分自身に写します。
+	std::vector<int32_t> makeSwapTable()
+	{
+		std::vector<int32_t> res(PatternEvaluator::PhaseSize);
+		for (int32_t s = 0; s < Reversi::Eval::NumShapes; ++s)
+		{
+			const int32_t size = Reversi::Eval::ShapeSize[s];
+			for (int32_t index = 0; index < Reversi::Eval::Pow3[size]; ++index)
+			{
+				int32_t swapped = 0;
+				for (int32_t i = size - 1; i >= 0; --i)
+				{
+					const int32_t digit = index / Reversi::Eval::Pow3[i] % 3;
+					swapped = swapped * 3 + (digit == 0 ? 0 : 3 - digit);
+				}
+				res[PatternEvaluator::ShapeOffset[s] + index] = PatternEvaluator::ShapeOffset[s] + swapped;
+			}
+		}
+		for (int32_t n = 0; n < PatternEvaluator::MobilitySize; ++n)
+		{
+			res[PatternEvaluator::MobilityOffset + n] = PatternEvaluator::MobilityOffset + n;
+		}
+		return res;
+	}
+
+	/// @brief 局面集の各行を読み、盤面と手番側から見た石差を f に渡します
+	/// @return ファイルを開ければ true
+	template <class F>
+	bool forEachCorpusLine(const std::string& path, F f)
+	{
+		std::ifstream ifs(path);
+		if (not ifs) return false;
+
+		ReversiEngine engine;
+		std::string line;
+		int64_t lineNo = 0, skipped = 0;
+
+		while (std::getline(ifs, line))
+		{
+			lineNo++;
+			if (line.empty()) continue;
+			// 盤面 64 文字、空白、手番の後に石差が続く
+			if (line.size() < 68 or not Reversi::parseBoard(std::string_view(line).substr(0, 66), engine))
+			{
+				skipped++;
+				continue;
+			}
+			f(engine, std::clamp(std::stof(line.substr(66)), -64.0f, 64.0f));
+		}
+
+		if (skipped) std::cout << "skipped " << skipped << " invalid lines of " << lineNo << "\n";
+		return true;
+	}
+
+	bool readCorpus(const std::string& path, std::vector<Sample>& samples)
+	{
+		PatternState state;
+		return forEachCorpusLine(path, [&](const ReversiEngine& engine, float score)
+		{
+			Sample sample;
+			state.reset(engine);
+			const int32_t discs = std::popcount(engine.getBlacks() | engine.getWhites());
+			sample.offset = PatternEvaluator::phaseOf(discs) * PatternEvaluator::PhaseSize;
+			sample.indices = state.indices;
+			sample.mobility = static_cast<uint8_t>(std::popcount(engine.getLegals()));
+			sample.sign = engine.isBlackTurn() ? 1 : -1;
+			sample.target = score;
+			samples.push_back(sample);
+		});
+	}
+
+	/// @brief 重み (石単位) で局面の石差を予測します
+	inline float predict(const Sample& sample, const float* w)
+	{
+		w += sample.offset;
+		float sum = 0;
+		for (int32_t f = 0; f < NumFeatures; ++f)
+		{
+			sum += w[PatternEvaluator::FeatureOffset[f] + sample.indices[f]];
+		}
+		return sample.sign * sum + w[PatternEvaluator::MobilityOffset + sample.mobility];
+	}
+
+	class Trainer
+	{
+	public:
+		Trainer(const std::vector<Sample>& samples, size_t numTrain, int32_t threads) :
+			m_samples(samples), m_numTrain(numTrain), m_threads(threads),
+			m_swap(makeSwapTable()),
+			m_weights(CMat::MatShape{ PatternEvaluator::NumPhases, PatternEvaluator::PhaseSize }),
+			m_init(m_weights.shape), m_m(m_weights.shape), m_v(m_weights.shape),
+			m_grads(threads, CMat::CMat<float>(m_weights.shape)),
+			m_loss(threads)
+		{
+			// 既定の重みから始める
+			const PatternEvaluator defaults;
+			const auto init = defaults.weights();
+			for (int32_t i = 0; i < NumWeights; ++i) m_init.data()[i] = static_cast<float>(init[i]) / PatternEvaluator::Scale;
+			m_weights = m_init;
+		}
+
+		/// @brief 1 回全件を見て重みを更新します
+		/// @return 学習用の局面での平均二乗誤差
+		double step(float learningRate, float l2)
+		{
+			std::vector<std::thread> workers;
+			for (int32_t t = 1; t < m_threads; ++t) workers.emplace_back(&Trainer::accumulate, this, t);
+			accumulate(0);
+			for (auto& th : workers) th.join();
+
+			// スレッドごとの勾配を足し合わせる
+			CMat::CMat<float>& grad = m_grads[0];
+			double loss = m_loss[0];
+			for (int32_t t = 1; t < m_threads; ++t)
+			{
+				grad += m_grads[t];
+				loss += m_loss[t];
+			}
+
+			// Adam
+			constexpr float Beta1 = 0.9f, Beta2 = 0.999f, Eps = 1e-8f;
+			m_t++;
+			const float c1 = 1.0f / (1.0f - std::pow(Beta1, static_cast<float>(m_t)));
+			const float c2 = 1.0f / (1.0f - std::pow(Beta2, static_cast<float>(m_t)));
+			const float inv = 1.0f / static_cast<float>(m_numTrain);
+
+			float* w = m_weights.data();
+			const float* w0 = m_init.data();
+			float* m = m_m.data();
+			float* v = m_v.data();
+			const float* g = grad.data();
+			for (int32_t i = 0; i < NumWeights; ++i)
+			{
+				const float gi = g[i] * inv + l2 * (w[i] - w0[i]);
+				m[i] = Beta1 * m[i] + (1 - Beta1) * gi;
+				v[i] = Beta2 * v[i] + (1 - Beta2) * gi * gi;
+				w[i] -= learningRate * (m[i] * c1) / (std::sqrt(v[i] * c2) + Eps);
+			}
+			return loss / static_cast<double>(m_numTrain);
+		}
+
+		/// @brief 検証用の局面 (学習に使っていない残り) での平均二乗誤差と平均絶対誤差
+		std::pair<double, double> validate() const
+		{
+			double se = 0, ae = 0;
+			for (size_t i = m_numTrain; i < m_samples.size(); ++i)
+			{
+				const double e = predict(m_samples[i], m_weights.data()) - m_samples[i].target;
+				se += e * e;
+				ae += std::abs(e);
+			}
+			const double n = static_cast<double>(std::max<size_t>(m_samples.size() - m_numTrain, 1));
+			return { se / n, ae / n };
+		}
+
+		/// @brief 学習した重みを評価関数の単位に直します
+		std::vector<int16_t> exportWeights() const
+		{
+			std::vector<int16_t> res(NumWeights);
+			for (int32_t i = 0; i < NumWeights; ++i)
+			{
+				const float value = std::round(m_weights.data()[i] * PatternEvaluator::Scale);
+				res[i] = static_cast<int16_t>(std::clamp(value, -32767.0f, 32767.0f));
+			}
+			return res;
+		}
+
+	private:
+		const std::vector<Sample>& m_samples;
+		size_t m_numTrain;
+		int32_t m_threads;
+		std::vector<int32_t> m_swap;
+		CMat::CMat<float> m_weights; // [段階][1 段階の重み]、石単位
+		CMat::CMat<float> m_init; // 既定の重み
+		CMat::CMat<float> m_m, m_v; // Adam の 1 次と 2 次のモーメント
+		std::vector<CMat::CMat<float>> m_grads; // スレッドごとの勾配
+		std::vector<double> m_loss;
+		int32_t m_t = 0;
+
+		/// @brief 担当する局面の勾配 (誤差の和) を集めます
+		void accumulate(int32_t thread)
+		{
+			CMat::CMat<float>& grad = m_grads[thread];
+			std::fill(grad.data(), grad.data() + NumWeights, 0.0f);
+			float* g = grad.data();
+			const float* w = m_weights.data();
+
+			const size_t first = m_numTrain * thread / m_threads;
+			const size_t last = m_numTrain * (thread + 1) / m_threads;
+			double loss = 0;
+
+			for (size_t i = first; i < last; ++i)
+			{
+				const Sample& s = m_samples[i];
+				const float e = predict(s, w) - s.target;
+				loss += static_cast<double>(e) * e;
+
+				// 白黒を入れ替えたパターンには符号を反転した勾配を与えて、重みの反対称を保つ
+				const float ge = s.sign * e * 0.5f;
+				float* gp = g + s.offset;
+				for (int32_t f = 0; f < NumFeatures; ++f)
+				{
+					const int32_t col = PatternEvaluator::FeatureOffset[f] + s.indices[f];
+					gp[col] += ge;
+					gp[m_swap[col]] -= ge;
+				}
+				gp[PatternEvaluator::MobilityOffset + s.mobility] += e;
+			}
+			m_loss[thread] = loss;
+		}
+	};
+
+	int train(const std::string& corpusPath, const std::string& outPath, int32_t epochs, int32_t threads)
+	{
+		std::vector<Sample> samples;
+		auto start = std::chrono::steady_clock::now();
+		if (not readCorpus(corpusPath, samples))
+		{
+			std::cout << "cannot open " << corpusPath << "\n";
+			return 1;
+		}
+		if (samples.empty())
+		{
+			std::cout << "no samples\n";
+			return 1;
+		}
+
+		// 並びの偏りを無くしてから、末尾の 1/20 を検証用に取っておく
+		std::shuffle(samples.begin(), samples.end(), std::mt19937_64(1));
+		const size_t numTrain = samples.size() - samples.size() / 20;
+
+		std::cout << samples.size() << " samples (" << numTrain << " train), loaded in "
+			<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+
+		int64_t phaseCounts[PatternEvaluator::NumPhases] = {};
+		for (const auto& s : samples) phaseCounts[s.offset / PatternEvaluator::PhaseSize]++;
+		std::cout << "samples per phase:";
+		for (int64_t n : phaseCounts) std::cout << " " << n;
+		std::cout << "\n";
+
+		Trainer trainer(samples, numTrain, threads);
+		auto [mse, mae] = trainer.validate();
+		std::cout << "initial: valid mse " << mse << ", mae " << mae << "\n";
+
+		start = std::chrono::steady_clock::now();
+		for (int32_t epoch = 1; epoch <= epochs; ++epoch)
+		{
+			// 後半は学習率を下げる
+			const float learningRate = epoch <= epochs / 2 ? 0.05f : epoch <= epochs * 3 / 4 ? 0.02f : 0.005f;
+			const double loss = trainer.step(learningRate, 1e-6f);
+
+			if (epoch % 10 == 0 or epoch == epochs)
+			{
+				std::tie(mse, mae) = trainer.validate();
+				std::cout << "epoch " << epoch << ": train mse " << loss << ", valid mse " << mse << ", mae " << mae << ", "
+					<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+			}
+		}
+
+		if (not Reversi::Eval::saveWeightFile(outPath, trainer.exportWeights()))
+		{
+			std::cout << "cannot write " << outPath << "\n";
+			return 1;
+		}
+		std::cout << "wrote " << outPath << "\n";
+		return 0;
+	}
+
+	/// @brief ネットの学習に使う 1 局面
+	struct NetworkSample
+	{
+		uint64_t blacks, whites;
+		float target; // 黒から見た石差
+	};
+
+	/// @brief ニューラルネット (Reversi::Eval::NNParameters と同じ形) を小さなバッチごとの Adam で学習します
+	/// 順伝播と逆伝播はバッチを行列にして CMat::matmul で計算し、バッチをスレッドに分けて勾配を足し合わせます。
+	class NetworkTrainer
+	{
+	public:
+		static constexpr int32_t BatchSize = 256;
+
+		NetworkTrainer(const std::vector<NetworkSample>& samples, size_t numTrain, int32_t threads) :
+			m_samples(samples), m_numTrain(numTrain), m_threads(threads), m_grads(threads)
+		{
+			const auto init = Reversi::Eval::NNParameters::initial(1);
+			m_params[W1] = toMat(init.w1, Input, Hidden1);
+			m_params[B1] = toMat(init.b1, 1, Hidden1);
+			m_params[W2] = toMat(init.w2, Hidden1, Hidden2);
+			m_params[B2] = toMat(init.b2, 1, Hidden2);
+			m_params[W3] = toMat(init.w3, Hidden2, 1);
+			m_params[B3] = toMat({ init.b3 }, 1, 1);
+			for (int32_t i = 0; i < NumParams; ++i)
+			{
+				m_m[i] = CMat::CMat<float>(m_params[i].shape);
+				m_v[i] = CMat::CMat<float>(m_params[i].shape);
+				for (auto& g : m_grads) g[i] = CMat::CMat<float>(m_params[i].shape);
+			}
+		}
+
+		/// @brief 学習用の局面を 1 周します
+		/// @return 平均二乗誤差
+		double epoch(float learningRate, std::mt19937_64& rng)
+		{
+			std::vector<size_t> order(m_numTrain);
+			for (size_t i = 0; i < m_numTrain; ++i) order[i] = i;
+			std::shuffle(order.begin(), order.end(), rng);
+
+			double loss = 0;
+			std::vector<double> losses(m_threads);
+			for (size_t first = 0; first < m_numTrain; first += BatchSize)
+			{
+				const size_t size = std::min<size_t>(BatchSize, m_numTrain - first);
+				auto work = [&](int32_t t)
+				{
+					const size_t begin = first + size * t / m_threads, end = first + size * (t + 1) / m_threads;
+					losses[t] = backward(order.data() + begin, end - begin, m_grads[t]);
+				};
+
+				std::vector<std::thread> workers;
+				for (int32_t t = 1; t < m_threads; ++t) workers.emplace_back(work, t);
+				work(0);
+				for (auto& th : workers) th.join();
+
+				for (int32_t t = 0; t < m_threads; ++t) loss += losses[t];
+				for (int32_t t = 1; t < m_threads; ++t)
+				{
+					for (int32_t i = 0; i < NumParams; ++i) m_grads[0][i] += m_grads[t][i];
+				}
+				adam(learningRate, 1.0f / static_cast<float>(size));
+			}
+			return loss / static_cast<double>(m_numTrain);
+		}
+
+		/// @brief 検証用の局面での、量子化した評価関数の平均二乗誤差と平均絶対誤差 (石差)
+		std::pair<double, double> validate() const
+		{
+			const Reversi::Eval::NNEvaluator evaluator(parameters());
+			double se = 0, ae = 0;
+			for (size_t i = m_numTrain; i < m_samples.size(); ++i)
+			{
+				ReversiEngine engine;
+				engine.setState(m_samples[i].blacks, m_samples[i].whites, true);
+				Reversi::Eval::NNState state;
+				evaluator.reset(state, engine);
+				const double e = static_cast<double>(evaluator.evaluateRaw(state)) / Reversi::Eval::DiscScale - m_samples[i].target;
+				se += e * e;
+				ae += std::abs(e);
+			}
+			const double n = static_cast<double>(std::max<size_t>(m_samples.size() - m_numTrain, 1));
+			return { se / n, ae / n };
+		}
+
+		Reversi::Eval::NNParameters parameters() const
+		{
+			Reversi::Eval::NNParameters res;
+			res.w1.assign(m_params[W1].data(), m_params[W1].data() + Input * Hidden1);
+			res.b1.assign(m_params[B1].data(), m_params[B1].data() + Hidden1);
+			res.w2.assign(m_params[W2].data(), m_params[W2].data() + Hidden1 * Hidden2);
+			res.b2.assign(m_params[B2].data(), m_params[B2].data() + Hidden2);
+			res.w3.assign(m_params[W3].data(), m_params[W3].data() + Hidden2);
+			res.b3 = m_params[B3].data()[0];
+			return res;
+		}
+
+	private:
+		static constexpr uint32_t Input = Reversi::Eval::NNParameters::InputSize;
+		static constexpr uint32_t Hidden1 = Reversi::Eval::NNParameters::Hidden1;
+		static constexpr uint32_t Hidden2 = Reversi::Eval::NNParameters::Hidden2;
+
+		enum { W1, B1, W2, B2, W3, B3, NumParams };
+		using Params = std::array<CMat::CMat<float>, NumParams>;
+
+		const std::vector<NetworkSample>& m_samples;
+		size_t m_numTrain;
+		int32_t m_threads;
+		Params m_params, m_m, m_v; // 重みと Adam の 1 次と 2 次のモーメント
+		std::vector<Params> m_grads; // スレッドごとの勾配
+		int32_t m_t = 0;
+
+		static CMat::CMat<float> toMat(const std::vector<float>& values, uint32_t rows, uint32_t cols)
+		{
+			CMat::CMat<float> res(CMat::MatShape{ rows, cols });
+			std::copy(values.begin(), values.end(), res.data());
+			return res;
+		}
+
+		/// @brief 各行にバイアスを足して [0, 1] に切り詰めます
+		static void addBiasClamp(CMat::CMat<float>& z, const CMat::CMat<float>& bias, CMat::CMat<float>& a)
+		{
+			a = CMat::CMat<float>(z.shape);
+			for (uint32_t r = 0; r < z.shape.rows; ++r)
+			{
+				for (uint32_t c = 0; c < z.shape.cols; ++c)
+				{
+					float& v = z.data()[r * z.shape.cols + c];
+					v += bias.data()[c];
+					a.data()[r * z.shape.cols + c] = std::clamp(v, 0.0f, 1.0f);
+				}
+			}
+		}
+
+		/// @brief 切り詰めた所の勾配を 0 にし、列ごとの和をバイアスの勾配に足します
+		static void maskAndSum(CMat::CMat<float>& d, const CMat::CMat<float>& z, CMat::CMat<float>& biasGrad)
+		{
+			for (uint32_t r = 0; r < d.shape.rows; ++r)
+			{
+				for (uint32_t c = 0; c < d.shape.cols; ++c)
+				{
+					float& v = d.data()[r * d.shape.cols + c];
+					const float zv = z.data()[r * d.shape.cols + c];
+					if (zv <= 0.0f or zv >= 1.0f) v = 0;
+					biasGrad.data()[c] += v;
+				}
+			}
+		}
+
+		/// @brief 局面の組の勾配 (誤差の和) を求めます
+		/// @return 二乗誤差の和
+		double backward(const size_t* indices, size_t n, Params& grads) const
+		{
+			for (auto& g : grads) std::fill(g.data(), g.data() + g.size(), 0.0f);
+			if (n == 0) return 0;
+			const uint32_t rows = static_cast<uint32_t>(n);
+
+			CMat::CMat<float> x(CMat::MatShape{ rows, Input });
+			for (uint32_t r = 0; r < rows; ++r)
+			{
+				const NetworkSample& s = m_samples[indices[r]];
+				float* row = x.data() + static_cast<size_t>(r) * Input;
+				for (uint64_t b = s.blacks; b; b &= b - 1) row[std::countr_zero(b)] = 1;
+				for (uint64_t w = s.whites; w; w &= w - 1) row[64 + std::countr_zero(w)] = 1;
+			}
+
+			// 順伝播
+			CMat::CMat<float> z1 = CMat::matmul(x, m_params[W1]), a1;
+			addBiasClamp(z1, m_params[B1], a1);
+			CMat::CMat<float> z2 = CMat::matmul(a1, m_params[W2]), a2;
+			addBiasClamp(z2, m_params[B2], a2);
+			CMat::CMat<float> y = CMat::matmul(a2, m_params[W3]);
+
+			// 出力の誤差
+			double loss = 0;
+			for (uint32_t r = 0; r < rows; ++r)
+			{
+				float& e = y.data()[r];
+				e += m_params[B3].data()[0] - m_samples[indices[r]].target;
+				loss += static_cast<double>(e) * e;
+				grads[B3].data()[0] += e;
+			}
+
+			// 逆伝播
+			grads[W3] = CMat::matmul(a2.transposedView(), y);
+			CMat::CMat<float> d2 = CMat::matmul(y, m_params[W3].transposedView());
+			maskAndSum(d2, z2, grads[B2]);
+			grads[W2] = CMat::matmul(a1.transposedView(), d2);
+			CMat::CMat<float> d1 = CMat::matmul(d2, m_params[W2].transposedView());
+			maskAndSum(d1, z1, grads[B1]);
+			grads[W1] = CMat::matmul(x.transposedView(), d1);
+			return loss;
+		}
+
+		void adam(float learningRate, float scale)
+		{
+			constexpr float Beta1 = 0.9f, Beta2 = 0.999f, Eps = 1e-8f;
+			m_t++;
+			const float c1 = 1.0f / (1.0f - std::pow(Beta1, static_cast<float>(m_t)));
+			const float c2 = 1.0f / (1.0f - std::pow(Beta2, static_cast<float>(m_t)));
+
+			for (int32_t p = 0; p < NumParams; ++p)
+			{
+				float* w = m_params[p].data();
+				float* m = m_m[p].data();
+				float* v = m_v[p].data();
+				const float* g = m_grads[0][p].data();
+				for (size_t i = 0; i < m_params[p].size(); ++i)
+				{
+					const float gi = g[i] * scale;
+					m[i] = Beta1 * m[i] + (1 - Beta1) * gi;
+					v[i] = Beta2 * v[i] + (1 - Beta2) * gi * gi;
+					w[i] -= learningRate * (m[i] * c1) / (std::sqrt(v[i] * c2) + Eps);
+				}
+			}
+		}
+	};
+
+	int trainNetwork(const std::string& corpusPath, const std::string& outPath, int32_t epochs, int32_t threads)
+	{
+		std::vector<NetworkSample> samples;
+		auto start = std::chrono::steady_clock::now();
+		const bool opened = forEachCorpusLine(corpusPath, [&](const ReversiEngine& engine, float score)
+		{
+			samples.push_back({ engine.getBlacks(), engine.getWhites(), engine.isBlackTurn() ? score : -score });
+		});
+		if (not opened)
+		{
+			std::cout << "cannot open " << corpusPath << "\n";
+			return 1;
+		}
+		if (samples.empty())
+		{
+			std::cout << "no samples\n";
+			return 1;
+		}
+
+		std::shuffle(samples.begin(), samples.end(), std::mt19937_64(1));
+		const size_t numTrain = samples.size() - samples.size() / 20;
+		std::cout << samples.size() << " samples (" << numTrain << " train), loaded in "
+			<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+
+		NetworkTrainer trainer(samples, numTrain, threads);
+		std::mt19937_64 rng(2);
+		start = std::chrono::steady_clock::now();
+		for (int32_t epoch = 1; epoch <= epochs; ++epoch)
+		{
+			const float learningRate = epoch <= epochs / 2 ? 1e-3f : epoch <= epochs * 3 / 4 ? 3e-4f : 1e-4f;
+			const double loss = trainer.epoch(learningRate, rng);
+			const auto [mse, mae] = trainer.validate();
+			std::cout << "epoch " << epoch << ": train mse " << loss << ", valid mse " << mse << ", mae " << mae << " (quantized), "
+				<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+		}
+
+		if (not Reversi::Eval::saveNetworkFile(outPath, trainer.parameters()))
+		{
+			std::cout << "cannot write " << outPath << "\n";
+			return 1;
+		}
+		std::cout << "wrote " << outPath << "\n";
+		return 0;
+	}
+
+	/// @brief 自己対局で局面集を作ります
+	/// 序盤は乱択で散らし、その後は浅い探索 (ときどき乱択) で打ちます。空きが SolveEmpties 以下になったら
+	/// 完全読みで打ち、そこまでの局面には完全読みの結果を、以降の局面には各局面の完全読みの値を付けます。
+	class Generator
+	{
+	public:
+		static constexpr int32_t SolveEmpties = 14;
+		static constexpr int32_t SearchDepth = 4;
+
+		Generator(std::ofstream& ofs, std::mutex& mutex, uint64_t seed) :
+			m_ofs(ofs), m_mutex(mutex), m_rng(seed), m_agent(4), m_solver(4)
+		{
+			m_agent.setSearchDepth(SearchDepth);
+			m_agent.setEndgameEmpties(0);
+		}
+
+		/// @return 書き出した局面の数
+		int64_t playGame()
+		{
+			ReversiEngine engine;
+			engine.reset();
+			std::vector<std::pair<std::string, bool>> history; // 盤面の文字列と黒番かどうか
+			std::string lines;
+			const int32_t randomPlies = 8 + static_cast<int32_t>(m_rng() % 12);
+			int64_t written = 0;
+			int32_t solvedScore = 0;
+			bool solvedBlack = true;
+			bool solved = false;
+
+			for (int32_t ply = 0; ; ++ply)
+			{
+				uint64_t legals = engine.getLegals();
+				if (legals == 0)
+				{
+					if (engine.getLegals(true) == 0) break;
+					engine.pass();
+					continue;
+				}
+
+				const int32_t empties = 64 - std::popcount(engine.getBlacks() | engine.getWhites());
+				uint64_t bit;
+
+				if (empties <= SolveEmpties)
+				{
+					const auto res = m_solver.solve(engine);
+					if (not solved)
+					{
+						solved = true;
+						solvedScore = res.score;
+						solvedBlack = engine.isBlackTurn();
+					}
+					lines += Reversi::toBoardString(engine) + " " + std::to_string(res.score) + "\n";
+					written++;
+					bit = res.bestMove;
+				}
+				else
+				{
+					if (ply >= randomPlies) history.emplace_back(Reversi::toBoardString(engine), engine.isBlackTurn());
+
+					if (ply < randomPlies or m_rng() % 10 == 0)
+					{
+						bit = pickRandom(legals);
+					}
+					else
+					{
+						m_agent.reset();
+						const auto [x, y] = m_agent.play(engine);
+						bit = 1ull << (63 - (x + 8 * y));
+					}
+				}
+				engine.placeUnchecked(bit);
+			}
+
+			if (not solved)
+			{
+				// 空きが残ったまま終局した
+				solvedScore = engine.getNBlacks() - engine.getNWhites();
+				const int32_t empties = 64 - engine.getNBlacks() - engine.getNWhites();
+				solvedScore += solvedScore > 0 ? empties : solvedScore < 0 ? -empties : 0;
+				solvedBlack = true;
+			}
+
+			for (const auto& [board, black] : history)
+			{
+				lines += board + " " + std::to_string(black == solvedBlack ? solvedScore : -solvedScore) + "\n";
+				written++;
+			}
+
+			std::lock_guard lock(m_mutex);
+			m_ofs << lines;
+			return written;
+		}
+
+	private:
+		std::ofstream& m_ofs;
+		std::mutex& m_mutex;
+		std::mt19937_64 m_rng;
+		AlphaBetaAgent m_agent;
+		Reversi::EndgameSolver m_solver;
+
+		uint64_t pickRandom(uint64_t legals)
+		{
+			for (int32_t n = static_cast<int32_t>(m_rng() % std::popcount(legals)); n > 0; --n) legals &= legals - 1;
+			return legals & (0 - legals);
+		}
+	};
+
+	int generate(int64_t games, const std::string& outPath, int32_t threads, uint64_t seed)
+	{
+		std::ofstream ofs(outPath, std::ios::app);
+		if (not ofs)
+		{
+			std::cout << "cannot open " << outPath << "\n";
+			return 1;
+		}
+
+		std::mutex mutex;
+		std::atomic<int64_t> nextGame = 0, positions = 0;
+		const auto start = std::chrono::steady_clock::now();
+
+		auto work = [&](int32_t id)
+		{
+			Generator generator(ofs, mutex, seed * 1000 + id);
+			for (int64_t g; (g = nextGame++) < games; )
+			{
+				positions += generator.playGame();
+				if (id == 0 and g % 100 == 0)
+				{
+					std::cout << "game " << g << ", " << positions << " positions, "
+						<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+				}
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (int32_t t = 1; t < threads; ++t) workers.emplace_back(work, t);
+		work(0);
+		for (auto& th : workers) th.join();
+
+		std::cout << games << " games, " << positions << " positions\n";
+		return 0;
+	}
+
+	/// @brief 重みファイルを圧縮して、ReversiEval/EmbeddedWeights.hpp と同じ形のヘッダに書き出します
+	int embed(const std::string& weightPath, const std::string& outPath)
+	{
+		PatternEvaluator evaluator;
+		if (not Reversi::Eval::loadWeightFile(weightPath, evaluator))
+		{
+			std::cout << "cannot load " << weightPath << "\n";
+			return 1;
+		}
+
+		const std::string blob = Reversi::Eval::encodeEmbeddedWeights(evaluator.weights());
+
+		std::ofstream ofs(outPath, std::ios::binary);
+		if (not ofs)
+		{
+			std::cout << "cannot open " << outPath << "\n";
+			return 1;
+		}
+
+		// MSVC の文字列リテラルの長さの制限に掛からないように分ける
+		constexpr size_t PieceSize = 4096;
+		ofs << "\xEF\xBB\xBF#pragma once\n\n"
+			<< "// CodinGame 版に埋め込む重み。Tools/Tuner embed で学習した重みファイルから作り直します\n"
+			<< "// 空のままなら既定の重みを使います。\n"
+			<< "namespace Reversi::Eval\n{\n"
+			<< "\tinline constexpr const char* EmbeddedWeights[] = {\n";
+		for (size_t i = 0; i < blob.size(); i += PieceSize)
+		{
+			ofs << "\t\t\"" << blob.substr(i, PieceSize) << "\",\n";
+		}
+		ofs << "\t};\n}\n";
+
+		std::cout << "wrote " << outPath << " (" << blob.size() << " characters)\n";
+		return ofs ? 0 : 1;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const std::string mode = argc > 1 ? argv[1] : "";
+	const int32_t hardwareThreads = static_cast<int32_t>(std::max(std::thread::hardware_concurrency(), 1u));
+
+	if (mode == "gen" and argc > 3)
+	{
+		const int32_t threads = argc > 4 ? std::stoi(argv[4]) : hardwareThreads;
+		const uint64_t seed = argc > 5 ? std::stoull(argv[5]) : 1;
+		return generate(std::stoll(argv[2]), argv[3], std::max(threads, 1), seed);
+	}
+
+	if (mode == "train" and argc > 3)
+	{
+		const int32_t epochs = argc > 4 ? std::stoi(argv[4]) : 200;
+		const int32_t threads = argc > 5 ? std::stoi(argv[5]) : hardwareThreads;
+		return train(argv[2], argv[3], epochs, std::max(threads, 1));
+	}
+
+	if (mode == "trainnn" and argc > 3)
+	{
+		const int32_t epochs = argc > 4 ? std::stoi(argv[4]) : 20;
+		const int32_t threads = argc > 5 ? std::stoi(argv[5]) : hardwareThreads;
+		return trainNetwork(argv[2], argv[3], epochs, std::max(threads, 1));
+	}
+
+	if (mode == "embed" and argc > 3)
+	{
+		return embed(argv[2], argv[3]);
+	}
+
+	std::cout << "usage:\n"
+		<< "  Tuner gen <games> <corpus.txt> [threads] [seed]\n"
+		<< "  Tuner train <corpus.txt> <eval.bin> [epochs] [threads]\n"
+		<< "  Tuner trainnn <corpus.txt> <network.bin> [epochs] [threads]\n"
+		<< "  Tuner embed <eval.bin> <EmbeddedWeights.hpp>\n";
+	return 1;
+}
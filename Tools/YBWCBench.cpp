@@ -0,0 +1,78 @@
+﻿// YBWCAgent (Young Brothers Wait) と AlphaBetaAgent (逐次) を終盤の局面集で比べます
+// 深さを空きマス数にして終局まで読むので、逐次探索のノード数は実行ごとに変わりません。
+// 並列探索のノード数と逐次探索のノード数の比が、木を分けたことによる余分な探索 (探索効率) の目安です。
+//
+// g++ -std=c++20 -O2 -march=native -pthread Tools/YBWCBench.cpp ReversiEngine.cpp Trace.cpp TranspositionTable.cpp WorkStealingPool.cpp EndgameSolver.cpp ReversiEval/PatternEval.cpp ReversiEval/NNEval.cpp ReversiEval/WeightFormat.cpp ReversiAgents/AlphaBetaAgent.cpp ReversiAgents/YBWCAgent.cpp -o YBWCBench
+// ./YBWCBench [maxThreads]    既定はスレッド数 1, 2, 4, 8 (maxThreads まで)
+
+# include <iostream>
+# include <chrono>
+# include <string>
+# include <thread>
+# include "../ReversiAgents/AlphaBetaAgent.hpp"
+# include "../ReversiAgents/YBWCAgent.hpp"
+# include "BenchPositions.hpp"
+
+namespace
+{
+	struct Result
+	{
+		int64_t nodes = 0;
+		double sec = 0;
+		std::string moves;
+	};
+
+	/// @brief 局面集を空きマス数の深さで読み、ノード数と時間を合計します
+	template<class Agent>
+	Result run(Agent& agent)
+	{
+		Result res;
+		for (const char* board : BenchPositions::Endgame)
+		{
+			Reversi::ReversiEngine engine;
+			Reversi::parseBoard(board, engine);
+			agent.setSearchDepth(64 - std::popcount(engine.getBlacks() | engine.getWhites()));
+			agent.clearHash();
+			agent.reset();
+
+			const auto start = std::chrono::steady_clock::now();
+			const auto [x, y] = agent.play(engine);
+			const auto end = std::chrono::steady_clock::now();
+
+			res.sec += std::chrono::duration<double>(end - start).count();
+			res.nodes += agent.getNodeCount();
+			res.moves += { char('a' + x), char('1' + y), ' ' };
+		}
+		return res;
+	}
+
+	void print(const std::string& name, const Result& res, const Result& serial)
+	{
+		std::cout << name << ": " << res.sec * 1000 << " ms, " << res.nodes << " nodes ("
+			<< static_cast<double>(res.nodes) / serial.nodes << "x serial), "
+			<< static_cast<int64_t>(res.nodes / std::max(res.sec, 1e-9)) << " nodes/s, speedup x"
+			<< serial.sec / std::max(res.sec, 1e-9) << ", moves " << res.moves << "\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const int32_t maxThreads = argc > 1 ? std::stoi(argv[1]) : 8;
+	std::cout << "hardware threads " << std::thread::hardware_concurrency() << "\n";
+
+	// 同じ木を比べたいので、AlphaBetaAgent の完全読みは使わない
+	AlphaBetaAgent alphaBeta(64);
+	alphaBeta.setEndgameEmpties(0);
+	const Result serial = run(alphaBeta);
+	print("AlphaBeta serial", serial, serial);
+
+	YBWCAgent ybwc(64);
+	for (int32_t threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		ybwc.setThreadCount(threads);
+		const Result res = run(ybwc);
+		print("YBWC " + std::to_string(threads) + " threads", res, serial);
+		std::cout << "  splits " << ybwc.getSplitCount() << " (last position)\n";
+	}
+	return 0;
+}
@@ -0,0 +1,133 @@
+﻿# include "Trace.hpp"
+# include <algorithm>
+# include <chrono>
+# include <fstream>
+# include <mutex>
+# include <thread>
+# include <vector>
+
+namespace Reversi::Trace
+{
+#ifdef REVERSI_TRACE
+	namespace
+	{
+		struct Registry
+		{
+			std::mutex mutex;
+			std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+			std::vector<ThreadBuffer*> freeBuffers; // 終わったスレッドのバッファ
+		};
+
+		Registry& registry()
+		{
+			static Registry instance;
+			return instance;
+		}
+
+		/// @brief スレッドが終わるときにバッファを返します
+		struct BufferOwner
+		{
+			ThreadBuffer* buffer = nullptr;
+
+			~BufferOwner()
+			{
+				if (buffer == nullptr) return;
+				Registry& reg = registry();
+				std::lock_guard lock{ reg.mutex };
+				reg.freeBuffers.push_back(buffer);
+			}
+		};
+
+		thread_local BufferOwner t_owner;
+
+		/// @brief now() の単位を µs に直すための、プログラム開始時の時刻の組
+		const uint64_t StartTicks = now();
+		const std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+
+		/// @brief now() の 1 µs あたりのカウント
+		double ticksPerUs()
+		{
+#ifdef REVERSI_TRACE_RDTSC
+			// 開始からの時間が短いと誤差が大きいので、10 ms は空ける
+			const auto minEnd = StartTime + std::chrono::milliseconds(10);
+			if (std::chrono::steady_clock::now() < minEnd) std::this_thread::sleep_until(minEnd);
+			const uint64_t ticks = now() - StartTicks;
+			const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - StartTime).count();
+			return ticks / us;
+#else
+			return 1000.0;
+#endif
+		}
+	}
+
+	ThreadBuffer* acquireBuffer()
+	{
+		Registry& reg = registry();
+		std::lock_guard lock{ reg.mutex };
+		if (reg.freeBuffers.empty())
+		{
+			reg.buffers.push_back(std::make_unique<ThreadBuffer>());
+			reg.buffers.back()->id = static_cast<uint32_t>(reg.buffers.size());
+			reg.freeBuffers.push_back(reg.buffers.back().get());
+		}
+		t_buffer = t_owner.buffer = reg.freeBuffers.back();
+		reg.freeBuffers.pop_back();
+		return t_buffer;
+	}
+
+	bool dumpChromeTrace(const std::string& path)
+	{
+		std::ofstream ofs(path);
+		if (not ofs) return false;
+
+		const double scale = 1.0 / ticksPerUs();
+		Registry& reg = registry();
+		std::lock_guard lock{ reg.mutex };
+
+		// 最も古い区間を 0 にする
+		uint64_t origin = UINT64_MAX;
+		for (const auto& buffer : reg.buffers)
+		{
+			const uint64_t head = buffer->head.load(std::memory_order_acquire);
+			for (uint64_t i = head - std::min(head, ThreadBuffer::Capacity); i < head; ++i)
+			{
+				origin = std::min(origin, buffer->events[i & (ThreadBuffer::Capacity - 1)].begin);
+			}
+		}
+
+		ofs << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+		bool first = true;
+		for (const auto& buffer : reg.buffers)
+		{
+			const uint64_t head = buffer->head.load(std::memory_order_acquire);
+			for (uint64_t i = head - std::min(head, ThreadBuffer::Capacity); i < head; ++i)
+			{
+				const Event& e = buffer->events[i & (ThreadBuffer::Capacity - 1)];
+				ofs << (first ? "\n" : ",\n") << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+					<< ",\"ts\":" << (e.begin - origin) * scale << ",\"dur\":" << (e.end - e.begin) * scale << "}";
+				first = false;
+			}
+		}
+		ofs << "\n]}\n";
+		return static_cast<bool>(ofs);
+	}
+
+	void clear()
+	{
+		Registry& reg = registry();
+		std::lock_guard lock{ reg.mutex };
+		for (const auto& buffer : reg.buffers) buffer->head.store(0, std::memory_order_relaxed);
+	}
+#else
+	bool dumpChromeTrace(const std::string& path)
+	{
+		std::ofstream ofs(path);
+		ofs << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[]}\n";
+		return static_cast<bool>(ofs);
+	}
+
+	void clear()
+	{
+	}
+#endif
+}
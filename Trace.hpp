@@ -0,0 +1,108 @@
+﻿#pragma once
+# include <atomic>
+# include <cstdint>
+# include <memory>
+# include <string>
+
+// 探索の区間の計測 (トレース)
+// REVERSI_TRACE を定義してビルドすると、REVERSI_TRACE_ZONE("名前") を置いたスコープの開始と終了の時刻を
+// スレッドごとのリングバッファに記録し、dumpChromeTrace で Chrome trace の JSON に書き出せます
+// (chrome://tracing や https://ui.perfetto.dev で開けます)。
+// 定義しなければ REVERSI_TRACE_ZONE は何も生成しません。
+#if defined(REVERSI_TRACE) && (defined(__x86_64__) || defined(_M_X64))
+#ifdef _MSC_VER
+# include <intrin.h>
+#else
+# include <x86intrin.h>
+#endif
+#define REVERSI_TRACE_RDTSC
+#elif defined(REVERSI_TRACE)
+# include <chrono>
+#endif
+
+namespace Reversi::Trace
+{
+	/// @brief REVERSI_TRACE を定義してビルドしたか
+#ifdef REVERSI_TRACE
+	inline constexpr bool Enabled = true;
+#else
+	inline constexpr bool Enabled = false;
+#endif
+
+	/// @brief 全てのスレッドの記録を Chrome trace の JSON で書き出します
+	/// 記録中のスレッドがあると、書き出している間に上書きされた区間が混ざります。探索していない時に呼んでください
+	/// @return 書き出せたら true (REVERSI_TRACE を定義していなければ区間の無いファイルを書きます)
+	bool dumpChromeTrace(const std::string& path);
+
+	/// @brief 全てのスレッドの記録を消します (探索していない時に呼んでください)
+	void clear();
+
+#ifdef REVERSI_TRACE
+	/// @brief 時刻 (x86 では rdtsc のカウンタ、それ以外では ns)
+	inline uint64_t now()
+	{
+#ifdef REVERSI_TRACE_RDTSC
+		return __rdtsc();
+#else
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+	}
+
+	struct Event
+	{
+		const char* name;
+		uint64_t begin, end;
+	};
+
+	/// @brief 1 スレッドの区間のリングバッファ
+	/// 書くのは持ち主のスレッドだけなので、書き込みにロックは要りません。満杯になると古い区間から上書きします。
+	/// スレッドが終わると次に作られたスレッドが引き継ぎます (記録は残ります)。
+	struct ThreadBuffer
+	{
+		static constexpr uint64_t Capacity = 1 << 18;
+
+		std::unique_ptr<Event[]> events = std::make_unique<Event[]>(Capacity);
+		std::atomic<uint64_t> head = 0; // これまでに書いた区間の数
+		uint32_t id = 0; // trace の tid
+	};
+
+	/// @brief 呼び出したスレッドのバッファを割り当てます (スレッドごとに最初の 1 回だけ呼ばれます)
+	ThreadBuffer* acquireBuffer();
+
+	inline thread_local ThreadBuffer* t_buffer = nullptr;
+
+	/// @brief 区間を 1 つ記録します
+	inline void record(const char* name, uint64_t begin, uint64_t end)
+	{
+		ThreadBuffer* buffer = t_buffer ? t_buffer : acquireBuffer();
+		const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+		buffer->events[head & (ThreadBuffer::Capacity - 1)] = { name, begin, end };
+		buffer->head.store(head + 1, std::memory_order_release);
+	}
+
+	/// @brief スコープの開始から終了までを 1 つの区間として記録します
+	class Zone
+	{
+	public:
+		/// @param name 区間の名前 (文字列リテラルなど、書き出すまで生きている文字列)
+		explicit Zone(const char* name) : m_name(name), m_begin(now()) {}
+		~Zone() { record(m_name, m_begin, now()); }
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+		const char* m_name;
+		uint64_t m_begin;
+	};
+#endif
+}
+
+#ifdef REVERSI_TRACE
+#define REVERSI_TRACE_CONCAT_(a, b) a##b
+#define REVERSI_TRACE_CONCAT(a, b) REVERSI_TRACE_CONCAT_(a, b)
+#define REVERSI_TRACE_ZONE(name) const ::Reversi::Trace::Zone REVERSI_TRACE_CONCAT(traceZone_, __LINE__){ name }
+#else
+#define REVERSI_TRACE_ZONE(name) ((void)0)
+#endif
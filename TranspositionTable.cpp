@@ -0,0 +1,150 @@
+﻿# include "TranspositionTable.hpp"
+# include "Trace.hpp"
+# include <algorithm>
+# include <bit>
+# include <climits>
+
+namespace Reversi
+{
+	TranspositionTable::TranspositionTable(size_t sizeMB) :
+		m_mask(0), m_age(0)
+	{
+		resize(sizeMB);
+	}
+
+	void TranspositionTable::resize(size_t sizeMB)
+	{
+		const size_t buckets = std::bit_floor(std::max<size_t>(sizeMB * 1024 * 1024 / sizeof(Bucket), 1));
+		m_buckets = std::make_unique<Bucket[]>(buckets);
+		m_mask = buckets - 1;
+		m_age = 0;
+	}
+
+	void TranspositionTable::clear()
+	{
+		for (size_t i = 0; i <= m_mask; ++i)
+		{
+			for (auto& slot : m_buckets[i].slots)
+			{
+				slot.check.store(0, std::memory_order_relaxed);
+				slot.data.store(0, std::memory_order_relaxed);
+			}
+		}
+		m_age = 0;
+	}
+
+	void TranspositionTable::newSearch()
+	{
+		++m_age;
+	}
+
+	bool TranspositionTable::probe(uint64_t key, TTEntry& entry) const
+	{
+		REVERSI_TRACE_ZONE("tt.probe");
+		const Bucket& bucket = m_buckets[key & m_mask];
+		for (const auto& slot : bucket.slots)
+		{
+			const uint64_t data = slot.data.load(std::memory_order_relaxed);
+			const uint64_t check = slot.check.load(std::memory_order_relaxed);
+			if (data != 0 and (check ^ data) == key)
+			{
+				entry = unpack(data);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool TranspositionTable::store(uint64_t key, int32_t score, int32_t depth, Bound bound, uint64_t bestMove)
+	{
+		REVERSI_TRACE_ZONE("tt.store");
+		TTEntry entry{
+			static_cast<int16_t>(std::clamp(score, -SHRT_MAX, static_cast<int32_t>(SHRT_MAX))),
+			static_cast<int8_t>(std::clamp(depth, 0, static_cast<int32_t>(SCHAR_MAX))),
+			bound,
+			bestMove ? static_cast<uint8_t>(std::countr_zero(bestMove)) : TTEntry::NoMove,
+			m_age,
+		};
+
+		Bucket& bucket = m_buckets[key & m_mask];
+		Slot* victim = nullptr;
+		int32_t victimValue = INT_MAX;
+		bool sameKey = false;
+
+		for (auto& slot : bucket.slots)
+		{
+			const uint64_t data = slot.data.load(std::memory_order_relaxed);
+			const uint64_t check = slot.check.load(std::memory_order_relaxed);
+
+			if (data == 0)
+			{
+				// 空きは同じ局面のエントリが無いときだけ使う
+				if (victimValue != INT_MIN)
+				{
+					victim = &slot;
+					victimValue = INT_MIN;
+				}
+				continue;
+			}
+
+			const TTEntry old = unpack(data);
+			if ((check ^ data) == key)
+			{
+				// 同じ探索で得た、ずっと深い結果は浅い境界値で上書きしない
+				if (old.age == m_age and old.depth > entry.depth + 2 and bound != Bound::Exact) return false;
+				if (entry.bestMove == TTEntry::NoMove) entry.bestMove = old.bestMove;
+				victim = &slot;
+				sameKey = true;
+				break;
+			}
+
+			// 浅いものと古い探索のものから置き換える
+			const int32_t value = old.depth - 8 * static_cast<uint8_t>(m_age - old.age);
+			if (value < victimValue)
+			{
+				victim = &slot;
+				victimValue = value;
+			}
+		}
+
+		const uint64_t data = pack(entry);
+		victim->data.store(data, std::memory_order_relaxed);
+		victim->check.store(key ^ data, std::memory_order_relaxed);
+		return not sameKey and victimValue != INT_MIN;
+	}
+
+	int32_t TranspositionTable::hashfull() const
+	{
+		const size_t buckets = std::min<size_t>(m_mask + 1, 250);
+		int32_t used = 0;
+		for (size_t i = 0; i < buckets; ++i)
+		{
+			for (const auto& slot : m_buckets[i].slots)
+			{
+				const uint64_t data = slot.data.load(std::memory_order_relaxed);
+				if (data != 0 and unpack(data).age == m_age) used++;
+			}
+		}
+		return static_cast<int32_t>(used * 1000 / (buckets * BucketSize));
+	}
+
+	uint64_t TranspositionTable::pack(const TTEntry& entry)
+	{
+		return static_cast<uint64_t>(static_cast<uint16_t>(entry.score))
+			| static_cast<uint64_t>(static_cast<uint8_t>(entry.depth)) << 16
+			| static_cast<uint64_t>(entry.bound) << 24
+			| static_cast<uint64_t>(entry.bestMove) << 26
+			| static_cast<uint64_t>(entry.age) << 33;
+	}
+
+	TTEntry TranspositionTable::unpack(uint64_t data)
+	{
+		return {
+			static_cast<int16_t>(static_cast<uint16_t>(data)),
+			static_cast<int8_t>(static_cast<uint8_t>(data >> 16)),
+			static_cast<Bound>((data >> 24) & 3),
+			static_cast<uint8_t>((data >> 26) & 127),
+			static_cast<uint8_t>(data >> 33),
+		};
+	}
+}
@@ -0,0 +1,93 @@
+﻿#pragma once
+# include <cstdint>
+# include <cstddef>
+# include <atomic>
+# include <memory>
+
+namespace Reversi
+{
+	/// @brief 置換表に保存した評価値の種類
+	enum class Bound : uint8_t
+	{
+		None = 0,
+		Exact = 1, // 真の値
+		Lower = 2, // 真の値はこれ以上 (beta カット)
+		Upper = 3, // 真の値はこれ以下 (全ての手が alpha 以下)
+	};
+
+	/// @brief 置換表から読み出したエントリ
+	struct TTEntry
+	{
+		int16_t score;
+		int8_t depth;
+		Bound bound;
+		uint8_t bestMove; // 最善手のビット番号。NoMove なら無し
+		uint8_t age;
+
+		static constexpr uint8_t NoMove = 64;
+	};
+
+	/// @brief 固定サイズの置換表
+	/// 1 バケット (64 バイト) に 4 エントリを持ちます。
+	/// エントリはキーとデータの排他的論理和で検査するので、ロックなしで複数スレッドから読み書きできます。
+	class TranspositionTable
+	{
+	public:
+		/// @param sizeMB 使うメモリの上限 (MB)。バケット数は 2 の冪に切り下げます
+		explicit TranspositionTable(size_t sizeMB = 16);
+
+		/// @brief 大きさを変えて中身を消します
+		void resize(size_t sizeMB);
+
+		/// @brief 中身を消します
+		void clear();
+
+		/// @brief 新しい探索を始めます。古い探索のエントリは置き換えられやすくなります
+		void newSearch();
+
+		/// @brief 局面のエントリを探します
+		/// @param key 局面のハッシュ
+		/// @param entry 見つかったエントリ
+		/// @return 見つかれば true
+		bool probe(uint64_t key, TTEntry& entry) const;
+
+		/// @brief 局面のエントリを保存します
+		/// @param key 局面のハッシュ
+		/// @param score 評価値
+		/// @param depth 残り深さ
+		/// @param bound 評価値の種類
+		/// @param bestMove 最善手のビット。0 なら無し
+		/// @return 別の局面のエントリを追い出して書いたら true
+		bool store(uint64_t key, int32_t score, int32_t depth, Bound bound, uint64_t bestMove);
+
+		/// @brief 現在の探索の世代
+		uint8_t age() const { return m_age; }
+
+		/// @brief 保存できるエントリ数
+		size_t capacity() const { return (m_mask + 1) * BucketSize; }
+
+		/// @brief 現在の世代のエントリが占める割合 (‰)。先頭 1000 バケット弱から見積もります
+		int32_t hashfull() const;
+
+	private:
+		static constexpr size_t BucketSize = 4;
+
+		struct Slot
+		{
+			std::atomic<uint64_t> check; // key ^ data
+			std::atomic<uint64_t> data;
+		};
+
+		struct alignas(64) Bucket
+		{
+			Slot slots[BucketSize];
+		};
+
+		std::unique_ptr<Bucket[]> m_buckets;
+		size_t m_mask;
+		uint8_t m_age;
+
+		static uint64_t pack(const TTEntry& entry);
+		static TTEntry unpack(uint64_t data);
+	};
+}
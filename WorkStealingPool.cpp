@@ -0,0 +1,86 @@
+﻿# include "WorkStealingPool.hpp"
+
+namespace Reversi
+{
+	thread_local int32_t WorkStealingPool::t_worker = 0;
+
+	WorkStealingPool::WorkStealingPool(int32_t threads)
+	{
+		const int32_t n = threads < 1 ? 1 : threads;
+		for (int32_t i = 0; i < n; ++i)
+		{
+			m_queues.push_back(std::make_unique<Queue>());
+		}
+		for (int32_t i = 1; i < n; ++i)
+		{
+			m_threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+		}
+	}
+
+	WorkStealingPool::~WorkStealingPool()
+	{
+		m_quit = true;
+		for (auto& thread : m_threads) thread.join();
+	}
+
+	void WorkStealingPool::push(Task task)
+	{
+		Queue& queue = *m_queues[t_worker];
+		std::lock_guard lock{ queue.mutex };
+		queue.tasks.push_back(std::move(task));
+	}
+
+	bool WorkStealingPool::runOne()
+	{
+		Task task;
+		if (pop(t_worker, task) or steal(t_worker, task))
+		{
+			task();
+			return true;
+		}
+		return false;
+	}
+
+	void WorkStealingPool::wait(const std::atomic<int32_t>& counter)
+	{
+		while (counter.load(std::memory_order_acquire) > 0)
+		{
+			if (not runOne()) std::this_thread::yield();
+		}
+	}
+
+	bool WorkStealingPool::pop(int32_t worker, Task& task)
+	{
+		Queue& queue = *m_queues[worker];
+		std::lock_guard lock{ queue.mutex };
+		if (queue.tasks.empty()) return false;
+		task = std::move(queue.tasks.back());
+		queue.tasks.pop_back();
+		return true;
+	}
+
+	bool WorkStealingPool::steal(int32_t thief, Task& task)
+	{
+		// 盗む相手は自分の次の番号から順に見る (偏りを減らすため)
+		const int32_t n = size();
+		for (int32_t k = 1; k < n; ++k)
+		{
+			Queue& queue = *m_queues[(thief + k) % n];
+			std::lock_guard lock{ queue.mutex };
+			if (queue.tasks.empty()) continue;
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			return true;
+		}
+		return false;
+	}
+
+	void WorkStealingPool::workerLoop(int32_t worker)
+	{
+		t_worker = worker;
+		while (not m_quit.load(std::memory_order_relaxed))
+		{
+			if (not runOne()) std::this_thread::yield();
+		}
+	}
+}
@@ -0,0 +1,62 @@
+﻿#pragma once
+# include <cstdint>
+# include <atomic>
+# include <deque>
+# include <functional>
+# include <memory>
+# include <mutex>
+# include <thread>
+# include <vector>
+
+namespace Reversi
+{
+	/// @brief 作業を盗み合うスレッドプール
+	/// スレッドごとに両端キューを持ち、自分のキューには末尾から積んで末尾から取り出し、
+	/// 空いたスレッドは他のキューの先頭 (積まれたのが古い方) から盗みます。
+	/// プールを作ったスレッドも番号 0 の作業者として wait の間に作業を実行します。
+	class WorkStealingPool
+	{
+	public:
+		using Task = std::function<void()>;
+
+		/// @param threads 作業者の数 (作ったスレッドを含む)。補助スレッドは threads - 1 個作ります
+		explicit WorkStealingPool(int32_t threads);
+
+		/// @brief 補助スレッドを止めて待ちます。積まれたまま実行されていない作業は捨てます
+		~WorkStealingPool();
+
+		WorkStealingPool(const WorkStealingPool&) = delete;
+		WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+		/// @brief 作業者の数
+		int32_t size() const { return static_cast<int32_t>(m_queues.size()); }
+
+		/// @brief 呼び出したスレッドの作業者番号のキューの末尾に作業を積みます
+		void push(Task task);
+
+		/// @brief 自分のキューの末尾か、他のキューの先頭から作業を 1 つ取って実行します
+		/// @return 実行したら true
+		bool runOne();
+
+		/// @brief counter が 0 になるまで、他の作業を手伝いながら待ちます
+		void wait(const std::atomic<int32_t>& counter);
+
+	private:
+		struct alignas(64) Queue
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		std::vector<std::thread> m_threads;
+		std::atomic<bool> m_quit = false;
+
+		/// @brief 呼び出したスレッドの作業者番号 (プール外のスレッドは 0)
+		static thread_local int32_t t_worker;
+
+		bool pop(int32_t worker, Task& task);
+		bool steal(int32_t thief, Task& task);
+		void workerLoop(int32_t worker);
+	};
+}
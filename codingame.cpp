@@ -7,6 +7,7 @@
 #pragma GCC target("movbe")                                      // byte swap
 #pragma GCC target("aes,pclmul,rdrnd")                           // encryption
 #pragma GCC target("avx,avx2,f16c,fma,sse3,ssse3,sse4.1,sse4.2") // SIMD
+#define REVERSI_SIMD_AVX2 // #pragma GCC target では __AVX2__ が定義されないため
 
 #include <iostream>
 #include <string>
@@ -16,6 +17,8 @@
 #include <bit>
 #include "ReversiEngine.hpp"
 #include "ReversiAgents/AlphaBetaAgent.hpp"
+#include "ReversiEval/WeightFormat.hpp"
+#include "ReversiEval/EmbeddedWeights.hpp"
 
 using namespace std;
 
@@ -28,8 +31,14 @@ int main()
 
 	assert(board_size == 8);
 
+	// ファイルを読めないので、埋め込んだ重みがあればそれを使う
+	Reversi::Eval::loadEmbeddedWeights(Reversi::Eval::EmbeddedWeights, Reversi::Eval::defaultPatternEvaluator());
+
 	AlphaBetaAgent agent;
 	Reversi::ReversiEngine engine;
+	// 制限時間は 1 手目が 1000 ms、以降は 150 ms。入出力の分だけ余裕を残す
+	agent.setSearchDepth(60);
+	agent.setTimeControl({ 900, 0, 0 });
 
 	// game loop
 	while (1) {
@@ -55,5 +64,6 @@ int main()
 		auto action = agent.play(engine);
 
 		cout << char('a' + action.first) << char('1' + action.second) << endl;
+		agent.setTimeControl({ 130, 0, 0 });
 	}
 }
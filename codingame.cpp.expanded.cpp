@@ -10,56 +10,112 @@
 # include <algorithm>
 # include <assert.h>
 # include <bit>
-# include <bitset>
-# include <unordered_map>
+# include <cstdint>
+# include <array>
+# include <tuple>
+# include <string_view>
+# include <atomic>
+# include <utility>
+# include <memory>
+# include <chrono>
+# include <fstream>
+# include <mutex>
+# include <thread>
+# include <cstddef>
+# include <functional>
+# include <climits>
+# include <span>
+# include <cmath>
+# include <cstring>
+# include <random>
 // optim pragmas
 // https://www.codingame.com/playgrounds/58302/using-pragma-for-compile-optimization
 
+#define REVERSI_SIMD_AVX2 // #pragma GCC target では __AVX2__ が定義されないため
 
 
+// getLegals の SIMD 実装の選択
+// コンパイラが AVX2 / AVX-512 を有効にしていれば自動で使います。
+// #pragma GCC target で有効にした場合は __AVX2__ が定義されないので REVERSI_SIMD_AVX2 を定義してください。
+// REVERSI_NO_SIMD を定義するとスカラー実装に固定します。
+#if !defined(REVERSI_NO_SIMD)
+#if defined(__AVX512F__) && !defined(REVERSI_SIMD_AVX512)
+#define REVERSI_SIMD_AVX512
+#endif
+#if (defined(__AVX2__) || defined(REVERSI_SIMD_AVX512)) && !defined(REVERSI_SIMD_AVX2)
+#define REVERSI_SIMD_AVX2
+#endif
+#endif
+
 namespace Reversi
 {
-	struct TupleHash {
-		std::size_t operator()(const std::tuple<uint64_t, uint64_t, bool>& t) const noexcept {
-			uint64_t a, b;
-			bool c;
-			std::tie(a, b, c) = t;
-
-			// 高速で分布の良いハッシュ関数（SplitMix64ベース）
-			auto hash64 = [](uint64_t x) {
+	namespace Zobrist
+	{
+		/// @brief SplitMix64 で乱数表を作ります
+		constexpr std::array<uint64_t, 129> makeTable()
+		{
+			std::array<uint64_t, 129> res{};
+			uint64_t x = 0x2545F4914F6CDD1D;
+			for (auto& v : res)
+			{
 				x += 0x9e3779b97f4a7c15;
-				x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
-				x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
-				return x ^ (x >> 31);
-				};
+				uint64_t z = x;
+				z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+				z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+				v = z ^ (z >> 31);
+			}
+			return res;
+		}
 
-			uint64_t h1 = hash64(a);
-			uint64_t h2 = hash64(b);
-			uint64_t h3 = hash64(static_cast<uint64_t>(c));
+		inline constexpr std::array<uint64_t, 129> Table = makeTable();
 
-			// ハッシュ値を混合する（rotate xor加算など）
-			uint64_t combined = h1;
-			combined ^= (h2 << 1) | (h2 >> 63);
-			combined ^= (h3 << 2) | (h3 >> 62);
+		/// @brief ビット番号 sq に黒石があるときのキー
+		constexpr uint64_t black(int32_t sq) { return Table[sq]; }
 
-			return static_cast<std::size_t>(combined);
-		}
-	};
+		/// @brief ビット番号 sq に白石があるときのキー
+		constexpr uint64_t white(int32_t sq) { return Table[64 + sq]; }
+
+		/// @brief 白番のときのキー
+		constexpr uint64_t WhiteTurn = Table[128];
+	}
 
 	class ReversiEngine
 	{
+	public:
+		/// @brief 着手の記録。bit が 0 の手はパスを表します
+		struct Move
+		{
+			uint64_t bit;
+			uint64_t flips;
+		};
+
 	private:
 		uint64_t m_blacks, m_whites;
 		bool m_blackTurn;
 
+		/// @brief 局面の Zobrist ハッシュ (着手ごとに差分更新する)
+		uint64_t m_hash;
+
+		/// @brief 裏返った石のキーを m_hash に反映します
+		inline void hashFlips(uint64_t flips)
+		{
+			while (flips)
+			{
+				const int32_t sq = std::countr_zero(flips);
+				m_hash ^= Zobrist::black(sq) ^ Zobrist::white(sq);
+				flips &= flips - 1;
+			}
+		}
+
+		/// @brief 盤面から m_hash を計算し直します
+		void recomputeHash();
+
 		/// @brief 二次元座標をビットに変換します
 		/// @param x 左から何番目か
 		/// @param y 上から何番目か
 		/// @return ビッドボードでのマスク
 		uint64_t pos2bit(uint32_t x, uint32_t y) const;
 
-		uint64_t transfer(uint64_t put, uint32_t dir) const;
-
 	public:
 		ReversiEngine();
 
@@ -69,6 +125,56 @@ namespace Reversi
 
 		bool place(uint32_t x, uint32_t y);
 
+		/// @brief 合法であることが分かっている手を検査なしで打ちます
+		/// @param bit 打つマスのビット
+		void placeUnchecked(uint64_t bit);
+
+		/// @brief 手番側がマスに打ったときに裏返る石を求めます
+		/// @param bit 打つマスのビット (空きマスであること)
+		/// @return 裏返る石のマスク。0 なら非合法手
+		uint64_t getFlips(uint64_t bit) const;
+
+		/// @brief 手番側がマスに打つ着手を作ります
+		/// @param bit 打つマスのビット (合法手であること)
+		inline Move makeMove(uint64_t bit) const
+		{
+			return { bit, getFlips(bit) };
+		}
+
+		/// @brief 着手を適用して手番を交代します
+		inline void doMove(const Move& move)
+		{
+			uint64_t& playerBoard = m_blackTurn ? m_blacks : m_whites;
+			uint64_t& oppBoard = m_blackTurn ? m_whites : m_blacks;
+			playerBoard ^= move.bit | move.flips;
+			oppBoard ^= move.flips;
+			if (move.bit)
+			{
+				const int32_t sq = std::countr_zero(move.bit);
+				m_hash ^= m_blackTurn ? Zobrist::black(sq) : Zobrist::white(sq);
+			}
+			hashFlips(move.flips);
+			m_hash ^= Zobrist::WhiteTurn;
+			m_blackTurn = !m_blackTurn;
+		}
+
+		/// @brief doMove で適用した着手を取り消します
+		inline void undoMove(const Move& move)
+		{
+			m_blackTurn = !m_blackTurn;
+			uint64_t& playerBoard = m_blackTurn ? m_blacks : m_whites;
+			uint64_t& oppBoard = m_blackTurn ? m_whites : m_blacks;
+			playerBoard ^= move.bit | move.flips;
+			oppBoard ^= move.flips;
+			if (move.bit)
+			{
+				const int32_t sq = std::countr_zero(move.bit);
+				m_hash ^= m_blackTurn ? Zobrist::black(sq) : Zobrist::white(sq);
+			}
+			hashFlips(move.flips);
+			m_hash ^= Zobrist::WhiteTurn;
+		}
+
 		void getBoard(std::vector<int32_t>& board) const;
 
 		void pass();
@@ -93,17 +199,143 @@ namespace Reversi
 		{
 			return { m_blacks, m_whites, m_blackTurn };
 		}
+
+		/// @brief 局面の Zobrist ハッシュ (手番を含む)
+		inline uint64_t getHash() const
+		{
+			return m_hash;
+		}
 	};
 
 	void bit2boad(const uint64_t& bit, std::vector<int32_t>& board);
 
+	/// @brief 盤面文字列を読み込みます
+	/// @param str 左上から 1 行ずつ 64 文字 (黒 X, 白 O, 空き -) と、空白を挟んで手番 (X / O)
+	/// @param engine 読み込んだ局面を設定するエンジン
+	/// @return 書式が正しければ true
+	bool parseBoard(std::string_view str, ReversiEngine& engine);
+
+	/// @brief 局面を parseBoard で読める盤面文字列にします
+	std::string toBoardString(const ReversiEngine& engine);
+
+	/// @brief 手番側がマスに打ったときに裏返る石を求めます
+	/// @param playerBoard 手番側の石
+	/// @param oppBoard 相手の石
+	/// @param sq 打つマスのビット番号 (空きマスであること)
+	/// @return 裏返る石のマスク。0 なら非合法手
+	uint64_t calcFlips(uint64_t playerBoard, uint64_t oppBoard, int32_t sq);
+
+	/// @brief 合法手を求めます (ビルドで有効な最速の実装)
+	/// @param playerBoard 手番側の石
+	/// @param oppBoard 相手の石
+	/// @return 合法手のマスク
+	uint64_t calcLegals(uint64_t playerBoard, uint64_t oppBoard);
+
+	/// @brief 8 方向を 1 方向ずつ調べる合法手生成
+	uint64_t calcLegalsScalar(uint64_t playerBoard, uint64_t oppBoard);
+
+#ifdef REVERSI_SIMD_AVX2
+	/// @brief 4 方向を 1 本の __m256i にまとめ、左右 2 回のシフトで調べる合法手生成
+	uint64_t calcLegalsAVX2(uint64_t playerBoard, uint64_t oppBoard);
+#endif
+
+#ifdef REVERSI_SIMD_AVX512
+	/// @brief 8 方向を 1 本の __m512i にまとめ、ローテートで一度に調べる合法手生成
+	uint64_t calcLegalsAVX512(uint64_t playerBoard, uint64_t oppBoard);
+#endif
+
+};
+
+
+/// @brief 探索しながら数える値
+/// スレッドや作業ごとに持って数え、最後に足し合わせます。
+struct SearchCounters
+{
+	int64_t nodes = 0; // 探索したノード数
+	int64_t ttProbes = 0; // 置換表を引いた回数 (手の並べ替えのためのものは除く)
+	int64_t ttHits = 0; // そのうち見つかった回数
+	int64_t ttStores = 0; // 置換表に書いた回数
+	int64_t ttCollisions = 0; // そのうち別の局面のエントリを追い出した回数
+	int64_t cutNodes = 0; // beta カットしたノード数
+	int64_t firstMoveCuts = 0; // そのうち最初に読んだ手でカットしたもの
+
+	SearchCounters& operator+=(const SearchCounters& other)
+	{
+		nodes += other.nodes;
+		ttProbes += other.ttProbes;
+		ttHits += other.ttHits;
+		ttStores += other.ttStores;
+		ttCollisions += other.ttCollisions;
+		cutNodes += other.cutNodes;
+		firstMoveCuts += other.firstMoveCuts;
+		return *this;
+	}
+};
+
+/// @brief 反復深化の 1 回の反復の結果
+struct IterationStats
+{
+	int32_t depth;
+	int32_t score; // ルートの評価値
+	int64_t nodes; // この反復の終わりまでのノード数の合計
+	int64_t timeUs; // 探索開始からこの反復の終わりまでの時間 (µs)
 };
 
+/// @brief 1 回の play の探索の統計
+struct SearchStats : SearchCounters
+{
+	int32_t depth = 0; // 最後まで読み終えた深さ (完全読みなら空きマス数)
+	int64_t timeUs = 0; // play にかかった時間 (µs)
+	std::vector<IterationStats> iterations; // 読み終えた反復 (反復深化しないエージェントでは 1 つか空)
+
+	/// @brief 1 秒あたりのノード数
+	double nps() const { return timeUs > 0 ? nodes * 1e6 / timeUs : 0.0; }
+
+	/// @brief 置換表を引いて見つかった割合
+	double ttHitRate() const { return ratio(ttHits, ttProbes); }
+
+	/// @brief 置換表に書いたときに別の局面を追い出した割合
+	double ttCollisionRate() const { return ratio(ttCollisions, ttStores); }
+
+	/// @brief beta カットのうち最初に読んだ手でカットした割合 (手の並べ替えの良さ)
+	double firstMoveCutRate() const { return ratio(firstMoveCuts, cutNodes); }
+
+	/// @brief 実効分岐数 (最後の反復のノード数 / その前の反復のノード数)。反復が 2 つ無ければ 0
+	double branchingFactor() const
+	{
+		const size_t n = iterations.size();
+		if (n < 2) return 0.0;
+		const int64_t last = iterations[n - 1].nodes - iterations[n - 2].nodes;
+		const int64_t prev = iterations[n - 2].nodes - (n >= 3 ? iterations[n - 3].nodes : 0);
+		return ratio(last, prev);
+	}
+
+private:
+	static double ratio(int64_t a, int64_t b) { return b > 0 ? static_cast<double>(a) / b : 0.0; }
+};
 
 class ReversiAgent
 {
+public:
+	/// @brief 持ち時間の設定。0 の項目は指定なしとして扱います
+	struct TimeControl
+	{
+		int32_t moveTimeMs = 0; // 1 手に使える時間
+		int32_t remainingMs = 0; // 持ち時間の残り
+		int32_t incrementMs = 0; // 1 手ごとに加算される時間
+	};
+
+	/// @brief 1 手に使う時間の目安
+	struct TimeBudget
+	{
+		int32_t softMs; // これを過ぎたら次の反復を始めない
+		int32_t hardMs; // これを過ぎたら探索を打ち切る
+	};
+
 private:
-	bool m_abort;
+	std::atomic<bool> m_abort;
+	TimeControl m_timeControl;
+
 public:
 	using Pos = std::pair<int32_t, int32_t>;
 
@@ -122,13 +354,199 @@ public:
 	{
 		m_abort = true;
 	}
+
+	void setTimeControl(const TimeControl& timeControl)
+	{
+		m_timeControl = timeControl;
+	}
+
+	const TimeControl& getTimeControl() const
+	{
+		return m_timeControl;
+	}
+
+	/// @brief 直前の play の探索の統計 (play の最中に読んではいけません)
+	const SearchStats& getSearchStats() const
+	{
+		return m_searchStats;
+	}
 protected:
 	const int32_t inf = 1000000;
-	bool isAborted() { return m_abort; }
+
+	/// @brief play の中で書き込む探索の統計
+	SearchStats m_searchStats;
+	bool isAborted() const { return m_abort.load(std::memory_order_relaxed); }
+
+	/// @brief 持ち時間の設定からこの手に使う時間を決めます
+	/// @param empties 空きマスの数 (残りの手数の見積もりに使う)
+	/// @return 時間の指定が無ければ両方とも負の値
+	TimeBudget getTimeBudget(int32_t empties) const
+	{
+		const TimeControl& tc = m_timeControl;
+		int32_t hard = -1;
+
+		if (tc.remainingMs > 0)
+		{
+			// 自分の残り手数で均等に割り、加算分はほぼ使い切る
+			const int32_t movesLeft = std::max((empties + 1) / 2, 4);
+			const int32_t share = tc.remainingMs / movesLeft + tc.incrementMs * 3 / 4;
+			hard = std::min(share * 2, tc.remainingMs / 3);
+		}
+		if (tc.moveTimeMs > 0)
+		{
+			hard = hard < 0 ? tc.moveTimeMs : std::min(hard, tc.moveTimeMs);
+		}
+
+		if (hard < 0) return { -1, -1 };
+		hard = std::max(hard, 1);
+		// 次の反復は今までの合計より長くかかるので、半分を過ぎたら始めない
+		return { hard / 2, hard };
+	}
+
+	/// @brief マスのビットを座標に変換します
+	static Pos bit2pos(uint64_t bit)
+	{
+		const int32_t idx = 63 - std::countr_zero(bit);
+		return { idx & 7, idx >> 3 };
+	}
 };
 
+// 探索の区間の計測 (トレース)
+// REVERSI_TRACE を定義してビルドすると、REVERSI_TRACE_ZONE("名前") を置いたスコープの開始と終了の時刻を
+// スレッドごとのリングバッファに記録し、dumpChromeTrace で Chrome trace の JSON に書き出せます
+// (chrome://tracing や https://ui.perfetto.dev で開けます)。
+// 定義しなければ REVERSI_TRACE_ZONE は何も生成しません。
+#if defined(REVERSI_TRACE) && (defined(__x86_64__) || defined(_M_X64))
+#ifdef _MSC_VER
+# include <intrin.h>
+#else
+# include <x86intrin.h>
+#endif
+#define REVERSI_TRACE_RDTSC
+#elif defined(REVERSI_TRACE)
+# include <chrono>
+#endif
+
+namespace Reversi::Trace
+{
+	/// @brief REVERSI_TRACE を定義してビルドしたか
+#ifdef REVERSI_TRACE
+	inline constexpr bool Enabled = true;
+#else
+	inline constexpr bool Enabled = false;
+#endif
+
+	/// @brief 全てのスレッドの記録を Chrome trace の JSON で書き出します
+	/// 記録中のスレッドがあると、書き出している間に上書きされた区間が混ざります。探索していない時に呼んでください
+	/// @return 書き出せたら true (REVERSI_TRACE を定義していなければ区間の無いファイルを書きます)
+	bool dumpChromeTrace(const std::string& path);
+
+	/// @brief 全てのスレッドの記録を消します (探索していない時に呼んでください)
+	void clear();
+
+#ifdef REVERSI_TRACE
+	/// @brief 時刻 (x86 では rdtsc のカウンタ、それ以外では ns)
+	inline uint64_t now()
+	{
+#ifdef REVERSI_TRACE_RDTSC
+		return __rdtsc();
+#else
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+	}
+
+	struct Event
+	{
+		const char* name;
+		uint64_t begin, end;
+	};
+
+	/// @brief 1 スレッドの区間のリングバッファ
+	/// 書くのは持ち主のスレッドだけなので、書き込みにロックは要りません。満杯になると古い区間から上書きします。
+	/// スレッドが終わると次に作られたスレッドが引き継ぎます (記録は残ります)。
+	struct ThreadBuffer
+	{
+		static constexpr uint64_t Capacity = 1 << 18;
+
+		std::unique_ptr<Event[]> events = std::make_unique<Event[]>(Capacity);
+		std::atomic<uint64_t> head = 0; // これまでに書いた区間の数
+		uint32_t id = 0; // trace の tid
+	};
+
+	/// @brief 呼び出したスレッドのバッファを割り当てます (スレッドごとに最初の 1 回だけ呼ばれます)
+	ThreadBuffer* acquireBuffer();
+
+	inline thread_local ThreadBuffer* t_buffer = nullptr;
+
+	/// @brief 区間を 1 つ記録します
+	inline void record(const char* name, uint64_t begin, uint64_t end)
+	{
+		ThreadBuffer* buffer = t_buffer ? t_buffer : acquireBuffer();
+		const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+		buffer->events[head & (ThreadBuffer::Capacity - 1)] = { name, begin, end };
+		buffer->head.store(head + 1, std::memory_order_release);
+	}
+
+	/// @brief スコープの開始から終了までを 1 つの区間として記録します
+	class Zone
+	{
+	public:
+		/// @param name 区間の名前 (文字列リテラルなど、書き出すまで生きている文字列)
+		explicit Zone(const char* name) : m_name(name), m_begin(now()) {}
+		~Zone() { record(m_name, m_begin, now()); }
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+		const char* m_name;
+		uint64_t m_begin;
+	};
+#endif
+}
+
+#ifdef REVERSI_TRACE
+#define REVERSI_TRACE_CONCAT_(a, b) a##b
+#define REVERSI_TRACE_CONCAT(a, b) REVERSI_TRACE_CONCAT_(a, b)
+#define REVERSI_TRACE_ZONE(name) const ::Reversi::Trace::Zone REVERSI_TRACE_CONCAT(traceZone_, __LINE__){ name }
+#else
+#define REVERSI_TRACE_ZONE(name) ((void)0)
+#endif
+#ifdef REVERSI_SIMD_AVX2
+# include <immintrin.h>
+#endif
+
 namespace Reversi
 {
+	namespace
+	{
+		/// @brief 各マスから 8 方向へ伸びる直線 (自マスを含まない) のマスクを作ります
+		/// @return [ビット番号][方向] のマスク。方向 0-3 は上位ビット向き、4-7 は下位ビット向き
+		constexpr std::array<std::array<uint64_t, 8>, 64> makeLineMasks()
+		{
+			constexpr int32_t dx[8] = { -1, 0, 1, -1, 1, 0, -1, 1 };
+			constexpr int32_t dy[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+			std::array<std::array<uint64_t, 8>, 64> res{};
+			for (int32_t bit = 0; bit < 64; ++bit)
+			{
+				const int32_t x = (63 - bit) & 7, y = (63 - bit) >> 3;
+				for (int32_t dir = 0; dir < 8; ++dir)
+				{
+					int32_t cx = x + dx[dir], cy = y + dy[dir];
+					while (0 <= cx and cx < 8 and 0 <= cy and cy < 8)
+					{
+						res[bit][dir] |= 0x8000000000000000ull >> (cx + (cy << 3));
+						cx += dx[dir];
+						cy += dy[dir];
+					}
+				}
+			}
+			return res;
+		}
+
+		constexpr auto LineMasks = makeLineMasks();
+	}
 
 	uint64_t ReversiEngine::pos2bit(uint32_t x, uint32_t y) const
 	{
@@ -139,8 +557,15 @@ namespace Reversi
 	}
 
 	ReversiEngine::ReversiEngine() :
-		m_blacks(0), m_whites(0), m_blackTurn(true)
+		m_blacks(0), m_whites(0), m_blackTurn(true), m_hash(0)
+	{
+	}
+
+	void ReversiEngine::recomputeHash()
 	{
+		m_hash = m_blackTurn ? 0 : Zobrist::WhiteTurn;
+		for (uint64_t b = m_blacks; b; b &= b - 1) m_hash ^= Zobrist::black(std::countr_zero(b));
+		for (uint64_t w = m_whites; w; w &= w - 1) m_hash ^= Zobrist::white(std::countr_zero(w));
 	}
 
 	void ReversiEngine::reset()
@@ -148,16 +573,15 @@ namespace Reversi
 		m_blacks = pos2bit(4, 3) | pos2bit(3, 4);
 		m_whites = pos2bit(3, 3) | pos2bit(4, 4);
 		m_blackTurn = true;
+		recomputeHash();
 	}
 
-	uint64_t ReversiEngine::getLegals(bool inverseTurn) const
+	uint64_t calcLegalsScalar(uint64_t playerBoard, uint64_t oppBoard)
 	{
-		const uint64_t& playerBoard = (m_blackTurn ^ inverseTurn) ? m_blacks : m_whites;
-		const uint64_t& oppBoard = (m_blackTurn ^ inverseTurn) ? m_whites : m_blacks;
 		const uint64_t hMask = 0x7e7e7e7e7e7e7e7e & oppBoard;
 		const uint64_t vMask = 0x00FFFFFFFFFFFF00 & oppBoard;
 		const uint64_t edgeMask = 0x007e7e7e7e7e7e00 & oppBoard;
-		const uint64_t blank = ~(m_blacks | m_whites);
+		const uint64_t blank = ~(playerBoard | oppBoard);
 
 		uint64_t tmp = 0, legals = 0;
 
@@ -228,57 +652,122 @@ namespace Reversi
 		return legals;
 	}
 
-	bool ReversiEngine::place(uint32_t x, uint32_t y)
+#ifdef REVERSI_SIMD_AVX2
+	uint64_t calcLegalsAVX2(uint64_t playerBoard, uint64_t oppBoard)
+	{
+		// レーンごとに 横 / 縦 / 斜め / 斜め の方向を担当する
+		const __m256i shift = _mm256_set_epi64x(9, 7, 8, 1);
+		const __m256i player = _mm256_set1_epi64x(static_cast<int64_t>(playerBoard));
+		const __m256i mask = _mm256_and_si256(_mm256_set1_epi64x(static_cast<int64_t>(oppBoard)),
+			_mm256_set_epi64x(0x007e7e7e7e7e7e00, 0x007e7e7e7e7e7e00, 0x00FFFFFFFFFFFF00, 0x7e7e7e7e7e7e7e7e));
+
+		__m256i l, r;
+
+		l = _mm256_and_si256(mask, _mm256_sllv_epi64(player, shift));
+		r = _mm256_and_si256(mask, _mm256_srlv_epi64(player, shift));
+		for (int32_t i = 0; i < 5; ++i)
+		{
+			l = _mm256_or_si256(l, _mm256_and_si256(mask, _mm256_sllv_epi64(l, shift)));
+			r = _mm256_or_si256(r, _mm256_and_si256(mask, _mm256_srlv_epi64(r, shift)));
+		}
+		const __m256i legals = _mm256_or_si256(_mm256_sllv_epi64(l, shift), _mm256_srlv_epi64(r, shift));
+
+		__m128i res = _mm_or_si128(_mm256_castsi256_si128(legals), _mm256_extracti128_si256(legals, 1));
+		res = _mm_or_si128(res, _mm_unpackhi_epi64(res, res));
+		return static_cast<uint64_t>(_mm_cvtsi128_si64(res)) & ~(playerBoard | oppBoard);
+	}
+#endif
+
+#ifdef REVERSI_SIMD_AVX512
+	uint64_t calcLegalsAVX512(uint64_t playerBoard, uint64_t oppBoard)
+	{
+		// 右シフトは 64 - n の左ローテートで表す。
+		// 回り込んだビットは各方向のマスクで盤端として落ちるので、ローテートのままでよい
+		const __m512i rotate = _mm512_set_epi64(55, 57, 56, 63, 9, 7, 8, 1);
+		const __m512i player = _mm512_set1_epi64(static_cast<int64_t>(playerBoard));
+		const __m512i mask = _mm512_and_si512(_mm512_set1_epi64(static_cast<int64_t>(oppBoard)),
+			_mm512_set_epi64(0x007e7e7e7e7e7e00, 0x007e7e7e7e7e7e00, 0x00FFFFFFFFFFFF00, 0x7e7e7e7e7e7e7e7e,
+				0x007e7e7e7e7e7e00, 0x007e7e7e7e7e7e00, 0x00FFFFFFFFFFFF00, 0x7e7e7e7e7e7e7e7e));
+
+		__m512i tmp = _mm512_and_si512(mask, _mm512_rolv_epi64(player, rotate));
+		for (int32_t i = 0; i < 5; ++i)
+		{
+			tmp = _mm512_or_si512(tmp, _mm512_and_si512(mask, _mm512_rolv_epi64(tmp, rotate)));
+		}
+		const uint64_t legals = static_cast<uint64_t>(_mm512_reduce_or_epi64(_mm512_rolv_epi64(tmp, rotate)));
+		return legals & ~(playerBoard | oppBoard);
+	}
+#endif
+
+	uint64_t calcFlips(uint64_t playerBoard, uint64_t oppBoard, int32_t sq)
 	{
-		uint64_t& playerBoard = m_blackTurn ? m_blacks : m_whites;
-		uint64_t& oppBoard = m_blackTurn ? m_whites : m_blacks;
-		uint64_t b = pos2bit(x, y);
-		if ((getLegals() & b) == 0) return false;
+		const auto& lines = LineMasks[sq];
 		uint64_t rev = 0;
-		for (int dir = 0; dir < 8; ++dir)
+
+		// 上位ビット方向: 打ったマスに最も近いのは最下位ビット
+		for (uint32_t dir = 0; dir < 4; ++dir)
 		{
-			uint64_t rev_ = 0;
-			uint64_t mask = transfer(b, dir);
-			while (mask != 0 && ((mask & oppBoard) != 0))
-			{
-				rev_ |= mask;
-				mask = transfer(mask, dir);
-			}
-			if ((mask & playerBoard) != 0)
-			{
-				rev |= rev_;
-			}
+			const uint64_t outflank = lines[dir] & ~oppBoard;
+			const uint64_t first = outflank & (0 - outflank);
+			const uint64_t valid = 0 - static_cast<uint64_t>((first & playerBoard) != 0);
+			rev |= lines[dir] & (first - 1) & valid;
 		}
 
-		playerBoard ^= b | rev;
-		oppBoard ^= rev;
-		m_blackTurn = !m_blackTurn;
+		// 下位ビット方向: 打ったマスに最も近いのは最上位ビット
+		for (uint32_t dir = 4; dir < 8; ++dir)
+		{
+			const uint64_t outflank = lines[dir] & ~oppBoard;
+			const uint64_t first = std::bit_floor(outflank);
+			const uint64_t valid = 0 - static_cast<uint64_t>((first & playerBoard) != 0);
+			rev |= lines[dir] & ~((first << 1) - 1) & valid;
+		}
+
+		return rev;
+	}
+
+	uint64_t calcLegals(uint64_t playerBoard, uint64_t oppBoard)
+	{
+#if defined(REVERSI_SIMD_AVX512)
+		return calcLegalsAVX512(playerBoard, oppBoard);
+#elif defined(REVERSI_SIMD_AVX2)
+		return calcLegalsAVX2(playerBoard, oppBoard);
+#else
+		return calcLegalsScalar(playerBoard, oppBoard);
+#endif
+	}
 
+	uint64_t ReversiEngine::getLegals(bool inverseTurn) const
+	{
+		REVERSI_TRACE_ZONE("getLegals");
+		const uint64_t& playerBoard = (m_blackTurn ^ inverseTurn) ? m_blacks : m_whites;
+		const uint64_t& oppBoard = (m_blackTurn ^ inverseTurn) ? m_whites : m_blacks;
+		return calcLegals(playerBoard, oppBoard);
+	}
+
+	bool ReversiEngine::place(uint32_t x, uint32_t y)
+	{
+		REVERSI_TRACE_ZONE("place");
+		const uint64_t b = pos2bit(x, y);
+		if ((m_blacks | m_whites) & b) return false;
+
+		const uint64_t rev = getFlips(b);
+		if (rev == 0) return false;
+
+		doMove({ b, rev });
 		return true;
 	}
 
-	uint64_t ReversiEngine::transfer(uint64_t put, uint32_t dir) const
-	{
-		switch (dir) {
-		case 0: //上
-			return (put << 8) & 0xffffffffffffff00;
-		case 1: //右上
-			return (put << 7) & 0x7f7f7f7f7f7f7f00;
-		case 2: //右
-			return (put >> 1) & 0x7f7f7f7f7f7f7f7f;
-		case 3: //右下
-			return (put >> 9) & 0x007f7f7f7f7f7f7f;
-		case 4: //下
-			return (put >> 8) & 0x00ffffffffffffff;
-		case 5: //左下
-			return (put >> 7) & 0x00fefefefefefefe;
-		case 6: //左
-			return (put << 1) & 0xfefefefefefefefe;
-		case 7: //左上
-			return (put << 9) & 0xfefefefefefefe00;
-		default:
-			return 0;
-		}
+	void ReversiEngine::placeUnchecked(uint64_t bit)
+	{
+		REVERSI_TRACE_ZONE("place");
+		doMove(makeMove(bit));
+	}
+
+	uint64_t ReversiEngine::getFlips(uint64_t bit) const
+	{
+		REVERSI_TRACE_ZONE("getFlips");
+		return m_blackTurn ? calcFlips(m_blacks, m_whites, std::countr_zero(bit))
+			: calcFlips(m_whites, m_blacks, std::countr_zero(bit));
 	}
 
 	void ReversiEngine::getBoard(std::vector<int32_t>& board) const
@@ -297,6 +786,7 @@ namespace Reversi
 	void ReversiEngine::pass()
 	{
 		m_blackTurn = !m_blackTurn;
+		m_hash ^= Zobrist::WhiteTurn;
 	}
 
 	void ReversiEngine::setState(uint64_t blacks, uint64_t whites, bool blackTurn)
@@ -304,12 +794,14 @@ namespace Reversi
 		m_blacks = blacks;
 		m_whites = whites;
 		m_blackTurn = blackTurn;
+		recomputeHash();
 	}
 
 	void ReversiEngine::swapBW()
 	{
 		std::swap(m_blacks, m_whites);
 		m_blackTurn = !m_blackTurn;
+		recomputeHash();
 	}
 
 	bool ReversiEngine::isBlackTurn() const
@@ -355,128 +847,2142 @@ namespace Reversi
 			mask >>= 1;
 		}
 	}
-}
 
-class AlphaBetaAgent : public ReversiAgent
-{
-public:
-	AlphaBetaAgent();
-	Pos play(const Reversi::ReversiEngine& engine) override;
-	void reset_child() override;
-private:
-	struct LegalState
+	bool parseBoard(std::string_view str, ReversiEngine& engine)
 	{
-		int32_t score, idx;
-		inline bool operator<(const LegalState& a)
+		uint64_t blacks = 0, whites = 0, mask = 0x8000000000000000;
+		size_t i = 0;
+		for (; i < str.size() and mask; ++i)
 		{
-			if (score != a.score) return score < a.score;
-			return idx < a.idx;
+			switch (str[i])
+			{
+			case 'X': case 'x': case '*': blacks |= mask; break;
+			case 'O': case 'o': whites |= mask; break;
+			case '-': case '.': break;
+			default: return false;
+			}
+			mask >>= 1;
 		}
+		if (mask) return false;
 
-		inline bool operator>(const LegalState& a)
-		{
-			if (score != a.score) return score > a.score;
-			return idx > a.idx;
-		}
-	};
+		while (i < str.size() and str[i] == ' ') ++i;
+		if (i == str.size()) return false;
 
-	const std::vector<int32_t>valPerCell = {
-		2714, 147, 69, -18, -18, 69, 147, 2714,
-		147, -577, -186, -153, -153, -186, -577, 147,
-		69, -186, -379, -122, -122, -379, -186, 69,
-		-18, -153, -122, -169, -169, -122, -153, -18,
-		-18, -153, -122, -169, -169, -122, -153, -18,
-		69, -186, -379, -122, -122, -379, -186, 69,
-		147, -577, -186, -153, -153, -186, -577, 147,
-		2714, 147, 69, -18, -18, 69, 147, 2714,
-	};
+		const char turn = str[i];
+		if (turn != 'X' and turn != 'x' and turn != '*' and turn != 'O' and turn != 'o') return false;
 
-	const std::vector<int32_t>rowValues = _initRowValues();
-	const int32_t MAX_CALL_CNT = 100000;
+		engine.setState(blacks, whites, turn == 'X' or turn == 'x' or turn == '*');
+		return true;
+	}
 
-	std::vector<int32_t> _initRowValues()
+	std::string toBoardString(const ReversiEngine& engine)
 	{
-		//Grid<int32_t>res{ 8, (1 << 8) };
-		std::vector<int32_t> res(1 << 11);
-		int32_t i, bit, j;
-		for (i = 0; i < 8; i++)
+		std::string res(66, ' ');
+		uint64_t mask = 0x8000000000000000;
+		for (uint32_t i = 0; i < 64; ++i)
 		{
-			for (bit = 0; bit < (1 << 8); bit++)
-			{
-				for (j = 0; j < 8; j++)
-				{
-					if (bit & (1 << (7 - j)))
-					{
-						res[(i << 8) + bit] += valPerCell[(i << 3) + j];
-					}
-				}
-			}
+			if (engine.getBlacks() & mask) res[i] = 'X';
+			else if (engine.getWhites() & mask) res[i] = 'O';
+			else res[i] = '-';
+			mask >>= 1;
 		}
+		res[65] = engine.isBlackTurn() ? 'X' : 'O';
 		return res;
 	}
+}
 
-	int32_t negaAlpha(Reversi::ReversiEngine& engine, int32_t depth, bool passed, int32_t alpha, int32_t beta);
-
-	inline int32_t eval(const Reversi::ReversiEngine& engine) const;
-
-
-	/// @brief 合法手をざっとした評価の高い順に並べて返します
-	/// @param engine リバーシエンジン
-	/// @param legalList 適当なリスト (スコア, 手)
-	inline void getSortedLegals(Reversi::ReversiEngine& engine, std::vector<LegalState>& legalList)
+namespace Reversi::Trace
+{
+#ifdef REVERSI_TRACE
+	namespace
 	{
-		const uint64_t legals = engine.getLegals();
-		const uint64_t prevBlacks = engine.getBlacks(), prevWhites = engine.getWhites();
-		const bool prevTurn = engine.isBlackTurn();
+		struct Registry
+		{
+			std::mutex mutex;
+			std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+			std::vector<ThreadBuffer*> freeBuffers; // 終わったスレッドのバッファ
+		};
 
-		legalList.assign(std::popcount(legals), { 0,0 });
+		Registry& registry()
+		{
+			static Registry instance;
+			return instance;
+		}
 
-		uint64_t mask = 0x8000000000000000;
-		int32_t idx = 0, i;
-		for (i = 0; i < 64; i++)
+		/// @brief スレッドが終わるときにバッファを返します
+		struct BufferOwner
 		{
-			if (not (legals & mask))
+			ThreadBuffer* buffer = nullptr;
+
+			~BufferOwner()
 			{
-				mask >>= 1;
-				continue;
+				if (buffer == nullptr) return;
+				Registry& reg = registry();
+				std::lock_guard lock{ reg.mutex };
+				reg.freeBuffers.push_back(buffer);
 			}
+		};
+
+		thread_local BufferOwner t_owner;
+
+		/// @brief now() の単位を µs に直すための、プログラム開始時の時刻の組
+		const uint64_t StartTicks = now();
+		const std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+
+		/// @brief now() の 1 µs あたりのカウント
+		double ticksPerUs()
+		{
+#ifdef REVERSI_TRACE_RDTSC
+			// 開始からの時間が短いと誤差が大きいので、10 ms は空ける
+			const auto minEnd = StartTime + std::chrono::milliseconds(10);
+			if (std::chrono::steady_clock::now() < minEnd) std::this_thread::sleep_until(minEnd);
+			const uint64_t ticks = now() - StartTicks;
+			const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - StartTime).count();
+			return ticks / us;
+#else
+			return 1000.0;
+#endif
+		}
+	}
+
+	ThreadBuffer* acquireBuffer()
+	{
+		Registry& reg = registry();
+		std::lock_guard lock{ reg.mutex };
+		if (reg.freeBuffers.empty())
+		{
+			reg.buffers.push_back(std::make_unique<ThreadBuffer>());
+			reg.buffers.back()->id = static_cast<uint32_t>(reg.buffers.size());
+			reg.freeBuffers.push_back(reg.buffers.back().get());
+		}
+		t_buffer = t_owner.buffer = reg.freeBuffers.back();
+		reg.freeBuffers.pop_back();
+		return t_buffer;
+	}
 
-			engine.place(i & 7, i >> 3);
+	bool dumpChromeTrace(const std::string& path)
+	{
+		std::ofstream ofs(path);
+		if (not ofs) return false;
+
+		const double scale = 1.0 / ticksPerUs();
+		Registry& reg = registry();
+		std::lock_guard lock{ reg.mutex };
 
-			if (transTablePrev.contains(engine.getTupleState()))
+		// 最も古い区間を 0 にする
+		uint64_t origin = UINT64_MAX;
+		for (const auto& buffer : reg.buffers)
+		{
+			const uint64_t head = buffer->head.load(std::memory_order_acquire);
+			for (uint64_t i = head - std::min(head, ThreadBuffer::Capacity); i < head; ++i)
 			{
-				legalList[idx++] = { 1000 - transTablePrev[engine.getTupleState()], i };
+				origin = std::min(origin, buffer->events[i & (ThreadBuffer::Capacity - 1)].begin);
 			}
-			else
+		}
+
+		ofs << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+		bool first = true;
+		for (const auto& buffer : reg.buffers)
+		{
+			const uint64_t head = buffer->head.load(std::memory_order_acquire);
+			for (uint64_t i = head - std::min(head, ThreadBuffer::Capacity); i < head; ++i)
 			{
-				legalList[idx++] = { -eval(engine), i };
+				const Event& e = buffer->events[i & (ThreadBuffer::Capacity - 1)];
+				ofs << (first ? "\n" : ",\n") << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+					<< ",\"ts\":" << (e.begin - origin) * scale << ",\"dur\":" << (e.end - e.begin) * scale << "}";
+				first = false;
 			}
-
-			engine.setState(prevBlacks, prevWhites, prevTurn);
-			mask >>= 1;
 		}
-
-		std::sort(legalList.rbegin(), legalList.rend());
+		ofs << "\n]}\n";
+		return static_cast<bool>(ofs);
 	}
 
-	int32_t callCnt;
-	std::unordered_map<std::tuple<uint64_t, uint64_t, bool>, int32_t, Reversi::TupleHash> transTable, transTablePrev;
-	//HashTable<std::tuple<uint64_t, uint64_t, bool>, int32_t> transTable, transTablePrev;
-};
+	void clear()
+	{
+		Registry& reg = registry();
+		std::lock_guard lock{ reg.mutex };
+		for (const auto& buffer : reg.buffers) buffer->head.store(0, std::memory_order_relaxed);
+	}
+#else
+	bool dumpChromeTrace(const std::string& path)
+	{
+		std::ofstream ofs(path);
+		ofs << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[]}\n";
+		return static_cast<bool>(ofs);
+	}
 
-using namespace std;
+	void clear()
+	{
+	}
+#endif
+}
 
-int main()
+namespace Reversi
 {
-	int id; // id of your player.
-	cin >> id; cin.ignore();
-	int board_size;
-	cin >> board_size; cin.ignore();
+	/// @brief 置換表に保存した評価値の種類
+	enum class Bound : uint8_t
+	{
+		None = 0,
+		Exact = 1, // 真の値
+		Lower = 2, // 真の値はこれ以上 (beta カット)
+		Upper = 3, // 真の値はこれ以下 (全ての手が alpha 以下)
+	};
 
-	assert(board_size == 8);
+	/// @brief 置換表から読み出したエントリ
+	struct TTEntry
+	{
+		int16_t score;
+		int8_t depth;
+		Bound bound;
+		uint8_t bestMove; // 最善手のビット番号。NoMove なら無し
+		uint8_t age;
+
+		static constexpr uint8_t NoMove = 64;
+	};
+
+	/// @brief 固定サイズの置換表
+	/// 1 バケット (64 バイト) に 4 エントリを持ちます。
+	/// エントリはキーとデータの排他的論理和で検査するので、ロックなしで複数スレッドから読み書きできます。
+	class TranspositionTable
+	{
+	public:
+		/// @param sizeMB 使うメモリの上限 (MB)。バケット数は 2 の冪に切り下げます
+		explicit TranspositionTable(size_t sizeMB = 16);
+
+		/// @brief 大きさを変えて中身を消します
+		void resize(size_t sizeMB);
+
+		/// @brief 中身を消します
+		void clear();
+
+		/// @brief 新しい探索を始めます。古い探索のエントリは置き換えられやすくなります
+		void newSearch();
+
+		/// @brief 局面のエントリを探します
+		/// @param key 局面のハッシュ
+		/// @param entry 見つかったエントリ
+		/// @return 見つかれば true
+		bool probe(uint64_t key, TTEntry& entry) const;
+
+		/// @brief 局面のエントリを保存します
+		/// @param key 局面のハッシュ
+		/// @param score 評価値
+		/// @param depth 残り深さ
+		/// @param bound 評価値の種類
+		/// @param bestMove 最善手のビット。0 なら無し
+		/// @return 別の局面のエントリを追い出して書いたら true
+		bool store(uint64_t key, int32_t score, int32_t depth, Bound bound, uint64_t bestMove);
+
+		/// @brief 現在の探索の世代
+		uint8_t age() const { return m_age; }
+
+		/// @brief 保存できるエントリ数
+		size_t capacity() const { return (m_mask + 1) * BucketSize; }
+
+		/// @brief 現在の世代のエントリが占める割合 (‰)。先頭 1000 バケット弱から見積もります
+		int32_t hashfull() const;
+
+	private:
+		static constexpr size_t BucketSize = 4;
+
+		struct Slot
+		{
+			std::atomic<uint64_t> check; // key ^ data
+			std::atomic<uint64_t> data;
+		};
+
+		struct alignas(64) Bucket
+		{
+			Slot slots[BucketSize];
+		};
+
+		std::unique_ptr<Bucket[]> m_buckets;
+		size_t m_mask;
+		uint8_t m_age;
+
+		static uint64_t pack(const TTEntry& entry);
+		static TTEntry unpack(uint64_t data);
+	};
+}
+
+namespace Reversi
+{
+	/// @brief 終盤の完全読み
+	/// 評価値は手番側から見た最終石差 (空きマスは勝った側に数える) です。
+	/// 勝敗 (WLD) は窓 (-1, 1) の、石差は勝敗で絞った窓の null window 探索 (PVS) で求めます。
+	/// 手は残り空きマスが多い所では相手の着手可能数の少ない順 (fastest-first)、少ない所では偶数理論 (奇数個の空きがある区画を先) で並べ、
+	/// 最後の 4 マスは合法手生成を使わない専用の関数で読みます。
+	class EndgameSolver
+	{
+	public:
+		struct Result
+		{
+			int32_t score = 0; // 最終石差。solveWLD では -1 / 0 / 1
+			uint64_t bestMove = 0; // 最善手のビット。パスか、勝敗も求まらずに打ち切られたら 0
+			bool completed = false; // 打ち切られずに読み終えたら true
+		};
+
+		/// @param hashSizeMB 置換表の大きさ (MB)
+		explicit EndgameSolver(size_t hashSizeMB = 16);
+
+		/// @brief 置換表の中身を消します
+		void clearHash();
+
+		/// @brief 探索を打ち切るかを返す関数を設定します。数千ノードごとに呼びます
+		void setStopCallback(std::function<bool()> shouldStop);
+
+		/// @brief 勝敗だけを求めます
+		Result solveWLD(const ReversiEngine& engine);
+
+		/// @brief 最終石差を求めます
+		/// 勝敗を求めた後で打ち切られたときは、completed を false にして勝敗の結果を返します
+		Result solve(const ReversiEngine& engine);
+
+		/// @brief 直前の solve / solveWLD で探索したノード数
+		int64_t getNodeCount() const { return m_nodes; }
+
+	private:
+		static constexpr int32_t ScoreInf = 65;
+
+		/// @brief 置換表を使う空きマス数の下限
+		static constexpr int32_t HashMinEmpties = 10;
+
+		/// @brief fastest-first で並べる空きマス数の下限。これ未満は偶数理論だけで並べる
+		static constexpr int32_t FastestFirstMinEmpties = 7;
+
+		/// @brief 停止を確かめる間隔 (ノード数、2 の冪)
+		static constexpr int64_t StopCheckInterval = 4096;
+
+		TranspositionTable m_table;
+		std::function<bool()> m_shouldStop;
+		int64_t m_nodes = 0;
+		bool m_stopped = false;
+
+		/// @brief ノード数を数え、一定間隔で停止を確かめます
+		/// @return 打ち切るなら true
+		bool countNode();
+
+		/// @brief ルートの全ての手を窓 (alpha, beta) で読みます
+		Result searchRoot(const ReversiEngine& engine, int32_t alpha, int32_t beta);
+
+		/// @brief 空きマス 5 以上の局面の探索
+		int32_t search(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, bool passed);
+
+		/// @brief 空きマス 5 から 6 程度の、置換表も fastest-first も使わない探索
+		int32_t searchParity(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, bool passed);
+
+		/// @brief 残り 4 マス以下の局面を専用の関数に振り分けます
+		int32_t searchLast(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta);
+
+		int32_t solve4(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, int32_t sq1, int32_t sq2, int32_t sq3, int32_t sq4, bool passed);
+		int32_t solve3(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, int32_t sq1, int32_t sq2, int32_t sq3, bool passed);
+		int32_t solve2(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, int32_t sq1, int32_t sq2, bool passed);
+		int32_t solve1(uint64_t player, uint64_t opp, int32_t sq);
+
+		/// @brief 子の局面を並べ替えた順に読み、PVS で値を求めます (search と searchRoot の共通部分)
+		/// @param best 最善手のビット
+		int32_t searchMoves(uint64_t player, uint64_t opp, uint64_t legals, int32_t alpha, int32_t beta, uint64_t ttMove, uint64_t& best);
+	};
+}
+
+namespace Reversi
+{
+	TranspositionTable::TranspositionTable(size_t sizeMB) :
+		m_mask(0), m_age(0)
+	{
+		resize(sizeMB);
+	}
+
+	void TranspositionTable::resize(size_t sizeMB)
+	{
+		const size_t buckets = std::bit_floor(std::max<size_t>(sizeMB * 1024 * 1024 / sizeof(Bucket), 1));
+		m_buckets = std::make_unique<Bucket[]>(buckets);
+		m_mask = buckets - 1;
+		m_age = 0;
+	}
+
+	void TranspositionTable::clear()
+	{
+		for (size_t i = 0; i <= m_mask; ++i)
+		{
+			for (auto& slot : m_buckets[i].slots)
+			{
+				slot.check.store(0, std::memory_order_relaxed);
+				slot.data.store(0, std::memory_order_relaxed);
+			}
+		}
+		m_age = 0;
+	}
+
+	void TranspositionTable::newSearch()
+	{
+		++m_age;
+	}
+
+	bool TranspositionTable::probe(uint64_t key, TTEntry& entry) const
+	{
+		REVERSI_TRACE_ZONE("tt.probe");
+		const Bucket& bucket = m_buckets[key & m_mask];
+		for (const auto& slot : bucket.slots)
+		{
+			const uint64_t data = slot.data.load(std::memory_order_relaxed);
+			const uint64_t check = slot.check.load(std::memory_order_relaxed);
+			if (data != 0 and (check ^ data) == key)
+			{
+				entry = unpack(data);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool TranspositionTable::store(uint64_t key, int32_t score, int32_t depth, Bound bound, uint64_t bestMove)
+	{
+		REVERSI_TRACE_ZONE("tt.store");
+		TTEntry entry{
+			static_cast<int16_t>(std::clamp(score, -SHRT_MAX, static_cast<int32_t>(SHRT_MAX))),
+			static_cast<int8_t>(std::clamp(depth, 0, static_cast<int32_t>(SCHAR_MAX))),
+			bound,
+			bestMove ? static_cast<uint8_t>(std::countr_zero(bestMove)) : TTEntry::NoMove,
+			m_age,
+		};
+
+		Bucket& bucket = m_buckets[key & m_mask];
+		Slot* victim = nullptr;
+		int32_t victimValue = INT_MAX;
+		bool sameKey = false;
+
+		for (auto& slot : bucket.slots)
+		{
+			const uint64_t data = slot.data.load(std::memory_order_relaxed);
+			const uint64_t check = slot.check.load(std::memory_order_relaxed);
+
+			if (data == 0)
+			{
+				// 空きは同じ局面のエントリが無いときだけ使う
+				if (victimValue != INT_MIN)
+				{
+					victim = &slot;
+					victimValue = INT_MIN;
+				}
+				continue;
+			}
+
+			const TTEntry old = unpack(data);
+			if ((check ^ data) == key)
+			{
+				// 同じ探索で得た、ずっと深い結果は浅い境界値で上書きしない
+				if (old.age == m_age and old.depth > entry.depth + 2 and bound != Bound::Exact) return false;
+				if (entry.bestMove == TTEntry::NoMove) entry.bestMove = old.bestMove;
+				victim = &slot;
+				sameKey = true;
+				break;
+			}
+
+			// 浅いものと古い探索のものから置き換える
+			const int32_t value = old.depth - 8 * static_cast<uint8_t>(m_age - old.age);
+			if (value < victimValue)
+			{
+				victim = &slot;
+				victimValue = value;
+			}
+		}
+
+		const uint64_t data = pack(entry);
+		victim->data.store(data, std::memory_order_relaxed);
+		victim->check.store(key ^ data, std::memory_order_relaxed);
+		return not sameKey and victimValue != INT_MIN;
+	}
+
+	int32_t TranspositionTable::hashfull() const
+	{
+		const size_t buckets = std::min<size_t>(m_mask + 1, 250);
+		int32_t used = 0;
+		for (size_t i = 0; i < buckets; ++i)
+		{
+			for (const auto& slot : m_buckets[i].slots)
+			{
+				const uint64_t data = slot.data.load(std::memory_order_relaxed);
+				if (data != 0 and unpack(data).age == m_age) used++;
+			}
+		}
+		return static_cast<int32_t>(used * 1000 / (buckets * BucketSize));
+	}
+
+	uint64_t TranspositionTable::pack(const TTEntry& entry)
+	{
+		return static_cast<uint64_t>(static_cast<uint16_t>(entry.score))
+			| static_cast<uint64_t>(static_cast<uint8_t>(entry.depth)) << 16
+			| static_cast<uint64_t>(entry.bound) << 24
+			| static_cast<uint64_t>(entry.bestMove) << 26
+			| static_cast<uint64_t>(entry.age) << 33;
+	}
+
+	TTEntry TranspositionTable::unpack(uint64_t data)
+	{
+		return {
+			static_cast<int16_t>(static_cast<uint16_t>(data)),
+			static_cast<int8_t>(static_cast<uint8_t>(data >> 16)),
+			static_cast<Bound>((data >> 24) & 3),
+			static_cast<uint8_t>((data >> 26) & 127),
+			static_cast<uint8_t>(data >> 33),
+		};
+	}
+}
+
+namespace Reversi::Eval
+{
+	/// @brief 評価関数の内部の単位 (1 石 = DiscScale)
+	inline constexpr int32_t DiscScale = 256;
+
+	/// @brief DiscScale 倍の評価値を四捨五入して石差にし、[-64, 64] に収めます
+	constexpr int32_t toDiscDiff(int32_t raw)
+	{
+		const int32_t score = raw > 0 ? (raw + DiscScale / 2) / DiscScale : -((-raw + DiscScale / 2) / DiscScale);
+		return score < -64 ? -64 : score > 64 ? 64 : score;
+	}
+
+	/// @brief マスごとの価値の既定値 (石差の DiscScale 倍)
+	struct DefaultSquareValues
+	{
+		/// @brief [x + 8 * y]
+		static constexpr std::array<int32_t, 64> Values = {
+			2714, 147, 69, -18, -18, 69, 147, 2714,
+			147, -577, -186, -153, -153, -186, -577, 147,
+			69, -186, -379, -122, -122, -379, -186, 69,
+			-18, -153, -122, -169, -169, -122, -153, -18,
+			-18, -153, -122, -169, -169, -122, -153, -18,
+			69, -186, -379, -122, -122, -379, -186, 69,
+			147, -577, -186, -153, -153, -186, -577, 147,
+			2714, 147, 69, -18, -18, 69, 147, 2714,
+		};
+	};
+
+	/// @brief マスごとの価値の合計による評価関数
+	/// 価値は Policy::Values ([x + 8 * y]、石差の DiscScale 倍) で与えます。
+	/// 行ごとに石の並び 256 通りの価値の合計をコンパイル時に表にしておき、1 行 1 回の表引きで合計します。
+	/// 表は Policy ごとに 1 つだけの静的な配列 (8 KB) で、エージェントごとには持ちません。
+	template <class Policy = DefaultSquareValues>
+	class SquareEvaluator
+	{
+	public:
+		/// @brief [行][その行の石の並び (左端が最上位ビット)] 価値の合計
+		static constexpr std::array<std::array<int32_t, 256>, 8> RowValues = []
+		{
+			std::array<std::array<int32_t, 256>, 8> res{};
+			for (int32_t y = 0; y < 8; ++y)
+			{
+				for (int32_t bits = 0; bits < 256; ++bits)
+				{
+					for (int32_t x = 0; x < 8; ++x)
+					{
+						if (bits & (1 << (7 - x))) res[y][bits] += Policy::Values[x + 8 * y];
+					}
+				}
+			}
+			return res;
+		}();
+
+		/// @brief 黒から見た価値の合計 (石差の DiscScale 倍)
+		static constexpr int32_t evaluateRaw(uint64_t blacks, uint64_t whites)
+		{
+			int32_t score = 0;
+			for (int32_t y = 0; y < 8; ++y)
+			{
+				const int32_t shift = 56 - 8 * y;
+				score += RowValues[y][(blacks >> shift) & 0xFF];
+				score -= RowValues[y][(whites >> shift) & 0xFF];
+			}
+			return score;
+		}
+
+		/// @brief 手番側から見た評価値 (石差、[-64, 64])
+		static int32_t evaluate(const ReversiEngine& engine)
+		{
+			const int32_t score = evaluateRaw(engine.getBlacks(), engine.getWhites());
+			return toDiscDiff(engine.isBlackTurn() ? score : -score);
+		}
+	};
+
+	static_assert(SquareEvaluator<>::evaluateRaw(0x0000000810000000, 0x0000001008000000) == 0, "initial position must be even");
+	static_assert(SquareEvaluator<>::evaluateRaw(0x8000000000000001, 0) == 2 * 2714, "corners");
+}
+
+namespace Reversi::Eval
+{
+	/// @brief パターンの形。同じ形のパターン (回転・反転したもの) は同じ重みの表を使います
+	enum class Shape : uint8_t
+	{
+		Edge2X, // 辺 8 マスと 2 つの X 打ち
+		Corner3x3, // 隅の 3x3
+		Corner2x5, // 隅の 2x5 (縦横 2 種類)
+		Diag8, // 長さ 8 の斜め
+		Diag7,
+		Diag6,
+		Diag5,
+		Diag4,
+	};
+
+	inline constexpr int32_t NumShapes = 8;
+
+	/// @brief 形ごとのマス数
+	inline constexpr int32_t ShapeSize[NumShapes] = { 10, 9, 10, 8, 7, 6, 5, 4 };
+
+	/// @brief 3 の冪
+	inline constexpr int32_t Pow3[11] = { 1, 3, 9, 27, 81, 243, 729, 2187, 6561, 19683, 59049 };
+
+	/// @brief 1 つの局面で見るパターン (特徴) の数
+	inline constexpr int32_t NumFeatures = 34;
+
+	/// @brief 盤面上に置いた 1 つのパターン
+	struct Feature
+	{
+		Shape shape;
+		int8_t squares[10]; // ビット番号。先頭のマスが 3 進数の最上位の桁
+	};
+
+	namespace detail
+	{
+		struct Point
+		{
+			int8_t x, y;
+		};
+
+		/// @brief 90 度回転
+		constexpr Point rotate(Point p) { return { static_cast<int8_t>(7 - p.y), p.x }; }
+
+		/// @brief 左上と右下を結ぶ対角線での反転
+		constexpr Point transpose(Point p) { return { p.y, p.x }; }
+
+		constexpr int8_t toBit(Point p) { return static_cast<int8_t>(63 - (p.x + 8 * p.y)); }
+
+		/// @brief 基準の配置を回転 (と反転) して全てのパターンを作ります
+		constexpr std::array<Feature, NumFeatures> makeFeatures()
+		{
+			constexpr Point edge2X[10] = { { 1, 1 }, { 0, 0 }, { 1, 0 }, { 2, 0 }, { 3, 0 }, { 4, 0 }, { 5, 0 }, { 6, 0 }, { 7, 0 }, { 6, 1 } };
+			constexpr Point corner3x3[9] = { { 0, 0 }, { 1, 0 }, { 2, 0 }, { 0, 1 }, { 1, 1 }, { 2, 1 }, { 0, 2 }, { 1, 2 }, { 2, 2 } };
+			constexpr Point corner2x5[10] = { { 0, 0 }, { 1, 0 }, { 2, 0 }, { 3, 0 }, { 4, 0 }, { 0, 1 }, { 1, 1 }, { 2, 1 }, { 3, 1 }, { 4, 1 } };
+			constexpr Point diag8[8] = { { 0, 0 }, { 1, 1 }, { 2, 2 }, { 3, 3 }, { 4, 4 }, { 5, 5 }, { 6, 6 }, { 7, 7 } };
+			constexpr Point diag7[7] = { { 1, 0 }, { 2, 1 }, { 3, 2 }, { 4, 3 }, { 5, 4 }, { 6, 5 }, { 7, 6 } };
+			constexpr Point diag6[6] = { { 2, 0 }, { 3, 1 }, { 4, 2 }, { 5, 3 }, { 6, 4 }, { 7, 5 } };
+			constexpr Point diag5[5] = { { 3, 0 }, { 4, 1 }, { 5, 2 }, { 6, 3 }, { 7, 4 } };
+			constexpr Point diag4[4] = { { 4, 0 }, { 5, 1 }, { 6, 2 }, { 7, 3 } };
+
+			std::array<Feature, NumFeatures> res{};
+			int32_t n = 0;
+
+			auto add = [&](Shape shape, const Point* base, int32_t size, int32_t rotations, bool flip)
+			{
+				for (int32_t r = 0; r < rotations; ++r)
+				{
+					Feature f{ shape, {} };
+					for (int32_t i = 0; i < size; ++i)
+					{
+						Point p = flip ? transpose(base[i]) : base[i];
+						for (int32_t k = 0; k < r; ++k) p = rotate(p);
+						f.squares[i] = toBit(p);
+					}
+					res[n++] = f;
+				}
+			};
+
+			add(Shape::Edge2X, edge2X, 10, 4, false);
+			add(Shape::Corner3x3, corner3x3, 9, 4, false);
+			add(Shape::Corner2x5, corner2x5, 10, 4, false);
+			add(Shape::Corner2x5, corner2x5, 10, 4, true);
+			add(Shape::Diag8, diag8, 8, 2, false);
+			add(Shape::Diag7, diag7, 7, 4, false);
+			add(Shape::Diag6, diag6, 6, 4, false);
+			add(Shape::Diag5, diag5, 5, 4, false);
+			add(Shape::Diag4, diag4, 4, 4, false);
+			return res;
+		}
+	}
+
+	inline constexpr std::array<Feature, NumFeatures> Features = detail::makeFeatures();
+
+	/// @brief あるマスを含むパターンと、そのマスの桁の重み (3 の冪)
+	struct SquareFeatures
+	{
+		struct Entry
+		{
+			uint8_t feature;
+			uint16_t pow3;
+		};
+
+		int32_t count;
+		Entry entries[8];
+	};
+
+	namespace detail
+	{
+		constexpr std::array<SquareFeatures, 64> makeSquareFeatures()
+		{
+			std::array<SquareFeatures, 64> res{};
+			for (int32_t f = 0; f < NumFeatures; ++f)
+			{
+				const int32_t size = ShapeSize[static_cast<int32_t>(Features[f].shape)];
+				for (int32_t i = 0; i < size; ++i)
+				{
+					auto& sq = res[Features[f].squares[i]];
+					sq.entries[sq.count++] = { static_cast<uint8_t>(f), static_cast<uint16_t>(Pow3[size - 1 - i]) };
+				}
+			}
+			return res;
+		}
+	}
+
+	/// @brief [ビット番号] そのマスを含むパターンの一覧
+	inline constexpr std::array<SquareFeatures, 64> SquareToFeatures = detail::makeSquareFeatures();
+
+	/// @brief 局面の全てのパターンの 3 進数の番号 (空き 0, 黒 1, 白 2)
+	/// 着手ごとに、打ったマスと裏返った石のマスを含むパターンの番号だけを差分で更新します
+	struct PatternState
+	{
+		std::array<uint16_t, NumFeatures> indices{};
+
+		/// @brief 盤面から番号を計算し直します
+		void reset(const ReversiEngine& engine);
+
+		/// @brief ReversiEngine::doMove の後に呼びます
+		/// @param blackMoved 黒の着手なら true
+		inline void update(const ReversiEngine::Move& move, bool blackMoved)
+		{
+			if (move.bit)
+			{
+				for (const auto& e : entriesOf(move.bit)) indices[e.feature] += e.pow3 * (blackMoved ? 1 : 2);
+			}
+			// 裏返った石は黒 (1) と白 (2) が入れ替わる
+			applyFlips(move.flips, blackMoved ? -1 : 1);
+		}
+
+		/// @brief ReversiEngine::undoMove の後に呼びます
+		/// @param blackMoved 取り消した着手が黒のものなら true
+		inline void restore(const ReversiEngine::Move& move, bool blackMoved)
+		{
+			if (move.bit)
+			{
+				for (const auto& e : entriesOf(move.bit)) indices[e.feature] -= e.pow3 * (blackMoved ? 1 : 2);
+			}
+			applyFlips(move.flips, blackMoved ? 1 : -1);
+		}
+
+	private:
+		struct EntryRange
+		{
+			const SquareFeatures::Entry* first;
+			const SquareFeatures::Entry* last;
+			const SquareFeatures::Entry* begin() const { return first; }
+			const SquareFeatures::Entry* end() const { return last; }
+		};
+
+		static EntryRange entriesOf(uint64_t bit)
+		{
+			const auto& sq = SquareToFeatures[std::countr_zero(bit)];
+			return { sq.entries, sq.entries + sq.count };
+		}
+
+		inline void applyFlips(uint64_t flips, int32_t sign)
+		{
+			for (; flips; flips &= flips - 1)
+			{
+				for (const auto& e : entriesOf(flips)) indices[e.feature] += sign * e.pow3;
+			}
+		}
+	};
+
+	/// @brief パターンの重みによる評価関数
+	/// 重みは [段階][形ごとの表 + 着手可能数の表] の順に 1 本の int16_t 配列に詰めてあります。
+	/// 段階は石の数で分け、番号は黒から見たものなので、白番では符号を反転します。
+	/// 重みの配列は読み取り専用で、コピーした評価関数どうしや読み込んだファイル (WeightFile.hpp) と共有します。
+	class PatternEvaluator
+	{
+	public:
+		/// @brief 段階の数
+		static constexpr int32_t NumPhases = 6;
+
+		/// @brief 重みの単位 (1 石 = Scale)
+		static constexpr int32_t Scale = DiscScale;
+
+		/// @brief 形ごとの表の先頭位置 (1 段階の中での位置)
+		static constexpr std::array<int32_t, NumShapes + 1> ShapeOffset = []
+		{
+			std::array<int32_t, NumShapes + 1> res{};
+			for (int32_t s = 0; s < NumShapes; ++s) res[s + 1] = res[s] + Pow3[ShapeSize[s]];
+			return res;
+		}();
+
+		/// @brief パターンごとの表の先頭位置 (1 段階の中での位置)
+		static constexpr std::array<int32_t, NumFeatures> FeatureOffset = []
+		{
+			std::array<int32_t, NumFeatures> res{};
+			for (int32_t f = 0; f < NumFeatures; ++f) res[f] = ShapeOffset[static_cast<int32_t>(Features[f].shape)];
+			return res;
+		}();
+
+		/// @brief 着手可能数の表の先頭位置と大きさ
+		static constexpr int32_t MobilityOffset = ShapeOffset[NumShapes];
+		static constexpr int32_t MobilitySize = 64;
+
+		/// @brief 1 段階の重みの数
+		static constexpr int32_t PhaseSize = MobilityOffset + MobilitySize;
+
+		/// @brief 重み全体の数
+		static constexpr size_t WeightCount = static_cast<size_t>(PhaseSize) * NumPhases;
+
+		/// @brief 石の数から段階を求めます
+		static constexpr int32_t phaseOf(int32_t discs)
+		{
+			const int32_t phase = (discs - 4) * NumPhases / 61;
+			return phase < 0 ? 0 : phase >= NumPhases ? NumPhases - 1 : phase;
+		}
+
+		/// @brief マスごとの静的な価値から作った初期の重みで作ります
+		PatternEvaluator();
+
+		/// @brief 手番側から見た評価値 (石差、[-64, 64])
+		int32_t evaluate(const PatternState& state, const ReversiEngine& engine) const;
+
+		/// @brief 重み全体
+		std::span<const int16_t> weights() const { return { m_weights, WeightCount }; }
+
+		/// @brief 重みを差し替えます (学習の結果など)
+		/// @return 数が WeightCount でなければ何もせず false
+		bool setWeights(std::vector<int16_t> weights);
+
+		/// @brief 外部のメモリにある重みを、コピーせずに使います
+		/// @param owner weights の寿命を持つもの (メモリに割り当てたファイルなど)
+		/// @param weights WeightCount 個の重み
+		void shareWeights(std::shared_ptr<const void> owner, const int16_t* weights);
+
+	private:
+		std::shared_ptr<const void> m_owner; // m_weights の寿命を持つ
+		const int16_t* m_weights = nullptr;
+	};
+
+	/// @brief 既定の評価関数 (全てのエージェントで共有する)
+	PatternEvaluator& defaultPatternEvaluator();
+}
+
+#ifdef REVERSI_SIMD_AVX2
+# include <immintrin.h>
+#endif
+
+namespace Reversi::Eval
+{
+	/// @brief ニューラルネットの評価関数の学習用の (量子化前の) 重み
+	/// 入力は 128 個 ([ビット番号] 黒の石、[64 + ビット番号] 白の石) で、
+	/// 隠れ層 2 つは [0, 1] に切り詰める ReLU、出力は黒から見た石差です。
+	/// 行列は全て [入力][出力] の順に行優先で並べます。
+	struct NNParameters
+	{
+		static constexpr int32_t InputSize = 128;
+		static constexpr int32_t Hidden1 = 64;
+		static constexpr int32_t Hidden2 = 32;
+
+		std::vector<float> w1; // [InputSize][Hidden1]
+		std::vector<float> b1; // [Hidden1]
+		std::vector<float> w2; // [Hidden1][Hidden2]
+		std::vector<float> b2; // [Hidden2]
+		std::vector<float> w3; // [Hidden2]
+		float b3 = 0;
+
+		/// @brief 乱数で初期化した重みを作ります (学習の開始点や速度の計測用)
+		static NNParameters initial(uint64_t seed);
+
+		/// @brief 全ての配列が正しい大きさか
+		bool isValid() const;
+	};
+
+	/// @brief NNParameters をファイルに書き出します
+	/// 先頭に識別子 "RVNN"、版、層の大きさ 3 つ、重みの CRC-32 (各 uint32_t) を置き、続けて重みを float で並べます。
+	bool saveNetworkFile(const std::string& path, const NNParameters& params);
+
+	/// @brief saveNetworkFile で書いたファイルを読みます
+	/// @return 読み込めれば true。形式やチェックサムが合わなければ params は変えずに false
+	bool loadNetworkFile(const std::string& path, NNParameters& params);
+
+	/// @brief 1 層目の出力 (アキュムレータ)。局面の石から差分で更新します
+	struct NNState
+	{
+		alignas(32) std::array<int16_t, NNParameters::Hidden1> acc{};
+	};
+
+	/// @brief 量子化したニューラルネットによる評価関数
+	/// 1 層目は入力が石の有無だけなので、着手ごとに打ったマスと裏返った石のマスの列を
+	/// アキュムレータ (NNState) に足し引きするだけで済みます (石 1 つにつき 16 ビット整数 64 個の加算)。
+	/// 2 層目以降だけを局面ごとに計算します。
+	/// 値の単位: 1 層目の出力と活性は 127 が 1.0、2 層目の重みは 64 が 1.0、出力は DiscScale が 1 石。
+	class NNEvaluator
+	{
+	public:
+		static constexpr int32_t Hidden1 = NNParameters::Hidden1;
+		static constexpr int32_t Hidden2 = NNParameters::Hidden2;
+
+		/// @brief 活性の 1.0
+		static constexpr int32_t ActivationOne = 127;
+
+		/// @brief 2 層目の重みの 1.0
+		static constexpr int32_t Weight2One = 64;
+
+		/// @brief 全ての重みが 0 の (常に 0 を返す) 評価関数を作ります
+		NNEvaluator();
+
+		explicit NNEvaluator(const NNParameters& params);
+
+		/// @brief 重みを量子化して設定します
+		/// @return params の大きさが合わなければ何もせず false
+		bool setParameters(const NNParameters& params);
+
+		/// @brief 盤面からアキュムレータを計算し直します
+		void reset(NNState& state, const ReversiEngine& engine) const;
+
+		/// @brief ReversiEngine::doMove の後に呼びます
+		/// @param blackMoved 黒の着手なら true
+		inline void update(NNState& state, const ReversiEngine::Move& move, bool blackMoved) const
+		{
+			if (move.bit)
+			{
+				const int32_t sq = std::countr_zero(move.bit);
+				add(state, blackMoved ? m_black[sq] : m_white[sq]);
+			}
+			// 裏返った石は白と黒の列が入れ替わる
+			for (uint64_t flips = move.flips; flips; flips &= flips - 1)
+			{
+				const auto& column = m_flip[std::countr_zero(flips)];
+				blackMoved ? add(state, column) : sub(state, column);
+			}
+		}
+
+		/// @brief ReversiEngine::undoMove の後に呼びます
+		/// @param blackMoved 取り消した着手が黒のものなら true
+		inline void restore(NNState& state, const ReversiEngine::Move& move, bool blackMoved) const
+		{
+			if (move.bit)
+			{
+				const int32_t sq = std::countr_zero(move.bit);
+				sub(state, blackMoved ? m_black[sq] : m_white[sq]);
+			}
+			for (uint64_t flips = move.flips; flips; flips &= flips - 1)
+			{
+				const auto& column = m_flip[std::countr_zero(flips)];
+				blackMoved ? sub(state, column) : add(state, column);
+			}
+		}
+
+		/// @brief 手番側から見た評価値 (石差、[-64, 64])
+		int32_t evaluate(const NNState& state, const ReversiEngine& engine) const;
+
+		/// @brief 黒から見た評価値 (石差の DiscScale 倍)
+		int32_t evaluateRaw(const NNState& state) const;
+
+	private:
+		using Column = std::array<int16_t, Hidden1>;
+
+		alignas(32) std::array<Column, 64> m_black{}; // [ビット番号] 黒の石の列
+		alignas(32) std::array<Column, 64> m_white{}; // [ビット番号] 白の石の列
+		alignas(32) std::array<Column, 64> m_flip{}; // [ビット番号] m_black - m_white
+		alignas(32) Column m_bias1{};
+		alignas(32) std::array<Column, Hidden2> m_w2{}; // [出力][入力]
+		std::array<int32_t, Hidden2> m_b2{};
+		std::array<int32_t, Hidden2> m_w3{};
+		int32_t m_b3 = 0;
+
+		static inline void add(NNState& state, const Column& column)
+		{
+#ifdef REVERSI_SIMD_AVX2
+			for (int32_t i = 0; i < Hidden1; i += 16)
+			{
+				__m256i* p = reinterpret_cast<__m256i*>(state.acc.data() + i);
+				*p = _mm256_add_epi16(*p, _mm256_load_si256(reinterpret_cast<const __m256i*>(column.data() + i)));
+			}
+#else
+			for (int32_t i = 0; i < Hidden1; ++i) state.acc[i] += column[i];
+#endif
+		}
+
+		static inline void sub(NNState& state, const Column& column)
+		{
+#ifdef REVERSI_SIMD_AVX2
+			for (int32_t i = 0; i < Hidden1; i += 16)
+			{
+				__m256i* p = reinterpret_cast<__m256i*>(state.acc.data() + i);
+				*p = _mm256_sub_epi16(*p, _mm256_load_si256(reinterpret_cast<const __m256i*>(column.data() + i)));
+			}
+#else
+			for (int32_t i = 0; i < Hidden1; ++i) state.acc[i] -= column[i];
+#endif
+		}
+	};
+}
+
+class AlphaBetaAgent : public ReversiAgent
+{
+public:
+	/// @param hashSizeMB 置換表の大きさ (MB)
+	explicit AlphaBetaAgent(size_t hashSizeMB = 16);
+	Pos play(const Reversi::ReversiEngine& engine) override;
+	void reset_child() override;
+
+	/// @brief 置換表の大きさを変えます (中身は消えます)
+	void setHashSize(size_t hashSizeMB);
+
+	/// @brief 置換表の中身を消します (新しい対局の前など)
+	void clearHash();
+
+	/// @brief 反復深化で読む最大の深さ (ルートの手を含む) を設定します
+	/// 持ち時間 (setTimeControl) を設定したときは、時間内で読める所までの上限になります
+	void setSearchDepth(int32_t depth);
+
+	/// @brief 空きマスがこの数以下なら、評価関数で読む代わりに終局まで完全に読みます (0 なら使わない)
+	/// 持ち時間の内に勝敗も求まらなければ、いつもの探索に戻ります
+	void setEndgameEmpties(int32_t empties);
+
+	/// @brief 評価関数を設定します (既定は Reversi::Eval::defaultPatternEvaluator)
+	void setEvaluator(const Reversi::Eval::PatternEvaluator& evaluator);
+
+	/// @brief ニューラルネットの評価関数を設定します。設定している間はパターンの評価関数の代わりに使います
+	/// @param network 使う評価関数 (探索中は生きていること)。nullptr ならパターンの評価関数に戻します
+	void setNetwork(const Reversi::Eval::NNEvaluator* network);
+
+	/// @brief 探索に使うスレッド数を設定します (Lazy SMP)
+	/// 2 以上なら補助スレッドが同じルートを少しずらした深さと手順で探索し、置換表だけを共有します
+	void setThreadCount(int32_t threads);
+
+	/// @brief 反復深化の窓 (aspiration window) を設定します
+	/// 深さ 3 からは偶奇の同じ 1 つ前の反復 (深さ - 2) の値 ± window の窓で読み、外れたら外れた側の幅を growth 倍に広げて読み直します
+	/// (評価値は読む深さの偶奇で大きく振れるので、直前の反復の値を中心にすると外れてばかりになる)
+	/// @param window 最初の窓の片側の幅 (石差)。0 なら毎回全幅で読みます
+	/// @param growth 外れるたびに幅を何倍にするか (2 から 16)
+	void setAspiration(int32_t window, int32_t growth = 2);
+
+	/// @brief 直前の play で探索したノード数 (全スレッドの合計)
+	int64_t getNodeCount() const { return callCnt; }
+
+	/// @brief 直前の play で最後まで読み終えた深さ (完全読みなら空きマス数)
+	int32_t getLastDepth() const { return lastDepth; }
+private:
+	/// @brief Tools/MicroBench.cpp が非公開の getSortedLegals を測るため
+	friend struct MicroBenchAccess;
+
+	struct LegalState
+	{
+		int32_t score;
+		Reversi::ReversiEngine::Move move;
+
+		// 同点なら盤面の右下側 (下位ビット) を大きいとみなす
+		inline bool operator<(const LegalState& a) const
+		{
+			if (score != a.score) return score < a.score;
+			return move.bit > a.move.bit;
+		}
+
+		inline bool operator>(const LegalState& a) const
+		{
+			if (score != a.score) return score > a.score;
+			return move.bit < a.move.bit;
+		}
+	};
+
+	/// @brief 1 局面の合法手を置いておく領域 (合法手は高々 64 個)
+	using LegalList = std::array<LegalState, 64>;
+
+	/// @brief スレッドごとの探索状態
+	struct Worker
+	{
+		Reversi::ReversiEngine engine;
+		Reversi::Eval::PatternState patterns; // engine と同じ局面のパターン番号 (network が無いとき)
+		Reversi::Eval::NNState nn; // engine と同じ局面のアキュムレータ (network があるとき)
+		const Reversi::Eval::NNEvaluator* network = nullptr;
+		SearchCounters stats;
+		int32_t id = 0; // 0 が主スレッド
+	};
+
+	/// @brief 着手を盤面と評価関数の差分の状態 (パターン番号かアキュムレータ) の両方に適用します
+	static inline void doMove(Worker& worker, const Reversi::ReversiEngine::Move& move)
+	{
+		REVERSI_TRACE_ZONE("doMove");
+		const bool blackMoved = worker.engine.isBlackTurn();
+		worker.engine.doMove(move);
+		if (worker.network) worker.network->update(worker.nn, move, blackMoved);
+		else worker.patterns.update(move, blackMoved);
+	}
+
+	/// @brief doMove で適用した着手を取り消します
+	static inline void undoMove(Worker& worker, const Reversi::ReversiEngine::Move& move)
+	{
+		worker.engine.undoMove(move);
+		if (worker.network) worker.network->restore(worker.nn, move, worker.engine.isBlackTurn());
+		else worker.patterns.restore(move, worker.engine.isBlackTurn());
+	}
+
+	/// @brief 時間と中断要求を確かめる間隔 (ノード数、2 の冪)
+	static constexpr int64_t TimeCheckInterval = 1024;
+
+	/// @brief ルートの全ての手を窓 (alpha, beta) で読みます
+	/// @param bestMove 最善手のビット (並べ替えの先頭にも使います)。打ち切ったときと窓より下に外れたときは書き換えません
+	/// @return 最善手の評価値 (fail-soft なので窓の外なら境界値)。打ち切ったときの値は使えません
+	int32_t searchRoot(Worker& worker, int32_t depth, int32_t alpha, int32_t beta, uint64_t& bestMove);
+
+	/// @brief 補助スレッドの反復深化。stopped が立つか最大の深さまで読むと戻ります
+	void helperSearch(Worker& worker);
+
+	/// @brief PVS (NegaScout) で読みます。最初の手だけ窓全体で読み、残りは null window で確かめます
+	int32_t negaAlpha(Worker& worker, int32_t depth, bool passed, int32_t alpha, int32_t beta);
+
+	/// @brief 探索開始からの経過時間 (ms)
+	int64_t elapsedMs() const;
+
+	/// @brief 探索開始からの経過時間 (µs)
+	int64_t elapsedUs() const;
+
+	/// @brief 時間切れか中断要求があれば stopped を立てます
+	void checkStop();
+
+	/// @brief 今の局面を置換表に書き、書いた回数と追い出した回数を数えます
+	inline void storeEntry(Worker& worker, int32_t score, int32_t depth, Reversi::Bound bound, uint64_t bestMove)
+	{
+		worker.stats.ttStores++;
+		if (transTable.store(worker.engine.getHash(), score, depth, bound, bestMove)) worker.stats.ttCollisions++;
+	}
+
+	inline int32_t eval(const Worker& worker) const
+	{
+		REVERSI_TRACE_ZONE("eval");
+		if (worker.network) return worker.network->evaluate(worker.nn, worker.engine);
+		return evaluator->evaluate(worker.patterns, worker.engine);
+	}
+
+
+	/// @brief 合法手をざっとした評価の高い順に並べて返します
+	/// 置換表の最善手を先頭にし、残りは置換表にある子の値か静的評価で並べます
+	/// @param worker 探索状態
+	/// @param legalList 結果を書き込む領域 (スコア, 手)
+	/// @param ttMove 置換表の最善手のビット。0 なら無し
+	/// @return 合法手の数
+	inline int32_t getSortedLegals(Worker& worker, LegalList& legalList, uint64_t ttMove)
+	{
+		REVERSI_TRACE_ZONE("getSortedLegals");
+		Reversi::ReversiEngine& engine = worker.engine;
+		uint64_t legals = engine.getLegals();
+		int32_t idx = 0;
+
+		while (legals)
+		{
+			const uint64_t bit = legals & (0 - legals);
+			legals ^= bit;
+
+			const auto move = engine.makeMove(bit);
+			if (bit == ttMove)
+			{
+				legalList[idx++] = { inf, move };
+				continue;
+			}
+
+			doMove(worker, move);
+
+			Reversi::TTEntry entry;
+			if (transTable.probe(engine.getHash(), entry))
+			{
+				legalList[idx++] = { 1000 - entry.score, move };
+			}
+			else
+			{
+				legalList[idx++] = { -eval(worker), move };
+			}
+
+			undoMove(worker, move);
+		}
+
+		std::sort(legalList.begin(), legalList.begin() + idx, std::greater<>{});
+		return idx;
+	}
+
+	int64_t callCnt = 0;
+	int32_t searchDepth = 7;
+	int32_t lastDepth = 0;
+	int32_t threadCount = 1;
+	int32_t endgameEmpties = 16;
+	int32_t aspirationWindow = 2;
+	int32_t aspirationGrowth = 2;
+
+	std::chrono::steady_clock::time_point searchStart;
+	TimeBudget budget = { -1, -1 };
+	std::atomic<bool> stopped = false; // 全スレッドの探索を打ち切る
+	Reversi::TranspositionTable transTable;
+	Reversi::EndgameSolver endgameSolver;
+	const Reversi::Eval::PatternEvaluator* evaluator = &Reversi::Eval::defaultPatternEvaluator();
+	const Reversi::Eval::NNEvaluator* network = nullptr;
+};
+
+namespace Reversi
+{
+	namespace
+	{
+		constexpr uint64_t Corners = 0x8100000000000081;
+
+		/// @brief 盤面を 4 つに分けた区画 (左上, 右上, 左下, 右下)
+		constexpr uint64_t Quadrants[4] = {
+			0xF0F0F0F000000000, 0x0F0F0F0F00000000, 0x00000000F0F0F0F0, 0x000000000F0F0F0F,
+		};
+
+		/// @brief 空きマスが奇数個ある区画のマスク
+		inline uint64_t oddQuadrants(uint64_t empties)
+		{
+			uint64_t res = 0;
+			for (const uint64_t quadrant : Quadrants)
+			{
+				if (std::popcount(empties & quadrant) & 1) res |= quadrant;
+			}
+			return res;
+		}
+
+		/// @brief 終局の石差。空きマスは勝った側に数える
+		inline int32_t finalScore(uint64_t player, uint64_t opp)
+		{
+			const int32_t p = std::popcount(player), o = std::popcount(opp);
+			const int32_t diff = p - o;
+			if (diff > 0) return diff + (64 - p - o);
+			if (diff < 0) return diff - (64 - p - o);
+			return 0;
+		}
+
+		/// @brief 置換表のキー。解く局面は手番側から見た盤面なので手番は含めない
+		inline uint64_t hashBoard(uint64_t player, uint64_t opp)
+		{
+			uint64_t z = player * 0x9e3779b97f4a7c15 ^ std::rotl(opp, 29) * 0xc2b2ae3d27d4eb4f;
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+			return z ^ (z >> 31);
+		}
+	}
+
+	EndgameSolver::EndgameSolver(size_t hashSizeMB) :
+		m_table(hashSizeMB)
+	{
+	}
+
+	void EndgameSolver::clearHash()
+	{
+		m_table.clear();
+	}
+
+	void EndgameSolver::setStopCallback(std::function<bool()> shouldStop)
+	{
+		m_shouldStop = std::move(shouldStop);
+	}
+
+	EndgameSolver::Result EndgameSolver::solveWLD(const ReversiEngine& engine)
+	{
+		m_nodes = 0;
+		m_stopped = false;
+		m_table.newSearch();
+
+		Result res = searchRoot(engine, -1, 1);
+		if (not res.completed) return {};
+		res.score = (res.score > 0) - (res.score < 0);
+		return res;
+	}
+
+	EndgameSolver::Result EndgameSolver::solve(const ReversiEngine& engine)
+	{
+		// 勝敗で窓を半分に絞ってから石差を求める (子は PVS の null window で調べる)。引き分けならそれで終わり
+		const Result wld = solveWLD(engine);
+		if (not wld.completed or wld.score == 0) return wld;
+
+		Result res = wld.score > 0 ? searchRoot(engine, 0, ScoreInf) : searchRoot(engine, -ScoreInf, 0);
+		if (not res.completed)
+		{
+			// 勝敗の結果は確かなので、そちらの手を返す
+			res = wld;
+			res.completed = false;
+		}
+		return res;
+	}
+
+	bool EndgameSolver::countNode()
+	{
+		if ((++m_nodes & (StopCheckInterval - 1)) == 0 and m_shouldStop and m_shouldStop()) m_stopped = true;
+		return m_stopped;
+	}
+
+	EndgameSolver::Result EndgameSolver::searchRoot(const ReversiEngine& engine, int32_t alpha, int32_t beta)
+	{
+		const uint64_t player = engine.isBlackTurn() ? engine.getBlacks() : engine.getWhites();
+		const uint64_t opp = engine.isBlackTurn() ? engine.getWhites() : engine.getBlacks();
+		const uint64_t legals = calcLegals(player, opp);
+		Result res;
+
+		if (legals == 0)
+		{
+			res.score = -search(opp, player, -beta, -alpha, true);
+		}
+		else
+		{
+			TTEntry entry;
+			uint64_t ttMove = 0;
+			if (m_table.probe(hashBoard(player, opp), entry) and entry.bestMove != TTEntry::NoMove) ttMove = 1ull << entry.bestMove;
+
+			res.score = searchMoves(player, opp, legals, alpha, beta, ttMove, res.bestMove);
+			if (not m_stopped) m_table.store(hashBoard(player, opp), res.score, std::popcount(~(player | opp)), Bound::Exact, res.bestMove);
+		}
+
+		res.completed = not m_stopped;
+		return res;
+	}
+
+	int32_t EndgameSolver::search(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, bool passed)
+	{
+		const int32_t nEmpties = std::popcount(~(player | opp));
+		if (nEmpties < FastestFirstMinEmpties) return searchParity(player, opp, alpha, beta, passed);
+		if (countNode()) return 0;
+
+		const uint64_t legals = calcLegals(player, opp);
+		if (legals == 0)
+		{
+			if (passed) return finalScore(player, opp);
+			return -search(opp, player, -beta, -alpha, true);
+		}
+
+		// 空きマスが同じなら深さも同じなので、深さは比べずに値の種類だけ見る
+		const bool useHash = nEmpties >= HashMinEmpties;
+		const uint64_t key = useHash ? hashBoard(player, opp) : 0;
+		uint64_t ttMove = 0;
+		if (useHash)
+		{
+			TTEntry entry;
+			if (m_table.probe(key, entry))
+			{
+				if (entry.bestMove != TTEntry::NoMove) ttMove = 1ull << entry.bestMove;
+				if (entry.bound == Bound::Exact) return entry.score;
+				if (entry.bound == Bound::Lower and entry.score >= beta) return entry.score;
+				if (entry.bound == Bound::Upper and entry.score <= alpha) return entry.score;
+			}
+		}
+
+		uint64_t best = 0;
+		const int32_t score = searchMoves(player, opp, legals, alpha, beta, ttMove, best);
+		if (m_stopped) return 0;
+
+		if (useHash)
+		{
+			const Bound bound = score >= beta ? Bound::Lower : score > alpha ? Bound::Exact : Bound::Upper;
+			m_table.store(key, score, nEmpties, bound, best);
+		}
+		return score;
+	}
+
+	int32_t EndgameSolver::searchMoves(uint64_t player, uint64_t opp, uint64_t legals, int32_t alpha, int32_t beta, uint64_t ttMove, uint64_t& best)
+	{
+		struct Candidate
+		{
+			int32_t key;
+			uint64_t bit, flips;
+		};
+		std::array<Candidate, 64> moves;
+		int32_t nMoves = 0, i, j;
+
+		// 置換表の手を先に、残りは相手の着手可能数が少ない順。同数なら隅と奇数区画を先にする
+		const uint64_t odd = oddQuadrants(~(player | opp));
+		while (legals)
+		{
+			const uint64_t bit = legals & (0 - legals);
+			legals ^= bit;
+			const uint64_t flips = calcFlips(player, opp, std::countr_zero(bit));
+
+			int32_t key;
+			if (bit == ttMove)
+			{
+				key = 1 << 20;
+			}
+			else
+			{
+				key = -16 * std::popcount(calcLegals(opp ^ flips, player ^ flips ^ bit));
+				if (bit & Corners) key += 8;
+				if (bit & odd) key += 4;
+			}
+
+			// 挿入ソート (合法手は多くても 30 程度)
+			for (j = nMoves++; j > 0 and moves[j - 1].key < key; j--) moves[j] = moves[j - 1];
+			moves[j] = { key, bit, flips };
+		}
+
+		int32_t maxScore = -ScoreInf, g;
+		for (i = 0; i < nMoves; i++)
+		{
+			const uint64_t nextPlayer = opp ^ moves[i].flips;
+			const uint64_t nextOpp = player ^ moves[i].flips ^ moves[i].bit;
+
+			// 最初の手だけ全幅で読み、残りは alpha を超えるかだけ null window で確かめる
+			if (i == 0)
+			{
+				g = -search(nextPlayer, nextOpp, -beta, -alpha, false);
+			}
+			else
+			{
+				g = -search(nextPlayer, nextOpp, -alpha - 1, -alpha, false);
+				if (alpha < g and g < beta) g = -search(nextPlayer, nextOpp, -beta, -g, false);
+			}
+			if (m_stopped) return 0;
+
+			if (g > maxScore)
+			{
+				maxScore = g;
+				best = moves[i].bit;
+			}
+			if (g >= beta) break;
+			alpha = std::max(alpha, g);
+		}
+		return maxScore;
+	}
+
+	int32_t EndgameSolver::searchParity(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, bool passed)
+	{
+		const uint64_t empties = ~(player | opp);
+		if (std::popcount(empties) <= 4) return searchLast(player, opp, alpha, beta);
+		if (countNode()) return 0;
+
+		const uint64_t legals = calcLegals(player, opp);
+		if (legals == 0)
+		{
+			if (passed) return finalScore(player, opp);
+			return -searchParity(opp, player, -beta, -alpha, true);
+		}
+
+		// 奇数個の空きがある区画に打てば、その区画の最後の 1 マスを自分が取りやすい
+		const uint64_t odd = oddQuadrants(empties);
+		int32_t maxScore = -ScoreInf, g;
+		for (uint64_t moves : { legals & odd, legals & ~odd })
+		{
+			while (moves)
+			{
+				const int32_t sq = std::countr_zero(moves);
+				const uint64_t bit = 1ull << sq;
+				moves ^= bit;
+
+				const uint64_t flips = calcFlips(player, opp, sq);
+				g = -searchParity(opp ^ flips, player ^ flips ^ bit, -beta, -alpha, false);
+				if (m_stopped) return 0;
+
+				if (g > maxScore) maxScore = g;
+				if (g >= beta) return g;
+				alpha = std::max(alpha, g);
+			}
+		}
+		return maxScore;
+	}
+
+	int32_t EndgameSolver::searchLast(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta)
+	{
+		// 空きマスを奇数区画のものから並べる
+		const uint64_t empties = ~(player | opp);
+		const uint64_t odd = oddQuadrants(empties);
+		int32_t sq[4], n = 0;
+		for (uint64_t part : { empties & odd, empties & ~odd })
+		{
+			for (; part; part &= part - 1) sq[n++] = std::countr_zero(part);
+		}
+
+		switch (n)
+		{
+		case 4: return solve4(player, opp, alpha, beta, sq[0], sq[1], sq[2], sq[3], false);
+		case 3: return solve3(player, opp, alpha, beta, sq[0], sq[1], sq[2], false);
+		case 2: return solve2(player, opp, alpha, beta, sq[0], sq[1], false);
+		case 1: return solve1(player, opp, sq[0]);
+		default: return finalScore(player, opp);
+		}
+	}
+
+	int32_t EndgameSolver::solve4(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, int32_t sq1, int32_t sq2, int32_t sq3, int32_t sq4, bool passed)
+	{
+		m_nodes++;
+		int32_t maxScore = -ScoreInf, g;
+		uint64_t flips;
+
+		if ((flips = calcFlips(player, opp, sq1)))
+		{
+			g = -solve3(opp ^ flips, player ^ flips ^ (1ull << sq1), -beta, -alpha, sq2, sq3, sq4, false);
+			if (g >= beta) return g;
+			maxScore = g;
+			alpha = std::max(alpha, g);
+		}
+		if ((flips = calcFlips(player, opp, sq2)))
+		{
+			g = -solve3(opp ^ flips, player ^ flips ^ (1ull << sq2), -beta, -alpha, sq1, sq3, sq4, false);
+			if (g >= beta) return g;
+			maxScore = std::max(maxScore, g);
+			alpha = std::max(alpha, g);
+		}
+		if ((flips = calcFlips(player, opp, sq3)))
+		{
+			g = -solve3(opp ^ flips, player ^ flips ^ (1ull << sq3), -beta, -alpha, sq1, sq2, sq4, false);
+			if (g >= beta) return g;
+			maxScore = std::max(maxScore, g);
+			alpha = std::max(alpha, g);
+		}
+		if ((flips = calcFlips(player, opp, sq4)))
+		{
+			g = -solve3(opp ^ flips, player ^ flips ^ (1ull << sq4), -beta, -alpha, sq1, sq2, sq3, false);
+			return std::max(maxScore, g);
+		}
+
+		if (maxScore == -ScoreInf)
+		{
+			if (passed) return finalScore(player, opp);
+			return -solve4(opp, player, -beta, -alpha, sq1, sq2, sq3, sq4, true);
+		}
+		return maxScore;
+	}
+
+	int32_t EndgameSolver::solve3(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, int32_t sq1, int32_t sq2, int32_t sq3, bool passed)
+	{
+		m_nodes++;
+		int32_t maxScore = -ScoreInf, g;
+		uint64_t flips;
+
+		if ((flips = calcFlips(player, opp, sq1)))
+		{
+			g = -solve2(opp ^ flips, player ^ flips ^ (1ull << sq1), -beta, -alpha, sq2, sq3, false);
+			if (g >= beta) return g;
+			maxScore = g;
+			alpha = std::max(alpha, g);
+		}
+		if ((flips = calcFlips(player, opp, sq2)))
+		{
+			g = -solve2(opp ^ flips, player ^ flips ^ (1ull << sq2), -beta, -alpha, sq1, sq3, false);
+			if (g >= beta) return g;
+			maxScore = std::max(maxScore, g);
+			alpha = std::max(alpha, g);
+		}
+		if ((flips = calcFlips(player, opp, sq3)))
+		{
+			g = -solve2(opp ^ flips, player ^ flips ^ (1ull << sq3), -beta, -alpha, sq1, sq2, false);
+			return std::max(maxScore, g);
+		}
+
+		if (maxScore == -ScoreInf)
+		{
+			if (passed) return finalScore(player, opp);
+			return -solve3(opp, player, -beta, -alpha, sq1, sq2, sq3, true);
+		}
+		return maxScore;
+	}
+
+	int32_t EndgameSolver::solve2(uint64_t player, uint64_t opp, int32_t alpha, int32_t beta, int32_t sq1, int32_t sq2, bool passed)
+	{
+		m_nodes++;
+		int32_t maxScore = -ScoreInf, g;
+		uint64_t flips;
+
+		if ((flips = calcFlips(player, opp, sq1)))
+		{
+			g = -solve1(opp ^ flips, player ^ flips ^ (1ull << sq1), sq2);
+			if (g >= beta) return g;
+			maxScore = g;
+		}
+		if ((flips = calcFlips(player, opp, sq2)))
+		{
+			g = -solve1(opp ^ flips, player ^ flips ^ (1ull << sq2), sq1);
+			return std::max(maxScore, g);
+		}
+
+		if (maxScore == -ScoreInf)
+		{
+			if (passed) return finalScore(player, opp);
+			return -solve2(opp, player, -beta, -alpha, sq1, sq2, true);
+		}
+		return maxScore;
+	}
+
+	int32_t EndgameSolver::solve1(uint64_t player, uint64_t opp, int32_t sq)
+	{
+		// 残り 1 マスなので石の数は 63。石差は手番側の石の数と裏返る石の数だけで決まる
+		m_nodes++;
+		const int32_t p = std::popcount(player);
+		uint64_t flips = calcFlips(player, opp, sq);
+		if (flips) return 2 * (p + std::popcount(flips)) - 62;
+
+		flips = calcFlips(opp, player, sq);
+		if (flips) return 2 * (p - std::popcount(flips)) - 64;
+
+		// どちらも打てない
+		return p > 31 ? 2 * p - 62 : 2 * p - 64;
+	}
+}
+
+namespace Reversi::Eval
+{
+	namespace
+	{
+		constexpr int32_t maxSquareFeatures()
+		{
+			int32_t res = 0;
+			for (const auto& sq : SquareToFeatures) res = std::max(res, sq.count);
+			return res;
+		}
+		static_assert(maxSquareFeatures() <= 8, "SquareFeatures::entries is too small");
+	}
+
+	void PatternState::reset(const ReversiEngine& engine)
+	{
+		const uint64_t blacks = engine.getBlacks(), whites = engine.getWhites();
+		for (int32_t f = 0; f < NumFeatures; ++f)
+		{
+			const int32_t size = ShapeSize[static_cast<int32_t>(Features[f].shape)];
+			int32_t index = 0;
+			for (int32_t i = 0; i < size; ++i)
+			{
+				const uint64_t bit = 1ull << Features[f].squares[i];
+				index = index * 3 + ((blacks & bit) ? 1 : (whites & bit) ? 2 : 0);
+			}
+			indices[f] = static_cast<uint16_t>(index);
+		}
+	}
+
+	PatternEvaluator::PatternEvaluator()
+	{
+		// 各マスの価値を、そのマスを含むパターンの数で割って配る。
+		// 全てのパターンを足すと、マスごとの価値の合計 (以前の静的評価) になる
+		int32_t coverage[64] = {};
+		for (const auto& f : Features)
+		{
+			for (int32_t i = 0; i < ShapeSize[static_cast<int32_t>(f.shape)]; ++i) coverage[f.squares[i]]++;
+		}
+
+		std::vector<int16_t> phase(PhaseSize);
+		for (int32_t s = 0; s < NumShapes; ++s)
+		{
+			// 同じ形のパターンは回転・反転しただけなので、先頭のものの配置で計算すればよい
+			const Feature* base = std::find_if(Features.begin(), Features.end(), [&](const Feature& f) { return static_cast<int32_t>(f.shape) == s; });
+			const int32_t size = ShapeSize[s];
+
+			for (int32_t index = 0; index < Pow3[size]; ++index)
+			{
+				double value = 0;
+				for (int32_t i = 0, rest = index; i < size; ++i, rest /= 3)
+				{
+					const int32_t sq = base->squares[size - 1 - i];
+					const int32_t digit = rest % 3;
+					if (digit == 0) continue;
+					value += (digit == 1 ? 1.0 : -1.0) * DefaultSquareValues::Values[63 - sq] / coverage[sq];
+				}
+				phase[ShapeOffset[s] + index] = static_cast<int16_t>(std::lround(value));
+			}
+		}
+
+		// 着手可能数 1 つにつき 1 石
+		for (int32_t n = 0; n < MobilitySize; ++n) phase[MobilityOffset + n] = static_cast<int16_t>(n * Scale);
+
+		std::vector<int16_t> weights(WeightCount);
+		for (int32_t p = 0; p < NumPhases; ++p)
+		{
+			std::copy(phase.begin(), phase.end(), weights.begin() + static_cast<size_t>(p) * PhaseSize);
+		}
+		setWeights(std::move(weights));
+	}
+
+	int32_t PatternEvaluator::evaluate(const PatternState& state, const ReversiEngine& engine) const
+	{
+		const int32_t discs = std::popcount(engine.getBlacks() | engine.getWhites());
+		const int16_t* w = m_weights + static_cast<size_t>(phaseOf(discs)) * PhaseSize;
+
+		int32_t score = 0;
+		for (int32_t f = 0; f < NumFeatures; ++f)
+		{
+			score += w[FeatureOffset[f] + state.indices[f]];
+		}
+		if (not engine.isBlackTurn()) score = -score;
+
+		score += w[MobilityOffset + std::popcount(engine.getLegals())];
+
+		return toDiscDiff(score);
+	}
+
+	bool PatternEvaluator::setWeights(std::vector<int16_t> weights)
+	{
+		if (weights.size() != WeightCount) return false;
+		auto owner = std::make_shared<const std::vector<int16_t>>(std::move(weights));
+		shareWeights(owner, owner->data());
+		return true;
+	}
+
+	void PatternEvaluator::shareWeights(std::shared_ptr<const void> owner, const int16_t* weights)
+	{
+		m_owner = std::move(owner);
+		m_weights = weights;
+	}
+
+	PatternEvaluator& defaultPatternEvaluator()
+	{
+		static PatternEvaluator evaluator;
+		return evaluator;
+	}
+}
+
+namespace Reversi::Eval
+{
+	/// @brief 重みファイルの先頭 (32 バイト)
+	/// ファイルではこの直後に int16_t の重みが count 個続きます。リトルエンディアンの環境で書いたものをそのまま読みます。
+	/// 先頭が 32 バイトなので、メモリに割り当てたファイルの重みも 32 バイト境界に揃います。
+	struct WeightFileHeader
+	{
+		char magic[4]; // "RVPW"。埋め込み用に圧縮したものは "RVPZ"
+		uint32_t version;
+		uint32_t numPhases;
+		uint32_t phaseSize;
+		uint64_t count; // 重みの数
+		uint32_t checksum; // 圧縮前の重みの CRC-32
+		uint32_t reserved;
+	};
+	static_assert(sizeof(WeightFileHeader) == 32, "WeightFileHeader must be 32 bytes");
+
+	/// @brief 重みファイルの版。形式を変えたら上げる
+	inline constexpr uint32_t WeightFileVersion = 2;
+
+	/// @brief CRC-32 (IEEE 802.3)
+	uint32_t crc32(const void* data, size_t size);
+
+	/// @brief PatternEvaluator の重みのヘッダを作ります
+	/// @param compressed 埋め込み用に圧縮したものなら true
+	WeightFileHeader makeWeightFileHeader(std::span<const int16_t> weights, bool compressed);
+
+	/// @brief ヘッダの識別子、版、大きさが今の PatternEvaluator と合うか確かめます (チェックサムは見ません)
+	bool isValidHeader(const WeightFileHeader& header, bool compressed);
+
+	/// @brief 重みを圧縮し、ソースコードに埋め込める base64 の文字列にします
+	/// 既定の重み (PatternEvaluator のコンストラクタのもの) との差を、0 の連続をまとめた可変長整数で並べます。
+	/// 局面集に現れず学習で変わらなかった重みは 0 の連続になります。
+	std::string encodeEmbeddedWeights(std::span<const int16_t> weights);
+
+	/// @brief encodeEmbeddedWeights の文字列を読んで評価関数に設定します
+	/// @param pieces 文字列を分けたもの (コンパイラの文字列リテラルの長さの制限のため)。つないで 1 つとして読みます
+	/// @return 読み込めれば true。空か壊れていれば評価関数は変えずに false
+	bool loadEmbeddedWeights(std::span<const char* const> pieces, PatternEvaluator& evaluator);
+}
+
+namespace Reversi::Eval
+{
+	namespace
+	{
+		struct NetworkFileHeader
+		{
+			char magic[4];
+			uint32_t version;
+			uint32_t inputSize;
+			uint32_t hidden1;
+			uint32_t hidden2;
+			uint32_t checksum; // 重みの CRC-32
+		};
+
+		constexpr char NetworkFileMagic[4] = { 'R', 'V', 'N', 'N' };
+		constexpr uint32_t NetworkFileVersion = 1;
+
+		/// @brief 1 層目の量子化した重みの上限。64 マス全てに石があっても 16 ビットで溢れないようにする
+		constexpr int32_t MaxWeight1 = 480;
+		constexpr int32_t MaxBias1 = 1000;
+
+		int32_t quantize(float value, float scale, int32_t limit)
+		{
+			return std::clamp(static_cast<int32_t>(std::lround(value * scale)), -limit, limit);
+		}
+
+		/// @brief 全ての重みを決まった順に 1 本に並べます (ファイルの中身とチェックサムの対象)
+		std::vector<float> flatten(const NNParameters& params)
+		{
+			std::vector<float> res;
+			for (const auto* v : { &params.w1, &params.b1, &params.w2, &params.b2, &params.w3 }) res.insert(res.end(), v->begin(), v->end());
+			res.push_back(params.b3);
+			return res;
+		}
+	}
+
+	NNParameters NNParameters::initial(uint64_t seed)
+	{
+		std::mt19937_64 rng(seed);
+		auto fill = [&](std::vector<float>& v, size_t size, float range)
+		{
+			std::uniform_real_distribution<float> dist(-range, range);
+			v.resize(size);
+			for (auto& x : v) x = dist(rng);
+		};
+
+		// 入力は 1 局面に高々 64 個しか立たないので小さめに、隠れ層は活性が [0, 1] の中に来るように
+		NNParameters res;
+		fill(res.w1, static_cast<size_t>(InputSize) * Hidden1, 0.1f);
+		res.b1.assign(Hidden1, 0.5f);
+		fill(res.w2, static_cast<size_t>(Hidden1) * Hidden2, std::sqrt(3.0f / Hidden1));
+		res.b2.assign(Hidden2, 0.5f);
+		fill(res.w3, Hidden2, std::sqrt(3.0f / Hidden2));
+		res.b3 = 0;
+		return res;
+	}
+
+	bool NNParameters::isValid() const
+	{
+		return w1.size() == static_cast<size_t>(InputSize) * Hidden1
+			and b1.size() == Hidden1
+			and w2.size() == static_cast<size_t>(Hidden1) * Hidden2
+			and b2.size() == Hidden2
+			and w3.size() == Hidden2;
+	}
+
+	bool saveNetworkFile(const std::string& path, const NNParameters& params)
+	{
+		if (not params.isValid()) return false;
+		std::ofstream ofs(path, std::ios::binary);
+		if (not ofs) return false;
+
+		const std::vector<float> data = flatten(params);
+		NetworkFileHeader header{ {}, NetworkFileVersion, NNParameters::InputSize, NNParameters::Hidden1, NNParameters::Hidden2,
+			crc32(data.data(), data.size() * sizeof(float)) };
+		std::memcpy(header.magic, NetworkFileMagic, sizeof(header.magic));
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		ofs.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size() * sizeof(float)));
+		return static_cast<bool>(ofs);
+	}
+
+	bool loadNetworkFile(const std::string& path, NNParameters& params)
+	{
+		std::ifstream ifs(path, std::ios::binary);
+		if (not ifs) return false;
+
+		NetworkFileHeader header{};
+		if (not ifs.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+		if (std::memcmp(header.magic, NetworkFileMagic, sizeof(header.magic)) != 0
+			or header.version != NetworkFileVersion
+			or header.inputSize != NNParameters::InputSize
+			or header.hidden1 != NNParameters::Hidden1
+			or header.hidden2 != NNParameters::Hidden2)
+		{
+			return false;
+		}
+
+		NNParameters res = NNParameters::initial(0);
+		std::vector<float> data = flatten(res);
+		if (not ifs.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size() * sizeof(float)))) return false;
+		if (crc32(data.data(), data.size() * sizeof(float)) != header.checksum) return false;
+
+		const float* p = data.data();
+		for (auto* v : { &res.w1, &res.b1, &res.w2, &res.b2, &res.w3 })
+		{
+			std::copy(p, p + v->size(), v->begin());
+			p += v->size();
+		}
+		res.b3 = *p;
+		params = std::move(res);
+		return true;
+	}
+
+	NNEvaluator::NNEvaluator() = default;
+
+	NNEvaluator::NNEvaluator(const NNParameters& params)
+	{
+		setParameters(params);
+	}
+
+	bool NNEvaluator::setParameters(const NNParameters& params)
+	{
+		if (not params.isValid()) return false;
+
+		for (int32_t sq = 0; sq < 64; ++sq)
+		{
+			for (int32_t h = 0; h < Hidden1; ++h)
+			{
+				m_black[sq][h] = static_cast<int16_t>(quantize(params.w1[static_cast<size_t>(sq) * Hidden1 + h], ActivationOne, MaxWeight1));
+				m_white[sq][h] = static_cast<int16_t>(quantize(params.w1[static_cast<size_t>(64 + sq) * Hidden1 + h], ActivationOne, MaxWeight1));
+				m_flip[sq][h] = static_cast<int16_t>(m_black[sq][h] - m_white[sq][h]);
+			}
+		}
+		for (int32_t h = 0; h < Hidden1; ++h) m_bias1[h] = static_cast<int16_t>(quantize(params.b1[h], ActivationOne, MaxBias1));
+
+		for (int32_t o = 0; o < Hidden2; ++o)
+		{
+			for (int32_t h = 0; h < Hidden1; ++h)
+			{
+				m_w2[o][h] = static_cast<int16_t>(quantize(params.w2[static_cast<size_t>(h) * Hidden2 + o], Weight2One, 32767));
+			}
+			m_b2[o] = quantize(params.b2[o], static_cast<float>(ActivationOne * Weight2One), 1 << 30);
+			m_w3[o] = quantize(params.w3[o], DiscScale, 1 << 24);
+		}
+		m_b3 = quantize(params.b3, DiscScale, 1 << 24);
+		return true;
+	}
+
+	void NNEvaluator::reset(NNState& state, const ReversiEngine& engine) const
+	{
+		state.acc = m_bias1;
+		for (uint64_t b = engine.getBlacks(); b; b &= b - 1) add(state, m_black[std::countr_zero(b)]);
+		for (uint64_t w = engine.getWhites(); w; w &= w - 1) add(state, m_white[std::countr_zero(w)]);
+	}
+
+	int32_t NNEvaluator::evaluateRaw(const NNState& state) const
+	{
+		std::array<int32_t, Hidden2> a2;
+
+#ifdef REVERSI_SIMD_AVX2
+		// 1 層目の活性 [0, 127]
+		__m256i a1[Hidden1 / 16];
+		for (int32_t i = 0; i < Hidden1 / 16; ++i)
+		{
+			const __m256i acc = _mm256_load_si256(reinterpret_cast<const __m256i*>(state.acc.data() + 16 * i));
+			a1[i] = _mm256_min_epi16(_mm256_max_epi16(acc, _mm256_setzero_si256()), _mm256_set1_epi16(ActivationOne));
+		}
+
+		// 2 層目: 出力 8 個ずつ、積和 (madd) の 8 レーンを水平に足し合わせる
+		for (int32_t o = 0; o < Hidden2; o += 8)
+		{
+			__m256i sums[8];
+			for (int32_t k = 0; k < 8; ++k)
+			{
+				const __m256i* w = reinterpret_cast<const __m256i*>(m_w2[o + k].data());
+				__m256i s = _mm256_madd_epi16(a1[0], _mm256_load_si256(w));
+				for (int32_t i = 1; i < Hidden1 / 16; ++i) s = _mm256_add_epi32(s, _mm256_madd_epi16(a1[i], _mm256_load_si256(w + i)));
+				sums[k] = s;
+			}
+			const __m256i s01 = _mm256_hadd_epi32(sums[0], sums[1]);
+			const __m256i s23 = _mm256_hadd_epi32(sums[2], sums[3]);
+			const __m256i s45 = _mm256_hadd_epi32(sums[4], sums[5]);
+			const __m256i s67 = _mm256_hadd_epi32(sums[6], sums[7]);
+			const __m256i s0123 = _mm256_hadd_epi32(s01, s23);
+			const __m256i s4567 = _mm256_hadd_epi32(s45, s67);
+			// 下位 128 ビットと上位 128 ビットを足すと、出力 o..o+7 が順に並ぶ
+			const __m256i lo = _mm256_permute2x128_si256(s0123, s4567, 0x20);
+			const __m256i hi = _mm256_permute2x128_si256(s0123, s4567, 0x31);
+			__m256i z = _mm256_add_epi32(_mm256_add_epi32(lo, hi), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m_b2.data() + o)));
+			z = _mm256_srai_epi32(z, std::countr_zero(static_cast<uint32_t>(Weight2One)));
+			z = _mm256_min_epi32(_mm256_max_epi32(z, _mm256_setzero_si256()), _mm256_set1_epi32(ActivationOne));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(a2.data() + o), z);
+		}
+#else
+		std::array<int32_t, Hidden1> a1;
+		for (int32_t h = 0; h < Hidden1; ++h) a1[h] = std::clamp<int32_t>(state.acc[h], 0, ActivationOne);
+
+		for (int32_t o = 0; o < Hidden2; ++o)
+		{
+			int32_t z = m_b2[o];
+			for (int32_t h = 0; h < Hidden1; ++h) z += a1[h] * m_w2[o][h];
+			a2[o] = std::clamp(z >> std::countr_zero(static_cast<uint32_t>(Weight2One)), 0, ActivationOne);
+		}
+#endif
+
+		int32_t out = 0;
+		for (int32_t o = 0; o < Hidden2; ++o) out += a2[o] * m_w3[o];
+		return out / ActivationOne + m_b3;
+	}
+
+	int32_t NNEvaluator::evaluate(const NNState& state, const ReversiEngine& engine) const
+	{
+		const int32_t score = evaluateRaw(state);
+		return toDiscDiff(engine.isBlackTurn() ? score : -score);
+	}
+}
+
+namespace Reversi::Eval
+{
+	namespace
+	{
+		constexpr char RawMagic[4] = { 'R', 'V', 'P', 'W' };
+		constexpr char CompressedMagic[4] = { 'R', 'V', 'P', 'Z' };
+
+		constexpr std::array<uint32_t, 256> Crc32Table = []
+		{
+			std::array<uint32_t, 256> res{};
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t c = i;
+				for (int32_t k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+				res[i] = c;
+			}
+			return res;
+		}();
+
+		constexpr char Base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+		constexpr std::array<int8_t, 256> Base64Values = []
+		{
+			std::array<int8_t, 256> res{};
+			res.fill(-1);
+			for (int32_t i = 0; i < 64; ++i) res[static_cast<uint8_t>(Base64Chars[i])] = static_cast<int8_t>(i);
+			return res;
+		}();
+
+		void putVarint(std::string& out, uint32_t value)
+		{
+			for (; value >= 0x80; value >>= 7) out += static_cast<char>((value & 0x7F) | 0x80);
+			out += static_cast<char>(value);
+		}
+
+		bool getVarint(const std::string& in, size_t& pos, uint32_t& value)
+		{
+			value = 0;
+			for (int32_t shift = 0; shift < 35; shift += 7)
+			{
+				if (pos >= in.size()) return false;
+				const uint8_t byte = static_cast<uint8_t>(in[pos++]);
+				value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+				if (not (byte & 0x80)) return true;
+			}
+			return false;
+		}
+
+		std::string toBase64(const std::string& bytes)
+		{
+			std::string res;
+			res.reserve((bytes.size() + 2) / 3 * 4);
+			uint32_t buffer = 0;
+			int32_t bits = 0;
+			for (const char c : bytes)
+			{
+				buffer = (buffer << 8) | static_cast<uint8_t>(c);
+				for (bits += 8; bits >= 6; bits -= 6) res += Base64Chars[(buffer >> (bits - 6)) & 63];
+			}
+			if (bits > 0) res += Base64Chars[(buffer << (6 - bits)) & 63];
+			return res;
+		}
+
+		/// @brief base64 を読みます。改行などの base64 でない文字は読み飛ばします
+		std::string fromBase64(std::span<const char* const> pieces)
+		{
+			std::string res;
+			uint32_t buffer = 0;
+			int32_t bits = 0;
+			for (const char* piece : pieces)
+			{
+				for (; *piece; ++piece)
+				{
+					const int32_t value = Base64Values[static_cast<uint8_t>(*piece)];
+					if (value < 0) continue;
+					buffer = (buffer << 6) | static_cast<uint32_t>(value);
+					bits += 6;
+					if (bits >= 8)
+					{
+						bits -= 8;
+						res += static_cast<char>((buffer >> bits) & 0xFF);
+					}
+				}
+			}
+			return res;
+		}
+	}
+
+	uint32_t crc32(const void* data, size_t size)
+	{
+		const uint8_t* p = static_cast<const uint8_t*>(data);
+		uint32_t c = 0xFFFFFFFF;
+		for (size_t i = 0; i < size; ++i) c = Crc32Table[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+		return c ^ 0xFFFFFFFF;
+	}
+
+	WeightFileHeader makeWeightFileHeader(std::span<const int16_t> weights, bool compressed)
+	{
+		WeightFileHeader header{ {}, WeightFileVersion, PatternEvaluator::NumPhases, PatternEvaluator::PhaseSize,
+			weights.size(), crc32(weights.data(), weights.size_bytes()), 0 };
+		std::memcpy(header.magic, compressed ? CompressedMagic : RawMagic, sizeof(header.magic));
+		return header;
+	}
+
+	bool isValidHeader(const WeightFileHeader& header, bool compressed)
+	{
+		return std::memcmp(header.magic, compressed ? CompressedMagic : RawMagic, sizeof(header.magic)) == 0
+			and header.version == WeightFileVersion
+			and header.numPhases == PatternEvaluator::NumPhases
+			and header.phaseSize == PatternEvaluator::PhaseSize
+			and header.count == PatternEvaluator::WeightCount;
+	}
+
+	std::string encodeEmbeddedWeights(std::span<const int16_t> weights)
+	{
+		const WeightFileHeader header = makeWeightFileHeader(weights, true);
+		const PatternEvaluator defaults;
+		const auto base = defaults.weights();
+
+		std::string bytes(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (size_t i = 0; i < weights.size(); )
+		{
+			// 0 の連続は (長さ << 1) | 1、それ以外は差をジグザグ符号化して << 1
+			const int32_t diff = weights[i] - base[i];
+			if (diff == 0)
+			{
+				size_t j = i;
+				while (j < weights.size() and weights[j] == base[j]) ++j;
+				putVarint(bytes, static_cast<uint32_t>(j - i) << 1 | 1);
+				i = j;
+			}
+			else
+			{
+				const uint32_t zigzag = static_cast<uint32_t>(diff << 1) ^ static_cast<uint32_t>(diff >> 31);
+				putVarint(bytes, zigzag << 1);
+				++i;
+			}
+		}
+		return toBase64(bytes);
+	}
+
+	bool loadEmbeddedWeights(std::span<const char* const> pieces, PatternEvaluator& evaluator)
+	{
+		const std::string bytes = fromBase64(pieces);
+		if (bytes.size() < sizeof(WeightFileHeader)) return false;
+
+		WeightFileHeader header;
+		std::memcpy(&header, bytes.data(), sizeof(header));
+		if (not isValidHeader(header, true)) return false;
+
+		const PatternEvaluator defaults;
+		const auto base = defaults.weights();
+		std::vector<int16_t> weights(base.begin(), base.end());
+		size_t pos = sizeof(header), i = 0;
+		uint32_t token;
+
+		while (pos < bytes.size())
+		{
+			if (not getVarint(bytes, pos, token)) return false;
+			if (token & 1)
+			{
+				i += token >> 1;
+			}
+			else
+			{
+				if (i >= weights.size()) return false;
+				const uint32_t zigzag = token >> 1;
+				const int32_t diff = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+				weights[i] = static_cast<int16_t>(base[i] + diff);
+				++i;
+			}
+		}
+
+		if (i != weights.size() or crc32(weights.data(), weights.size() * sizeof(int16_t)) != header.checksum) return false;
+		return evaluator.setWeights(std::move(weights));
+	}
+}
+
+// CodinGame 版に埋め込む重み。Tools/Tuner embed で学習した重みファイルから作り直します
+// 空のままなら既定の重みを使います。
+namespace Reversi::Eval
+{
+	inline constexpr const char* EmbeddedWeights[] = {
+		"",
+	};
+}
+
+using namespace std;
+
+int main()
+{
+	int id; // id of your player.
+	cin >> id; cin.ignore();
+	int board_size;
+	cin >> board_size; cin.ignore();
+
+	assert(board_size == 8);
+
+	// ファイルを読めないので、埋め込んだ重みがあればそれを使う
+	Reversi::Eval::loadEmbeddedWeights(Reversi::Eval::EmbeddedWeights, Reversi::Eval::defaultPatternEvaluator());
 
 	AlphaBetaAgent agent;
 	Reversi::ReversiEngine engine;
+	// 制限時間は 1 手目が 1000 ms、以降は 150 ms。入出力の分だけ余裕を残す
+	agent.setSearchDepth(60);
+	agent.setTimeControl({ 900, 0, 0 });
 
 	// game loop
 	while (1) {
@@ -502,120 +3008,333 @@ int main()
 		auto action = agent.play(engine);
 
 		cout << char('a' + action.first) << char('1' + action.second) << endl;
+		agent.setTimeControl({ 130, 0, 0 });
 	}
 }
 
-AlphaBetaAgent::AlphaBetaAgent()
+AlphaBetaAgent::AlphaBetaAgent(size_t hashSizeMB) :
+	transTable(hashSizeMB), endgameSolver(hashSizeMB)
+{
+	endgameSolver.setStopCallback([this]
+	{
+		checkStop();
+		return stopped.load();
+	});
+}
+
+void AlphaBetaAgent::setHashSize(size_t hashSizeMB)
+{
+	transTable.resize(hashSizeMB);
+}
+
+void AlphaBetaAgent::clearHash()
+{
+	transTable.clear();
+	endgameSolver.clearHash();
+}
+
+void AlphaBetaAgent::setSearchDepth(int32_t depth)
+{
+	searchDepth = std::max(depth, 1);
+}
+
+void AlphaBetaAgent::setEndgameEmpties(int32_t empties)
+{
+	endgameEmpties = std::max(empties, 0);
+}
+
+void AlphaBetaAgent::setEvaluator(const Reversi::Eval::PatternEvaluator& evaluator_)
+{
+	evaluator = &evaluator_;
+}
+
+void AlphaBetaAgent::setNetwork(const Reversi::Eval::NNEvaluator* network_)
+{
+	network = network_;
+}
+
+void AlphaBetaAgent::setThreadCount(int32_t threads)
 {
+	threadCount = std::max(threads, 1);
+}
 
+void AlphaBetaAgent::setAspiration(int32_t window, int32_t growth)
+{
+	aspirationWindow = std::max(window, 0);
+	aspirationGrowth = std::clamp(growth, 2, 16);
 }
 
 AlphaBetaAgent::Pos AlphaBetaAgent::play(const Reversi::ReversiEngine& engine)
 {
+	searchStart = std::chrono::steady_clock::now();
 	callCnt = 0;
-	Reversi::ReversiEngine env = engine;
-	if (not env.isBlackTurn()) env.swapBW(); // 黒を扱いたい
-	const uint64_t prevBlacks = env.getBlacks(), prevWhites = env.getWhites();
-	const int32_t SEARCH_DEPTH = 6;
+	lastDepth = 0;
+	stopped = false;
+	m_searchStats = SearchStats();
+
+	Worker main;
+	main.engine = engine;
+	if (not main.engine.isBlackTurn()) main.engine.swapBW(); // 黒を扱いたい
+	main.network = network;
+	if (network) network->reset(main.nn, main.engine);
+	else main.patterns.reset(main.engine);
+
+	// 打てる手が無ければ読むものが無い。ルートの値が -inf のままになり、窓を広げる繰り返しが終わらなくなる
+	if (main.engine.getLegals() == 0)
+	{
+		m_searchStats.timeUs = elapsedUs();
+		return bit2pos(0);
+	}
 
-	int32_t best = -1, score, alpha = -inf, beta = inf, depth;
-	std::vector<LegalState> legals;
+	const int32_t empties = 64 - std::popcount(main.engine.getBlacks() | main.engine.getWhites());
+	budget = getTimeBudget(empties);
 
-	for (depth = 0; depth < SEARCH_DEPTH; depth++)
+	if (empties <= endgameEmpties)
 	{
-		if (isAborted()) break;
-		alpha = -inf, beta = inf;
+		// 勝敗までは求まれば、その手は評価関数で読んだ手より確か
+		const auto res = endgameSolver.solve(main.engine);
+		callCnt = endgameSolver.getNodeCount();
+		if (res.bestMove != 0)
+		{
+			lastDepth = res.completed ? empties : 0;
+			m_searchStats.nodes = callCnt;
+			m_searchStats.depth = lastDepth;
+			m_searchStats.timeUs = elapsedUs();
+			return bit2pos(res.bestMove);
+		}
+		stopped = false;
+	}
 
-		getSortedLegals(env, legals);
+	// 置換表は反復の間も手の間も持ち越す。世代だけ進めて古いエントリを置き換えやすくする
+	transTable.newSearch();
 
-		for (auto [v, idx] : legals)
+	// 補助スレッドの結果は置換表を通してだけ主スレッドに伝わる
+	std::vector<Worker> helpers(threadCount - 1);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < helpers.size(); i++)
+	{
+		helpers[i].engine = main.engine;
+		helpers[i].patterns = main.patterns;
+		helpers[i].nn = main.nn;
+		helpers[i].network = main.network;
+		helpers[i].id = static_cast<int32_t>(i + 1);
+		threads.emplace_back(&AlphaBetaAgent::helperSearch, this, std::ref(helpers[i]));
+	}
+
+	uint64_t best = 0, iterBest;
+	int32_t depth, score, alpha, beta, delta;
+	int32_t prevScore[2] = {};
+
+	for (depth = 1; depth <= searchDepth; depth++)
+	{
+		if (isAborted()) break;
+		// 次の反復は終わりそうにないので始めない。深さ 1 だけは必ず読む
+		if (depth > 1 and budget.softMs >= 0 and elapsedMs() >= budget.softMs) break;
+
+		// 偶奇の同じ前の反復の値の近くに窓を絞り、外れたら外れた側だけ広げて読み直す
+		delta = aspirationWindow;
+		alpha = depth > 2 and delta > 0 ? std::max(prevScore[depth & 1] - delta, -inf) : -inf;
+		beta = depth > 2 and delta > 0 ? std::min(prevScore[depth & 1] + delta, inf) : inf;
+		while (true)
 		{
-			env.place(idx & 7, idx >> 3);
-			score = -negaAlpha(env, depth + 1, false, -beta, -alpha);
+			iterBest = best;
+			score = searchRoot(main, depth, alpha, beta, iterBest);
+			if (stopped) break;
 
-			if (alpha < score)
-			{
-				alpha = score;
-				best = idx;
-			}
+			if (score <= alpha) alpha = std::max(score - (delta = std::min(delta * aspirationGrowth, inf)), -inf);
+			else if (score >= beta) beta = std::min(score + (delta = std::min(delta * aspirationGrowth, inf)), inf);
+			else break;
+		}
+
+		// 途中で打ち切った反復の結果は使わない
+		if (stopped) break;
+
+		best = iterBest;
+		prevScore[depth & 1] = score;
+		lastDepth = depth;
+		// 補助スレッドのノードは読み終えるまで数えられないので、反復ごとの数は主スレッドの分だけ
+		m_searchStats.iterations.push_back({ depth, score, main.stats.nodes, elapsedUs() });
+	}
+
+	stopped = true;
+	for (auto& thread : threads) thread.join();
+
+	m_searchStats += main.stats;
+	for (const auto& helper : helpers) m_searchStats += helper.stats;
+	callCnt += m_searchStats.nodes;
+	m_searchStats.nodes = callCnt;
+	m_searchStats.depth = lastDepth;
+	m_searchStats.timeUs = elapsedUs();
+
+	// 1 回目の反復も終わらなかったときは、並べ替えで先頭に来た手を指す
+	if (best == 0)
+	{
+		LegalList legals;
+		if (getSortedLegals(main, legals, 0) > 0) best = legals[0].move.bit;
+	}
+	return bit2pos(best);
+}
+
+int32_t AlphaBetaAgent::searchRoot(Worker& worker, int32_t depth, int32_t alpha, int32_t beta, uint64_t& bestMove)
+{
+	LegalList legals;
+	const int32_t nLegals = getSortedLegals(worker, legals, bestMove);
+	const int32_t alphaOrig = alpha;
+	int32_t maxScore = -inf, score, i;
+	uint64_t best = 0;
+
+	// 補助スレッドは置換表の手の後ろをずらし、主スレッドと別の部分木から読み始める
+	if (worker.id > 0 and nLegals > 2)
+	{
+		std::rotate(legals.begin() + 1, legals.begin() + 1 + worker.id % (nLegals - 1), legals.begin() + nLegals);
+	}
+
+	for (i = 0; i < nLegals; i++)
+	{
+		const auto& move = legals[i].move;
+		doMove(worker, move);
+		// 最初の手だけ窓全体で読み、残りは alpha を超えるかだけ null window で確かめる
+		if (i == 0)
+		{
+			score = -negaAlpha(worker, depth - 1, false, -beta, -alpha);
+		}
+		else
+		{
+			score = -negaAlpha(worker, depth - 1, false, -alpha - 1, -alpha);
+			if (alpha < score and score < beta) score = -negaAlpha(worker, depth - 1, false, -beta, -score);
+		}
+		undoMove(worker, move);
+		if (stopped) return maxScore;
 
-			env.setState(prevBlacks, prevWhites, true);
+		if (score > maxScore)
+		{
+			maxScore = score;
+			best = move.bit;
 		}
-		transTable.swap(transTablePrev);
-		transTable.clear();
+		if (score >= beta) break;
+		alpha = std::max(alpha, score);
+	}
+
+	// 窓より下に外れたら、どの手も上限しか分からないので最善手は前のままにする
+	if (maxScore > alphaOrig) bestMove = best;
+	const Reversi::Bound bound = maxScore >= beta ? Reversi::Bound::Lower
+		: maxScore > alphaOrig ? Reversi::Bound::Exact : Reversi::Bound::Upper;
+	storeEntry(worker, maxScore, depth, bound, bestMove);
+	return maxScore;
+}
+
+void AlphaBetaAgent::helperSearch(Worker& worker)
+{
+	uint64_t best = 0;
+	// 奇数番は 1 つ深い所から読み、主スレッドより先の深さの置換表を埋める
+	for (int32_t depth = 1 + (worker.id & 1); depth <= searchDepth; depth++)
+	{
+		searchRoot(worker, depth, -inf, inf, best);
+		if (stopped) return;
 	}
-	return { best & 7, best >> 3 };
+}
+
+int64_t AlphaBetaAgent::elapsedMs() const
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - searchStart).count();
+}
+
+int64_t AlphaBetaAgent::elapsedUs() const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - searchStart).count();
+}
+
+void AlphaBetaAgent::checkStop()
+{
+	if (isAborted() or (budget.hardMs >= 0 and elapsedMs() >= budget.hardMs)) stopped = true;
 }
 
 void AlphaBetaAgent::reset_child()
 {
 }
 
-int32_t AlphaBetaAgent::negaAlpha(Reversi::ReversiEngine& engine, int32_t depth, bool passed, int32_t alpha, int32_t beta)
+int32_t AlphaBetaAgent::negaAlpha(Worker& worker, int32_t depth, bool passed, int32_t alpha, int32_t beta)
 {
-	callCnt++;
-	if (depth == 0) return eval(engine);
-	if (transTable.contains(engine.getTupleState())) return transTable[engine.getTupleState()];
+	REVERSI_TRACE_ZONE("negaAlpha");
+	Reversi::ReversiEngine& engine = worker.engine;
+
+	// 打ち切ったら値は使われないので、置換表に書かずにすぐ戻る
+	if ((++worker.stats.nodes & (TimeCheckInterval - 1)) == 0) checkStop();
+	if (stopped) return 0;
+	if (depth == 0) return eval(worker);
+
+	// 十分な深さで探索済みなら、値の種類に応じて使い回す。足りなくても最善手は並べ替えに使う
+	Reversi::TTEntry entry;
+	uint64_t ttMove = 0;
+	worker.stats.ttProbes++;
+	if (transTable.probe(engine.getHash(), entry))
+	{
+		worker.stats.ttHits++;
+		if (entry.bestMove != Reversi::TTEntry::NoMove) ttMove = 1ull << entry.bestMove;
+		if (entry.depth >= depth)
+		{
+			if (entry.bound == Reversi::Bound::Exact) return entry.score;
+			if (entry.bound == Reversi::Bound::Lower and entry.score >= beta) return entry.score;
+			if (entry.bound == Reversi::Bound::Upper and entry.score <= alpha) return entry.score;
+		}
+	}
 
-	const uint64_t prevBlacks = engine.getBlacks(), prevWhites = engine.getWhites();
-	const bool prevBlackTurn = engine.isBlackTurn();
-	int32_t maxScore = -inf, g = 0;
+	const int32_t alphaOrig = alpha;
+	int32_t maxScore = -inf, g = 0, nLegals, i;
+	uint64_t best = 0;
 
-	std::vector<LegalState> legals;
-	getSortedLegals(engine, legals);
+	LegalList legals;
+	nLegals = getSortedLegals(worker, legals, ttMove);
 
-	for (auto [v, idx] : legals)
+	// fail-soft: 窓の外に出た値もそのまま返し、境界値として保存する
+	for (i = 0; i < nLegals; i++)
 	{
-		engine.place(idx & 7, idx >> 3);
-		g = -negaAlpha(engine, depth - 1, false, -beta, -alpha);
-		if (g >= beta) return g;
+		const auto& move = legals[i].move;
+		doMove(worker, move);
+		// ルートと同じ PVS。null window で alpha を超えた手だけ窓全体で読み直す
+		if (i == 0)
+		{
+			g = -negaAlpha(worker, depth - 1, false, -beta, -alpha);
+		}
+		else
+		{
+			g = -negaAlpha(worker, depth - 1, false, -alpha - 1, -alpha);
+			if (alpha < g and g < beta) g = -negaAlpha(worker, depth - 1, false, -beta, -g);
+		}
+		undoMove(worker, move);
+		if (stopped) return 0;
+		if (g > maxScore)
+		{
+			maxScore = g;
+			best = move.bit;
+		}
+		if (g >= beta)
+		{
+			worker.stats.cutNodes++;
+			if (i == 0) worker.stats.firstMoveCuts++;
+			break;
+		}
 		alpha = std::max(alpha, g);
-		maxScore = std::max(maxScore, g);
-		engine.setState(prevBlacks, prevWhites, prevBlackTurn);
-	}
-
-	if (maxScore != -inf) return transTable[engine.getTupleState()] = maxScore; // 操作をした
-
-	if (passed) return transTable[engine.getTupleState()] = eval(engine); // パスの連続
-
-	// 初回のパス
-	engine.pass();
-	maxScore = -negaAlpha(engine, depth - 1, true, -beta, -alpha);
-	engine.pass();
-	return transTable[engine.getTupleState()] = maxScore;
-}
-
-inline int32_t AlphaBetaAgent::eval(const Reversi::ReversiEngine& engine) const
-{
-	uint64_t black = engine.getBlacks(), white = engine.getWhites();
-	int32_t score = 0;
-	score += rowValues[(0 << 8) + ((black & 0xFF00000000000000) >> 56)];
-	score += rowValues[(1 << 8) + ((black & 0x00FF000000000000) >> 48)];
-	score += rowValues[(2 << 8) + ((black & 0x0000FF0000000000) >> 40)];
-	score += rowValues[(3 << 8) + ((black & 0x000000FF00000000) >> 32)];
-	score += rowValues[(4 << 8) + ((black & 0x00000000FF000000) >> 24)];
-	score += rowValues[(5 << 8) + ((black & 0x0000000000FF0000) >> 16)];
-	score += rowValues[(6 << 8) + ((black & 0x000000000000FF00) >> 8)];
-	score += rowValues[(7 << 8) + ((black & 0x00000000000000FF))];
-	score -= rowValues[(0 << 8) + ((white & 0xFF00000000000000) >> 56)];
-	score -= rowValues[(1 << 8) + ((white & 0x00FF000000000000) >> 48)];
-	score -= rowValues[(2 << 8) + ((white & 0x0000FF0000000000) >> 40)];
-	score -= rowValues[(3 << 8) + ((white & 0x000000FF00000000) >> 32)];
-	score -= rowValues[(4 << 8) + ((white & 0x00000000FF000000) >> 24)];
-	score -= rowValues[(5 << 8) + ((white & 0x0000000000FF0000) >> 16)];
-	score -= rowValues[(6 << 8) + ((white & 0x000000000000FF00) >> 8)];
-	score -= rowValues[(7 << 8) + ((white & 0x00000000000000FF))];
-
-	if (not engine.isBlackTurn()) score = -score;
-	if (score > 0) // 四捨五入のため
-		score += 128;
-	else
-		score -= 128;
-	score /= 256; // 生の評価値は最終石差の256倍なので、256で割る
-	if (score > 64) score = 64; // 評価値を[-64, 64] に収める
-	else if (score < -64) score = -64;
-
-	score += std::popcount(engine.getLegals());
-
-	return score;
+	}
+
+	if (maxScore == -inf)
+	{
+		if (passed) // パスの連続
+		{
+			maxScore = eval(worker);
+			storeEntry(worker, maxScore, depth, Reversi::Bound::Exact, 0);
+			return maxScore;
+		}
+
+		// 初回のパス
+		engine.pass();
+		maxScore = -negaAlpha(worker, depth - 1, true, -beta, -alpha);
+		engine.pass();
+		if (stopped) return 0;
+	}
+
+	const Reversi::Bound bound = maxScore >= beta ? Reversi::Bound::Lower
+		: maxScore > alphaOrig ? Reversi::Bound::Exact : Reversi::Bound::Upper;
+	storeEntry(worker, maxScore, depth, bound, best);
+	return maxScore;
 }
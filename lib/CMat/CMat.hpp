@@ -1,4 +1,5 @@
 ﻿# pragma once
 
 # include "CMat/Matrix.hpp"
+# include "CMat/Expression.hpp"
 # include "CMat/Operations.hpp"
@@ -0,0 +1,40 @@
+﻿# pragma once
+
+# include <cstddef>
+# include <new>
+
+namespace CMat
+{
+	/// @brief Align バイト境界に揃えたメモリを返すアロケータ
+	/// 既定の 64 はキャッシュラインの大きさで、AVX2 と AVX-512 のロードも境界をまたぎません。
+	template<class _Dty, size_t Align = 64>
+	struct AlignedAllocator
+	{
+		using value_type = _Dty;
+
+		template<class _Other>
+		struct rebind
+		{
+			using other = AlignedAllocator<_Other, Align>;
+		};
+
+		AlignedAllocator() noexcept = default;
+		template<class _Other>
+		AlignedAllocator(const AlignedAllocator<_Other, Align>&) noexcept {}
+
+		_Dty* allocate(size_t n)
+		{
+			return static_cast<_Dty*>(::operator new(n * sizeof(_Dty), std::align_val_t(Align)));
+		}
+
+		void deallocate(_Dty* p, size_t) noexcept
+		{
+			::operator delete(p, std::align_val_t(Align));
+		}
+
+		template<class _Other>
+		bool operator==(const AlignedAllocator<_Other, Align>&) const noexcept { return true; }
+		template<class _Other>
+		bool operator!=(const AlignedAllocator<_Other, Align>&) const noexcept { return false; }
+	};
+}
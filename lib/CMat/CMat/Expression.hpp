@@ -0,0 +1,219 @@
+﻿# pragma once
+
+# include <string>
+# include <type_traits>
+# include "Matrix.hpp"
+# include "Simd.hpp"
+# include "View.hpp"
+
+namespace CMat
+{
+	namespace detail
+	{
+		/// @brief 式の葉になる行列 (CMat と MatView は読み取り専用のビューにして持ちます)
+		template<class _Dty>
+		class Leaf
+		{
+		private:
+			MatView<const _Dty> m_view;
+		public:
+			using value_type = _Dty;
+			using Simd = simd::Traits<_Dty>;
+
+			MatShape shape;
+
+			explicit Leaf(const MatView<const _Dty>& view) : m_view(view), shape(view.shape) {}
+
+			bool unitStride() const { return m_view.colStride() == 1 or shape.cols <= 1; }
+			_Dty at(uint32_t row, uint32_t col) const { return m_view(row, col); }
+			typename Simd::Vec packet(uint32_t row, uint32_t col) const { return Simd::load(&m_view(row, col)); }
+		};
+
+		/// @brief 全ての要素が同じ値の葉 (行列とスカラーの演算に使います)
+		template<class _Dty>
+		class ScalarLeaf
+		{
+		private:
+			_Dty m_value;
+		public:
+			using value_type = _Dty;
+			using Simd = simd::Traits<_Dty>;
+
+			MatShape shape;
+
+			ScalarLeaf(_Dty value, const MatShape& shape) : m_value(value), shape(shape) {}
+
+			bool unitStride() const { return true; }
+			_Dty at(uint32_t, uint32_t) const { return m_value; }
+			typename Simd::Vec packet(uint32_t, uint32_t) const { return Simd::broadcast(&m_value); }
+		};
+
+		struct Add
+		{
+			static constexpr const char* Symbol = "+";
+			template<class _Dty> static _Dty apply(_Dty a, _Dty b) { return a + b; }
+			template<class _Simd, class _Vec> static _Vec packet(_Vec a, _Vec b) { return _Simd::add(a, b); }
+		};
+
+		struct Sub
+		{
+			static constexpr const char* Symbol = "-";
+			template<class _Dty> static _Dty apply(_Dty a, _Dty b) { return a - b; }
+			template<class _Simd, class _Vec> static _Vec packet(_Vec a, _Vec b) { return _Simd::sub(a, b); }
+		};
+
+		struct Mul
+		{
+			static constexpr const char* Symbol = "*";
+			template<class _Dty> static _Dty apply(_Dty a, _Dty b) { return a * b; }
+			template<class _Simd, class _Vec> static _Vec packet(_Vec a, _Vec b) { return _Simd::mul(a, b); }
+		};
+
+		struct Div
+		{
+			static constexpr const char* Symbol = "/";
+			template<class _Dty> static _Dty apply(_Dty a, _Dty b) { return a / b; }
+			template<class _Simd, class _Vec> static _Vec packet(_Vec a, _Vec b) { return _Simd::div(a, b); }
+		};
+	}
+
+	/// @brief 要素ごとの二項演算の、まだ計算していない式
+	/// 部分式は値で、行列はビューで持つので、式を作っても行列はコピーしません。
+	/// CMat に代入するかビューに書き込むときに、全体を 1 回のループで計算します。
+	/// 式は元の行列への参照なので、auto で受けて文をまたいで持ち越してはいけません。
+	template<class _Op, class _L, class _R>
+	class BinaryExpr
+	{
+	private:
+		_L m_l;
+		_R m_r;
+	public:
+		using value_type = typename _L::value_type;
+		using Simd = simd::Traits<value_type>;
+		static_assert(std::is_same_v<value_type, typename _R::value_type>, "Element types of the operands don't match.");
+
+		MatShape shape;
+
+		BinaryExpr(const _L& l, const _R& r) : m_l(l), m_r(r), shape(l.shape)
+		{
+			if (l.shape != r.shape)
+				throw std::invalid_argument(std::string("Two shape of operand for operator ") + _Op::Symbol + " doesn't match.");
+		}
+
+		bool unitStride() const { return m_l.unitStride() and m_r.unitStride(); }
+		value_type at(uint32_t row, uint32_t col) const { return _Op::apply(m_l.at(row, col), m_r.at(row, col)); }
+		typename Simd::Vec packet(uint32_t row, uint32_t col) const
+		{
+			return _Op::template packet<Simd>(m_l.packet(row, col), m_r.packet(row, col));
+		}
+	};
+
+	template<class _Op, class _L, class _R>
+	struct IsMatExpr<BinaryExpr<_Op, _L, _R>> : std::true_type {};
+
+	namespace detail
+	{
+		template<class _Dty>
+		Leaf<_Dty> asNode(const CMat<_Dty>& m) { return Leaf<_Dty>(m.view()); }
+
+		template<class _Dty>
+		Leaf<std::remove_const_t<_Dty>> asNode(const MatView<_Dty>& v) { return Leaf<std::remove_const_t<_Dty>>(v); }
+
+		template<class _Op, class _L, class _R>
+		const BinaryExpr<_Op, _L, _R>& asNode(const BinaryExpr<_Op, _L, _R>& e) { return e; }
+
+		template<class _Expr>
+		using NodeOf = std::remove_cvref_t<decltype(asNode(std::declval<const _Expr&>()))>;
+
+		template<class _Op, class _L, class _R>
+		BinaryExpr<_Op, NodeOf<_L>, NodeOf<_R>> makeBinary(const _L& l, const _R& r)
+		{
+			return BinaryExpr<_Op, NodeOf<_L>, NodeOf<_R>>(asNode(l), asNode(r));
+		}
+
+		template<class _Op, class _L, class _Scalar>
+		auto makeBinaryScalar(const _L& l, _Scalar s)
+		{
+			using T = typename NodeOf<_L>::value_type;
+			return BinaryExpr<_Op, NodeOf<_L>, ScalarLeaf<T>>(asNode(l), ScalarLeaf<T>(static_cast<T>(s), l.shape));
+		}
+
+		template<class _Op, class _Scalar, class _R>
+		auto makeScalarBinary(_Scalar s, const _R& r)
+		{
+			using T = typename NodeOf<_R>::value_type;
+			return BinaryExpr<_Op, ScalarLeaf<T>, NodeOf<_R>>(ScalarLeaf<T>(static_cast<T>(s), r.shape), asNode(r));
+		}
+
+		template<class _Dty, class _Expr>
+		void evaluate(const MatView<_Dty>& dst, const _Expr& expr)
+		{
+			static_assert(not std::is_const_v<_Dty>, "Cannot write to a read-only view.");
+			if (dst.shape != expr.shape) throw std::invalid_argument("Shape of the expression doesn't match the destination.");
+
+			const auto node = asNode(expr);
+			using Simd = simd::Traits<_Dty>;
+			const bool vectorize = Simd::Enabled and dst.colStride() == 1 and node.unitStride();
+
+			for (uint32_t r = 0; r < dst.shape.rows; ++r)
+			{
+				_Dty* out = &dst(r, 0);
+				uint32_t c = 0;
+				if constexpr (Simd::Enabled)
+				{
+					if (vectorize)
+					{
+						for (; c + Simd::Width <= dst.shape.cols; c += Simd::Width) Simd::store(out + c, node.packet(r, c));
+					}
+				}
+				for (; c < dst.shape.cols; ++c) out[c * dst.colStride()] = node.at(r, c);
+			}
+		}
+	}
+
+	template<class _L, class _R> requires (IsMatExprV<_L> and IsMatExprV<_R>)
+	auto operator+(const _L& l, const _R& r) { return detail::makeBinary<detail::Add>(l, r); }
+	template<class _L, class _R> requires (IsMatExprV<_L> and IsMatExprV<_R>)
+	auto operator-(const _L& l, const _R& r) { return detail::makeBinary<detail::Sub>(l, r); }
+	template<class _L, class _R> requires (IsMatExprV<_L> and IsMatExprV<_R>)
+	auto operator*(const _L& l, const _R& r) { return detail::makeBinary<detail::Mul>(l, r); }
+	template<class _L, class _R> requires (IsMatExprV<_L> and IsMatExprV<_R>)
+	auto operator/(const _L& l, const _R& r) { return detail::makeBinary<detail::Div>(l, r); }
+
+	template<class _L, class _S> requires (IsMatExprV<_L> and std::is_arithmetic_v<_S>)
+	auto operator+(const _L& l, _S s) { return detail::makeBinaryScalar<detail::Add>(l, s); }
+	template<class _L, class _S> requires (IsMatExprV<_L> and std::is_arithmetic_v<_S>)
+	auto operator-(const _L& l, _S s) { return detail::makeBinaryScalar<detail::Sub>(l, s); }
+	template<class _L, class _S> requires (IsMatExprV<_L> and std::is_arithmetic_v<_S>)
+	auto operator*(const _L& l, _S s) { return detail::makeBinaryScalar<detail::Mul>(l, s); }
+	template<class _L, class _S> requires (IsMatExprV<_L> and std::is_arithmetic_v<_S>)
+	auto operator/(const _L& l, _S s) { return detail::makeBinaryScalar<detail::Div>(l, s); }
+
+	template<class _S, class _R> requires (std::is_arithmetic_v<_S> and IsMatExprV<_R>)
+	auto operator+(_S s, const _R& r) { return detail::makeScalarBinary<detail::Add>(s, r); }
+	template<class _S, class _R> requires (std::is_arithmetic_v<_S> and IsMatExprV<_R>)
+	auto operator-(_S s, const _R& r) { return detail::makeScalarBinary<detail::Sub>(s, r); }
+	template<class _S, class _R> requires (std::is_arithmetic_v<_S> and IsMatExprV<_R>)
+	auto operator*(_S s, const _R& r) { return detail::makeScalarBinary<detail::Mul>(s, r); }
+	template<class _S, class _R> requires (std::is_arithmetic_v<_S> and IsMatExprV<_R>)
+	auto operator/(_S s, const _R& r) { return detail::makeScalarBinary<detail::Div>(s, r); }
+
+	/// 複合代入は a = a op b を a に直接書き込みます (一時的な行列を作りません)
+	template<class _Dty, class _R> requires (IsMatExprV<_R> or std::is_arithmetic_v<_R>)
+	CMat<_Dty>& operator+=(CMat<_Dty>& a, const _R& b) { detail::evaluate(a.view(), a + b); return a; }
+	template<class _Dty, class _R> requires (IsMatExprV<_R> or std::is_arithmetic_v<_R>)
+	CMat<_Dty>& operator-=(CMat<_Dty>& a, const _R& b) { detail::evaluate(a.view(), a - b); return a; }
+	template<class _Dty, class _R> requires (IsMatExprV<_R> or std::is_arithmetic_v<_R>)
+	CMat<_Dty>& operator*=(CMat<_Dty>& a, const _R& b) { detail::evaluate(a.view(), a * b); return a; }
+	template<class _Dty, class _R> requires (IsMatExprV<_R> or std::is_arithmetic_v<_R>)
+	CMat<_Dty>& operator/=(CMat<_Dty>& a, const _R& b) { detail::evaluate(a.view(), a / b); return a; }
+
+	template<class _Dty, class _R> requires (not std::is_const_v<_Dty> and (IsMatExprV<_R> or std::is_arithmetic_v<_R>))
+	const MatView<_Dty>& operator+=(const MatView<_Dty>& a, const _R& b) { detail::evaluate(a, a + b); return a; }
+	template<class _Dty, class _R> requires (not std::is_const_v<_Dty> and (IsMatExprV<_R> or std::is_arithmetic_v<_R>))
+	const MatView<_Dty>& operator-=(const MatView<_Dty>& a, const _R& b) { detail::evaluate(a, a - b); return a; }
+	template<class _Dty, class _R> requires (not std::is_const_v<_Dty> and (IsMatExprV<_R> or std::is_arithmetic_v<_R>))
+	const MatView<_Dty>& operator*=(const MatView<_Dty>& a, const _R& b) { detail::evaluate(a, a * b); return a; }
+	template<class _Dty, class _R> requires (not std::is_const_v<_Dty> and (IsMatExprV<_R> or std::is_arithmetic_v<_R>))
+	const MatView<_Dty>& operator/=(const MatView<_Dty>& a, const _R& b) { detail::evaluate(a, a / b); return a; }
+}
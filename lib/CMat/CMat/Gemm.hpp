@@ -0,0 +1,248 @@
+﻿# pragma once
+
+# include <algorithm>
+# include <atomic>
+# include <cstdint>
+# include <thread>
+# include <type_traits>
+# include <vector>
+# include "Allocator.hpp"
+# include "Simd.hpp"
+
+namespace CMat
+{
+	/// @brief 作業を呼び出したスレッドで順に実行します
+	struct SerialExecutor
+	{
+		template<class _Fn>
+		void operator()(uint32_t count, _Fn&& fn) const
+		{
+			for (uint32_t i = 0; i < count; ++i) fn(i);
+		}
+	};
+
+	/// @brief 作業を threads 個のスレッド (呼び出したスレッドを含む) に分けて実行します
+	struct ThreadExecutor
+	{
+		uint32_t threads = 1;
+
+		template<class _Fn>
+		void operator()(uint32_t count, _Fn&& fn) const
+		{
+			const uint32_t n = std::min(threads, count);
+			if (n <= 1)
+			{
+				SerialExecutor{}(count, fn);
+				return;
+			}
+
+			std::atomic<uint32_t> next = 0;
+			auto work = [&]()
+			{
+				for (uint32_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) fn(i);
+			};
+
+			std::vector<std::thread> workers;
+			workers.reserve(n - 1);
+			for (uint32_t t = 1; t < n; ++t) workers.emplace_back(work);
+			work();
+			for (auto& th : workers) th.join();
+		}
+	};
+
+	namespace detail
+	{
+		/// @brief GEMM のマイクロカーネルとブロックの大きさ
+		/// C の MR x NR の小行列をレジスタに置いたまま、詰め直した A と B の列と行の外積を KC 回足します。
+		template<class _Dty>
+		struct GemmKernel : simd::Traits<_Dty>
+		{
+		};
+
+		template<>
+		struct GemmKernel<float> : simd::Traits<float>
+		{
+			static constexpr uint32_t MR = 6, NR = 16;
+			static constexpr uint32_t MC = 72, KC = 256, NC = 1024;
+		};
+
+		template<>
+		struct GemmKernel<double> : simd::Traits<double>
+		{
+			static constexpr uint32_t MR = 6, NR = 8;
+			static constexpr uint32_t MC = 72, KC = 256, NC = 512;
+		};
+
+		/// @brief A の mc x kc のブロックを MR 行ずつの帯にし、帯の中は列ごとに MR 個並べます (足りない行は 0)
+		template<class _Dty, class _K = GemmKernel<_Dty>>
+		inline void packA(const _Dty* a, size_t rsa, size_t csa, uint32_t mc, uint32_t kc, _Dty* dst)
+		{
+			for (uint32_t i = 0; i < mc; i += _K::MR)
+			{
+				const uint32_t mr = std::min(_K::MR, mc - i);
+				for (uint32_t k = 0; k < kc; ++k)
+				{
+					uint32_t r = 0;
+					for (; r < mr; ++r) *dst++ = a[(i + r) * rsa + k * csa];
+					for (; r < _K::MR; ++r) *dst++ = 0;
+				}
+			}
+		}
+
+		/// @brief B の kc x nc のブロックを NR 列ずつの帯にし、帯の中は行ごとに NR 個並べます (足りない列は 0)
+		template<class _Dty, class _K = GemmKernel<_Dty>>
+		inline void packB(const _Dty* b, size_t rsb, size_t csb, uint32_t kc, uint32_t nc, _Dty* dst)
+		{
+			for (uint32_t j = 0; j < nc; j += _K::NR)
+			{
+				const uint32_t nr = std::min(_K::NR, nc - j);
+				if (nr == _K::NR and csb == 1)
+				{
+					// 行の中が連続した帯はベクトル単位で写す
+					for (uint32_t k = 0; k < kc; ++k, dst += _K::NR)
+					{
+						const _Dty* src = b + k * rsb + j;
+						for (uint32_t v = 0; v < _K::NR; v += _K::Width) _K::store(dst + v, _K::load(src + v));
+					}
+					continue;
+				}
+				for (uint32_t k = 0; k < kc; ++k)
+				{
+					const _Dty* src = b + k * rsb + j * csb;
+					uint32_t c = 0;
+					if (csb == 1)
+					{
+						for (; c < nr; ++c) *dst++ = src[c];
+					}
+					else
+					{
+						for (; c < nr; ++c) *dst++ = src[c * csb];
+					}
+					for (; c < _K::NR; ++c) *dst++ = 0;
+				}
+			}
+		}
+
+		/// @brief C[mr x nr] += (詰めた A の帯) * (詰めた B の帯)
+		template<class _Dty, class _K = GemmKernel<_Dty>>
+		inline void microKernel(uint32_t kc, const _Dty* ap, const _Dty* bp, _Dty* c, size_t ldc, uint32_t mr, uint32_t nr)
+		{
+			constexpr uint32_t MR = _K::MR;
+			constexpr uint32_t V = _K::NR / _K::Width;
+			using Vec = typename _K::Vec;
+			static_assert(MR == 6 and V == 2, "The micro kernel is written for 6 rows x 2 vectors.");
+
+			// 配列とループで書くとコンパイラが全てをレジスタに置かないので、12 個のアキュムレータを並べて書く
+			Vec c00 = _K::zero(), c01 = _K::zero(), c10 = _K::zero(), c11 = _K::zero(), c20 = _K::zero(), c21 = _K::zero();
+			Vec c30 = _K::zero(), c31 = _K::zero(), c40 = _K::zero(), c41 = _K::zero(), c50 = _K::zero(), c51 = _K::zero();
+
+			for (uint32_t k = 0; k < kc; ++k)
+			{
+				const Vec b0 = _K::load(bp), b1 = _K::load(bp + _K::Width);
+				Vec a = _K::broadcast(ap + 0);
+				c00 = _K::fma(a, b0, c00); c01 = _K::fma(a, b1, c01);
+				a = _K::broadcast(ap + 1);
+				c10 = _K::fma(a, b0, c10); c11 = _K::fma(a, b1, c11);
+				a = _K::broadcast(ap + 2);
+				c20 = _K::fma(a, b0, c20); c21 = _K::fma(a, b1, c21);
+				a = _K::broadcast(ap + 3);
+				c30 = _K::fma(a, b0, c30); c31 = _K::fma(a, b1, c31);
+				a = _K::broadcast(ap + 4);
+				c40 = _K::fma(a, b0, c40); c41 = _K::fma(a, b1, c41);
+				a = _K::broadcast(ap + 5);
+				c50 = _K::fma(a, b0, c50); c51 = _K::fma(a, b1, c51);
+				ap += MR;
+				bp += _K::NR;
+			}
+			const Vec acc[MR][V] = { { c00, c01 }, { c10, c11 }, { c20, c21 }, { c30, c31 }, { c40, c41 }, { c50, c51 } };
+
+			if (mr == MR and nr == _K::NR)
+			{
+				for (uint32_t r = 0; r < MR; ++r)
+				{
+					_Dty* row = c + r * ldc;
+					for (uint32_t v = 0; v < V; ++v)
+					{
+						_K::store(row + v * _K::Width, _K::add(_K::load(row + v * _K::Width), acc[r][v]));
+					}
+				}
+				return;
+			}
+
+			// 端の小行列は一度書き出してから必要な所だけ足す
+			alignas(32) _Dty tmp[MR * _K::NR];
+			for (uint32_t r = 0; r < MR; ++r)
+			{
+				for (uint32_t v = 0; v < V; ++v) _K::store(tmp + r * _K::NR + v * _K::Width, acc[r][v]);
+			}
+			for (uint32_t r = 0; r < mr; ++r)
+			{
+				for (uint32_t j = 0; j < nr; ++j) c[r * ldc + j] += tmp[r * _K::NR + j];
+			}
+		}
+
+		/// @brief C[m x n] += A[m x k] * B[k x n]
+		/// A と B は行と列の間隔 (要素数) を別々に持つので、転置したビューもそのまま渡せます。C は行優先です。
+		/// B を KC x NC (L3)、A を MC x KC (L2) のブロックに詰め直し、C の MC 行ごとのタイルを executor で並列に計算します。
+		template<class _Dty, class _Exec>
+		inline void gemm(uint32_t m, uint32_t n, uint32_t k, const _Dty* a, size_t rsa, size_t csa, const _Dty* b, size_t rsb, size_t csb, _Dty* c, size_t ldc, _Exec&& executor)
+		{
+			using K = GemmKernel<_Dty>;
+
+			if constexpr (not K::Enabled)
+			{
+				// SIMD の無い型は i-k-j の順に足す
+				executor(m, [&](uint32_t i)
+				{
+					_Dty* crow = c + i * ldc;
+					for (uint32_t p = 0; p < k; ++p)
+					{
+						const _Dty aip = a[i * rsa + p * csa];
+						const _Dty* brow = b + p * rsb;
+						for (uint32_t j = 0; j < n; ++j) crow[j] += aip * brow[j * csb];
+					}
+				});
+			}
+			else
+			{
+				if (m == 0 or n == 0 or k == 0) return;
+
+				// 詰めた B の領域はスレッドごとに使い回し、小さな行列積を繰り返しても確保し直さない
+				thread_local std::vector<_Dty, AlignedAllocator<_Dty>> bPacked;
+				const size_t bSize = static_cast<size_t>(std::min(k, K::KC)) * ((std::min(n, K::NC) + K::NR - 1) / K::NR * K::NR);
+				if (bPacked.size() < bSize) bPacked.resize(bSize);
+				const uint32_t tiles = (m + K::MC - 1) / K::MC;
+
+				for (uint32_t jc = 0; jc < n; jc += K::NC)
+				{
+					const uint32_t nc = std::min(K::NC, n - jc);
+					for (uint32_t pc = 0; pc < k; pc += K::KC)
+					{
+						const uint32_t kc = std::min(K::KC, k - pc);
+						packB(b + pc * rsb + jc * csb, rsb, csb, kc, nc, bPacked.data());
+						// bPacked は呼び出したスレッドのものなので、タイルを読む他のスレッドにはポインタで渡す
+						const _Dty* const bPanel = bPacked.data();
+
+						executor(tiles, [&](uint32_t tile)
+						{
+							const uint32_t ic = tile * K::MC;
+							const uint32_t mc = std::min(K::MC, m - ic);
+							alignas(64) _Dty aPacked[K::MC * K::KC];
+							packA(a + ic * rsa + pc * csa, rsa, csa, mc, kc, aPacked);
+
+							for (uint32_t jr = 0; jr < nc; jr += K::NR)
+							{
+								const _Dty* bp = bPanel + static_cast<size_t>(jr) * kc;
+								for (uint32_t ir = 0; ir < mc; ir += K::MR)
+								{
+									microKernel(kc, aPacked + ir * kc, bp, c + (ic + ir) * ldc + jc + jr, ldc,
+										std::min(K::MR, mc - ir), std::min(K::NR, nc - jr));
+								}
+							}
+						});
+					}
+				}
+			}
+		}
+	}
+}
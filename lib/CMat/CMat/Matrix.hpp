@@ -5,22 +5,30 @@
 # include <cstdint>
 # include <stdexcept>
 # include <immintrin.h>
+# include "Allocator.hpp"
 # include "Shape.hpp"
+# include "Transpose.hpp"
+# include "View.hpp"
 
 namespace CMat
 {
 
+	/// @brief 行優先に並べた密な行列
+	/// 要素は 64 バイト境界に揃えて確保します。
 	template<class _Dty>
 	class CMat
 	{
+	public:
+		using value_type = _Dty;
+		using Storage = std::vector<_Dty, AlignedAllocator<_Dty>>;
+
 	private:
-		std::vector<_Dty> m_data;
-		MatShape m_strides;
+		Storage m_data;
 	public:
 		MatShape shape;
 
-		CMat() : shape(0, 0), m_strides(0, 0) {}
-		CMat(const std::initializer_list<_Dty>& init) : m_data(init.begin(), init.end()), shape(1, init.size()), m_strides(init.size(), 1) {}
+		CMat() : shape(0, 0) {}
+		CMat(const std::initializer_list<_Dty>& init) : m_data(init.begin(), init.end()), shape(1, static_cast<uint32_t>(init.size())) {}
 
 		CMat(const std::initializer_list<std::initializer_list<_Dty>>& init)
 		{
@@ -39,53 +47,61 @@ namespace CMat
 			}
 		}
 
-		CMat(const MatShape& shape): m_data(shape.cols * shape.rows), shape(shape) {}
+		CMat(const MatShape& shape): m_data(static_cast<size_t>(shape.cols) * shape.rows), shape(shape) {}
+
+		/// @brief 式 (a * b + c など) を 1 回で計算して行列を作ります
+		template<class _Expr> requires (IsMatExprV<_Expr> and not std::is_same_v<std::remove_cvref_t<_Expr>, CMat>)
+		CMat(const _Expr& expr) : CMat(expr.shape)
+		{
+			detail::evaluate(view(), expr);
+		}
+
+		/// @brief 式を計算して代入します。大きさが違えば作り直します
+		/// 要素ごとの演算なので右辺に自分が現れてもよいですが、転置したビューなど並びの違う自分を含めてはいけません。
+		template<class _Expr> requires (IsMatExprV<_Expr> and not std::is_same_v<std::remove_cvref_t<_Expr>, CMat>)
+		CMat& operator=(const _Expr& expr)
+		{
+			if (shape != expr.shape)
+			{
+				CMat res(expr);
+				return *this = std::move(res);
+			}
+			detail::evaluate(view(), expr);
+			return *this;
+		}
 
 		_Dty* data() { return m_data.data(); }
 		const _Dty* data() const { return m_data.data(); }
-		size_t size() { return m_data.size(); }
+		size_t size() const { return m_data.size(); }
 
+		MatView<_Dty> view() { return MatView<_Dty>(data(), shape, shape.cols); }
+		MatView<const _Dty> view() const { return MatView<const _Dty>(data(), shape, shape.cols); }
 
-		inline CMat& transpose()
-		{
-			constexpr bool is_float = std::is_same_v<_Dty, float>;
-			constexpr bool is_double = std::is_same_v<_Dty, double>;
+		/// @brief (row, col) から rows x cols の部分行列のビュー
+		MatView<_Dty> block(uint32_t row, uint32_t col, uint32_t rows, uint32_t cols) { return view().block(row, col, rows, cols); }
+		MatView<const _Dty> block(uint32_t row, uint32_t col, uint32_t rows, uint32_t cols) const { return view().block(row, col, rows, cols); }
 
-			std::vector<_Dty>res(shape.cols * shape.rows);
-			uint32_t i, j, k;
+		MatView<_Dty> row(uint32_t row) { return view().row(row); }
+		MatView<const _Dty> row(uint32_t row) const { return view().row(row); }
+		MatView<_Dty> col(uint32_t col) { return view().col(col); }
+		MatView<const _Dty> col(uint32_t col) const { return view().col(col); }
 
-			for (i = 0; i < shape.rows; ++i)
-			{
-				j = 0;
-				if constexpr (is_float)
-				{
-					for (; j + 8 <= shape.cols; j += 8)
-					{
-						__m256 vec = _mm256_loadu_ps(&m_data[i * shape.cols + j]);
-						for (k = 0; k < 8; ++k)
-						{
-							res[(j + k) * shape.rows + i] = ((float*)&vec)[k];
-						}
-					}
-				}
-				else if constexpr (is_double)
-				{
-					for (; j + 4 <= shape.cols; j += 4)
-					{
-						__m256 vec = _mm256_loadu_pd(&m_data[i * shape.cols + j]);
-						for (k = 0; k < 4; ++k)
-						{
-							res[(j + k) * shape.rows + i] = ((float*)&vec)[k];
-						}
-					}
-				}
+		/// @brief 転置したビュー。transposed() と違ってコピーしません
+		MatView<_Dty> transposedView() { return view().transposedView(); }
+		MatView<const _Dty> transposedView() const { return view().transposedView(); }
 
-				for (; j < shape.cols; ++j)
-				{
-					res[j * shape.rows + i] = m_data[i * shape.cols + j];
-				}
+
+		/// @brief 転置します。正方行列はその場で、それ以外は新しい領域に書いてから入れ替えます
+		inline CMat& transpose()
+		{
+			if (shape.rows == shape.cols)
+			{
+				detail::transposeSquareInPlace(data(), shape.cols, shape.rows);
+				return *this;
 			}
 
+			Storage res(m_data.size());
+			detail::transposeBlock(data(), shape.cols, res.data(), shape.rows, shape.rows, shape.cols);
 			m_data.swap(res);
 			std::swap(shape.cols, shape.rows);
 			return *this;
@@ -93,7 +109,9 @@ namespace CMat
 
 		inline CMat transposed() const
 		{
-			return CMat(*this).transpose();
+			CMat res(MatShape{ shape.cols, shape.rows });
+			detail::transposeBlock(data(), shape.cols, res.data(), shape.rows, shape.rows, shape.cols);
+			return res;
 		}
 
 #ifdef SIV3D_INCLUDED
@@ -107,8 +125,8 @@ namespace CMat
 				else formatData.string += U"  {";
 				for (uint32_t j : step(value.shape.cols))
 				{
-					if (j == 0) formatData.string += U" {}"_fmt(value.m_data[i * value.shape.rows + j]);
-					else formatData.string += U", {}"_fmt(value.m_data[i * value.shape.rows + j]);
+					if (j == 0) formatData.string += U" {}"_fmt(value.m_data[i * value.shape.cols + j]);
+					else formatData.string += U", {}"_fmt(value.m_data[i * value.shape.cols + j]);
 				}
 
 				if (i == value.shape.rows - 1) formatData.string += U" }";
@@ -119,4 +137,7 @@ namespace CMat
 
 #endif
 	};
+
+	template<class _Dty>
+	struct IsMatExpr<CMat<_Dty>> : std::true_type {};
 };
@@ -1,138 +1,65 @@
 ﻿# pragma once
 
 # include "Matrix.hpp"
+# include "Expression.hpp"
+# include "Gemm.hpp"
 # include "Shape.hpp"
 
 namespace CMat
 {
-	template<class _Dty>
-	CMat<_Dty>& operator+=(CMat<_Dty>& a, const CMat<_Dty>& b)
+	namespace detail
 	{
-		if (a.shape != b.shape) throw std::invalid_argument("Two shape of operand for operator + doesn't match.");
+		template<class _Dty>
+		MatView<const _Dty> asMatrixView(const CMat<_Dty>& m) { return m.view(); }
 
-		_Dty* p = a.data();
-		const _Dty* q = b.data();
-		const _Dty* end = p + a.size();
+		template<class _Dty>
+		MatView<const _Dty> asMatrixView(const MatView<_Dty>& v) { return v; }
 
-		while (p != end)
-		{
-			*p++ += *q++;
-		}
-		return a;
-	}
-
-	template<class _Dty>
-	CMat<_Dty>& operator-=(CMat<_Dty>& a, const CMat<_Dty>& b)
-	{
-		if (a.shape != b.shape) throw std::invalid_argument("Two shape of operand for operator - doesn't match.");
-
-		_Dty* p = a.data();
-		const _Dty* q = b.data();
-		const _Dty* end = p + a.size();
-
-		while (p != end)
-		{
-			*p++ -= *q++;
-		}
-		return a;
-	}
+		template<class _Dty>
+		MatView<_Dty> asWritableView(CMat<_Dty>& m) { return m.view(); }
 
-	template<class _Dty>
-	CMat<_Dty>& operator*=(CMat<_Dty>& a, const CMat<_Dty>& b)
-	{
-		if (a.shape != b.shape) throw std::invalid_argument("Two shape of operand for operator * doesn't match.");
-
-		_Dty* p = a.data();
-		const _Dty* q = b.data();
-		const _Dty* end = p + a.size();
-
-		while (p != end)
-		{
-			*p++ *= *q++;
-		}
-		return a;
+		template<class _Dty> requires (not std::is_const_v<_Dty>)
+		MatView<_Dty> asWritableView(const MatView<_Dty>& v) { return v; }
 	}
 
-	template<class _Dty>
-	CMat<_Dty>& operator/=(CMat<_Dty>& a, const CMat<_Dty>& b)
-	{
-		if (a.shape != b.shape) throw std::invalid_argument("Two shape of operand for operator / doesn't match.");
-
-		_Dty* p = a.data();
-		const _Dty* q = b.data();
-		const _Dty* end = p + a.size();
+	/// @brief 行列積 a * b
+	/// a と b には CMat のほかに部分行列や転置のビューを渡せます (コピーせずに計算します)。
+	/// executor には SerialExecutor (既定) か ThreadExecutor{ スレッド数 } など、(個数, 関数) を受け取って
+	/// 関数を 0..個数-1 で 1 回ずつ呼ぶものを渡します。C の行のタイルをその単位で並列に計算します。
+	template<class _A, class _B, class _Exec = SerialExecutor>
+	inline auto matmul(const _A& a, const _B& b, _Exec&& executor = {}) {
+		const auto av = detail::asMatrixView(a);
+		const auto bv = detail::asMatrixView(b);
+		using _Dty = typename decltype(av)::value_type;
+		static_assert(std::is_same_v<_Dty, typename decltype(bv)::value_type>, "Element types of the operands don't match.");
+
+		if (av.shape.cols != bv.shape.rows)
+			throw std::invalid_argument("Number of cols for a and number of rows for b doesn't match.");
 
-		while (p != end)
-		{
-			*p++ /= *q++;
-		}
-		return a;
+		CMat<_Dty> c(MatShape{ av.shape.rows, bv.shape.cols });
+		detail::gemm(av.shape.rows, bv.shape.cols, av.shape.cols, av.data(), av.rowStride(), av.colStride(),
+			bv.data(), bv.rowStride(), bv.colStride(), c.data(), c.shape.cols, executor);
+		return c;
 	}
 
-	template<class _Dty>
-	CMat<_Dty> operator+(CMat<_Dty> a, const CMat<_Dty>& b) { return a += b; }
-	template<class _Dty>
-	CMat<_Dty> operator-(CMat<_Dty> a, const CMat<_Dty>& b) { return a -= b; }
-	template<class _Dty>
-	CMat<_Dty> operator*(CMat<_Dty> a, const CMat<_Dty>& b) { return a *= b; }
-	template<class _Dty>
-	CMat<_Dty> operator/(CMat<_Dty> a, const CMat<_Dty>& b) { return a /= b; }
-
+	/// @brief 行列積 a * b を確保済みの c (a.rows x b.cols) に書きます
+	/// c には CMat か、行の中が連続した (列の間隔が 1 の) 書き込めるビューを渡します。
+	/// 同じ大きさの計算を繰り返すときに、結果の行列を毎回確保せずに済みます。
+	template<class _C, class _A, class _B, class _Exec = SerialExecutor>
+	inline void matmulInto(_C&& c, const _A& a, const _B& b, _Exec&& executor = {}) {
+		const auto cv = detail::asWritableView(c);
+		const auto av = detail::asMatrixView(a);
+		const auto bv = detail::asMatrixView(b);
 
-	template<class _Dty>
-	inline CMat<_Dty> matmul(const CMat<_Dty>& a, const CMat<_Dty>& b) {
-		if (a.shape.cols != b.shape.rows)
+		if (av.shape.cols != bv.shape.rows)
 			throw std::invalid_argument("Number of cols for a and number of rows for b doesn't match.");
-
-		const CMat<_Dty> bt = b.transposed();
-		CMat<_Dty> c(MatShape{ a.shape.rows, b.shape.cols });
-
-		const _Dty* a_ptr = a.data();
-		_Dty* c_ptr = c.data();
-
-		constexpr bool is_float = std::is_same_v<_Dty, float>;
-		constexpr bool is_double = std::is_same_v<_Dty, double>;
-
-		const _Dty* bt_ptr;
-
-		for (uint32_t i = 0; i < c.shape.rows; ++i) {
-			bt_ptr = bt.data();
-			for (uint32_t j = 0; j < c.shape.cols; ++j) {
-				_Dty sum = 0;
-				uint32_t k = 0;
-
-				if constexpr (is_float) {
-					__m256 acc = _mm256_setzero_ps();
-					for (; k + 8 <= a.shape.cols; k += 8) {
-						__m256 va = _mm256_loadu_ps(a_ptr + k);
-						__m256 vb = _mm256_loadu_ps(bt_ptr + k);
-						acc = _mm256_fmadd_ps(va, vb, acc);
-					}
-					alignas(32) float temp[8];
-					_mm256_store_ps(temp, acc);
-					for (int l = 0; l < 8; ++l) sum += temp[l];
-				}
-				else if constexpr (is_double) {
-					__m256d acc = _mm256_setzero_pd();
-					for (; k + 4 <= a.shape.cols; k += 4) {
-						__m256d va = _mm256_loadu_pd(a_ptr + k);
-						__m256d vb = _mm256_loadu_pd(bt_ptr + k);
-						acc = _mm256_fmadd_pd(va, vb, acc);
-					}
-					alignas(32) double temp[4];
-					_mm256_store_pd(temp, acc);
-					for (int l = 0; l < 4; ++l) sum += temp[l];
-				}
-
-				for (; k < a.shape.cols; ++k) {
-					sum += a_ptr[k] * bt_ptr[k];
-				}
-
-				*c_ptr++ = sum;
-				bt_ptr += a.shape.cols;
-			}
-			a_ptr += a.shape.cols;
-		}
-		return c;
+		if (cv.shape.rows != av.shape.rows or cv.shape.cols != bv.shape.cols)
+			throw std::invalid_argument("Shape of c doesn't match the product.");
+		if (cv.colStride() != 1 and cv.shape.cols > 1)
+			throw std::invalid_argument("Rows of c need to be contiguous.");
+
+		for (uint32_t i = 0; i < cv.shape.rows; ++i) std::fill_n(&cv(i, 0), cv.shape.cols, 0);
+		detail::gemm(av.shape.rows, bv.shape.cols, av.shape.cols, av.data(), av.rowStride(), av.colStride(),
+			bv.data(), bv.rowStride(), bv.colStride(), cv.data(), cv.rowStride(), executor);
 	}
 }
@@ -1,5 +1,7 @@
 ﻿# pragma once
 
+# include <cstdint>
+
 namespace CMat
 {
 	class MatShape
@@ -10,7 +12,7 @@ namespace CMat
 		MatShape(): rows(0), cols(0) {}
 		MatShape(uint32_t r, uint32_t c): rows(r), cols(c) {}
 
-		bool operator==(const MatShape& a) { return rows == a.rows and cols == a.cols; }
-		bool operator!=(const MatShape& a) { return rows != a.rows or cols != a.cols; }
+		bool operator==(const MatShape& a) const { return rows == a.rows and cols == a.cols; }
+		bool operator!=(const MatShape& a) const { return rows != a.rows or cols != a.cols; }
 	};
 };
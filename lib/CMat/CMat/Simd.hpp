@@ -0,0 +1,50 @@
+﻿# pragma once
+
+# include <cstdint>
+# include <immintrin.h>
+
+namespace CMat::simd
+{
+	/// @brief 要素の型ごとの AVX2 の命令 (Enabled が false の型はスカラーで計算します)
+	template<class _Dty>
+	struct Traits
+	{
+		static constexpr bool Enabled = false;
+		using Vec = _Dty;
+		static constexpr uint32_t Width = 1;
+	};
+
+	template<>
+	struct Traits<float>
+	{
+		static constexpr bool Enabled = true;
+		using Vec = __m256;
+		static constexpr uint32_t Width = 8;
+		static Vec zero() { return _mm256_setzero_ps(); }
+		static Vec load(const float* p) { return _mm256_loadu_ps(p); }
+		static void store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+		static Vec broadcast(const float* p) { return _mm256_broadcast_ss(p); }
+		static Vec fma(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+		static Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+		static Vec sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+		static Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+		static Vec div(Vec a, Vec b) { return _mm256_div_ps(a, b); }
+	};
+
+	template<>
+	struct Traits<double>
+	{
+		static constexpr bool Enabled = true;
+		using Vec = __m256d;
+		static constexpr uint32_t Width = 4;
+		static Vec zero() { return _mm256_setzero_pd(); }
+		static Vec load(const double* p) { return _mm256_loadu_pd(p); }
+		static void store(double* p, Vec v) { _mm256_storeu_pd(p, v); }
+		static Vec broadcast(const double* p) { return _mm256_broadcast_sd(p); }
+		static Vec fma(Vec a, Vec b, Vec c) { return _mm256_fmadd_pd(a, b, c); }
+		static Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+		static Vec sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+		static Vec mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+		static Vec div(Vec a, Vec b) { return _mm256_div_pd(a, b); }
+	};
+}
@@ -0,0 +1,157 @@
+﻿# pragma once
+
+# include <algorithm>
+# include <cstddef>
+# include <cstdint>
+# include <utility>
+# include "Simd.hpp"
+
+namespace CMat
+{
+	namespace detail
+	{
+		/// @brief 転置の最小単位の正方タイルの大きさ (SIMD の幅。SIMD の無い型は 8)
+		template<class _Dty>
+		inline constexpr uint32_t TransposeTile = simd::Traits<_Dty>::Enabled ? simd::Traits<_Dty>::Width : 8;
+
+		/// @brief Tile x Tile の小行列を転置して dst に書きます
+		/// 全ての行を読んでから書くので、src と dst が同じ場所でも構いません。
+		template<class _Dty>
+		inline void transposeTile(const _Dty* src, size_t lds, _Dty* dst, size_t ldd)
+		{
+			constexpr uint32_t T = TransposeTile<_Dty>;
+			_Dty tmp[T][T];
+			for (uint32_t i = 0; i < T; ++i)
+			{
+				for (uint32_t j = 0; j < T; ++j) tmp[j][i] = src[i * lds + j];
+			}
+			for (uint32_t i = 0; i < T; ++i)
+			{
+				for (uint32_t j = 0; j < T; ++j) dst[i * ldd + j] = tmp[i][j];
+			}
+		}
+
+		/// @brief 8x8 の float をレジスタの中で転置します (unpack → shuffle → 128 ビットの入れ替え)
+		template<>
+		inline void transposeTile<float>(const float* src, size_t lds, float* dst, size_t ldd)
+		{
+			const __m256 r0 = _mm256_loadu_ps(src + 0 * lds), r1 = _mm256_loadu_ps(src + 1 * lds);
+			const __m256 r2 = _mm256_loadu_ps(src + 2 * lds), r3 = _mm256_loadu_ps(src + 3 * lds);
+			const __m256 r4 = _mm256_loadu_ps(src + 4 * lds), r5 = _mm256_loadu_ps(src + 5 * lds);
+			const __m256 r6 = _mm256_loadu_ps(src + 6 * lds), r7 = _mm256_loadu_ps(src + 7 * lds);
+
+			const __m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpackhi_ps(r0, r1);
+			const __m256 t2 = _mm256_unpacklo_ps(r2, r3), t3 = _mm256_unpackhi_ps(r2, r3);
+			const __m256 t4 = _mm256_unpacklo_ps(r4, r5), t5 = _mm256_unpackhi_ps(r4, r5);
+			const __m256 t6 = _mm256_unpacklo_ps(r6, r7), t7 = _mm256_unpackhi_ps(r6, r7);
+
+			const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+			const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+			const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0)), s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+			const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0)), s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+			_mm256_storeu_ps(dst + 0 * ldd, _mm256_permute2f128_ps(s0, s4, 0x20));
+			_mm256_storeu_ps(dst + 1 * ldd, _mm256_permute2f128_ps(s1, s5, 0x20));
+			_mm256_storeu_ps(dst + 2 * ldd, _mm256_permute2f128_ps(s2, s6, 0x20));
+			_mm256_storeu_ps(dst + 3 * ldd, _mm256_permute2f128_ps(s3, s7, 0x20));
+			_mm256_storeu_ps(dst + 4 * ldd, _mm256_permute2f128_ps(s0, s4, 0x31));
+			_mm256_storeu_ps(dst + 5 * ldd, _mm256_permute2f128_ps(s1, s5, 0x31));
+			_mm256_storeu_ps(dst + 6 * ldd, _mm256_permute2f128_ps(s2, s6, 0x31));
+			_mm256_storeu_ps(dst + 7 * ldd, _mm256_permute2f128_ps(s3, s7, 0x31));
+		}
+
+		/// @brief 4x4 の double をレジスタの中で転置します
+		template<>
+		inline void transposeTile<double>(const double* src, size_t lds, double* dst, size_t ldd)
+		{
+			const __m256d r0 = _mm256_loadu_pd(src + 0 * lds), r1 = _mm256_loadu_pd(src + 1 * lds);
+			const __m256d r2 = _mm256_loadu_pd(src + 2 * lds), r3 = _mm256_loadu_pd(src + 3 * lds);
+
+			const __m256d t0 = _mm256_unpacklo_pd(r0, r1), t1 = _mm256_unpackhi_pd(r0, r1);
+			const __m256d t2 = _mm256_unpacklo_pd(r2, r3), t3 = _mm256_unpackhi_pd(r2, r3);
+
+			_mm256_storeu_pd(dst + 0 * ldd, _mm256_permute2f128_pd(t0, t2, 0x20));
+			_mm256_storeu_pd(dst + 1 * ldd, _mm256_permute2f128_pd(t1, t3, 0x20));
+			_mm256_storeu_pd(dst + 2 * ldd, _mm256_permute2f128_pd(t0, t2, 0x31));
+			_mm256_storeu_pd(dst + 3 * ldd, _mm256_permute2f128_pd(t1, t3, 0x31));
+		}
+
+		/// @brief 再帰を止める小行列の一辺 (この大きさの src と dst が L1 に収まる)
+		inline constexpr uint32_t TransposeLeaf = 32;
+
+		/// @brief src (rows x cols) を転置して dst (cols x rows) に書きます
+		/// 長い方の辺をタイルの倍数の所で半分に分けていく、キャッシュの大きさによらない再帰です。
+		template<class _Dty>
+		inline void transposeBlock(const _Dty* src, size_t lds, _Dty* dst, size_t ldd, uint32_t rows, uint32_t cols)
+		{
+			constexpr uint32_t T = TransposeTile<_Dty>;
+
+			if (rows > TransposeLeaf or cols > TransposeLeaf)
+			{
+				if (rows >= cols)
+				{
+					const uint32_t half = (rows / 2 + T - 1) / T * T;
+					transposeBlock(src, lds, dst, ldd, half, cols);
+					transposeBlock(src + half * lds, lds, dst + half, ldd, rows - half, cols);
+				}
+				else
+				{
+					const uint32_t half = (cols / 2 + T - 1) / T * T;
+					transposeBlock(src, lds, dst, ldd, rows, half);
+					transposeBlock(src + half, lds, dst + half * ldd, ldd, rows, cols - half);
+				}
+				return;
+			}
+
+			const uint32_t fullRows = rows / T * T, fullCols = cols / T * T;
+			for (uint32_t i = 0; i < fullRows; i += T)
+			{
+				for (uint32_t j = 0; j < fullCols; j += T) transposeTile(src + i * lds + j, lds, dst + j * ldd + i, ldd);
+			}
+			// タイルに収まらない右端と下端
+			for (uint32_t i = 0; i < rows; ++i)
+			{
+				for (uint32_t j = (i < fullRows ? fullCols : 0); j < cols; ++j) dst[j * ldd + i] = src[i * lds + j];
+			}
+		}
+
+		/// @brief n x n の正方行列をその場で転置します
+		/// 対角のタイルはそのまま、対角をはさんだタイルの組は互いに転置して入れ替えます。
+		template<class _Dty>
+		inline void transposeSquareInPlace(_Dty* data, size_t ld, uint32_t n)
+		{
+			constexpr uint32_t T = TransposeTile<_Dty>;
+			const uint32_t full = n / T * T;
+			_Dty tmp[T * T];
+
+			for (uint32_t bi = 0; bi < full; bi += TransposeLeaf)
+			{
+				for (uint32_t bj = bi; bj < full; bj += TransposeLeaf)
+				{
+					const uint32_t iEnd = std::min(bi + TransposeLeaf, full), jEnd = std::min(bj + TransposeLeaf, full);
+					for (uint32_t i = bi; i < iEnd; i += T)
+					{
+						for (uint32_t j = std::max(bj, i); j < jEnd; j += T)
+						{
+							_Dty* a = data + i * ld + j;
+							if (i == j)
+							{
+								transposeTile(a, ld, a, ld);
+								continue;
+							}
+							_Dty* b = data + j * ld + i;
+							transposeTile(a, ld, tmp, T);
+							transposeTile(b, ld, a, ld);
+							for (uint32_t r = 0; r < T; ++r) std::copy_n(tmp + r * T, T, b + r * ld);
+						}
+					}
+				}
+			}
+			// タイルに収まらない右端の列と下端の行
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				for (uint32_t j = std::max(i + 1, full); j < n; ++j) std::swap(data[i * ld + j], data[j * ld + i]);
+			}
+		}
+	}
+}
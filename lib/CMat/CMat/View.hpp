@@ -0,0 +1,91 @@
+﻿# pragma once
+
+# include <cstddef>
+# include <cstdint>
+# include <stdexcept>
+# include <type_traits>
+# include <utility>
+# include "Shape.hpp"
+
+namespace CMat
+{
+	template<class _Dty>
+	class MatView;
+
+	/// @brief 要素ごとの式 (CMat, MatView, 演算子で作った式) か
+	template<class _Ty>
+	struct IsMatExpr : std::false_type {};
+
+	template<class _Ty>
+	inline constexpr bool IsMatExprV = IsMatExpr<std::remove_cvref_t<_Ty>>::value;
+
+	namespace detail
+	{
+		/// @brief 式を dst に書き込みます (Expression.hpp)
+		template<class _Dty, class _Expr>
+		void evaluate(const MatView<_Dty>& dst, const _Expr& expr);
+	}
+
+	/// @brief 行列の一部を指す、メモリを持たないビュー
+	/// 行と列の間隔 (要素数) を別々に持つので、部分行列、行、列、転置をコピー無しで表せます。
+	/// 書き込めるビューへの代入と複合代入は、指す先の要素を書き換えます。
+	/// 元の行列より長く使ってはいけません。
+	template<class _Dty>
+	class MatView
+	{
+	private:
+		_Dty* m_data;
+		size_t m_rowStride, m_colStride;
+	public:
+		using value_type = std::remove_const_t<_Dty>;
+
+		MatShape shape;
+
+		MatView(_Dty* data, const MatShape& shape, size_t rowStride, size_t colStride = 1) :
+			m_data(data), m_rowStride(rowStride), m_colStride(colStride), shape(shape) {}
+
+		MatView(const MatView&) = default;
+
+		/// @brief 書き込めるビューから読み取り専用のビューを作ります
+		template<class _Other> requires (std::is_same_v<const _Other, _Dty> and not std::is_same_v<_Other, _Dty>)
+		MatView(const MatView<_Other>& other) :
+			m_data(other.data()), m_rowStride(other.rowStride()), m_colStride(other.colStride()), shape(other.shape) {}
+
+		_Dty* data() const { return m_data; }
+		size_t rowStride() const { return m_rowStride; }
+		size_t colStride() const { return m_colStride; }
+		size_t size() const { return static_cast<size_t>(shape.rows) * shape.cols; }
+
+		_Dty& operator()(uint32_t row, uint32_t col) const { return m_data[row * m_rowStride + col * m_colStride]; }
+
+		/// @brief (row, col) から rows x cols の部分行列
+		MatView block(uint32_t row, uint32_t col, uint32_t rows, uint32_t cols) const
+		{
+			if (row + rows > shape.rows or col + cols > shape.cols)
+				throw std::out_of_range("Block is out of the matrix.");
+			return MatView(m_data + row * m_rowStride + col * m_colStride, MatShape{ rows, cols }, m_rowStride, m_colStride);
+		}
+
+		MatView row(uint32_t row) const { return block(row, 0, 1, shape.cols); }
+		MatView col(uint32_t col) const { return block(0, col, shape.rows, 1); }
+
+		/// @brief 転置したビュー (間隔を入れ替えるだけでコピーしません)
+		MatView transposedView() const { return MatView(m_data, MatShape{ shape.cols, shape.rows }, m_colStride, m_rowStride); }
+
+		MatView& operator=(const MatView& other)
+		{
+			detail::evaluate(*this, other);
+			return *this;
+		}
+
+		template<class _Expr> requires IsMatExprV<_Expr>
+		MatView& operator=(const _Expr& expr)
+		{
+			detail::evaluate(*this, expr);
+			return *this;
+		}
+	};
+
+	template<class _Dty>
+	struct IsMatExpr<MatView<_Dty>> : std::true_type {};
+};